@@ -0,0 +1,243 @@
+# frozen_string_literal: true
+
+# Measures the hot paths of the datadog_ci_native extension in isolation on a
+# synthetic project, so that per-line and per-allocation overhead regressions
+# show up before they show up as slower CI.
+#
+# Usage:
+#
+#   bundle exec rake compile_ext
+#   bundle exec ruby benchmarks/native_hot_paths.rb
+#
+# Environment:
+#
+#   FILES=2000            number of synthetic source files (one class each)
+#   LINES=20              lines executed per method call
+#   ROUNDS=5              rounds per benchmark, the median is reported
+#   THREADING_MODE=single DDCov threading mode for line events (single or
+#                         multi), allocation tracing always runs in multi
+#   OUTPUT=path.json      write results as JSON
+#   BASELINE=path.json    compare against results written by a previous run
+#                         and exit with status 1 on regressions
+#   THRESHOLD=0.25        allowed slowdown over the baseline (25%)
+
+require "fileutils"
+require "json"
+require "tmpdir"
+
+$LOAD_PATH.unshift(File.expand_path("../lib", __dir__))
+
+begin
+  require "datadog_ci_native.#{RUBY_VERSION}_#{RUBY_PLATFORM}"
+rescue LoadError
+  abort "datadog_ci_native is not compiled; run `bundle exec rake compile_ext`"
+end
+
+files_count = Integer(ENV.fetch("FILES", "2000"))
+lines_count = Integer(ENV.fetch("LINES", "20"))
+rounds = Integer(ENV.fetch("ROUNDS", "5"))
+threading_mode = ENV.fetch("THREADING_MODE", "single").to_sym
+threshold = Float(ENV.fetch("THRESHOLD", "0.25"))
+
+DDCov = Datadog::CI::TestImpactAnalysis::Coverage::DDCov
+
+# ---- Synthetic project -------------------------------------------------------
+
+def write_synthetic_file(path, module_name, class_name, lines_count)
+  body = Array.new(lines_count - 2) { "      value += 1" }.join("\n")
+
+  File.write(path, <<~RUBY)
+    module #{module_name}
+      class #{class_name}
+        def run(value)
+          value = value.to_i
+    #{body}
+          value
+        end
+      end
+    end
+  RUBY
+end
+
+root = File.realpath(Dir.mktmpdir("datadog-ci-native-benchmark"))
+ignored_path = File.join(root, "vendor")
+at_exit { FileUtils.rm_rf(root) }
+
+FileUtils.mkdir_p(File.join(root, "app"))
+FileUtils.mkdir_p(ignored_path)
+
+files_count.times do |index|
+  path = File.join(root, "app", "klass_#{index}.rb")
+  write_synthetic_file(path, "BenchmarkApp", "Klass#{index}", lines_count)
+  load path
+
+  path = File.join(ignored_path, "vendored_#{index}.rb")
+  write_synthetic_file(path, "BenchmarkVendor", "Vendored#{index}", lines_count)
+  load path
+end
+
+app_klasses = Array.new(files_count) { |index| BenchmarkApp.const_get("Klass#{index}") }
+app_objects = app_klasses.map(&:new)
+vendor_objects = Array.new(files_count) { |index| BenchmarkVendor.const_get("Vendored#{index}").new }
+
+# ---- Helpers -----------------------------------------------------------------
+
+def median(values)
+  sorted = values.sort
+  sorted[sorted.size / 2]
+end
+
+def measure
+  GC.start
+  started = Process.clock_gettime(Process::CLOCK_MONOTONIC, :nanosecond)
+  yield
+  Process.clock_gettime(Process::CLOCK_MONOTONIC, :nanosecond) - started
+end
+
+def new_coverage(root, ignored_path, threading_mode, use_allocation_tracing)
+  DDCov.new(
+    root: root,
+    ignored_path: ignored_path,
+    threading_mode: threading_mode,
+    use_allocation_tracing: use_allocation_tracing
+  )
+end
+
+# Runs the block with and without coverage and returns the overhead per
+# operation in nanoseconds.
+def coverage_overhead(rounds, operations, cov)
+  samples = Array.new(rounds) do
+    baseline = measure { yield }
+
+    cov.start
+    covered = measure { yield }
+    cov.stop
+
+    (covered - baseline).fdiv(operations)
+  end
+  median(samples)
+end
+
+results = {}
+
+# ---- on_line_event -----------------------------------------------------------
+
+cov = new_coverage(root, ignored_path, threading_mode, false)
+cov.start
+cov.stop
+
+calls = files_count * 10
+executed_lines = calls * lines_count
+
+hot_object = app_objects.first
+results["line_event.cache_hit"] = coverage_overhead(rounds, executed_lines, cov) do
+  calls.times { |index| hot_object.run(index) }
+end
+
+results["line_event.cache_miss"] = coverage_overhead(rounds, executed_lines, cov) do
+  calls.times { |index| app_objects[index % files_count].run(index) }
+end
+
+results["line_event.excluded_path"] = coverage_overhead(rounds, executed_lines, cov) do
+  calls.times { |index| vendor_objects[index % files_count].run(index) }
+end
+
+# ---- on_newobj_event ---------------------------------------------------------
+
+# allocation tracing is only supported in multi threaded mode
+allocation_cov = new_coverage(root, ignored_path, :multi, true)
+allocation_cov.start
+allocation_cov.stop
+
+allocations = files_count * 50
+results["newobj_event"] = coverage_overhead(rounds, allocations, allocation_cov) do
+  allocations.times { |index| app_klasses[index % files_count].new }
+end
+
+# ---- dd_cov_stop -------------------------------------------------------------
+
+stop_samples = Array.new(rounds) do
+  allocation_cov.start
+  app_klasses.each(&:new)
+  measure { allocation_cov.stop }
+end
+results["stop.large_class_set"] = median(stop_samples).fdiv(files_count)
+
+# ---- FileSerialization.pack_files --------------------------------------------
+
+coverage = {}
+app_objects.each_index { |index| coverage[File.join(root, "app", "klass_#{index}.rb")] = true }
+pack_iterations = 100
+pack_samples = Array.new(rounds) do
+  measure do
+    pack_iterations.times { Datadog::CI::FileSerialization.pack_files(coverage, [], root) }
+  end
+end
+results["pack_files"] = median(pack_samples).fdiv(pack_iterations * files_count)
+
+# ---- ISeqCollector -----------------------------------------------------------
+
+collect_samples = Array.new(rounds) { measure { Datadog::CI::SourceCode::ISeqCollector.collect_iseqs } }
+results["collect_iseqs"] = median(collect_samples).fdiv(files_count)
+
+collect_under_samples = Array.new(rounds) do
+  measure { Datadog::CI::SourceCode::ISeqCollector.collect_iseqs_under(root, ignored_path) }
+end
+results["collect_iseqs_under"] = median(collect_under_samples).fdiv(files_count)
+
+# ---- Report ------------------------------------------------------------------
+
+units = {
+  "line_event.cache_hit" => "ns/line",
+  "line_event.cache_miss" => "ns/line",
+  "line_event.excluded_path" => "ns/line",
+  "newobj_event" => "ns/allocation",
+  "stop.large_class_set" => "ns/class",
+  "pack_files" => "ns/file",
+  "collect_iseqs" => "ns/file",
+  "collect_iseqs_under" => "ns/file"
+}
+
+puts "Ruby #{RUBY_VERSION} (#{RUBY_PLATFORM})"
+puts "Files: #{files_count}, lines per call: #{lines_count}, rounds: #{rounds}, threading mode: #{threading_mode}"
+puts
+
+baseline = ENV["BASELINE"] && JSON.parse(File.read(ENV["BASELINE"])).fetch("results")
+regressions = []
+
+results.each do |name, value|
+  line = format("%-28s %12.1f %-14s", name, value, units.fetch(name))
+
+  if baseline&.key?(name)
+    baseline_value = baseline.fetch(name)
+    # overheads close to zero are dominated by noise, compare them in absolute terms
+    allowed = [baseline_value * (1 + threshold), baseline_value + 1.0].max
+    line += format(" baseline %10.1f", baseline_value)
+    if value > allowed
+      line += "   REGRESSION"
+      regressions << name
+    end
+  end
+
+  puts line
+end
+
+if ENV["OUTPUT"]
+  File.write(
+    ENV["OUTPUT"],
+    JSON.pretty_generate(
+      "ruby" => RUBY_VERSION,
+      "platform" => RUBY_PLATFORM,
+      "files" => files_count,
+      "lines" => lines_count,
+      "threading_mode" => threading_mode.to_s,
+      "units" => units,
+      "results" => results
+    )
+  )
+end
+
+unless regressions.empty?
+  warn "\nOverhead regressions over #{(threshold * 100).round}% of the baseline: #{regressions.join(", ")}"
+  exit 1
+end
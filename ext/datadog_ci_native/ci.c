@@ -1,16 +1,30 @@
+#include "covered_files.h"
 #include "datadog_cov.h"
 #include "datadog_method_inspect.h"
 #include "file_serialization.h"
 #include "iseq_collector.h"
+#include "span_serialization.h"
+#include "static_dependencies.h"
+#include "test_id_set.h"
 
 void Init_datadog_ci_native(void) {
+  // Coverage::CoveredFiles
+  Init_covered_files();
+
   // Coverage::DDCov
   Init_datadog_cov();
 
   // FileSerialization
   Init_file_serialization();
 
+  // SpanSerialization
+  Init_span_serialization();
+
+  // Utils::TestIdSet
+  Init_test_id_set();
+
   // SourceCode
   Init_datadog_method_inspect();
   Init_dd_ci_iseq_collector();
+  Init_dd_ci_static_dependencies();
 }
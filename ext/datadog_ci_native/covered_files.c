@@ -0,0 +1,364 @@
+#include <ruby.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "covered_files.h"
+
+// Covered files are interned in a process-wide table that assigns a dense ID
+// to every distinct path. Coverage collected for a single test is a bitmap over
+// these IDs, so recording a file never allocates and Ruby strings are only
+// produced when the set is read.
+//
+// The table interns absolute paths: they are what the line hook sees and what
+// CoveredFiles#keys returns, and collectors created with different roots share
+// the same IDs. The root-relative slice of a path is derived once per file ID
+// when it is first serialized (see filename_entries in file_serialization.c).
+// Only collectors intern paths: every interned path grows the bitmaps.
+
+#define BITS_PER_WORD 64
+
+// { String -> Integer } file path to file ID
+static VALUE file_ids = Qnil;
+// Array<String> frozen file paths indexed by file ID
+static VALUE file_paths = Qnil;
+
+uint32_t dd_ci_file_id(VALUE path) {
+  VALUE file_id = rb_hash_lookup2(file_ids, path, Qundef);
+  if (file_id != Qundef) {
+    return (uint32_t)FIX2ULONG(file_id);
+  }
+
+  long next_id = RARRAY_LEN(file_paths);
+  if (next_id >= UINT32_MAX) {
+    rb_raise(rb_eRuntimeError, "too many covered files");
+  }
+
+  VALUE interned_path = rb_obj_freeze(rb_str_dup(path));
+  rb_ary_push(file_paths, interned_path);
+  rb_hash_aset(file_ids, interned_path, LONG2FIX(next_id));
+  return (uint32_t)next_id;
+}
+
+bool dd_ci_file_id_lookup(VALUE path, uint32_t *file_id) {
+  VALUE id = rb_hash_lookup2(file_ids, path, Qundef);
+  if (id == Qundef) {
+    return false;
+  }
+
+  *file_id = (uint32_t)FIX2ULONG(id);
+  return true;
+}
+
+VALUE dd_ci_file_path(uint32_t file_id) {
+  return rb_ary_entry(file_paths, (long)file_id);
+}
+
+// Data structure
+struct covered_files_data {
+  uint64_t *words;
+  size_t words_len;
+  size_t count;
+};
+
+static void covered_files_free(void *ptr) {
+  struct covered_files_data *data = ptr;
+  xfree(data->words);
+  xfree(data);
+}
+
+static size_t covered_files_memsize(const void *ptr) {
+  const struct covered_files_data *data = ptr;
+  return sizeof(struct covered_files_data) + data->words_len * sizeof(uint64_t);
+}
+
+static const rb_data_type_t covered_files_data_type = {
+    .wrap_struct_name = "dd_covered_files",
+    .function = {.dmark = NULL,
+                 .dfree = covered_files_free,
+                 .dsize = covered_files_memsize},
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY};
+
+static VALUE cCoveredFiles = Qnil;
+
+static VALUE covered_files_allocate(VALUE klass) {
+  struct covered_files_data *data;
+  VALUE covered_files = TypedData_Make_Struct(
+      klass, struct covered_files_data, &covered_files_data_type, data);
+
+  data->words = NULL;
+  data->words_len = 0;
+  data->count = 0;
+
+  return covered_files;
+}
+
+static struct covered_files_data *get_covered_files_data(VALUE self) {
+  struct covered_files_data *data;
+  TypedData_Get_Struct(self, struct covered_files_data,
+                       &covered_files_data_type, data);
+  return data;
+}
+
+static void covered_files_data_add(struct covered_files_data *data,
+                                   uint32_t file_id) {
+  size_t word_index = file_id / BITS_PER_WORD;
+  if (word_index >= data->words_len) {
+    // grow to the size of the table to avoid resizing for every new file
+    size_t files_count = (size_t)RARRAY_LEN(file_paths);
+    size_t new_words_len = (files_count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    if (new_words_len <= word_index) {
+      new_words_len = word_index + 1;
+    }
+    REALLOC_N(data->words, uint64_t, new_words_len);
+    memset(data->words + data->words_len, 0,
+           (new_words_len - data->words_len) * sizeof(uint64_t));
+    data->words_len = new_words_len;
+  }
+
+  uint64_t mask = (uint64_t)1 << (file_id % BITS_PER_WORD);
+  if ((data->words[word_index] & mask) == 0) {
+    data->words[word_index] |= mask;
+    data->count++;
+  }
+}
+
+static bool covered_files_data_include(struct covered_files_data *data,
+                                       uint32_t file_id) {
+  size_t word_index = file_id / BITS_PER_WORD;
+  return word_index < data->words_len &&
+         (data->words[word_index] &
+          ((uint64_t)1 << (file_id % BITS_PER_WORD))) != 0;
+}
+
+VALUE dd_ci_covered_files_new(void) {
+  return covered_files_allocate(cCoveredFiles);
+}
+
+bool dd_ci_covered_files_p(VALUE obj) {
+  return rb_typeddata_is_kind_of(obj, &covered_files_data_type);
+}
+
+void dd_ci_covered_files_add(VALUE covered_files, uint32_t file_id) {
+  covered_files_data_add(RTYPEDDATA_DATA(covered_files), file_id);
+}
+
+void dd_ci_covered_files_foreach(VALUE covered_files,
+                                 int (*func)(VALUE path, VALUE value,
+                                             VALUE arg),
+                                 VALUE arg) {
+  struct covered_files_data *data = get_covered_files_data(covered_files);
+  for (size_t word_index = 0; word_index < data->words_len; word_index++) {
+    uint64_t word = data->words[word_index];
+    while (word != 0) {
+      int bit = __builtin_ctzll(word);
+      word &= word - 1;
+
+      uint32_t file_id = (uint32_t)(word_index * BITS_PER_WORD + bit);
+      if (func(dd_ci_file_path(file_id), Qtrue, arg) == ST_STOP) {
+        return;
+      }
+    }
+  }
+}
+
+void dd_ci_covered_files_foreach_id(VALUE covered_files,
+                                    int (*func)(uint32_t file_id, void *arg),
+                                    void *arg) {
+  struct covered_files_data *data = get_covered_files_data(covered_files);
+  for (size_t word_index = 0; word_index < data->words_len; word_index++) {
+    uint64_t word = data->words[word_index];
+    while (word != 0) {
+      int bit = __builtin_ctzll(word);
+      word &= word - 1;
+
+      if (func((uint32_t)(word_index * BITS_PER_WORD + bit), arg) ==
+          ST_STOP) {
+        return;
+      }
+    }
+  }
+}
+
+// CoveredFiles instance methods available in Ruby
+
+static VALUE covered_files_initialize_copy(VALUE self, VALUE orig) {
+  struct covered_files_data *data = get_covered_files_data(self);
+  struct covered_files_data *orig_data = get_covered_files_data(orig);
+
+  if (data == orig_data) {
+    return self;
+  }
+
+  REALLOC_N(data->words, uint64_t, orig_data->words_len);
+  if (orig_data->words_len > 0) {
+    memcpy(data->words, orig_data->words,
+           orig_data->words_len * sizeof(uint64_t));
+  }
+  data->words_len = orig_data->words_len;
+  data->count = orig_data->count;
+
+  return self;
+}
+
+static VALUE covered_files_size(VALUE self) {
+  return SIZET2NUM(get_covered_files_data(self)->count);
+}
+
+static VALUE covered_files_empty_p(VALUE self) {
+  return get_covered_files_data(self)->count == 0 ? Qtrue : Qfalse;
+}
+
+static VALUE covered_files_key_p(VALUE self, VALUE path) {
+  if (!RB_TYPE_P(path, T_STRING)) {
+    return Qfalse;
+  }
+
+  uint32_t file_id;
+  if (!dd_ci_file_id_lookup(path, &file_id)) {
+    return Qfalse;
+  }
+
+  return covered_files_data_include(get_covered_files_data(self), file_id)
+             ? Qtrue
+             : Qfalse;
+}
+
+static VALUE covered_files_aset(VALUE self, VALUE path, VALUE _value) {
+  Check_Type(path, T_STRING);
+
+  covered_files_data_add(get_covered_files_data(self), dd_ci_file_id(path));
+  return Qtrue;
+}
+
+static int merge_hash_key_i(VALUE path, VALUE _value, VALUE self) {
+  covered_files_aset(self, path, Qtrue);
+  return ST_CONTINUE;
+}
+
+static VALUE covered_files_merge_bang(VALUE self, VALUE other) {
+  if (RB_TYPE_P(other, T_HASH)) {
+    rb_hash_foreach(other, merge_hash_key_i, self);
+    return self;
+  }
+
+  struct covered_files_data *data = get_covered_files_data(self);
+  struct covered_files_data *other_data = get_covered_files_data(other);
+  if (data == other_data || other_data->count == 0) {
+    return self;
+  }
+
+  if (other_data->words_len > data->words_len) {
+    REALLOC_N(data->words, uint64_t, other_data->words_len);
+    memset(data->words + data->words_len, 0,
+           (other_data->words_len - data->words_len) * sizeof(uint64_t));
+    data->words_len = other_data->words_len;
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < data->words_len; i++) {
+    if (i < other_data->words_len) {
+      data->words[i] |= other_data->words[i];
+    }
+    count += (size_t)__builtin_popcountll(data->words[i]);
+  }
+  data->count = count;
+
+  return self;
+}
+
+static int yield_path_i(VALUE path, VALUE _value, VALUE _arg) {
+  rb_yield(path);
+  return ST_CONTINUE;
+}
+
+static VALUE covered_files_each_key(VALUE self) {
+  RETURN_SIZED_ENUMERATOR(self, 0, 0, covered_files_size);
+
+  dd_ci_covered_files_foreach(self, yield_path_i, Qnil);
+  return self;
+}
+
+static int push_path_i(VALUE path, VALUE _value, VALUE paths) {
+  rb_ary_push(paths, path);
+  return ST_CONTINUE;
+}
+
+static VALUE covered_files_keys(VALUE self) {
+  VALUE paths = rb_ary_new_capa((long)get_covered_files_data(self)->count);
+  dd_ci_covered_files_foreach(self, push_path_i, paths);
+  return paths;
+}
+
+static int hash_aset_path_i(VALUE path, VALUE value, VALUE hash) {
+  rb_hash_aset(hash, path, value);
+  return ST_CONTINUE;
+}
+
+static VALUE covered_files_to_h(VALUE self) {
+  VALUE hash = rb_hash_new();
+  dd_ci_covered_files_foreach(self, hash_aset_path_i, hash);
+  return hash;
+}
+
+static VALUE covered_files_equal(VALUE self, VALUE other) {
+  if (RB_TYPE_P(other, T_HASH)) {
+    return rb_equal(covered_files_to_h(self), other);
+  }
+  if (!dd_ci_covered_files_p(other)) {
+    return Qfalse;
+  }
+
+  struct covered_files_data *data = get_covered_files_data(self);
+  struct covered_files_data *other_data = get_covered_files_data(other);
+  if (data->count != other_data->count) {
+    return Qfalse;
+  }
+
+  size_t words_len = data->words_len > other_data->words_len
+                         ? data->words_len
+                         : other_data->words_len;
+  for (size_t i = 0; i < words_len; i++) {
+    uint64_t word = i < data->words_len ? data->words[i] : 0;
+    uint64_t other_word = i < other_data->words_len ? other_data->words[i] : 0;
+    if (word != other_word) {
+      return Qfalse;
+    }
+  }
+  return Qtrue;
+}
+
+static VALUE covered_files_inspect(VALUE self) {
+  return rb_inspect(covered_files_to_h(self));
+}
+
+void Init_covered_files(void) {
+  file_ids = rb_hash_new();
+  rb_gc_register_address(&file_ids);
+  file_paths = rb_ary_new();
+  rb_gc_register_address(&file_paths);
+
+  VALUE mDatadog = rb_define_module("Datadog");
+  VALUE mCI = rb_define_module_under(mDatadog, "CI");
+  VALUE mTestImpactAnalysis = rb_define_module_under(mCI, "TestImpactAnalysis");
+  VALUE mCoverage = rb_define_module_under(mTestImpactAnalysis, "Coverage");
+  cCoveredFiles = rb_define_class_under(mCoverage, "CoveredFiles", rb_cObject);
+  rb_gc_register_address(&cCoveredFiles);
+
+  rb_define_alloc_func(cCoveredFiles, covered_files_allocate);
+
+  rb_define_method(cCoveredFiles, "initialize_copy",
+                   covered_files_initialize_copy, 1);
+  rb_define_method(cCoveredFiles, "size", covered_files_size, 0);
+  rb_define_method(cCoveredFiles, "empty?", covered_files_empty_p, 0);
+  rb_define_method(cCoveredFiles, "key?", covered_files_key_p, 1);
+  rb_define_method(cCoveredFiles, "[]=", covered_files_aset, 2);
+  rb_define_method(cCoveredFiles, "merge!", covered_files_merge_bang, 1);
+  rb_define_method(cCoveredFiles, "each_key", covered_files_each_key, 0);
+  rb_define_method(cCoveredFiles, "keys", covered_files_keys, 0);
+  rb_define_method(cCoveredFiles, "to_h", covered_files_to_h, 0);
+  rb_define_method(cCoveredFiles, "==", covered_files_equal, 1);
+  rb_define_method(cCoveredFiles, "inspect", covered_files_inspect, 0);
+  rb_define_method(cCoveredFiles, "to_s", covered_files_inspect, 0);
+}
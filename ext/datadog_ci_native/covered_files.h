@@ -0,0 +1,30 @@
+#pragma once
+
+#include <ruby.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Returns the process-wide ID of the file path, interning it on first use.
+uint32_t dd_ci_file_id(VALUE path);
+// Looks up the ID of an interned file path without interning it.
+bool dd_ci_file_id_lookup(VALUE path, uint32_t *file_id);
+// Returns the frozen file path interned under the ID.
+VALUE dd_ci_file_path(uint32_t file_id);
+
+// Creates an empty Coverage::CoveredFiles set.
+VALUE dd_ci_covered_files_new(void);
+bool dd_ci_covered_files_p(VALUE obj);
+void dd_ci_covered_files_add(VALUE covered_files, uint32_t file_id);
+// Calls func with (path, Qtrue, arg) for each covered file in file ID order,
+// stops when func returns ST_STOP. Accepts rb_hash_foreach callbacks.
+void dd_ci_covered_files_foreach(VALUE covered_files,
+                                 int (*func)(VALUE path, VALUE value,
+                                             VALUE arg),
+                                 VALUE arg);
+// Same as dd_ci_covered_files_foreach without looking up the paths.
+void dd_ci_covered_files_foreach_id(VALUE covered_files,
+                                    int (*func)(uint32_t file_id, void *arg),
+                                    void *arg);
+
+void Init_covered_files(void);
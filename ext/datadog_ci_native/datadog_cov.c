@@ -3,9 +3,14 @@
 #include <ruby/st.h>
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "covered_files.h"
 #include "datadog_common.h"
+#include "iseq_collector.h"
+#include "ruby_internal.h"
 
 // This is a native extension that collects a list of Ruby files that were
 // executed during the test run. It is used to optimize the test suite by
@@ -14,7 +19,8 @@
 #define PROFILE_FRAMES_BUFFER_SIZE 1
 #define SEEN_FILENAME_CACHE_SIZE 1024
 #define SEEN_ALLOCATED_CLASS_CACHE_SIZE 4096
-#define KLASS_FILES_CACHE_SIZE 100000
+#define KLASS_FILES_INDEX_SIZE 100000
+#define SOURCE_FILES_CACHE_SIZE 100000
 
 #if SEEN_FILENAME_CACHE_SIZE == 0 ||                                       \
     (SEEN_FILENAME_CACHE_SIZE & (SEEN_FILENAME_CACHE_SIZE - 1)) != 0
@@ -30,9 +36,115 @@
 // threading modes
 enum threading_mode { single, multi };
 
+// line tracing modes
+enum line_tracing_mode { global_line_tracing, iseq_line_tracing };
+
+struct dd_cov_data;
+
+// Collectors referenced by pointer only, so that they can still be garbage
+// collected.
+struct dd_cov_collectors {
+  struct dd_cov_data **items;
+  long len;
+  long capa;
+};
+
+// Collectors using ISeq-local line tracing share one TracePoint per ISeq. A
+// file is disarmed once every active collector has recorded it, DDCov#start
+// re-arms the files that fired. TracePoints point to their file, never to a
+// collector: collectors register on their first start and unregister when
+// they are freed, the TracePoints are disabled once the last one is gone.
+//
+// collectors that ISeqs are registered for
+static struct dd_cov_collectors iseq_collectors = {NULL, 0, 0};
+// collectors between DDCov#start and DDCov#stop
+static struct dd_cov_collectors iseq_active_collectors = {NULL, 0, 0};
+// { (char *) path -> struct dd_cov_iseq_file * }
+static st_table *iseq_files = NULL;
+static struct dd_cov_iseq_file *fired_iseq_files = NULL;
+static VALUE script_compiled_tracepoint = Qnil;
+// Array keeping the paths, ISeqs and TracePoints of iseq_files alive
+static VALUE iseq_files_objects = Qnil;
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+static rb_postponed_job_handle_t teardown_iseq_line_tracing_job;
+#endif
+
+// Multi threaded collectors using global line tracing share a single line
+// hook. Each event is attributed to the collector that owns the current fiber:
+// DDCov#start stores an ownership token in the fiber storage, which is
+// inherited by threads and fibers spawned from the test (Ruby 3.2+). Events
+// from fibers that are not owned by a running collector, such as threads that
+// were started before the test, are attributed to all active collectors.
+//
+// Array<DDCov> collectors using the shared line hook
+static VALUE shared_hook_collectors = Qnil;
+// { fiber -> struct dd_cov_data * } owners of the fibers that produced line
+// events, NULL for fibers that are not owned by a running collector. The token
+// is read from the fiber storage only on the first event of a fiber. Filled in
+// DDCov#start and by the line hook, cleared in DDCov#stop.
+static st_table *fiber_owners = NULL;
+// hidden object marking the fibers of fiber_owners as pinned: the table is
+// keyed by their address
+static VALUE fiber_owners_object = Qnil;
+// the owner of the fiber that produced the last line event
+static VALUE owner_cache_fiber = Qnil;
+static struct dd_cov_data *owner_cache_collector = NULL;
+static VALUE owner_key = Qnil;
+static VALUE cFiber = Qnil;
+static bool fiber_storage_supported = false;
+
+// IDs of the methods called while tracing
+static ID id_aref;
+static ID id_aset;
+static ID id_path;
+static ID id_enable;
+static ID id_target;
+static ID id_instruction_sequence;
+static ID id_each_child;
+
 // functions declarations
 static void on_newobj_event(VALUE self, const rb_trace_arg_t *tracearg);
 
+// Path classification of a source file seen by the line hook, keyed by the
+// path pointer returned by rb_sourcefile. The filename is kept alive (and
+// pinned) so its pointer cannot be reused for another path. Files excluded by
+// root or ignored_path are stored with file_id -1.
+struct dd_cov_source_file {
+  VALUE filename;
+  long file_id;
+};
+
+// Source files of a class and its ancestors. The entry is valid while the
+// ancestry chain of the class has the same fingerprint: include, prepend or a
+// reopened class with a new superclass chain invalidate only this entry.
+struct dd_cov_klass_files {
+  uint64_t chain_fingerprint;
+  VALUE file_ids; // frozen Array<Integer>
+};
+
+// Direct-mapped cache slot for classes seen by the allocation hook. The slot
+// is valid only for the coverage generation it was stamped with.
+struct dd_cov_seen_klass {
+  VALUE klass;
+  unsigned long generation;
+};
+
+// All ISeqs that belong to one source file. The file is armed when each of
+// its TracePoints is enabled for its ISeq. The first line executed from any of
+// these ISeqs disarms all of them, so a covered file costs nothing for the rest
+// of the test. DDCov#start re-arms only the files that fired.
+struct dd_cov_iseq_file {
+  // frozen path, checked against the root of every active collector
+  VALUE path;
+  uint32_t file_id;
+  // ISeqs are kept alive to be able to re-arm them in the next test
+  VALUE iseqs;
+  // TracePoint per ISeq, in the same order as iseqs
+  VALUE tracepoints;
+  bool armed;
+  struct dd_cov_iseq_file *next_fired;
+};
+
 static int mark_key_for_gc_i(st_data_t key, st_data_t _value, st_data_t _data) {
   VALUE klass = (VALUE)key;
   // mark klass link for GC as non-movable to avoid changing hashtable's keys
@@ -40,18 +152,90 @@ static int mark_key_for_gc_i(st_data_t key, st_data_t _value, st_data_t _data) {
   return ST_CONTINUE;
 }
 
+static void fiber_owners_mark(void *ptr) {
+  st_foreach((st_table *)ptr, mark_key_for_gc_i, 0);
+}
+
+static void fiber_owners_free(void *ptr) { st_free_table((st_table *)ptr); }
+
+static const rb_data_type_t fiber_owners_data_type = {
+    .wrap_struct_name = "dd_cov_fiber_owners",
+    .function = {.dmark = fiber_owners_mark,
+                 .dfree = fiber_owners_free,
+                 .dsize = NULL},
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY};
+
 static int mark_klass_files_for_gc_i(st_data_t key, st_data_t value,
                                      st_data_t _data) {
-  // Both the class key and its cached filenames must remain at stable addresses
+  // Both the class key and its file IDs must remain at stable addresses
   // because they are stored outside Ruby's object containers.
   rb_gc_mark((VALUE)key);
-  rb_gc_mark((VALUE)value);
+  rb_gc_mark(((struct dd_cov_klass_files *)value)->file_ids);
   return ST_CONTINUE;
 }
 
+static int free_klass_files_i(st_data_t _key, st_data_t value,
+                              st_data_t _data) {
+  xfree((struct dd_cov_klass_files *)value);
+  return ST_CONTINUE;
+}
+
+static int mark_source_file_for_gc_i(st_data_t _key, st_data_t value,
+                                     st_data_t _data) {
+  struct dd_cov_source_file *source_file = (struct dd_cov_source_file *)value;
+  // pinned: the table is keyed by the string's buffer pointer
+  rb_gc_mark(source_file->filename);
+  return ST_CONTINUE;
+}
+
+static int free_source_file_i(st_data_t _key, st_data_t value,
+                              st_data_t _data) {
+  xfree((struct dd_cov_source_file *)value);
+  return ST_CONTINUE;
+}
+
+static int free_iseq_file_i(st_data_t key, st_data_t value,
+                            st_data_t _data) {
+  struct dd_cov_iseq_file *iseq_file = (struct dd_cov_iseq_file *)value;
+  long len = RARRAY_LEN(iseq_file->tracepoints);
+  for (long i = 0; i < len; i++) {
+    VALUE tracepoint = rb_ary_entry(iseq_file->tracepoints, i);
+    if (RTEST(rb_tracepoint_enabled_p(tracepoint))) {
+      rb_tracepoint_disable(tracepoint);
+    }
+  }
+  xfree((char *)key);
+  xfree(iseq_file);
+  return ST_CONTINUE;
+}
+
+// Hot path counters, cumulative for the life of the collector. They are plain
+// increments on the collector's own data, so they are cheap enough to be always
+// on. Exposed to Ruby with DDCov#stats.
+struct dd_cov_stats {
+  // line hook
+  uint64_t line_events;
+  uint64_t line_fast_path_hits;   // same file as the previous event
+  uint64_t line_direct_cache_hits; // seen_source_files slot
+  uint64_t line_table_hits;       // source_files table
+  uint64_t profile_frames_calls;
+  uint64_t excluded_path_verdicts;
+  uint64_t source_files_cache_resets;
+  // allocation hook
+  uint64_t newobj_events;
+  uint64_t klass_cache_hits;      // last allocated class or its cache slot
+  uint64_t klass_cache_evictions; // slot taken over by another class
+  uint64_t klass_index_hits;
+  uint64_t klass_index_misses;
+  // DDCov#stop
+  uint64_t stop_calls;
+  uint64_t stop_time_ns;
+  uint64_t stop_max_time_ns;
+};
+
 // Data structure
 struct dd_cov_data {
-  // Ruby hash with filenames impacted by the test.
+  // Coverage::CoveredFiles set with files impacted by the test.
   VALUE impacted_files;
 
   // Root is the path to the root folder of the project under test.
@@ -64,12 +248,19 @@ struct dd_cov_data {
   char *ignored_path;
   long ignored_path_len;
 
+  // Coverage generation, bumped by DDCov#stop. Per-test caches are stamped
+  // with the generation instead of being cleared between tests.
+  unsigned long generation;
+
   // Line tracepoint optimisation: make consecutive events from the same file a
-  // single comparison, then use a direct-mapped cache for later revisits. Keep
-  // the Ruby strings alive so their pointers cannot be reused for other paths.
+  // single comparison, then use a direct-mapped cache and a table of every
+  // classified source file for later revisits. Classification verdicts stay
+  // valid for the life of the collector, so the next test does not repeat
+  // rb_profile_frames and path checks for files it has already seen.
   // A collision only repeats path processing; it can never suppress coverage.
-  VALUE last_filename;
-  VALUE seen_filenames[SEEN_FILENAME_CACHE_SIZE];
+  struct dd_cov_source_file *last_source_file;
+  struct dd_cov_source_file *seen_source_files[SEEN_FILENAME_CACHE_SIZE];
+  st_table *source_files; // { (const char *) -> struct dd_cov_source_file * }
 
   // Line tracepoint can work in two modes: single threaded and multi threaded
   //
@@ -83,6 +274,22 @@ struct dd_cov_data {
   enum threading_mode threading_mode;
   // for single threaded mode: thread that is being covered
   VALUE th_covered;
+  // for multi threaded mode: collector is registered with the shared hook
+  bool shared_hook_active;
+
+  // Line tracing can work in two modes: global and ISeq-local
+  //
+  // In global mode a single RUBY_EVENT_LINE hook is called for every line
+  // executed while coverage is collected.
+  //
+  // In ISeq-local mode every ISeq located under root gets a TracePoint that is
+  // disabled after the first hit and re-armed by DDCov#start, so each file is
+  // traced at most once per test. ISeqs are discovered with a heap walk on the
+  // first start and via RUBY_EVENT_SCRIPT_COMPILED afterwards. TracePoints are
+  // shared with the other collectors, see iseq_collectors.
+  enum line_tracing_mode line_tracing_mode;
+  bool collecting;
+  bool iseq_registered;
 
   // Allocation tracing is used to track test impact for objects that do not
   // contain any methods that could be covered by line tracepoint.
@@ -90,12 +297,25 @@ struct dd_cov_data {
   // Allocation tracing works only in multi threaded mode.
   bool allocation_tracing_enabled;
   bool allocation_hook_active;
-  st_table *klasses_table; // { (VALUE) -> int } hashmap with class names that
-                           // were covered by allocation during the test run
+  st_table *klasses_table; // { (VALUE) -> generation } hashmap with classes
+                           // covered by allocation and the last generation
+                           // that allocated them
+  // classes covered by allocation during the current generation
+  VALUE *generation_klasses;
+  size_t generation_klasses_len;
+  size_t generation_klasses_capa;
   VALUE last_allocated_klass;
-  VALUE seen_allocated_klasses[SEEN_ALLOCATED_CLASS_CACHE_SIZE];
-  st_table *klass_files_cache; // { (VALUE) -> Array<String> } resolved files
-  size_t klass_files_cache_size;
+  struct dd_cov_seen_klass
+      seen_allocated_klasses[SEEN_ALLOCATED_CLASS_CACHE_SIZE];
+  // Class to source files index, built in one pass on the first start and
+  // completed lazily for classes defined later. Resolution of the modules is
+  // memoized, so stale entries are rebuilt without const_source_location.
+  bool klass_files_indexed;
+  st_table *klass_files_index; // { (VALUE) -> struct dd_cov_klass_files * }
+  st_table *module_files; // { (VALUE) -> file ID + 1 } 0 when the module has
+                          // no source file under root
+
+  struct dd_cov_stats stats;
 };
 
 static void dd_cov_mark(void *ptr) {
@@ -103,31 +323,38 @@ static void dd_cov_mark(void *ptr) {
   rb_gc_mark_movable(dd_cov_data->impacted_files);
   rb_gc_mark_movable(dd_cov_data->th_covered);
 
-  if (dd_cov_data->last_filename != Qnil) {
-    rb_gc_mark(dd_cov_data->last_filename);
-  }
-  for (size_t i = 0; i < SEEN_FILENAME_CACHE_SIZE; i++) {
-    if (dd_cov_data->seen_filenames[i] != Qnil) {
-      rb_gc_mark(dd_cov_data->seen_filenames[i]);
-    }
-  }
-
-  // if GC starts withing dd_cov_allocate() call, klasses_table might not be
+  // if GC starts withing dd_cov_allocate() call, tables might not be
   // initialized yet
+  if (dd_cov_data->source_files != NULL) {
+    st_foreach(dd_cov_data->source_files, mark_source_file_for_gc_i, 0);
+  }
   if (dd_cov_data->klasses_table != NULL) {
     st_foreach(dd_cov_data->klasses_table, mark_key_for_gc_i, 0);
   }
-  if (dd_cov_data->klass_files_cache != NULL) {
-    st_foreach(dd_cov_data->klass_files_cache, mark_klass_files_for_gc_i, 0);
+  if (dd_cov_data->klass_files_index != NULL) {
+    st_foreach(dd_cov_data->klass_files_index, mark_klass_files_for_gc_i, 0);
+  }
+  if (dd_cov_data->module_files != NULL) {
+    st_foreach(dd_cov_data->module_files, mark_key_for_gc_i, 0);
   }
 }
 
+static void unregister_iseq_collector(struct dd_cov_data *dd_cov_data);
+
 static void dd_cov_free(void *ptr) {
   struct dd_cov_data *dd_cov_data = ptr;
+  if (dd_cov_data->iseq_registered) {
+    unregister_iseq_collector(dd_cov_data);
+  }
   xfree(dd_cov_data->root);
   xfree(dd_cov_data->ignored_path);
+  st_foreach(dd_cov_data->source_files, free_source_file_i, 0);
+  st_free_table(dd_cov_data->source_files);
   st_free_table(dd_cov_data->klasses_table);
-  st_free_table(dd_cov_data->klass_files_cache);
+  free(dd_cov_data->generation_klasses);
+  st_foreach(dd_cov_data->klass_files_index, free_klass_files_i, 0);
+  st_free_table(dd_cov_data->klass_files_index);
+  st_free_table(dd_cov_data->module_files);
   xfree(dd_cov_data);
 }
 
@@ -152,16 +379,24 @@ static VALUE dd_cov_allocate(VALUE klass) {
   VALUE dd_cov = TypedData_Make_Struct(klass, struct dd_cov_data,
                                        &dd_cov_data_type, dd_cov_data);
 
-  dd_cov_data->impacted_files = rb_hash_new();
+  dd_cov_data->impacted_files = dd_ci_covered_files_new();
   dd_cov_data->root = NULL;
   dd_cov_data->root_len = 0;
   dd_cov_data->ignored_path = NULL;
   dd_cov_data->ignored_path_len = 0;
-  dd_cov_data->last_filename = Qnil;
-  for (size_t i = 0; i < SEEN_FILENAME_CACHE_SIZE; i++) {
-    dd_cov_data->seen_filenames[i] = Qnil;
-  }
+  dd_cov_data->generation = 1;
+  dd_cov_data->last_source_file = NULL;
+  memset(dd_cov_data->seen_source_files, 0,
+         sizeof(dd_cov_data->seen_source_files));
+  // numtable type is needed to store the path pointer as a key
+  dd_cov_data->source_files = st_init_numtable();
   dd_cov_data->threading_mode = multi;
+  dd_cov_data->th_covered = Qnil;
+  dd_cov_data->shared_hook_active = false;
+
+  dd_cov_data->line_tracing_mode = global_line_tracing;
+  dd_cov_data->collecting = false;
+  dd_cov_data->iseq_registered = false;
 
   dd_cov_data->allocation_tracing_enabled = false;
   dd_cov_data->allocation_hook_active = false;
@@ -170,8 +405,13 @@ static VALUE dd_cov_allocate(VALUE klass) {
          sizeof(dd_cov_data->seen_allocated_klasses));
   // numtable type is needed to store VALUE as a key
   dd_cov_data->klasses_table = st_init_numtable();
-  dd_cov_data->klass_files_cache = st_init_numtable();
-  dd_cov_data->klass_files_cache_size = 0;
+  dd_cov_data->generation_klasses = NULL;
+  dd_cov_data->generation_klasses_len = 0;
+  dd_cov_data->generation_klasses_capa = 0;
+  dd_cov_data->klass_files_indexed = false;
+  dd_cov_data->klass_files_index = st_init_numtable();
+  dd_cov_data->module_files = st_init_numtable();
+  memset(&dd_cov_data->stats, 0, sizeof(dd_cov_data->stats));
 
   return dd_cov;
 }
@@ -179,65 +419,596 @@ static VALUE dd_cov_allocate(VALUE klass) {
 // Helper functions (available in C only)
 
 // Checks if the filename is located under the root folder of the project (but
-// not in the ignored folder) and adds it to the impacted_files hash.
-static bool record_impacted_file(struct dd_cov_data *dd_cov_data,
-                                 VALUE filename) {
+// not in the ignored folder). Returns the file ID or -1 when the file is not
+// included.
+static long classify_file(struct dd_cov_data *dd_cov_data, VALUE filename) {
   if (!dd_ci_is_path_included(RSTRING_PTR(filename), RSTRING_LEN(filename),
                               dd_cov_data->root, dd_cov_data->root_len,
                               dd_cov_data->ignored_path,
                               dd_cov_data->ignored_path_len)) {
-    return false;
+    dd_cov_data->stats.excluded_path_verdicts++;
+    return -1;
   }
 
-  rb_hash_aset(dd_cov_data->impacted_files, filename, Qtrue);
-  return true;
+  return (long)dd_ci_file_id(filename);
+}
+
+// Classifies the filename and adds it to the impacted_files set when it is
+// included. Returns the file ID or -1 when the file is not included.
+static long record_impacted_file(struct dd_cov_data *dd_cov_data,
+                                 VALUE filename) {
+  long file_id = classify_file(dd_cov_data, filename);
+  if (file_id >= 0) {
+    dd_ci_covered_files_add(dd_cov_data->impacted_files, (uint32_t)file_id);
+  }
+  return file_id;
+}
+
+static void clear_source_files(struct dd_cov_data *dd_cov_data) {
+  st_foreach(dd_cov_data->source_files, free_source_file_i, 0);
+  st_clear(dd_cov_data->source_files);
+  memset(dd_cov_data->seen_source_files, 0,
+         sizeof(dd_cov_data->seen_source_files));
+  dd_cov_data->last_source_file = NULL;
+}
+
+// Remembers the classification of a file that was just recorded. Returns NULL
+// when the path pointer does not belong to the filename string and therefore
+// cannot be used as a cache key.
+static struct dd_cov_source_file *
+cache_source_file(struct dd_cov_data *dd_cov_data, const char *c_filename,
+                  VALUE filename, long file_id) {
+  if (RSTRING_PTR(filename) != c_filename) {
+    return NULL;
+  }
+
+  // Bound retention for eval-heavy suites; reaching the limit starts over.
+  if (dd_cov_data->source_files->num_entries >= SOURCE_FILES_CACHE_SIZE) {
+    clear_source_files(dd_cov_data);
+    dd_cov_data->stats.source_files_cache_resets++;
+  }
+
+  struct dd_cov_source_file *source_file = ALLOC(struct dd_cov_source_file);
+  source_file->filename = filename;
+  source_file->file_id = file_id;
+  st_insert(dd_cov_data->source_files, (st_data_t)c_filename,
+            (st_data_t)source_file);
+  return source_file;
+}
+
+// Records the file of the line being executed, captures the filename from
+// rb_profile_frames on the first visit.
+static void record_line_event(struct dd_cov_data *dd_cov_data,
+                              const char *c_filename) {
+  dd_cov_data->stats.line_events++;
+
+  // the last file is reset for every generation, so it is already recorded
+  struct dd_cov_source_file *source_file = dd_cov_data->last_source_file;
+  if (source_file != NULL && RSTRING_PTR(source_file->filename) == c_filename) {
+    dd_cov_data->stats.line_fast_path_hits++;
+    return;
+  }
+
+  uintptr_t current_filename_ptr = (uintptr_t)c_filename;
+  size_t cache_index =
+      ((current_filename_ptr >> 4) ^ (current_filename_ptr >> 12)) &
+      (SEEN_FILENAME_CACHE_SIZE - 1);
+  source_file = dd_cov_data->seen_source_files[cache_index];
+  if (source_file == NULL ||
+      RSTRING_PTR(source_file->filename) != c_filename) {
+    st_data_t cached_source_file;
+    if (!st_lookup(dd_cov_data->source_files, (st_data_t)c_filename,
+                   &cached_source_file)) {
+      dd_cov_data->stats.profile_frames_calls++;
+      VALUE top_frame;
+      int captured_frames =
+          rb_profile_frames(0 /* stack starting depth */,
+                            PROFILE_FRAMES_BUFFER_SIZE, &top_frame, NULL);
+
+      if (captured_frames != PROFILE_FRAMES_BUFFER_SIZE) {
+        return;
+      }
+
+      VALUE filename = rb_profile_frame_path(top_frame);
+      if (filename == Qnil) {
+        return;
+      }
+
+      long file_id = record_impacted_file(dd_cov_data, filename);
+      source_file =
+          cache_source_file(dd_cov_data, c_filename, filename, file_id);
+      if (source_file != NULL) {
+        dd_cov_data->last_source_file = source_file;
+        dd_cov_data->seen_source_files[cache_index] = source_file;
+      }
+      return;
+    }
+
+    source_file = (struct dd_cov_source_file *)cached_source_file;
+    dd_cov_data->seen_source_files[cache_index] = source_file;
+    dd_cov_data->stats.line_table_hits++;
+  } else {
+    dd_cov_data->stats.line_direct_cache_hits++;
+  }
+
+  dd_cov_data->last_source_file = source_file;
+  if (source_file->file_id >= 0) {
+    dd_ci_covered_files_add(dd_cov_data->impacted_files,
+                            (uint32_t)source_file->file_id);
+  }
 }
 
-// Executed on RUBY_EVENT_LINE event and captures the filename from
-// rb_profile_frames.
+// Executed on RUBY_EVENT_LINE event of the covered thread in single threaded
+// mode.
 static void on_line_event(rb_event_flag_t event, VALUE data, VALUE self, ID id,
                           VALUE klass) {
+  const char *c_filename = rb_sourcefile();
+  if (c_filename == NULL) {
+    return;
+  }
+
   // The hook is registered only with DDCov instances, so the full typed-data
   // type check on every Ruby line is unnecessary.
-  struct dd_cov_data *dd_cov_data = RTYPEDDATA_DATA(data);
+  record_line_event(RTYPEDDATA_DATA(data), c_filename);
+}
+
+static VALUE get_fiber_owner_token(void) {
+  if (fiber_storage_supported) {
+    return rb_funcall(cFiber, id_aref, 1, owner_key);
+  }
+  return rb_thread_local_aref(rb_thread_current(), SYM2ID(owner_key));
+}
+
+static void set_fiber_owner_token(VALUE token) {
+  if (fiber_storage_supported) {
+    rb_funcall(cFiber, id_aset, 2, owner_key, token);
+  } else {
+    rb_thread_local_aset(rb_thread_current(), SYM2ID(owner_key), token);
+  }
+}
+
+// The token is [collector, generation]: fibers that outlive the test stop
+// being owned when the collector moves to the next generation.
+static struct dd_cov_data *resolve_fiber_owner(void) {
+  VALUE token = get_fiber_owner_token();
+  if (!RB_TYPE_P(token, T_ARRAY) || RARRAY_LEN(token) != 2) {
+    return NULL;
+  }
 
+  VALUE collector = RARRAY_AREF(token, 0);
+  if (!rb_typeddata_is_kind_of(collector, &dd_cov_data_type)) {
+    return NULL;
+  }
+
+  struct dd_cov_data *dd_cov_data = RTYPEDDATA_DATA(collector);
+  if (!dd_cov_data->collecting || !dd_cov_data->shared_hook_active ||
+      dd_cov_data->generation != NUM2ULONG(RARRAY_AREF(token, 1))) {
+    return NULL;
+  }
+  return dd_cov_data;
+}
+
+static struct dd_cov_data *lookup_fiber_owner(VALUE fiber) {
+  st_data_t owner;
+  if (st_lookup(fiber_owners, (st_data_t)fiber, &owner)) {
+    return (struct dd_cov_data *)owner;
+  }
+
+  struct dd_cov_data *dd_cov_data = resolve_fiber_owner();
+  st_insert(fiber_owners, (st_data_t)fiber, (st_data_t)dd_cov_data);
+  return dd_cov_data;
+}
+
+// Executed on RUBY_EVENT_LINE event for all collectors using the shared hook.
+static void on_shared_line_event(rb_event_flag_t event, VALUE data,
+                                 VALUE self, ID id, VALUE klass) {
   const char *c_filename = rb_sourcefile();
   if (c_filename == NULL) {
     return;
   }
 
-  uintptr_t current_filename_ptr = (uintptr_t)c_filename;
-  if (dd_cov_data->last_filename != Qnil &&
-      RSTRING_PTR(dd_cov_data->last_filename) == c_filename) {
+  VALUE fiber = rb_fiber_current();
+  if (fiber != owner_cache_fiber) {
+    owner_cache_collector = lookup_fiber_owner(fiber);
+    owner_cache_fiber = fiber;
+  }
+
+  if (owner_cache_collector != NULL) {
+    record_line_event(owner_cache_collector, c_filename);
     return;
   }
 
-  size_t cache_index =
-      ((current_filename_ptr >> 4) ^ (current_filename_ptr >> 12)) &
-      (SEEN_FILENAME_CACHE_SIZE - 1);
-  VALUE cached_filename = dd_cov_data->seen_filenames[cache_index];
-  if (cached_filename != Qnil && RSTRING_PTR(cached_filename) == c_filename) {
-    dd_cov_data->last_filename = cached_filename;
+  long len = RARRAY_LEN(shared_hook_collectors);
+  for (long i = 0; i < len; i++) {
+    record_line_event(RTYPEDDATA_DATA(RARRAY_AREF(shared_hook_collectors, i)),
+                      c_filename);
+  }
+}
+
+static void invalidate_owner_cache(void) {
+  owner_cache_fiber = Qnil;
+  owner_cache_collector = NULL;
+}
+
+static void start_shared_line_hook(VALUE self,
+                                   struct dd_cov_data *dd_cov_data) {
+  if (!dd_cov_data->shared_hook_active) {
+    if (RARRAY_LEN(shared_hook_collectors) == 0) {
+      rb_add_event_hook(on_shared_line_event, RUBY_EVENT_LINE, Qnil);
+    }
+    rb_ary_push(shared_hook_collectors, self);
+    dd_cov_data->shared_hook_active = true;
+  }
+
+  // the token is inherited by the threads and fibers spawned by the test
+  set_fiber_owner_token(
+      rb_assoc_new(self, ULONG2NUM(dd_cov_data->generation)));
+  st_insert(fiber_owners, (st_data_t)rb_fiber_current(),
+            (st_data_t)dd_cov_data);
+  invalidate_owner_cache();
+}
+
+static void stop_shared_line_hook(VALUE self,
+                                  struct dd_cov_data *dd_cov_data) {
+  if (!dd_cov_data->shared_hook_active) {
     return;
   }
 
-  VALUE top_frame;
-  int captured_frames =
-      rb_profile_frames(0 /* stack starting depth */,
-                        PROFILE_FRAMES_BUFFER_SIZE, &top_frame, NULL);
+  rb_ary_delete(shared_hook_collectors, self);
+  if (RARRAY_LEN(shared_hook_collectors) == 0) {
+    rb_remove_event_hook(on_shared_line_event);
+  }
+  dd_cov_data->shared_hook_active = false;
+  // fibers of the other collectors are resolved again on their next event
+  st_clear(fiber_owners);
+  invalidate_owner_cache();
+}
+
+// ISeq-local line tracing
 
-  if (captured_frames != PROFILE_FRAMES_BUFFER_SIZE) {
+static bool collectors_include(struct dd_cov_collectors *collectors,
+                               struct dd_cov_data *dd_cov_data) {
+  for (long i = 0; i < collectors->len; i++) {
+    if (collectors->items[i] == dd_cov_data) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void collectors_add(struct dd_cov_collectors *collectors,
+                           struct dd_cov_data *dd_cov_data) {
+  if (collectors_include(collectors, dd_cov_data)) {
     return;
   }
+  if (collectors->len == collectors->capa) {
+    collectors->capa = collectors->capa == 0 ? 4 : collectors->capa * 2;
+    REALLOC_N(collectors->items, struct dd_cov_data *, collectors->capa);
+  }
+  collectors->items[collectors->len++] = dd_cov_data;
+}
+
+// Does not allocate, safe to call from dd_cov_free.
+static void collectors_remove(struct dd_cov_collectors *collectors,
+                              struct dd_cov_data *dd_cov_data) {
+  for (long i = 0; i < collectors->len; i++) {
+    if (collectors->items[i] == dd_cov_data) {
+      collectors->items[i] = collectors->items[--collectors->len];
+      return;
+    }
+  }
+}
 
-  VALUE filename = rb_profile_frame_path(top_frame);
-  if (filename == Qnil) {
+static bool is_iseq_path_included(struct dd_cov_data *dd_cov_data,
+                                  VALUE path) {
+  return RB_TYPE_P(path, T_STRING) &&
+         memchr(RSTRING_PTR(path), '\0', RSTRING_LEN(path)) == NULL &&
+         dd_ci_is_path_included(RSTRING_PTR(path), RSTRING_LEN(path),
+                                dd_cov_data->root, dd_cov_data->root_len,
+                                dd_cov_data->ignored_path,
+                                dd_cov_data->ignored_path_len);
+}
+
+static bool is_iseq_path_included_by_any_collector(VALUE path) {
+  for (long i = 0; i < iseq_collectors.len; i++) {
+    if (is_iseq_path_included(iseq_collectors.items[i], path)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static VALUE enable_tracepoint_for_iseq(VALUE args) {
+  VALUE tracepoint = rb_ary_entry(args, 0);
+  VALUE kwargs = rb_hash_new();
+  rb_hash_aset(kwargs, ID2SYM(id_target), rb_ary_entry(args, 1));
+  return rb_funcallv_kw(tracepoint, id_enable, 1, &kwargs,
+                        RB_PASS_KEYWORDS);
+}
+
+// TracePoint#enable(target:) raises for ISeqs without any line events, such
+// ISeqs are never traced.
+static bool safely_enable_tracepoint_for_iseq(VALUE tracepoint, VALUE iseq) {
+  int exception_state;
+  rb_protect(enable_tracepoint_for_iseq, rb_assoc_new(tracepoint, iseq),
+             &exception_state);
+  if (exception_state != 0) {
+    rb_set_errinfo(Qnil);
+    return false;
+  }
+  return true;
+}
+
+static void arm_iseq_file(struct dd_cov_iseq_file *iseq_file) {
+  long i = 0;
+  while (i < RARRAY_LEN(iseq_file->tracepoints)) {
+    VALUE tracepoint = rb_ary_entry(iseq_file->tracepoints, i);
+    VALUE iseq = rb_ary_entry(iseq_file->iseqs, i);
+    if (safely_enable_tracepoint_for_iseq(tracepoint, iseq)) {
+      i++;
+      continue;
+    }
+    rb_ary_delete_at(iseq_file->tracepoints, i);
+    rb_ary_delete_at(iseq_file->iseqs, i);
+  }
+  iseq_file->armed = true;
+}
+
+static void disarm_iseq_file(struct dd_cov_iseq_file *iseq_file) {
+  long len = RARRAY_LEN(iseq_file->tracepoints);
+  for (long i = 0; i < len; i++) {
+    VALUE tracepoint = rb_ary_entry(iseq_file->tracepoints, i);
+    if (RTEST(rb_tracepoint_enabled_p(tracepoint))) {
+      rb_tracepoint_disable(tracepoint);
+    }
+  }
+  iseq_file->armed = false;
+
+  iseq_file->next_fired = fired_iseq_files;
+  fired_iseq_files = iseq_file;
+}
+
+// Executed on the first RUBY_EVENT_LINE event from an armed file. The file is
+// recorded by every active collector that includes it, and stays armed while
+// a single threaded collector is still waiting for it in its covered thread.
+static void on_iseq_line_event(VALUE tracepoint, void *data) {
+  struct dd_cov_iseq_file *iseq_file = data;
+  if (!iseq_file->armed) {
+    return;
+  }
+
+  bool pending = false;
+  for (long i = 0; i < iseq_active_collectors.len; i++) {
+    struct dd_cov_data *dd_cov_data = iseq_active_collectors.items[i];
+    if (!is_iseq_path_included(dd_cov_data, iseq_file->path)) {
+      continue;
+    }
+    dd_cov_data->stats.line_events++;
+
+    if (dd_cov_data->threading_mode == single &&
+        rb_thread_current() != dd_cov_data->th_covered) {
+      pending = true;
+      continue;
+    }
+    dd_ci_covered_files_add(dd_cov_data->impacted_files, iseq_file->file_id);
+  }
+
+  // files executed between tests are only disarmed until the next start
+  if (!pending) {
+    disarm_iseq_file(iseq_file);
+  }
+}
+
+static bool is_iseq_file_tracing(struct dd_cov_iseq_file *iseq_file,
+                                 VALUE iseq) {
+  const rb_iseq_t *raw_iseq = rb_iseqw_to_iseq(iseq);
+  long len = RARRAY_LEN(iseq_file->iseqs);
+  for (long i = 0; i < len; i++) {
+    if (rb_iseqw_to_iseq(rb_ary_entry(iseq_file->iseqs, i)) == raw_iseq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void register_iseq(VALUE iseq) {
+  VALUE path = rb_funcall(iseq, id_path, 0);
+  if (!is_iseq_path_included_by_any_collector(path)) {
+    return;
+  }
+
+  struct dd_cov_iseq_file *iseq_file;
+  st_data_t existing_file;
+  char *key = dd_ci_ruby_strndup(RSTRING_PTR(path), RSTRING_LEN(path));
+  if (st_lookup(iseq_files, (st_data_t)key, &existing_file)) {
+    xfree(key);
+    iseq_file = (struct dd_cov_iseq_file *)existing_file;
+    // collectors with different roots walk the same heap
+    if (is_iseq_file_tracing(iseq_file, iseq)) {
+      return;
+    }
+  } else {
+    // allocate Ruby objects before they become reachable only from the table
+    uint32_t file_id = dd_ci_file_id(path);
+    VALUE file_path = dd_ci_file_path(file_id);
+    VALUE iseqs = rb_ary_new();
+    VALUE tracepoints = rb_ary_new();
+    rb_ary_push(iseq_files_objects, iseqs);
+    rb_ary_push(iseq_files_objects, tracepoints);
+
+    iseq_file = ALLOC(struct dd_cov_iseq_file);
+    iseq_file->path = file_path;
+    iseq_file->file_id = file_id;
+    iseq_file->iseqs = iseqs;
+    iseq_file->tracepoints = tracepoints;
+    iseq_file->armed = true;
+    iseq_file->next_fired = NULL;
+    st_insert(iseq_files, (st_data_t)key, (st_data_t)iseq_file);
+  }
+
+  VALUE tracepoint =
+      rb_tracepoint_new(0, RUBY_EVENT_LINE, on_iseq_line_event, iseq_file);
+  // a file that has already fired is re-armed with all its ISeqs on start
+  if (iseq_file->armed &&
+      !safely_enable_tracepoint_for_iseq(tracepoint, iseq)) {
+    return;
+  }
+  rb_ary_push(iseq_file->iseqs, iseq);
+  rb_ary_push(iseq_file->tracepoints, tracepoint);
+}
+
+// Executed on RUBY_EVENT_SCRIPT_COMPILED event to register ISeqs of files
+// loaded after the coverage was started for the first time.
+static void on_script_compiled_event(VALUE tracepoint, void *data) {
+  VALUE iseq = rb_funcall(tracepoint, id_instruction_sequence, 0);
+  if (NIL_P(iseq)) {
+    return;
+  }
+  register_iseq(iseq);
+}
+
+static VALUE mark_iseq_child_i(RB_BLOCK_CALL_FUNC_ARGLIST(child, children)) {
+  st_insert((st_table *)children, (st_data_t)rb_iseqw_to_iseq(child), 1);
+  return Qnil;
+}
+
+static int register_root_iseq_i(st_data_t key, st_data_t value,
+                                st_data_t data) {
+  st_table *children = (st_table *)data;
+  if (!st_is_member(children, key)) {
+    register_iseq((VALUE)value);
+  }
+  return ST_CONTINUE;
+}
+
+// Registers ISeqs that were loaded before the first start. Enabling a
+// TracePoint for an ISeq also covers its children, so only ISeqs that are not
+// children of other live ISeqs get their own TracePoint.
+static void collect_loaded_iseq_files(struct dd_cov_data *dd_cov_data) {
+  struct dd_ci_iseq_filter filter = {
+      .root_path = dd_cov_data->root,
+      .root_path_len = dd_cov_data->root_len,
+      .ignored_path = dd_cov_data->ignored_path,
+      .ignored_path_len = dd_cov_data->ignored_path_len,
+      .iseq_path = rb_iseq_path};
+  VALUE iseqs = dd_ci_collect_iseqs_filtered(&filter);
+  st_table *included_iseqs = st_init_numtable();
+  st_table *children = st_init_numtable();
+
+  long len = RARRAY_LEN(iseqs);
+  for (long i = 0; i < len; i++) {
+    VALUE iseq = rb_ary_entry(iseqs, i);
+    if (!is_iseq_path_included(dd_cov_data,
+                               rb_funcall(iseq, id_path, 0))) {
+      continue;
+    }
+
+    st_insert(included_iseqs, (st_data_t)rb_iseqw_to_iseq(iseq),
+              (st_data_t)iseq);
+    rb_block_call(iseq, id_each_child, 0, NULL, mark_iseq_child_i,
+                  (VALUE)children);
+  }
+
+  st_foreach(included_iseqs, register_root_iseq_i, (st_data_t)children);
+
+  st_free_table(children);
+  st_free_table(included_iseqs);
+  RB_GC_GUARD(iseqs);
+}
+
+// ISeqs of a collector with the same filter as an already registered one are
+// all registered: the heap walk is done once for per-thread collectors.
+static bool is_iseq_filter_registered(struct dd_cov_data *dd_cov_data) {
+  for (long i = 0; i < iseq_collectors.len; i++) {
+    struct dd_cov_data *other = iseq_collectors.items[i];
+    if (other->root_len == dd_cov_data->root_len &&
+        memcmp(other->root, dd_cov_data->root, (size_t)other->root_len) ==
+            0 &&
+        other->ignored_path_len == dd_cov_data->ignored_path_len &&
+        (other->ignored_path_len == 0 ||
+         memcmp(other->ignored_path, dd_cov_data->ignored_path,
+                (size_t)other->ignored_path_len) == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void register_iseq_collector(struct dd_cov_data *dd_cov_data) {
+  if (iseq_files == NULL) {
+    iseq_files = st_init_strtable();
+  }
+  bool collect = !is_iseq_filter_registered(dd_cov_data);
+
+  collectors_add(&iseq_collectors, dd_cov_data);
+  dd_cov_data->iseq_registered = true;
+
+  if (collect) {
+    collect_loaded_iseq_files(dd_cov_data);
+  }
+
+  if (NIL_P(script_compiled_tracepoint)) {
+    script_compiled_tracepoint = rb_tracepoint_new(
+        0, RUBY_EVENT_SCRIPT_COMPILED, on_script_compiled_event, NULL);
+    rb_tracepoint_enable(script_compiled_tracepoint);
+  }
+}
+
+// Disables the TracePoints once no collector is registered. Runs as a
+// postponed job: TracePoints can't be disabled while the garbage collector
+// frees the last collector.
+static void teardown_iseq_line_tracing(void *_data) {
+  if (iseq_collectors.len > 0 || iseq_files == NULL) {
     return;
   }
 
-  dd_cov_data->last_filename = filename;
-  dd_cov_data->seen_filenames[cache_index] = filename;
-  record_impacted_file(dd_cov_data, filename);
+  if (!NIL_P(script_compiled_tracepoint)) {
+    rb_tracepoint_disable(script_compiled_tracepoint);
+    script_compiled_tracepoint = Qnil;
+  }
+
+  st_foreach(iseq_files, free_iseq_file_i, 0);
+  st_free_table(iseq_files);
+  iseq_files = NULL;
+  fired_iseq_files = NULL;
+  rb_ary_clear(iseq_files_objects);
+}
+
+// Called from dd_cov_free: must neither allocate nor call Ruby.
+static void unregister_iseq_collector(struct dd_cov_data *dd_cov_data) {
+  collectors_remove(&iseq_active_collectors, dd_cov_data);
+  collectors_remove(&iseq_collectors, dd_cov_data);
+  dd_cov_data->iseq_registered = false;
+
+  if (iseq_collectors.len == 0) {
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+    rb_postponed_job_trigger(teardown_iseq_line_tracing_job);
+#else
+    rb_postponed_job_register_one(0, teardown_iseq_line_tracing, NULL);
+#endif
+  }
+}
+
+static void start_iseq_line_tracing(struct dd_cov_data *dd_cov_data) {
+  if (!dd_cov_data->iseq_registered) {
+    register_iseq_collector(dd_cov_data);
+  }
+  collectors_add(&iseq_active_collectors, dd_cov_data);
+
+  // re-arm files that were executed since the previous start
+  struct dd_cov_iseq_file *iseq_file = fired_iseq_files;
+  fired_iseq_files = NULL;
+  while (iseq_file != NULL) {
+    struct dd_cov_iseq_file *next = iseq_file->next_fired;
+    iseq_file->next_fired = NULL;
+    arm_iseq_file(iseq_file);
+    iseq_file = next;
+  }
+}
+
+static void stop_iseq_line_tracing(struct dd_cov_data *dd_cov_data) {
+  // TracePoints of files that were not executed stay armed for the next start
+  collectors_remove(&iseq_active_collectors, dd_cov_data);
 }
 
 // Safely get class name, returns Qnil on any error
@@ -250,32 +1021,55 @@ static VALUE safely_get_mod_ancestors(VALUE klass) {
   return dd_ci_rescue_nil(rb_mod_ancestors, klass);
 }
 
-// This function is called for each class that was instantiated during the test
-// run.
-static int each_instantiated_klass(st_data_t key, st_data_t _value,
-                                   st_data_t data) {
-  VALUE klass = (VALUE)key;
-  struct dd_cov_data *dd_cov_data = (struct dd_cov_data *)data;
-
-  st_data_t cached_files;
-  if (st_lookup(dd_cov_data->klass_files_cache, key, &cached_files)) {
-    VALUE files = (VALUE)cached_files;
-    long files_len = RARRAY_LEN(files);
-    for (long i = 0; i < files_len; i++) {
-      rb_hash_aset(dd_cov_data->impacted_files, rb_ary_entry(files, i), Qtrue);
-    }
-    return ST_CONTINUE;
+// Fingerprint of the raw superclass chain, including the internal classes of
+// included and prepended modules. Walking the chain does not allocate.
+static uint64_t klass_chain_fingerprint(VALUE klass) {
+  uint64_t fingerprint = 14695981039346656037ULL;
+  for (VALUE node = klass; RTEST(node); node = RCLASS_SUPER(node)) {
+    fingerprint ^= (uint64_t)node;
+    fingerprint *= 1099511628211ULL;
+  }
+  return fingerprint;
+}
+
+// Returns the ID of the file where the module is defined or -1 when it has no
+// source file under root. Named modules are memoized.
+static long resolve_module_file(struct dd_cov_data *dd_cov_data, VALUE mod) {
+  st_data_t memoized_file;
+  if (st_lookup(dd_cov_data->module_files, (st_data_t)mod, &memoized_file)) {
+    return (long)memoized_file - 1;
+  }
+
+  VALUE klass_name = safely_get_class_name(mod);
+  if (klass_name == Qnil) {
+    return -1;
+  }
+
+  long file_id = -1;
+  VALUE filename = dd_ci_resolve_const_to_file(klass_name);
+  if (filename != Qnil) {
+    file_id = classify_file(dd_cov_data, filename);
   }
 
-  VALUE files = rb_ary_new();
+  if (dd_cov_data->module_files->num_entries < KLASS_FILES_INDEX_SIZE) {
+    st_insert(dd_cov_data->module_files, (st_data_t)mod,
+              (st_data_t)(file_id + 1));
+  }
+  return file_id;
+}
 
+// Resolves the source files of the class and all its ancestors and stores them
+// in the index. Returns the frozen Array of file IDs or Qnil.
+static VALUE index_klass_files(struct dd_cov_data *dd_cov_data, VALUE klass,
+                               uint64_t chain_fingerprint) {
   // rb_mod_ancestors returns an array containing the "klass" itself
   // and all the parent classes and/or included/prepended modules
   VALUE ancestors = safely_get_mod_ancestors(klass);
   if (ancestors == Qnil || !RB_TYPE_P(ancestors, T_ARRAY)) {
-    return ST_CONTINUE;
+    return Qnil;
   }
 
+  VALUE file_ids = rb_ary_new();
   long len = RARRAY_LEN(ancestors);
   for (long i = 0; i < len; i++) {
     VALUE mod = rb_ary_entry(ancestors, i);
@@ -283,35 +1077,125 @@ static int each_instantiated_klass(st_data_t key, st_data_t _value,
       continue;
     }
 
-    VALUE klass_name = safely_get_class_name(mod);
-    if (klass_name == Qnil) {
+    long file_id = resolve_module_file(dd_cov_data, mod);
+    if (file_id < 0) {
       continue;
     }
 
-    VALUE filename = dd_ci_resolve_const_to_file(klass_name);
-    if (filename == Qnil || !record_impacted_file(dd_cov_data, filename)) {
+    rb_ary_push(file_ids, LONG2FIX(file_id));
+  }
+  rb_obj_freeze(file_ids);
+
+  st_data_t existing_entry;
+  if (st_lookup(dd_cov_data->klass_files_index, (st_data_t)klass,
+                &existing_entry)) {
+    struct dd_cov_klass_files *klass_files =
+        (struct dd_cov_klass_files *)existing_entry;
+    klass_files->chain_fingerprint = chain_fingerprint;
+    klass_files->file_ids = file_ids;
+  } else if (dd_cov_data->klass_files_index->num_entries <
+             KLASS_FILES_INDEX_SIZE) {
+    // Classes beyond the limit are resolved on every stop; the index is never
+    // flushed.
+    struct dd_cov_klass_files *klass_files =
+        ALLOC(struct dd_cov_klass_files);
+    klass_files->chain_fingerprint = chain_fingerprint;
+    klass_files->file_ids = file_ids;
+    st_insert(dd_cov_data->klass_files_index, (st_data_t)klass,
+              (st_data_t)klass_files);
+  }
+  return file_ids;
+}
+
+static VALUE push_klass_i(RB_BLOCK_CALL_FUNC_ARGLIST(klass, klasses)) {
+  rb_ary_push(klasses, klass);
+  return Qnil;
+}
+
+// Builds the class index for all named classes that are loaded when coverage
+// starts for the first time.
+static void build_klass_files_index(struct dd_cov_data *dd_cov_data) {
+  VALUE klasses = rb_ary_new();
+  VALUE object_space = rb_const_get(rb_cObject, rb_intern("ObjectSpace"));
+  rb_block_call(object_space, rb_intern("each_object"), 1, &rb_cClass,
+                push_klass_i, klasses);
+
+  long len = RARRAY_LEN(klasses);
+  for (long i = 0; i < len; i++) {
+    VALUE klass = RARRAY_AREF(klasses, i);
+    // anonymous and singleton classes are never recorded
+    if (rb_mod_name(klass) == Qnil) {
       continue;
     }
+    index_klass_files(dd_cov_data, klass, klass_chain_fingerprint(klass));
+  }
+  RB_GC_GUARD(klasses);
 
-    rb_ary_push(files, filename);
+  dd_cov_data->klass_files_indexed = true;
+}
+
+// This function is called for each class that was instantiated during the test
+// run. Indexed classes with an unchanged ancestry chain are a table lookup.
+static void record_instantiated_klass(struct dd_cov_data *dd_cov_data,
+                                      VALUE klass) {
+  uint64_t chain_fingerprint = klass_chain_fingerprint(klass);
+
+  VALUE file_ids = Qnil;
+  st_data_t existing_entry;
+  if (st_lookup(dd_cov_data->klass_files_index, (st_data_t)klass,
+                &existing_entry)) {
+    struct dd_cov_klass_files *klass_files =
+        (struct dd_cov_klass_files *)existing_entry;
+    if (klass_files->chain_fingerprint == chain_fingerprint) {
+      file_ids = klass_files->file_ids;
+    }
+  }
+  if (file_ids != Qnil) {
+    dd_cov_data->stats.klass_index_hits++;
+  } else {
+    dd_cov_data->stats.klass_index_misses++;
+    file_ids = index_klass_files(dd_cov_data, klass, chain_fingerprint);
+    if (file_ids == Qnil) {
+      return;
+    }
   }
 
-  rb_obj_freeze(files);
-  // Bound cross-test retention without adding eviction work to cache hits.
-  // Reaching the limit starts a fresh cache generation.
-  if (dd_cov_data->klass_files_cache_size >= KLASS_FILES_CACHE_SIZE) {
-    st_clear(dd_cov_data->klass_files_cache);
-    dd_cov_data->klass_files_cache_size = 0;
+  long file_ids_len = RARRAY_LEN(file_ids);
+  for (long i = 0; i < file_ids_len; i++) {
+    dd_ci_covered_files_add(dd_cov_data->impacted_files,
+                            (uint32_t)FIX2ULONG(RARRAY_AREF(file_ids, i)));
   }
-  st_insert(dd_cov_data->klass_files_cache, key, (st_data_t)files);
-  dd_cov_data->klass_files_cache_size++;
+}
 
-  return ST_CONTINUE;
+// Appends the class to the classes covered in the current generation. Uses
+// libc realloc because Ruby's allocator may start GC inside the NEWOBJ hook.
+static bool push_generation_klass(struct dd_cov_data *dd_cov_data,
+                                  VALUE klass) {
+  if (dd_cov_data->generation_klasses_len ==
+      dd_cov_data->generation_klasses_capa) {
+    size_t new_capa = dd_cov_data->generation_klasses_capa == 0
+                          ? 64
+                          : dd_cov_data->generation_klasses_capa * 2;
+    VALUE *new_klasses =
+        realloc(dd_cov_data->generation_klasses, new_capa * sizeof(VALUE));
+    if (new_klasses == NULL) {
+      return false;
+    }
+    dd_cov_data->generation_klasses = new_klasses;
+    dd_cov_data->generation_klasses_capa = new_capa;
+  }
+
+  dd_cov_data->generation_klasses[dd_cov_data->generation_klasses_len++] =
+      klass;
+  return true;
 }
 
 // Executed on RUBY_INTERNAL_EVENT_NEWOBJ event and captures the source file for
 // the allocated object's class.
 static void on_newobj_event(VALUE self, const rb_trace_arg_t *tracearg) {
+  struct dd_cov_data *dd_cov_data = RTYPEDDATA_DATA(self);
+  dd_cov_data->stats.newobj_events++;
+
   VALUE new_object = rb_tracearg_object((rb_trace_arg_t *)tracearg);
 
   // To keep things fast and practical, we only care about objects that extend
@@ -326,9 +1210,8 @@ static void on_newobj_event(VALUE self, const rb_trace_arg_t *tracearg) {
     return;
   }
 
-  struct dd_cov_data *dd_cov_data = RTYPEDDATA_DATA(self);
-
   if (dd_cov_data->last_allocated_klass == klass) {
+    dd_cov_data->stats.klass_cache_hits++;
     return;
   }
 
@@ -336,30 +1219,57 @@ static void on_newobj_event(VALUE self, const rb_trace_arg_t *tracearg) {
   size_t cache_index =
       ((klass_ptr >> 4) ^ (klass_ptr >> 12)) &
       (SEEN_ALLOCATED_CLASS_CACHE_SIZE - 1);
-  if (dd_cov_data->seen_allocated_klasses[cache_index] == klass) {
+  struct dd_cov_seen_klass *seen_klass =
+      &dd_cov_data->seen_allocated_klasses[cache_index];
+  if (seen_klass->klass == klass &&
+      seen_klass->generation == dd_cov_data->generation) {
+    dd_cov_data->stats.klass_cache_hits++;
     dd_cov_data->last_allocated_klass = klass;
     return;
   }
 
   // A direct-cache collision must not make us repeat name resolution or table
-  // insertion for a class that this test already observed.
-  if (st_is_member(dd_cov_data->klasses_table, (st_data_t)klass)) {
-    dd_cov_data->last_allocated_klass = klass;
-    dd_cov_data->seen_allocated_klasses[cache_index] = klass;
-    return;
-  }
+  // insertion for a class that this test already observed. Classes seen by
+  // earlier tests only need their generation stamp updated.
+  st_data_t klass_generation;
+  if (st_lookup(dd_cov_data->klasses_table, (st_data_t)klass,
+                &klass_generation)) {
+    if ((unsigned long)klass_generation != dd_cov_data->generation) {
+      if (!push_generation_klass(dd_cov_data, klass)) {
+        return;
+      }
+      st_insert(dd_cov_data->klasses_table, (st_data_t)klass,
+                (st_data_t)dd_cov_data->generation);
+    }
+  } else {
+    // rb_mod_name returns nil for anonymous classes and is safe during
+    // NEWOBJ.
+    if (rb_mod_name(klass) == Qnil) {
+      return;
+    }
+    if (!push_generation_klass(dd_cov_data, klass)) {
+      return;
+    }
 
-  // rb_mod_name returns nil for anonymous classes and is safe during NEWOBJ.
-  if (rb_mod_name(klass) == Qnil) {
-    return;
+    // We use VALUE directly as a key for the hashmap
+    // Ruby itself does it too:
+    // https://github.com/ruby/ruby/blob/94b87084a689a3bc732dcaee744508a708223d6c/ext/objspace/object_tracing.c#L113
+    st_insert(dd_cov_data->klasses_table, (st_data_t)klass,
+              (st_data_t)dd_cov_data->generation);
   }
 
-  // We use VALUE directly as a key for the hashmap
-  // Ruby itself does it too:
-  // https://github.com/ruby/ruby/blob/94b87084a689a3bc732dcaee744508a708223d6c/ext/objspace/object_tracing.c#L113
-  st_insert(dd_cov_data->klasses_table, (st_data_t)klass, 1);
   dd_cov_data->last_allocated_klass = klass;
-  dd_cov_data->seen_allocated_klasses[cache_index] = klass;
+  if (seen_klass->klass != 0 && seen_klass->klass != klass) {
+    dd_cov_data->stats.klass_cache_evictions++;
+  }
+  seen_klass->klass = klass;
+  seen_klass->generation = dd_cov_data->generation;
+}
+
+static uint64_t monotonic_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
 // DDCov instance methods available in Ruby
@@ -395,6 +1305,18 @@ static VALUE dd_cov_initialize(int argc, VALUE *argv, VALUE self) {
     rb_raise(rb_eArgError, "threading mode is invalid");
   }
 
+  VALUE rb_line_tracing_mode =
+      rb_hash_lookup(opt, ID2SYM(rb_intern("line_tracing_mode")));
+  enum line_tracing_mode line_tracing_mode;
+  if (NIL_P(rb_line_tracing_mode) ||
+      rb_line_tracing_mode == ID2SYM(rb_intern("global"))) {
+    line_tracing_mode = global_line_tracing;
+  } else if (rb_line_tracing_mode == ID2SYM(rb_intern("iseq"))) {
+    line_tracing_mode = iseq_line_tracing;
+  } else {
+    rb_raise(rb_eArgError, "line tracing mode is invalid");
+  }
+
   VALUE rb_allocation_tracing_enabled =
       rb_hash_lookup(opt, ID2SYM(rb_intern("use_allocation_tracing")));
   if (rb_allocation_tracing_enabled == Qtrue && threading_mode == single) {
@@ -407,6 +1329,7 @@ static VALUE dd_cov_initialize(int argc, VALUE *argv, VALUE self) {
                        dd_cov_data);
 
   dd_cov_data->threading_mode = threading_mode;
+  dd_cov_data->line_tracing_mode = line_tracing_mode;
   dd_cov_data->root_len = RSTRING_LEN(rb_root);
   dd_cov_data->root = dd_ci_ruby_strndup(root, dd_cov_data->root_len);
 
@@ -433,14 +1356,25 @@ static VALUE dd_cov_start(VALUE self) {
     rb_raise(rb_eRuntimeError, "root is required");
   }
 
+  if (dd_cov_data->allocation_tracing_enabled &&
+      !dd_cov_data->klass_files_indexed) {
+    build_klass_files_index(dd_cov_data);
+  }
+
   // add line tracepoint
-  if (dd_cov_data->threading_mode == single) {
+  if (dd_cov_data->line_tracing_mode == iseq_line_tracing) {
+    if (dd_cov_data->threading_mode == single) {
+      dd_cov_data->th_covered = rb_thread_current();
+    }
+    start_iseq_line_tracing(dd_cov_data);
+  } else if (dd_cov_data->threading_mode == single) {
     VALUE thval = rb_thread_current();
     rb_thread_add_event_hook(thval, on_line_event, RUBY_EVENT_LINE, self);
     dd_cov_data->th_covered = thval;
   } else {
-    rb_add_event_hook(on_line_event, RUBY_EVENT_LINE, self);
+    start_shared_line_hook(self, dd_cov_data);
   }
+  dd_cov_data->collecting = true;
 
   // Register the raw hook that TracePoint would wrap and dispatch directly to
   // the allocation callback. NEWOBJ permits no general Ruby API; the callback
@@ -466,6 +1400,8 @@ static VALUE dd_cov_stop(VALUE self) {
   TypedData_Get_Struct(self, struct dd_cov_data, &dd_cov_data_type,
                        dd_cov_data);
 
+  uint64_t started_at = monotonic_time_ns();
+
   // stop line tracepoint
   if (dd_cov_data->threading_mode == single) {
     VALUE thval = rb_thread_current();
@@ -473,11 +1409,17 @@ static VALUE dd_cov_stop(VALUE self) {
       rb_raise(rb_eRuntimeError, "Coverage was not started by this thread");
     }
 
-    rb_thread_remove_event_hook(dd_cov_data->th_covered, on_line_event);
+    if (dd_cov_data->line_tracing_mode == global_line_tracing) {
+      rb_thread_remove_event_hook(dd_cov_data->th_covered, on_line_event);
+    }
     dd_cov_data->th_covered = Qnil;
-  } else {
-    rb_remove_event_hook(on_line_event);
+  } else if (dd_cov_data->line_tracing_mode == global_line_tracing) {
+    stop_shared_line_hook(self, dd_cov_data);
   }
+  if (dd_cov_data->line_tracing_mode == iseq_line_tracing) {
+    stop_iseq_line_tracing(dd_cov_data);
+  }
+  dd_cov_data->collecting = false;
 
   // Remove only this collector's hook; other concurrently active collectors
   // continue to receive allocation events.
@@ -487,24 +1429,63 @@ static VALUE dd_cov_stop(VALUE self) {
   }
 
   // process classes covered by allocation tracing
-  st_foreach(dd_cov_data->klasses_table, each_instantiated_klass,
-             (st_data_t)dd_cov_data);
+  for (size_t i = 0; i < dd_cov_data->generation_klasses_len; i++) {
+    record_instantiated_klass(dd_cov_data,
+                              dd_cov_data->generation_klasses[i]);
+  }
+  dd_cov_data->generation_klasses_len = 0;
   dd_cov_data->last_allocated_klass = Qnil;
-  memset(dd_cov_data->seen_allocated_klasses, 0,
-         sizeof(dd_cov_data->seen_allocated_klasses));
-  st_clear(dd_cov_data->klasses_table);
+  // Bound cross-test retention the same way as the class index.
+  if (dd_cov_data->klasses_table->num_entries >= KLASS_FILES_INDEX_SIZE) {
+    st_clear(dd_cov_data->klasses_table);
+  }
 
   VALUE res = dd_cov_data->impacted_files;
 
-  dd_cov_data->impacted_files = rb_hash_new();
-  dd_cov_data->last_filename = Qnil;
-  for (size_t i = 0; i < SEEN_FILENAME_CACHE_SIZE; i++) {
-    dd_cov_data->seen_filenames[i] = Qnil;
+  // start the next generation: per-test caches become stale in O(1)
+  dd_cov_data->impacted_files = dd_ci_covered_files_new();
+  dd_cov_data->generation++;
+  dd_cov_data->last_source_file = NULL;
+
+  uint64_t elapsed_ns = monotonic_time_ns() - started_at;
+  dd_cov_data->stats.stop_calls++;
+  dd_cov_data->stats.stop_time_ns += elapsed_ns;
+  if (elapsed_ns > dd_cov_data->stats.stop_max_time_ns) {
+    dd_cov_data->stats.stop_max_time_ns = elapsed_ns;
   }
 
   return res;
 }
 
+// returns the hot path counters collected since the collector was created
+static VALUE dd_cov_stats(VALUE self) {
+  struct dd_cov_data *dd_cov_data;
+  TypedData_Get_Struct(self, struct dd_cov_data, &dd_cov_data_type,
+                       dd_cov_data);
+
+  const struct dd_cov_stats *stats = &dd_cov_data->stats;
+  VALUE res = rb_hash_new();
+#define DD_COV_STAT(name)                                                      \
+  rb_hash_aset(res, ID2SYM(rb_intern(#name)), ULL2NUM(stats->name))
+  DD_COV_STAT(line_events);
+  DD_COV_STAT(line_fast_path_hits);
+  DD_COV_STAT(line_direct_cache_hits);
+  DD_COV_STAT(line_table_hits);
+  DD_COV_STAT(profile_frames_calls);
+  DD_COV_STAT(excluded_path_verdicts);
+  DD_COV_STAT(source_files_cache_resets);
+  DD_COV_STAT(newobj_events);
+  DD_COV_STAT(klass_cache_hits);
+  DD_COV_STAT(klass_cache_evictions);
+  DD_COV_STAT(klass_index_hits);
+  DD_COV_STAT(klass_index_misses);
+  DD_COV_STAT(stop_calls);
+  DD_COV_STAT(stop_time_ns);
+  DD_COV_STAT(stop_max_time_ns);
+#undef DD_COV_STAT
+  return res;
+}
+
 void Init_datadog_cov(void) {
   VALUE mDatadog = rb_define_module("Datadog");
   VALUE mCI = rb_define_module_under(mDatadog, "CI");
@@ -512,9 +1493,39 @@ void Init_datadog_cov(void) {
   VALUE mCoverage = rb_define_module_under(mTestImpactAnalysis, "Coverage");
   VALUE cDatadogCov = rb_define_class_under(mCoverage, "DDCov", rb_cObject);
 
+  iseq_files_objects = rb_ary_new();
+  rb_gc_register_address(&iseq_files_objects);
+  rb_gc_register_address(&script_compiled_tracepoint);
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+  teardown_iseq_line_tracing_job =
+      rb_postponed_job_preregister(0, teardown_iseq_line_tracing, NULL);
+#endif
+
+  shared_hook_collectors = rb_ary_new();
+  rb_gc_register_address(&shared_hook_collectors);
+  rb_gc_register_address(&owner_cache_fiber);
+  fiber_owners = st_init_numtable();
+  fiber_owners_object =
+      TypedData_Wrap_Struct(0, &fiber_owners_data_type, fiber_owners);
+  rb_gc_register_address(&fiber_owners_object);
+  owner_key = ID2SYM(rb_intern("__datadog_ci_coverage_owner"));
+
+  id_aref = rb_intern("[]");
+  id_aset = rb_intern("[]=");
+  id_path = rb_intern("path");
+  id_enable = rb_intern("enable");
+  id_target = rb_intern("target");
+  id_instruction_sequence = rb_intern("instruction_sequence");
+  id_each_child = rb_intern("each_child");
+
+  // inheritable fiber storage is available since Ruby 3.2
+  cFiber = rb_const_get(rb_cObject, rb_intern("Fiber"));
+  fiber_storage_supported = rb_respond_to(cFiber, id_aref);
+
   rb_define_alloc_func(cDatadogCov, dd_cov_allocate);
 
   rb_define_method(cDatadogCov, "initialize", dd_cov_initialize, -1);
   rb_define_method(cDatadogCov, "start", dd_cov_start, 0);
   rb_define_method(cDatadogCov, "stop", dd_cov_stop, 0);
+  rb_define_method(cDatadogCov, "stats", dd_cov_stats, 0);
 }
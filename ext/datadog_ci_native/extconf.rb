@@ -9,6 +9,9 @@ end
 
 require "mkmf"
 
+# Ruby 3.3+ replaces rb_postponed_job_register_one with preregistered jobs
+have_func("rb_postponed_job_preregister", "ruby/debug.h")
+
 # Tag the native extension library with the Ruby version and Ruby platform.
 # This makes it easier for development (avoids "oops I forgot to rebuild when I switched my Ruby") and ensures that
 # the wrong library is never loaded.
@@ -6,18 +6,69 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "covered_files.h"
 #include "file_serialization.h"
 
 // Bulk file serialization is independent from coverage collection. It packs
 // large file lists without building normalized intermediate Ruby collections.
+//
+// The same repository files appear in almost every coverage event, so the
+// {"filename" => relative path} entry of every path is validated and encoded
+// once per process. Entries of covered files are indexed by the process-wide
+// file ID of the path (see covered_files.h), files of a CoveredFiles set are
+// packed without looking up their path at all. Other paths (Hash keys and
+// custom impacted files) are never interned as covered files, their entries
+// are indexed by a path table of their own. Paths are deduplicated by the ID
+// of their relative path, which is the name that is serialized.
+
+enum filename_entry_state {
+  FILENAME_ENTRY_UNKNOWN = 0,
+  // outside of the root or empty, never serialized
+  FILENAME_ENTRY_SKIPPED,
+  // not supported by the fast path, the files are packed in Ruby
+  FILENAME_ENTRY_UNSUPPORTED,
+  FILENAME_ENTRY_PACKED
+};
+
+struct filename_entry {
+  uint8_t state;
+  bool absolute;
+  bool binary;
+  uint8_t header_len;
+  uint32_t dedup_id;
+  uint32_t packed_len;
+  // {"filename" => relative path} MessagePack bytes
+  char *packed;
+};
+
+struct filename_entries {
+  struct filename_entry *entries;
+  size_t len;
+};
+
+// Entries valid for filename_entries_root: by covered file ID and by
+// path_entry_ids index.
+static struct filename_entries file_id_entries = {NULL, 0};
+static struct filename_entries path_entries = {NULL, 0};
+// { String -> Integer } path that is not interned as a covered file to index
+// in path_entries
+static VALUE path_entry_ids = Qnil;
+static char *filename_entries_root = NULL;
+static long filename_entries_root_len = 0;
+
+// { String -> Integer } relative path to deduplication ID
+static VALUE dedup_ids = Qnil;
+// Deduplication set: a relative path was already packed in the current call
+// when its stamp equals the stamp of the call.
+static uint32_t *dedup_stamps = NULL;
+static size_t dedup_stamps_len = 0;
+static uint32_t dedup_stamp = 0;
 
 struct packed_files_context {
-  VALUE root;
-  VALUE seen;
   VALUE packed;
-  long root_len;
+  // offset of the files array header in packed
+  long header_offset;
   uint32_t files_count;
-  bool direct_absolute;
   bool fast_path_supported;
 };
 
@@ -32,111 +83,116 @@ static bool string_bytes_are_ascii(VALUE string) {
   return true;
 }
 
-static void packed_files_append_u16(VALUE packed, uint16_t value) {
-  unsigned char bytes[2] = {(unsigned char)(value >> 8),
-                            (unsigned char)value};
-  rb_str_cat(packed, (const char *)bytes, 2);
-}
-
-static void packed_files_append_u32(VALUE packed, uint32_t value) {
-  unsigned char bytes[4] = {
-      (unsigned char)(value >> 24), (unsigned char)(value >> 16),
-      (unsigned char)(value >> 8), (unsigned char)value};
-  rb_str_cat(packed, (const char *)bytes, 4);
-}
-
-static void packed_files_append_string_header(VALUE packed, uint32_t len,
-                                              bool binary) {
-  unsigned char byte;
+// Writes the MessagePack str (or bin) header for len bytes, returns the size
+// of the header.
+static size_t encode_string_header(unsigned char *out, uint32_t len,
+                                   bool binary) {
   if (binary) {
     if (len < 256) {
-      byte = 0xc4;
-      rb_str_cat(packed, (const char *)&byte, 1);
-      byte = (unsigned char)len;
-      rb_str_cat(packed, (const char *)&byte, 1);
-    } else if (len < 65536) {
-      byte = 0xc5;
-      rb_str_cat(packed, (const char *)&byte, 1);
-      packed_files_append_u16(packed, (uint16_t)len);
-    } else {
-      byte = 0xc6;
-      rb_str_cat(packed, (const char *)&byte, 1);
-      packed_files_append_u32(packed, len);
+      out[0] = 0xc4;
+      out[1] = (unsigned char)len;
+      return 2;
     }
+    if (len < 65536) {
+      out[0] = 0xc5;
+      out[1] = (unsigned char)(len >> 8);
+      out[2] = (unsigned char)len;
+      return 3;
+    }
+    out[0] = 0xc6;
   } else if (len < 32) {
-    byte = (unsigned char)(0xa0U | len);
-    rb_str_cat(packed, (const char *)&byte, 1);
+    out[0] = (unsigned char)(0xa0U | len);
+    return 1;
   } else if (len < 256) {
-    byte = 0xd9;
-    rb_str_cat(packed, (const char *)&byte, 1);
-    byte = (unsigned char)len;
-    rb_str_cat(packed, (const char *)&byte, 1);
+    out[0] = 0xd9;
+    out[1] = (unsigned char)len;
+    return 2;
   } else if (len < 65536) {
-    byte = 0xda;
-    rb_str_cat(packed, (const char *)&byte, 1);
-    packed_files_append_u16(packed, (uint16_t)len);
+    out[0] = 0xda;
+    out[1] = (unsigned char)(len >> 8);
+    out[2] = (unsigned char)len;
+    return 3;
   } else {
-    byte = 0xdb;
-    rb_str_cat(packed, (const char *)&byte, 1);
-    packed_files_append_u32(packed, len);
+    out[0] = 0xdb;
   }
+  out[1] = (unsigned char)(len >> 24);
+  out[2] = (unsigned char)(len >> 16);
+  out[3] = (unsigned char)(len >> 8);
+  out[4] = (unsigned char)len;
+  return 5;
 }
 
-static bool packed_files_append_entry(struct packed_files_context *context,
-                                      VALUE file, bool additional_file) {
-  if (file == Qnil && !additional_file) {
-    return true;
+static const unsigned char filename_entry_prefix[] = {
+    0x81, 0xa8, 'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e'};
+
+static bool string_is_binary(VALUE string) {
+  return rb_enc_get_index(string) == rb_ascii8bit_encindex();
+}
+
+static void clear_filename_entries(struct filename_entries *entries) {
+  for (size_t i = 0; i < entries->len; i++) {
+    xfree(entries->entries[i].packed);
   }
-  if (!RB_TYPE_P(file, T_STRING) || rb_obj_class(file) != rb_cString) {
-    context->fast_path_supported = false;
-    return false;
+  xfree(entries->entries);
+  entries->entries = NULL;
+  entries->len = 0;
+}
+
+static void reset_filename_entries(VALUE root) {
+  clear_filename_entries(&file_id_entries);
+  clear_filename_entries(&path_entries);
+  rb_hash_clear(path_entry_ids);
+
+  xfree(filename_entries_root);
+  filename_entries_root_len = RSTRING_LEN(root);
+  filename_entries_root = ALLOC_N(char, filename_entries_root_len);
+  memcpy(filename_entries_root, RSTRING_PTR(root),
+         (size_t)filename_entries_root_len);
+}
+
+// Returns the dense ID of the string in ids, assigning the next one on first
+// use.
+static uint32_t string_id_for(VALUE ids, VALUE string) {
+  VALUE id = rb_hash_lookup2(ids, string, Qundef);
+  if (id != Qundef) {
+    return (uint32_t)FIX2ULONG(id);
   }
 
-  VALUE relative_file = file;
-  VALUE dedup_file = file;
-  long relative_len = RSTRING_LEN(file);
-  long relative_offset = 0;
+  long next_id = RHASH_SIZE(ids);
+  if (next_id >= UINT32_MAX) {
+    rb_raise(rb_eRuntimeError, "too many serialized files");
+  }
+  rb_hash_aset(ids, rb_str_new_frozen(string), LONG2FIX(next_id));
+  return (uint32_t)next_id;
+}
+
+// Validates the path and encodes its entry. Mirrors the normalization of
+// Coverage::Files: absolute paths are relative to root, paths outside of root
+// are dropped.
+static void fill_filename_entry(struct filename_entry *entry, VALUE file) {
   const char *file_ptr = RSTRING_PTR(file);
   long file_len = RSTRING_LEN(file);
-  if (memchr(file_ptr, '\0', (size_t)file_len) != NULL) {
-    context->fast_path_supported = false;
-    return false;
-  }
-  bool absolute = file_len > 0 && file_ptr[0] == '/';
-  if (absolute) {
-    if (file_len <= context->root_len ||
-        memcmp(file_ptr, RSTRING_PTR(context->root),
-               (size_t)context->root_len) != 0 ||
-        file_ptr[context->root_len] != '/') {
-      // Absolute additional files outside the immutable repository root are
-      // ignored. Primary files are already filtered by the same root.
-      return true;
-    }
+  entry->absolute = file_len > 0 && file_ptr[0] == '/';
 
-    relative_len = file_len - context->root_len - 1;
-    if (relative_len == 0) {
-      return true;
-    }
-    if (context->direct_absolute) {
-      relative_offset = context->root_len + 1;
-    } else {
-      relative_file = rb_str_substr(file, context->root_len + 1, file_len);
-      dedup_file = relative_file;
-    }
-  } else if (!additional_file) {
-    // Relative primary paths depend on cwd-to-root Pathname semantics. They
-    // are uncommon and retain the authoritative Ruby fallback.
-    context->fast_path_supported = false;
-    return false;
+  if (file_len > 0 && memchr(file_ptr, '\0', (size_t)file_len) != NULL) {
+    entry->state = FILENAME_ENTRY_UNSUPPORTED;
+    return;
   }
 
-  if (relative_len == 0) {
-    return true;
-  }
-  if (rb_hash_lookup2(context->seen, dedup_file, Qundef) != Qundef) {
-    return true;
+  VALUE relative_file = file;
+  if (entry->absolute) {
+    long root_len = filename_entries_root_len;
+    if (file_len <= root_len + 1 ||
+        memcmp(file_ptr, filename_entries_root, (size_t)root_len) != 0 ||
+        file_ptr[root_len] != '/') {
+      entry->state = FILENAME_ENTRY_SKIPPED;
+      return;
+    }
+    relative_file = rb_str_substr(file, root_len + 1, file_len);
+  } else if (file_len == 0) {
+    entry->state = FILENAME_ENTRY_SKIPPED;
+    return;
   }
-  rb_hash_aset(context->seen, dedup_file, Qtrue);
 
   int encoding_index = rb_enc_get_index(relative_file);
   bool binary = encoding_index == rb_ascii8bit_encindex();
@@ -144,28 +200,143 @@ static bool packed_files_append_entry(struct packed_files_context *context,
       encoding_index != rb_usascii_encindex() &&
       (!rb_enc_str_asciicompat_p(relative_file) ||
        !string_bytes_are_ascii(relative_file))) {
-    context->fast_path_supported = false;
-    return false;
+    entry->state = FILENAME_ENTRY_UNSUPPORTED;
+    return;
   }
 
+  long relative_len = RSTRING_LEN(relative_file);
   if (relative_len > UINT32_MAX) {
     rb_raise(rb_eArgError, "size of filename is too long to pack: %lu bytes",
              (unsigned long)relative_len);
   }
 
-  static const unsigned char filename_entry_prefix[] = {
-      0x81, 0xa8, 'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e'};
-  rb_str_cat(context->packed, (const char *)filename_entry_prefix,
-             sizeof(filename_entry_prefix));
-  packed_files_append_string_header(context->packed, (uint32_t)relative_len,
-                                    binary);
-  const char *relative_ptr = RSTRING_PTR(relative_file) + relative_offset;
-  rb_str_cat(context->packed, relative_ptr, relative_len);
+  unsigned char header[5];
+  size_t header_len =
+      encode_string_header(header, (uint32_t)relative_len, binary);
+  size_t packed_len =
+      sizeof(filename_entry_prefix) + header_len + (size_t)relative_len;
+
+  // allocate before the entry is published: string_id_for may raise
+  uint32_t dedup_id = string_id_for(dedup_ids, relative_file);
+  char *packed = ALLOC_N(char, packed_len);
+  memcpy(packed, filename_entry_prefix, sizeof(filename_entry_prefix));
+  memcpy(packed + sizeof(filename_entry_prefix), header, header_len);
+  memcpy(packed + sizeof(filename_entry_prefix) + header_len,
+         RSTRING_PTR(relative_file), (size_t)relative_len);
   RB_GC_GUARD(relative_file);
+
+  entry->binary = binary;
+  entry->header_len = (uint8_t)header_len;
+  entry->dedup_id = dedup_id;
+  entry->packed_len = (uint32_t)packed_len;
+  entry->packed = packed;
+  entry->state = FILENAME_ENTRY_PACKED;
+}
+
+static struct filename_entry *
+filename_entry_for(struct filename_entries *entries, uint32_t index,
+                   VALUE file) {
+  if (index >= entries->len) {
+    size_t new_len = entries->len == 0 ? 1024 : entries->len;
+    while (new_len <= index) {
+      new_len *= 2;
+    }
+    REALLOC_N(entries->entries, struct filename_entry, new_len);
+    memset(entries->entries + entries->len, 0,
+           (new_len - entries->len) * sizeof(struct filename_entry));
+    entries->len = new_len;
+  }
+
+  struct filename_entry *entry = &entries->entries[index];
+  if (entry->state == FILENAME_ENTRY_UNKNOWN) {
+    fill_filename_entry(entry, file);
+  }
+  return entry;
+}
+
+// Starts a new deduplication set.
+static void next_dedup_stamp(void) {
+  dedup_stamp++;
+  if (dedup_stamp == 0) {
+    memset(dedup_stamps, 0, dedup_stamps_len * sizeof(uint32_t));
+    dedup_stamp = 1;
+  }
+}
+
+// Returns true the first time the relative path is seen in the current set.
+static bool dedup_add(uint32_t dedup_id) {
+  if (dedup_id >= dedup_stamps_len) {
+    size_t new_len = dedup_stamps_len == 0 ? 1024 : dedup_stamps_len;
+    while (new_len <= dedup_id) {
+      new_len *= 2;
+    }
+    REALLOC_N(dedup_stamps, uint32_t, new_len);
+    memset(dedup_stamps + dedup_stamps_len, 0,
+           (new_len - dedup_stamps_len) * sizeof(uint32_t));
+    dedup_stamps_len = new_len;
+  }
+
+  if (dedup_stamps[dedup_id] == dedup_stamp) {
+    return false;
+  }
+  dedup_stamps[dedup_id] = dedup_stamp;
+  return true;
+}
+
+static bool packed_files_append_cached_entry(
+    struct packed_files_context *context, const struct filename_entry *entry,
+    bool additional_file, bool binary) {
+  // Relative primary paths depend on cwd-to-root Pathname semantics. They
+  // are uncommon and retain the authoritative Ruby fallback.
+  if (entry->state == FILENAME_ENTRY_UNSUPPORTED ||
+      (!additional_file && !entry->absolute)) {
+    context->fast_path_supported = false;
+    return false;
+  }
+  if (entry->state == FILENAME_ENTRY_SKIPPED || !dedup_add(entry->dedup_id)) {
+    return true;
+  }
+
+  if (entry->binary == binary) {
+    rb_str_cat(context->packed, entry->packed, entry->packed_len);
+  } else {
+    // ASCII-only paths that differ only by the binary encoding share the
+    // file ID, the path is packed with the other string header
+    size_t path_offset = sizeof(filename_entry_prefix) + entry->header_len;
+    uint32_t path_len = entry->packed_len - (uint32_t)path_offset;
+    unsigned char header[5];
+    size_t header_len = encode_string_header(header, path_len, binary);
+    rb_str_cat(context->packed, (const char *)filename_entry_prefix,
+               sizeof(filename_entry_prefix));
+    rb_str_cat(context->packed, (const char *)header, header_len);
+    rb_str_cat(context->packed, entry->packed + path_offset, path_len);
+  }
   context->files_count++;
   return true;
 }
 
+static bool packed_files_append_entry(struct packed_files_context *context,
+                                      VALUE file, bool additional_file) {
+  if (file == Qnil && !additional_file) {
+    return true;
+  }
+  if (!RB_TYPE_P(file, T_STRING) || rb_obj_class(file) != rb_cString) {
+    context->fast_path_supported = false;
+    return false;
+  }
+
+  // covered files reuse the entry of their file ID, other paths are not
+  // interned: the covered files table sizes every coverage bitmap
+  uint32_t file_id;
+  const struct filename_entry *entry =
+      dd_ci_file_id_lookup(file, &file_id)
+          ? filename_entry_for(&file_id_entries, file_id, file)
+          : filename_entry_for(&path_entries,
+                               string_id_for(path_entry_ids, file), file);
+  return packed_files_append_cached_entry(context, entry, additional_file,
+                                          string_is_binary(file));
+}
+
 static int pack_primary_file_i(VALUE file, VALUE _value,
                                VALUE context_value) {
   struct packed_files_context *context =
@@ -174,22 +345,14 @@ static int pack_primary_file_i(VALUE file, VALUE _value,
                                                          : ST_STOP;
 }
 
-static bool packed_file_is_absolute(VALUE file, bool additional_file) {
-  if (file == Qnil && !additional_file) {
-    return true;
-  }
-  return RB_TYPE_P(file, T_STRING) && rb_obj_class(file) == rb_cString &&
-         RSTRING_LEN(file) > 0 && RSTRING_PTR(file)[0] == '/';
-}
-
-static int detect_absolute_primary_file_i(VALUE file, VALUE _value,
-                                          VALUE all_absolute_value) {
-  bool *all_absolute = (bool *)all_absolute_value;
-  if (!packed_file_is_absolute(file, false)) {
-    *all_absolute = false;
-    return ST_STOP;
-  }
-  return ST_CONTINUE;
+static int pack_covered_file_i(uint32_t file_id, void *context_ptr) {
+  struct packed_files_context *context = context_ptr;
+  const struct filename_entry *entry =
+      filename_entry_for(&file_id_entries, file_id, dd_ci_file_path(file_id));
+  return packed_files_append_cached_entry(context, entry, false,
+                                          entry->binary)
+             ? ST_CONTINUE
+             : ST_STOP;
 }
 
 static void
@@ -213,62 +376,327 @@ packed_files_write_array_header(struct packed_files_context *context) {
     header_len = 5;
   }
 
-  long body_len = RSTRING_LEN(context->packed) - 5;
-  char *packed_ptr = RSTRING_PTR(context->packed);
+  long body_offset = context->header_offset + 5;
+  long body_len = RSTRING_LEN(context->packed) - body_offset;
+  char *header_ptr = RSTRING_PTR(context->packed) + context->header_offset;
   if (header_len != 5) {
-    memmove(packed_ptr + header_len, packed_ptr + 5, (size_t)body_len);
-    rb_str_resize(context->packed, body_len + (long)header_len);
-    packed_ptr = RSTRING_PTR(context->packed);
+    memmove(header_ptr + header_len, header_ptr + 5, (size_t)body_len);
+    rb_str_set_len(context->packed,
+                   context->header_offset + (long)header_len + body_len);
+    header_ptr = RSTRING_PTR(context->packed) + context->header_offset;
   }
-  memcpy(packed_ptr, header, header_len);
+  memcpy(header_ptr, header, header_len);
 }
 
-static VALUE file_serialization_pack_files(VALUE module, VALUE primary_files,
-                                           VALUE additional_files,
-                                           VALUE root) {
-  Check_Type(primary_files, T_HASH);
-  Check_Type(additional_files, T_ARRAY);
+// Appends the MessagePack files array to the end of packed. Primary files are
+// either a Hash keyed by file path or a Coverage::CoveredFiles set. Returns
+// false without consuming the written bytes when the files need the Ruby
+// fallback; the caller truncates packed.
+static bool pack_files_into(VALUE packed, VALUE primary_files,
+                            VALUE additional_files, VALUE root) {
   if (!RB_TYPE_P(root, T_STRING) || rb_obj_class(root) != rb_cString ||
       RSTRING_LEN(root) == 0 || !string_bytes_are_ascii(root)) {
-    return Qnil;
+    return false;
   }
-
-  bool all_absolute = true;
-  rb_hash_foreach(primary_files, detect_absolute_primary_file_i,
-                  (VALUE)&all_absolute);
-  long additional_files_len = RARRAY_LEN(additional_files);
-  for (long i = 0; all_absolute && i < additional_files_len; i++) {
-    all_absolute =
-        packed_file_is_absolute(rb_ary_entry(additional_files, i), true);
+  if (filename_entries_root == NULL ||
+      filename_entries_root_len != RSTRING_LEN(root) ||
+      memcmp(filename_entries_root, RSTRING_PTR(root),
+             (size_t)filename_entries_root_len) != 0) {
+    reset_filename_entries(root);
   }
 
   struct packed_files_context context = {
-      .root = root,
-      .seen = rb_hash_new(),
-      .packed = rb_str_buf_new(4096),
-      .root_len = RSTRING_LEN(root),
+      .packed = packed,
+      .header_offset = RSTRING_LEN(packed),
       .files_count = 0,
-      .direct_absolute = all_absolute,
       .fast_path_supported = true};
-  rb_str_resize(context.packed, 5);
+  // reserve the largest array header, shrunk once the count is known
+  rb_str_resize(packed, context.header_offset + 5);
+  next_dedup_stamp();
 
-  rb_hash_foreach(primary_files, pack_primary_file_i, (VALUE)&context);
+  if (dd_ci_covered_files_p(primary_files)) {
+    dd_ci_covered_files_foreach_id(primary_files, pack_covered_file_i,
+                                   &context);
+  } else {
+    rb_hash_foreach(primary_files, pack_primary_file_i, (VALUE)&context);
+  }
   if (!context.fast_path_supported) {
-    return Qnil;
+    return false;
   }
 
+  long additional_files_len = RARRAY_LEN(additional_files);
   for (long i = 0; i < additional_files_len; i++) {
     if (!packed_files_append_entry(&context,
                                    rb_ary_entry(additional_files, i), true)) {
-      return Qnil;
+      return false;
     }
   }
 
   packed_files_write_array_header(&context);
-  return context.packed;
+  return true;
+}
+
+static void check_files_types(VALUE primary_files, VALUE additional_files) {
+  if (!dd_ci_covered_files_p(primary_files)) {
+    Check_Type(primary_files, T_HASH);
+  }
+  Check_Type(additional_files, T_ARRAY);
+}
+
+static VALUE file_serialization_pack_files(VALUE module, VALUE primary_files,
+                                           VALUE additional_files,
+                                           VALUE root) {
+  check_files_types(primary_files, additional_files);
+
+  VALUE packed = rb_str_buf_new(4096);
+  if (!pack_files_into(packed, primary_files, additional_files, root)) {
+    return Qnil;
+  }
+  return packed;
+}
+
+// Coverage payloads
+//
+// A batch of Coverage::Event objects is written as complete
+// {"version" => 2, "coverages" => [...]} payloads in a single pass. Events are
+// appended to the current payload until the next one would exceed the maximum
+// payload size, then the payload is closed and the event starts the next one.
+// Events that cannot use the native files fast path are packed by their own
+// #to_msgpack through MessagePack.pack.
+
+#define COVERAGE_PAYLOAD_INITIAL_CAPACITY (64 * 1024)
+
+// {"version" => 2, "coverages" => array32 header}, the events count is
+// patched when the payload is closed
+static const unsigned char coverage_payload_header[] = {
+    0x82, 0xa7, 'v', 'e', 'r', 's', 'i', 'o', 'n', 0x02,
+    0xa9, 'c', 'o', 'v', 'e', 'r', 'a', 'g', 'e', 's',
+    0xdd, 0x00, 0x00, 0x00, 0x00};
+
+static ID id_to_i;
+static ID id_files;
+static ID id_coverage;
+static ID id_custom_impacted_files;
+static ID id_root;
+static ID id_test_id;
+static ID id_test_suite_id;
+static ID id_test_session_id;
+static ID id_pack;
+
+struct coverage_payloads_context {
+  // Array<[String, Integer]> closed payloads with their events count
+  VALUE payloads;
+  VALUE payload;
+  long max_payload_size;
+  // encoded events size in the current payload, without the header
+  long events_size;
+  uint32_t events_count;
+};
+
+static VALUE new_coverage_payload(long capacity) {
+  VALUE payload = rb_str_buf_new(capacity);
+  rb_str_cat(payload, (const char *)coverage_payload_header,
+             sizeof(coverage_payload_header));
+  return payload;
+}
+
+static void close_coverage_payload(struct coverage_payloads_context *context) {
+  unsigned char *count_ptr =
+      (unsigned char *)RSTRING_PTR(context->payload) +
+      sizeof(coverage_payload_header) - 4;
+  count_ptr[0] = (unsigned char)(context->events_count >> 24);
+  count_ptr[1] = (unsigned char)(context->events_count >> 16);
+  count_ptr[2] = (unsigned char)(context->events_count >> 8);
+  count_ptr[3] = (unsigned char)context->events_count;
+
+  rb_ary_push(context->payloads,
+              rb_assoc_new(context->payload, UINT2NUM(context->events_count)));
+}
+
+static void packed_append_uint(VALUE packed, uint64_t value) {
+  unsigned char bytes[9];
+  size_t len;
+  if (value < 128) {
+    bytes[0] = (unsigned char)value;
+    len = 1;
+  } else if (value < 256) {
+    bytes[0] = 0xcc;
+    bytes[1] = (unsigned char)value;
+    len = 2;
+  } else if (value < 65536) {
+    bytes[0] = 0xcd;
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)value;
+    len = 3;
+  } else if (value <= UINT32_MAX) {
+    bytes[0] = 0xce;
+    for (int i = 0; i < 4; i++) {
+      bytes[1 + i] = (unsigned char)(value >> (24 - 8 * i));
+    }
+    len = 5;
+  } else {
+    bytes[0] = 0xcf;
+    for (int i = 0; i < 8; i++) {
+      bytes[1 + i] = (unsigned char)(value >> (56 - 8 * i));
+    }
+    len = 9;
+  }
+  rb_str_cat(packed, (const char *)bytes, len);
+}
+
+// Converts an ID the same way as Event#to_msgpack (#to_i). Returns false for
+// values that are not packed as an unsigned integer.
+static bool coverage_event_id(VALUE value, uint64_t *id) {
+  if (!RB_INTEGER_TYPE_P(value)) {
+    value = rb_funcall(value, id_to_i, 0);
+    if (!RB_INTEGER_TYPE_P(value)) {
+      return false;
+    }
+  }
+  if (FIXNUM_P(value)) {
+    if (FIX2LONG(value) < 0) {
+      return false;
+    }
+    *id = (uint64_t)FIX2LONG(value);
+    return true;
+  }
+  if (RTEST(rb_funcall(value, '<', 1, INT2FIX(0))) ||
+      rb_absint_numwords(value, 64, NULL) > 1) {
+    return false;
+  }
+  *id = NUM2ULL(value);
+  return true;
+}
+
+// Appends the event with the native files fast path. Returns false when the
+// event needs the Ruby encoder; the caller truncates the payload.
+static bool append_coverage_event(struct coverage_payloads_context *context,
+                                  VALUE event) {
+  VALUE test_id = rb_funcall(event, id_test_id, 0);
+  uint64_t span_id = 0;
+  uint64_t test_suite_id;
+  uint64_t test_session_id;
+  if ((test_id != Qnil && !coverage_event_id(test_id, &span_id)) ||
+      !coverage_event_id(rb_funcall(event, id_test_suite_id, 0),
+                         &test_suite_id) ||
+      !coverage_event_id(rb_funcall(event, id_test_session_id, 0),
+                         &test_session_id)) {
+    return false;
+  }
+
+  VALUE files = rb_funcall(event, id_files, 0);
+  VALUE primary_files = rb_funcall(files, id_coverage, 0);
+  VALUE additional_files = rb_funcall(files, id_custom_impacted_files, 0);
+  VALUE root = rb_funcall(files, id_root, 0);
+  if ((!dd_ci_covered_files_p(primary_files) &&
+       !RB_TYPE_P(primary_files, T_HASH)) ||
+      !RB_TYPE_P(additional_files, T_ARRAY)) {
+    return false;
+  }
+
+  VALUE payload = context->payload;
+  static const unsigned char test_session_id_key[] = {
+      0xaf, 't', 'e', 's', 't', '_', 's', 'e', 's',
+      's',  'i', 'o', 'n', '_', 'i', 'd'};
+  static const unsigned char test_suite_id_key[] = {
+      0xad, 't', 'e', 's', 't', '_', 's', 'u', 'i', 't', 'e', '_', 'i', 'd'};
+  static const unsigned char span_id_key[] = {0xa7, 's', 'p', 'a', 'n',
+                                              '_',  'i', 'd'};
+  static const unsigned char files_key[] = {0xa5, 'f', 'i', 'l', 'e', 's'};
+
+  unsigned char map_header = test_id == Qnil ? 0x83 : 0x84;
+  rb_str_cat(payload, (const char *)&map_header, 1);
+  rb_str_cat(payload, (const char *)test_session_id_key,
+             sizeof(test_session_id_key));
+  packed_append_uint(payload, test_session_id);
+  rb_str_cat(payload, (const char *)test_suite_id_key,
+             sizeof(test_suite_id_key));
+  packed_append_uint(payload, test_suite_id);
+  if (test_id != Qnil) {
+    rb_str_cat(payload, (const char *)span_id_key, sizeof(span_id_key));
+    packed_append_uint(payload, span_id);
+  }
+  rb_str_cat(payload, (const char *)files_key, sizeof(files_key));
+
+  return pack_files_into(payload, primary_files, additional_files, root);
+}
+
+static void pack_coverage_event(struct coverage_payloads_context *context,
+                                VALUE event) {
+  VALUE payload = context->payload;
+  long event_offset = RSTRING_LEN(payload);
+
+  if (!append_coverage_event(context, event)) {
+    rb_str_set_len(payload, event_offset);
+    VALUE mMessagePack = rb_const_get(rb_cObject, rb_intern("MessagePack"));
+    VALUE encoded = rb_funcall(mMessagePack, id_pack, 1, event);
+    StringValue(encoded);
+    rb_str_cat(payload, RSTRING_PTR(encoded), RSTRING_LEN(encoded));
+  }
+
+  long event_size = RSTRING_LEN(payload) - event_offset;
+  if (event_size > context->max_payload_size) {
+    // copied: a shared substring would make the payload unresizable
+    VALUE encoded =
+        rb_str_new(RSTRING_PTR(payload) + event_offset, event_size);
+    rb_str_set_len(payload, event_offset);
+    if (rb_block_given_p()) {
+      rb_yield_values(2, event, encoded);
+    }
+    return;
+  }
+
+  if (context->events_count > 0 &&
+      context->events_size + event_size > context->max_payload_size) {
+    // the event starts the next payload
+    VALUE next_payload = new_coverage_payload(COVERAGE_PAYLOAD_INITIAL_CAPACITY);
+    rb_str_cat(next_payload, RSTRING_PTR(payload) + event_offset, event_size);
+    rb_str_set_len(payload, event_offset);
+    close_coverage_payload(context);
+
+    context->payload = next_payload;
+    context->events_size = 0;
+    context->events_count = 0;
+  }
+
+  context->events_size += event_size;
+  context->events_count++;
+}
+
+// FileSerialization.pack_coverage_events(events, max_payload_size) { |event, encoded| }
+// Returns Array<[String, Integer]>: the payloads and their events count.
+// Events larger than max_payload_size are yielded with their encoding and
+// are not included in any payload.
+static VALUE file_serialization_pack_coverage_events(VALUE module,
+                                                     VALUE events,
+                                                     VALUE max_payload_size) {
+  Check_Type(events, T_ARRAY);
+  long max_size = NUM2LONG(rb_funcall(max_payload_size, id_to_i, 0));
+
+  struct coverage_payloads_context context = {
+      .payloads = rb_ary_new(),
+      .payload = new_coverage_payload(COVERAGE_PAYLOAD_INITIAL_CAPACITY),
+      .max_payload_size = max_size,
+      .events_size = 0,
+      .events_count = 0};
+
+  for (long i = 0; i < RARRAY_LEN(events); i++) {
+    pack_coverage_event(&context, RARRAY_AREF(events, i));
+  }
+  if (context.events_count > 0) {
+    close_coverage_payload(&context);
+  }
+
+  RB_GC_GUARD(context.payload);
+  return context.payloads;
 }
 
 void Init_file_serialization(void) {
+  dedup_ids = rb_hash_new();
+  rb_gc_register_address(&dedup_ids);
+  path_entry_ids = rb_hash_new();
+  rb_gc_register_address(&path_entry_ids);
+
   VALUE mDatadog = rb_define_module("Datadog");
   VALUE mCI = rb_define_module_under(mDatadog, "CI");
   VALUE mFileSerialization =
@@ -276,4 +704,16 @@ void Init_file_serialization(void) {
 
   rb_define_singleton_method(mFileSerialization, "pack_files",
                              file_serialization_pack_files, 3);
+  rb_define_singleton_method(mFileSerialization, "pack_coverage_events",
+                             file_serialization_pack_coverage_events, 2);
+
+  id_to_i = rb_intern("to_i");
+  id_files = rb_intern("files");
+  id_coverage = rb_intern("coverage");
+  id_custom_impacted_files = rb_intern("custom_impacted_files");
+  id_root = rb_intern("root");
+  id_test_id = rb_intern("test_id");
+  id_test_suite_id = rb_intern("test_suite_id");
+  id_test_session_id = rb_intern("test_session_id");
+  id_pack = rb_intern("pack");
 }
@@ -1,6 +1,10 @@
 #include <ruby.h>
+#include <ruby/debug.h>
+#include <string.h>
 
+#include "datadog_common.h"
 #include "imemo_helpers.h"
+#include "iseq_collector.h"
 #include "ruby_internal.h"
 
 /*
@@ -44,7 +48,7 @@ static int collect_iseqs_callback(void *vstart, void *vend, size_t stride,
  * https://github.com/ruby/debug/blob/master/ext/debug/iseq_collector.c
 */
 
-static VALUE iseq_collector_collect(VALUE self) {
+VALUE dd_ci_collect_iseqs(void) {
   VALUE iseqs_array = rb_ary_new();
 
   rb_objspace_each_objects(collect_iseqs_callback, (void *)iseqs_array);
@@ -52,9 +56,189 @@ static VALUE iseq_collector_collect(VALUE self) {
   return iseqs_array;
 }
 
+struct collect_filtered_iseqs_args {
+  const struct dd_ci_iseq_filter *filter;
+  VALUE iseqs_array;
+};
+
+static bool iseq_path_included(const struct dd_ci_iseq_filter *filter,
+                               VALUE path) {
+  return RB_TYPE_P(path, T_STRING) &&
+         dd_ci_is_path_included(RSTRING_PTR(path), RSTRING_LEN(path),
+                                filter->root_path, filter->root_path_len,
+                                filter->ignored_path, filter->ignored_path_len);
+}
+
+static int collect_filtered_iseqs_callback(void *vstart, void *vend,
+                                           size_t stride, void *data) {
+  struct collect_filtered_iseqs_args *args = data;
+
+  for (VALUE v = (VALUE)vstart; v != (VALUE)vend; v += stride) {
+    if (dd_ci_imemo_iseq_p(v) &&
+        iseq_path_included(args->filter,
+                           args->filter->iseq_path((const rb_iseq_t *)v))) {
+      rb_ary_push(args->iseqs_array, rb_iseqw_new((void *)v));
+    }
+  }
+  return 0;
+}
+
+VALUE dd_ci_collect_iseqs_filtered(const struct dd_ci_iseq_filter *filter) {
+  struct collect_filtered_iseqs_args args = {.filter = filter,
+                                             .iseqs_array = rb_ary_new()};
+
+  rb_objspace_each_objects(collect_filtered_iseqs_callback, &args);
+
+  return args.iseqs_array;
+}
+
+/* ---- Load-time capture -------------------------------------------------- */
+
+// While the capture is active, ISeqs of the scripts compiled under the
+// capture root are recorded as they are loaded. Recorded top-level ISeqs are
+// kept alive, so they can be inspected after the script has finished running,
+// and collecting them does not need a walk over the whole object space.
+static struct dd_ci_iseq_filter capture_filter = {
+    .root_path = NULL,
+    .root_path_len = 0,
+    .ignored_path = NULL,
+    .ignored_path_len = 0,
+    .iseq_path = rb_iseq_absolute_path};
+static VALUE capture_tracepoint = Qnil;
+static VALUE captured_iseqs = Qnil;
+
+static void on_capture_script_compiled(VALUE tracepoint, void *data) {
+  VALUE iseq = rb_funcall(tracepoint, rb_intern("instruction_sequence"), 0);
+  if (NIL_P(iseq)) {
+    return;
+  }
+
+  if (iseq_path_included(&capture_filter,
+                         rb_iseq_absolute_path(rb_iseqw_to_iseq(iseq)))) {
+    rb_ary_push(captured_iseqs, iseq);
+  }
+}
+
+static void stop_capture(void) {
+  if (NIL_P(capture_tracepoint)) {
+    return;
+  }
+
+  rb_tracepoint_disable(capture_tracepoint);
+  capture_tracepoint = Qnil;
+  captured_iseqs = Qnil;
+
+  xfree((void *)capture_filter.root_path);
+  capture_filter.root_path = NULL;
+  capture_filter.root_path_len = 0;
+  if (capture_filter.ignored_path != NULL) {
+    xfree((void *)capture_filter.ignored_path);
+  }
+  capture_filter.ignored_path = NULL;
+  capture_filter.ignored_path_len = 0;
+}
+
+static bool same_path(const char *path, long path_len, const char *other_path,
+                      long other_path_len) {
+  return path_len == other_path_len &&
+         (path_len == 0 || memcmp(path, other_path, path_len) == 0);
+}
+
+VALUE dd_ci_iseqs_under(const char *root_path, long root_path_len,
+                        const char *ignored_path, long ignored_path_len) {
+  if (!NIL_P(capture_tracepoint) &&
+      same_path(capture_filter.root_path, capture_filter.root_path_len,
+                root_path, root_path_len) &&
+      same_path(capture_filter.ignored_path, capture_filter.ignored_path_len,
+                ignored_path, ignored_path_len)) {
+    return rb_ary_dup(captured_iseqs);
+  }
+
+  struct dd_ci_iseq_filter filter = {.root_path = root_path,
+                                     .root_path_len = root_path_len,
+                                     .ignored_path = ignored_path,
+                                     .ignored_path_len = ignored_path_len,
+                                     .iseq_path = rb_iseq_absolute_path};
+  return dd_ci_collect_iseqs_filtered(&filter);
+}
+
+/* ---- Ruby methods ------------------------------------------------------- */
+
+static VALUE iseq_collector_collect(VALUE self) {
+  return dd_ci_collect_iseqs();
+}
+
+/*
+ * ISeqCollector.collect_iseqs_under(root_path, ignored_path)
+ *
+ * @return [Array<RubyVM::InstructionSequence>] live ISeqs under root_path and
+ *   outside ignored_path, or the ISeqs recorded by an active capture for the
+ *   same paths
+ */
+static VALUE iseq_collector_collect_under(VALUE self, VALUE root_path,
+                                          VALUE ignored_path) {
+  Check_Type(root_path, T_STRING);
+  if (!NIL_P(ignored_path)) {
+    Check_Type(ignored_path, T_STRING);
+  }
+
+  VALUE iseqs = dd_ci_iseqs_under(
+      RSTRING_PTR(root_path), RSTRING_LEN(root_path),
+      NIL_P(ignored_path) ? NULL : RSTRING_PTR(ignored_path),
+      NIL_P(ignored_path) ? 0 : RSTRING_LEN(ignored_path));
+
+  RB_GC_GUARD(root_path);
+  RB_GC_GUARD(ignored_path);
+  return iseqs;
+}
+
+/*
+ * ISeqCollector.start_iseq_capture(root_path, ignored_path)
+ *
+ * Record the ISeqs under root_path (and outside ignored_path) that are live
+ * now or compiled from now on, until stop_iseq_capture is called.
+ */
+static VALUE iseq_collector_start_capture(VALUE self, VALUE root_path,
+                                          VALUE ignored_path) {
+  Check_Type(root_path, T_STRING);
+  if (!NIL_P(ignored_path)) {
+    Check_Type(ignored_path, T_STRING);
+  }
+
+  stop_capture();
+
+  capture_filter.root_path_len = RSTRING_LEN(root_path);
+  capture_filter.root_path = dd_ci_ruby_strndup(RSTRING_PTR(root_path),
+                                                capture_filter.root_path_len);
+  if (!NIL_P(ignored_path)) {
+    capture_filter.ignored_path_len = RSTRING_LEN(ignored_path);
+    capture_filter.ignored_path = dd_ci_ruby_strndup(
+        RSTRING_PTR(ignored_path), capture_filter.ignored_path_len);
+  }
+
+  captured_iseqs = dd_ci_collect_iseqs_filtered(&capture_filter);
+  capture_tracepoint = rb_tracepoint_new(
+      0, RUBY_EVENT_SCRIPT_COMPILED, on_capture_script_compiled, NULL);
+  rb_tracepoint_enable(capture_tracepoint);
+
+  return Qnil;
+}
+
+static VALUE iseq_collector_stop_capture(VALUE self) {
+  stop_capture();
+  return Qnil;
+}
+
+static VALUE iseq_collector_capture_active_p(VALUE self) {
+  return NIL_P(capture_tracepoint) ? Qfalse : Qtrue;
+}
+
 /* ---- Module initialization ---------------------------------------------- */
 
 void Init_dd_ci_iseq_collector(void) {
+  rb_gc_register_address(&capture_tracepoint);
+  rb_gc_register_address(&captured_iseqs);
+
   VALUE mDatadog = rb_define_module("Datadog");
   VALUE mCI = rb_define_module_under(mDatadog, "CI");
   VALUE mSourceCode = rb_define_module_under(mCI, "SourceCode");
@@ -62,4 +246,12 @@ void Init_dd_ci_iseq_collector(void) {
 
   rb_define_singleton_method(mISeqCollector, "collect_iseqs",
                              iseq_collector_collect, 0);
+  rb_define_singleton_method(mISeqCollector, "collect_iseqs_under",
+                             iseq_collector_collect_under, 2);
+  rb_define_singleton_method(mISeqCollector, "start_iseq_capture",
+                             iseq_collector_start_capture, 2);
+  rb_define_singleton_method(mISeqCollector, "stop_iseq_capture",
+                             iseq_collector_stop_capture, 0);
+  rb_define_singleton_method(mISeqCollector, "iseq_capture_active?",
+                             iseq_collector_capture_active_p, 0);
 }
@@ -1,6 +1,43 @@
 #ifndef ISEQ_COLLECTOR_H
 #define ISEQ_COLLECTOR_H
 
+#include <ruby.h>
+#include <stdbool.h>
+
+#include "ruby_internal.h"
+
+/**
+ * Which ISeqs to collect: ISeqs whose path (as returned by iseq_path) is
+ * under root_path and not under ignored_path.
+ */
+struct dd_ci_iseq_filter {
+  const char *root_path;
+  long root_path_len;
+  const char *ignored_path;
+  long ignored_path_len;
+  VALUE (*iseq_path)(const rb_iseq_t *iseq);
+};
+
+/**
+ * Walk the Ruby object space and return all live ISeqs wrapped as
+ * RubyVM::InstructionSequence objects.
+ */
+VALUE dd_ci_collect_iseqs(void);
+
+/**
+ * Walk the Ruby object space and return the live ISeqs matching the filter.
+ * ISeqs that don't match are never wrapped.
+ */
+VALUE dd_ci_collect_iseqs_filtered(const struct dd_ci_iseq_filter *filter);
+
+/**
+ * Return the ISeqs under root_path and outside ignored_path (filtered by
+ * absolute path). If an ISeq capture was started for the same paths, the
+ * captured ISeqs are returned without walking the object space.
+ */
+VALUE dd_ci_iseqs_under(const char *root_path, long root_path_len,
+                        const char *ignored_path, long ignored_path_len);
+
 void Init_dd_ci_iseq_collector(void);
 
 #endif /* ISEQ_COLLECTOR_H */
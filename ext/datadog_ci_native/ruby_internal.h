@@ -31,6 +31,18 @@ void rb_iseq_code_location(const rb_iseq_t *iseq, int *first_lineno,
  */
 VALUE rb_iseqw_new(const void *iseq);
 
+/**
+ * Get the path (or the absolute path, nil for eval'd code) of an ISeq.
+ */
+VALUE rb_iseq_path(const rb_iseq_t *iseq);
+VALUE rb_iseq_absolute_path(const rb_iseq_t *iseq);
+
+/**
+ * Disassemble an ISeq and its children into a String, one instruction per
+ * line (same output as RubyVM::InstructionSequence#disasm).
+ */
+VALUE rb_iseq_disasm(const rb_iseq_t *iseq);
+
 /* ---- Object space functions --------------------------------------------- */
 
 /**
@@ -0,0 +1,438 @@
+#include <ruby.h>
+#include <ruby/encoding.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "span_serialization.h"
+
+// Native MessagePack encoder for citestcycle events (see
+// TestTracing::Serializers::Base#to_msgpack). Events are appended straight to
+// the payload buffer. The span meta is read from the span itself: transient
+// tags are skipped and long strings are truncated while they are written, so
+// no filtered or truncated copy of the meta Hash is allocated per span.
+//
+// The bytes are the same as the msgpack gem writes for the same values. A
+// value that is not supported here (other string encodings, integers beyond
+// 64 bits, arbitrary objects) makes the whole event fall back to the Ruby
+// encoder.
+
+static ID id_span;
+static ID id_meta;
+static ID id_event_type;
+static ID id_version;
+static ID id_content_map_size;
+static ID id_content_fields;
+
+static VALUE str_meta;
+
+struct span_packer {
+  VALUE buffer;
+  // meta keys that are not serialized
+  VALUE excluded_keys;
+  long max_meta_string_length;
+  bool supported;
+};
+
+static void pack_bytes(struct span_packer *packer, const void *bytes,
+                       long len) {
+  rb_str_cat(packer->buffer, (const char *)bytes, len);
+}
+
+static void pack_header(struct span_packer *packer, uint32_t size,
+                        unsigned char fix_prefix, uint32_t fix_limit,
+                        unsigned char prefix16) {
+  unsigned char bytes[5];
+  if (size < fix_limit) {
+    bytes[0] = (unsigned char)(fix_prefix | size);
+    pack_bytes(packer, bytes, 1);
+  } else if (size < 65536) {
+    bytes[0] = prefix16;
+    bytes[1] = (unsigned char)(size >> 8);
+    bytes[2] = (unsigned char)size;
+    pack_bytes(packer, bytes, 3);
+  } else {
+    // the 32-bit format always follows the 16-bit one
+    bytes[0] = (unsigned char)(prefix16 + 1);
+    bytes[1] = (unsigned char)(size >> 24);
+    bytes[2] = (unsigned char)(size >> 16);
+    bytes[3] = (unsigned char)(size >> 8);
+    bytes[4] = (unsigned char)size;
+    pack_bytes(packer, bytes, 5);
+  }
+}
+
+static void pack_map_header(struct span_packer *packer, uint32_t size) {
+  pack_header(packer, size, 0x80, 16, 0xde);
+}
+
+static void pack_array_header(struct span_packer *packer, uint32_t size) {
+  pack_header(packer, size, 0x90, 16, 0xdc);
+}
+
+static void pack_uint(struct span_packer *packer, uint64_t value) {
+  unsigned char bytes[9];
+  long len;
+  if (value < 128) {
+    bytes[0] = (unsigned char)value;
+    len = 1;
+  } else if (value < 256) {
+    bytes[0] = 0xcc;
+    bytes[1] = (unsigned char)value;
+    len = 2;
+  } else if (value < 65536) {
+    bytes[0] = 0xcd;
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)value;
+    len = 3;
+  } else if (value <= UINT32_MAX) {
+    bytes[0] = 0xce;
+    for (int i = 0; i < 4; i++) {
+      bytes[1 + i] = (unsigned char)(value >> (24 - 8 * i));
+    }
+    len = 5;
+  } else {
+    bytes[0] = 0xcf;
+    for (int i = 0; i < 8; i++) {
+      bytes[1 + i] = (unsigned char)(value >> (56 - 8 * i));
+    }
+    len = 9;
+  }
+  pack_bytes(packer, bytes, len);
+}
+
+static void pack_negative_int(struct span_packer *packer, int64_t value) {
+  unsigned char bytes[9];
+  long len;
+  if (value >= -32) {
+    bytes[0] = (unsigned char)(int8_t)value;
+    len = 1;
+  } else if (value >= INT8_MIN) {
+    bytes[0] = 0xd0;
+    bytes[1] = (unsigned char)(int8_t)value;
+    len = 2;
+  } else if (value >= INT16_MIN) {
+    bytes[0] = 0xd1;
+    bytes[1] = (unsigned char)((uint16_t)value >> 8);
+    bytes[2] = (unsigned char)(uint16_t)value;
+    len = 3;
+  } else if (value >= INT32_MIN) {
+    uint32_t bits = (uint32_t)value;
+    bytes[0] = 0xd2;
+    for (int i = 0; i < 4; i++) {
+      bytes[1 + i] = (unsigned char)(bits >> (24 - 8 * i));
+    }
+    len = 5;
+  } else {
+    uint64_t bits = (uint64_t)value;
+    bytes[0] = 0xd3;
+    for (int i = 0; i < 8; i++) {
+      bytes[1 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    }
+    len = 9;
+  }
+  pack_bytes(packer, bytes, len);
+}
+
+static void pack_integer(struct span_packer *packer, VALUE value) {
+  if (FIXNUM_P(value)) {
+    long number = FIX2LONG(value);
+    if (number >= 0) {
+      pack_uint(packer, (uint64_t)number);
+    } else {
+      pack_negative_int(packer, (int64_t)number);
+    }
+    return;
+  }
+
+  // the msgpack gem packs bignums up to 64 bits, negative bignums are rare
+  // enough to be left to it
+  if (RBIGNUM_NEGATIVE_P(value) || rb_absint_numwords(value, 64, NULL) > 1) {
+    packer->supported = false;
+    return;
+  }
+  pack_uint(packer, NUM2ULL(value));
+}
+
+static void pack_float(struct span_packer *packer, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  unsigned char bytes[9];
+  bytes[0] = 0xcb;
+  for (int i = 0; i < 8; i++) {
+    bytes[1 + i] = (unsigned char)(bits >> (56 - 8 * i));
+  }
+  pack_bytes(packer, bytes, 9);
+}
+
+// Packs the first max_length characters of the string, the whole string when
+// max_length is negative.
+static void pack_string(struct span_packer *packer, VALUE string,
+                        long max_length) {
+  int encoding_index = rb_enc_get_index(string);
+  bool binary = encoding_index == rb_ascii8bit_encindex();
+  if (!binary && encoding_index != rb_utf8_encindex() &&
+      encoding_index != rb_usascii_encindex()) {
+    packer->supported = false;
+    return;
+  }
+
+  const char *ptr = RSTRING_PTR(string);
+  long len = RSTRING_LEN(string);
+  // a string can't have more characters than bytes
+  if (max_length >= 0 && len > max_length) {
+    const char *end = ptr + len;
+    const char *nth = rb_enc_nth(ptr, end, max_length, rb_enc_get(string));
+    if (nth < end) {
+      len = nth - ptr;
+    }
+  }
+
+  if (len > (long)UINT32_MAX) {
+    packer->supported = false;
+    return;
+  }
+
+  if (binary) {
+    unsigned char bytes[5];
+    long header_len;
+    if (len < 256) {
+      bytes[0] = 0xc4;
+      bytes[1] = (unsigned char)len;
+      header_len = 2;
+    } else if (len < 65536) {
+      bytes[0] = 0xc5;
+      bytes[1] = (unsigned char)(len >> 8);
+      bytes[2] = (unsigned char)len;
+      header_len = 3;
+    } else {
+      bytes[0] = 0xc6;
+      bytes[1] = (unsigned char)(len >> 24);
+      bytes[2] = (unsigned char)(len >> 16);
+      bytes[3] = (unsigned char)(len >> 8);
+      bytes[4] = (unsigned char)len;
+      header_len = 5;
+    }
+    pack_bytes(packer, bytes, header_len);
+  } else if (len < 32) {
+    unsigned char header = (unsigned char)(0xa0U | (uint32_t)len);
+    pack_bytes(packer, &header, 1);
+  } else if (len < 256) {
+    unsigned char bytes[2] = {0xd9, (unsigned char)len};
+    pack_bytes(packer, bytes, 2);
+  } else {
+    pack_header(packer, (uint32_t)len, 0, 0, 0xda);
+  }
+  pack_bytes(packer, ptr, len);
+
+  RB_GC_GUARD(string);
+}
+
+static void pack_value(struct span_packer *packer, VALUE value);
+
+static int pack_hash_pair_i(VALUE key, VALUE value, VALUE packer_ptr) {
+  struct span_packer *packer = (struct span_packer *)packer_ptr;
+  pack_value(packer, key);
+  pack_value(packer, value);
+  return packer->supported ? ST_CONTINUE : ST_STOP;
+}
+
+static void pack_value(struct span_packer *packer, VALUE value) {
+  if (!packer->supported) {
+    return;
+  }
+
+  switch (rb_type(value)) {
+  case T_NIL: {
+    unsigned char byte = 0xc0;
+    pack_bytes(packer, &byte, 1);
+    break;
+  }
+  case T_FALSE: {
+    unsigned char byte = 0xc2;
+    pack_bytes(packer, &byte, 1);
+    break;
+  }
+  case T_TRUE: {
+    unsigned char byte = 0xc3;
+    pack_bytes(packer, &byte, 1);
+    break;
+  }
+  case T_FIXNUM:
+  case T_BIGNUM:
+    pack_integer(packer, value);
+    break;
+  case T_FLOAT:
+    pack_float(packer, RFLOAT_VALUE(value));
+    break;
+  case T_STRING:
+    if (rb_obj_class(value) != rb_cString) {
+      packer->supported = false;
+      break;
+    }
+    pack_string(packer, value, -1);
+    break;
+  case T_SYMBOL:
+    pack_string(packer, rb_sym2str(value), -1);
+    break;
+  case T_HASH:
+    if (rb_obj_class(value) != rb_cHash) {
+      packer->supported = false;
+      break;
+    }
+    pack_map_header(packer, (uint32_t)RHASH_SIZE(value));
+    rb_hash_foreach(value, pack_hash_pair_i, (VALUE)packer);
+    break;
+  case T_ARRAY:
+    if (rb_obj_class(value) != rb_cArray) {
+      packer->supported = false;
+      break;
+    }
+    pack_array_header(packer, (uint32_t)RARRAY_LEN(value));
+    for (long i = 0; i < RARRAY_LEN(value) && packer->supported; i++) {
+      pack_value(packer, RARRAY_AREF(value, i));
+    }
+    break;
+  default:
+    // objects with their own #to_msgpack
+    packer->supported = false;
+    break;
+  }
+}
+
+static int pack_meta_pair_i(VALUE key, VALUE value, VALUE packer_ptr) {
+  struct span_packer *packer = (struct span_packer *)packer_ptr;
+  if (RTEST(rb_ary_includes(packer->excluded_keys, key))) {
+    return ST_CONTINUE;
+  }
+
+  pack_value(packer, key);
+  if (packer->supported && RB_TYPE_P(value, T_STRING) &&
+      rb_obj_class(value) == rb_cString) {
+    pack_string(packer, value, packer->max_meta_string_length);
+  } else {
+    pack_value(packer, value);
+  }
+  return packer->supported ? ST_CONTINUE : ST_STOP;
+}
+
+// Same as MetaTruncation.truncate_string_values(meta.reject { excluded })
+static void pack_meta(struct span_packer *packer, VALUE meta) {
+  if (!RB_TYPE_P(meta, T_HASH) || rb_obj_class(meta) != rb_cHash) {
+    packer->supported = false;
+    return;
+  }
+
+  long size = (long)RHASH_SIZE(meta);
+  for (long i = 0; i < RARRAY_LEN(packer->excluded_keys); i++) {
+    if (rb_hash_lookup2(meta, RARRAY_AREF(packer->excluded_keys, i),
+                        Qundef) != Qundef) {
+      size--;
+    }
+  }
+
+  pack_map_header(packer, (uint32_t)size);
+  rb_hash_foreach(meta, pack_meta_pair_i, (VALUE)packer);
+}
+
+static void pack_field(struct span_packer *packer, VALUE serializer,
+                       VALUE field_name, VALUE method) {
+  pack_value(packer, field_name);
+  if (!packer->supported) {
+    return;
+  }
+
+  if (rb_str_equal(method, str_meta) == Qtrue) {
+    VALUE span = rb_funcall(serializer, id_span, 0);
+    pack_meta(packer, rb_funcall(span, id_meta, 0));
+    return;
+  }
+
+  pack_value(packer, rb_funcall(serializer, rb_to_id(method), 0));
+}
+
+static int pack_field_pair_i(VALUE field_name, VALUE method,
+                             VALUE context_ptr) {
+  VALUE *context = (VALUE *)context_ptr;
+  struct span_packer *packer = (struct span_packer *)context[0];
+  pack_field(packer, context[1], field_name, method);
+  return packer->supported ? ST_CONTINUE : ST_STOP;
+}
+
+static VALUE pack_event(struct span_packer *packer, VALUE serializer) {
+  static const unsigned char type_key[] = {0xa4, 't', 'y', 'p', 'e'};
+  static const unsigned char version_key[] = {0xa7, 'v', 'e', 'r', 's',
+                                              'i',  'o', 'n'};
+  static const unsigned char content_key[] = {0xa7, 'c', 'o', 'n', 't',
+                                              'e',  'n', 't'};
+
+  pack_map_header(packer, 3);
+  pack_bytes(packer, type_key, sizeof(type_key));
+  pack_value(packer, rb_funcall(serializer, id_event_type, 0));
+  pack_bytes(packer, version_key, sizeof(version_key));
+  pack_value(packer, rb_funcall(serializer, id_version, 0));
+  pack_bytes(packer, content_key, sizeof(content_key));
+
+  VALUE content_map_size = rb_funcall(serializer, id_content_map_size, 0);
+  pack_map_header(packer, NUM2UINT(content_map_size));
+
+  VALUE fields = rb_funcall(serializer, id_content_fields, 0);
+  Check_Type(fields, T_ARRAY);
+  for (long i = 0; i < RARRAY_LEN(fields) && packer->supported; i++) {
+    VALUE field = RARRAY_AREF(fields, i);
+    if (RB_TYPE_P(field, T_HASH)) {
+      VALUE context[2] = {(VALUE)packer, serializer};
+      rb_hash_foreach(field, pack_field_pair_i, (VALUE)context);
+    } else {
+      pack_field(packer, serializer, field, field);
+    }
+  }
+
+  return packer->supported ? Qtrue : Qfalse;
+}
+
+// SpanSerialization.pack_event(buffer, serializer, excluded_meta_keys, max_meta_string_length)
+// Appends the event of the serializer to buffer. Returns false, with buffer
+// unchanged, when the event must be encoded with the Ruby encoder.
+static VALUE span_serialization_pack_event(VALUE module, VALUE buffer,
+                                           VALUE serializer,
+                                           VALUE excluded_meta_keys,
+                                           VALUE max_meta_string_length) {
+  Check_Type(buffer, T_STRING);
+  Check_Type(excluded_meta_keys, T_ARRAY);
+  rb_str_modify(buffer);
+
+  struct span_packer packer = {
+      .buffer = buffer,
+      .excluded_keys = excluded_meta_keys,
+      .max_meta_string_length = NUM2LONG(max_meta_string_length),
+      .supported = true};
+
+  long offset = RSTRING_LEN(buffer);
+  VALUE result = pack_event(&packer, serializer);
+  if (result == Qfalse) {
+    rb_str_set_len(buffer, offset);
+  }
+  return result;
+}
+
+void Init_span_serialization(void) {
+  VALUE mDatadog = rb_define_module("Datadog");
+  VALUE mCI = rb_define_module_under(mDatadog, "CI");
+  VALUE mSpanSerialization = rb_define_module_under(mCI, "SpanSerialization");
+
+  rb_define_singleton_method(mSpanSerialization, "pack_event",
+                             span_serialization_pack_event, 4);
+
+  id_span = rb_intern("span");
+  id_meta = rb_intern("meta");
+  id_event_type = rb_intern("event_type");
+  id_version = rb_intern("version");
+  id_content_map_size = rb_intern("content_map_size");
+  id_content_fields = rb_intern("content_fields");
+
+  str_meta = rb_obj_freeze(rb_str_new_cstr("meta"));
+  rb_gc_register_mark_object(str_meta);
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void Init_span_serialization(void);
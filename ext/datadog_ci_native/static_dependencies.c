@@ -0,0 +1,349 @@
+#include <ruby.h>
+#include <string.h>
+
+#include "datadog_common.h"
+#include "iseq_collector.h"
+#include "ruby_internal.h"
+#include "static_dependencies.h"
+
+// Static dependencies are extracted from the constant references in the
+// instructions of every live ISeq. The instructions are read from the ISeq
+// disassembly: the VM internals needed to walk the instruction stream directly
+// are not exported by libruby, and the disassembly is a single String per root
+// ISeq instead of the nested Array tree that ISeq#to_a builds for every
+// instruction.
+//
+// The instruction lines we are looking for look like this:
+//
+//   0000 opt_getconstant_path                   <ic:0 Foo::Bar::Baz>
+//   0015 getconstant                            :Baz
+//
+// Children of ISeqs that have catch tables (rescue/ensure) are indented with
+// "| " for every level of nesting.
+
+#define OPT_GETCONSTANT_PATH "opt_getconstant_path"
+#define OPT_GETCONSTANT_PATH_LEN (sizeof(OPT_GETCONSTANT_PATH) - 1)
+#define GETCONSTANT "getconstant"
+#define GETCONSTANT_LEN (sizeof(GETCONSTANT) - 1)
+#define INLINE_CACHE_PREFIX "<ic:"
+#define INLINE_CACHE_PREFIX_LEN (sizeof(INLINE_CACHE_PREFIX) - 1)
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static const char *skip_spaces(const char *ptr, const char *end) {
+  while (ptr < end && *ptr == ' ') {
+    ptr++;
+  }
+  return ptr;
+}
+
+static bool starts_with_token(const char *ptr, const char *end,
+                              const char *token, size_t token_len) {
+  return (size_t)(end - ptr) > token_len &&
+         memcmp(ptr, token, token_len) == 0 && ptr[token_len] == ' ';
+}
+
+// The disassembly is not tagged with the source encoding, constant names are
+// looked up as UTF-8 like Symbol#to_s would return them.
+static void add_constant_name(VALUE names, const char *start,
+                              const char *end) {
+  if (end <= start) {
+    return;
+  }
+  rb_hash_aset(names, rb_utf8_str_new(start, (long)(end - start)), Qtrue);
+}
+
+// <ic:0 Foo::Bar::Baz> -> "Foo::Bar::Baz"
+static void scan_opt_getconstant_path(VALUE names, const char *ptr,
+                                      const char *end) {
+  ptr = skip_spaces(ptr, end);
+  if ((size_t)(end - ptr) <= INLINE_CACHE_PREFIX_LEN ||
+      memcmp(ptr, INLINE_CACHE_PREFIX, INLINE_CACHE_PREFIX_LEN) != 0) {
+    return;
+  }
+  ptr += INLINE_CACHE_PREFIX_LEN;
+  while (ptr < end && is_digit(*ptr)) {
+    ptr++;
+  }
+  if (ptr >= end || *ptr != ' ') {
+    return;
+  }
+  ptr++;
+
+  const char *name_end = memchr(ptr, '>', (size_t)(end - ptr));
+  if (name_end == NULL) {
+    return;
+  }
+  add_constant_name(names, ptr, name_end);
+}
+
+// :Baz -> "Baz"
+static void scan_getconstant(VALUE names, const char *ptr,
+                             const char *end) {
+  ptr = skip_spaces(ptr, end);
+  // quoted symbols (:"...") are never valid constant names
+  if (end - ptr < 2 || ptr[0] != ':' || ptr[1] == '"') {
+    return;
+  }
+  ptr++;
+
+  const char *name_end = ptr;
+  while (name_end < end && *name_end != ' ' && *name_end != ',') {
+    name_end++;
+  }
+  add_constant_name(names, ptr, name_end);
+}
+
+static void scan_disasm_line(VALUE names, const char *ptr,
+                             const char *end) {
+  while (end - ptr >= 2 && ptr[0] == '|' && ptr[1] == ' ') {
+    ptr += 2;
+  }
+
+  // instruction lines start with the position of the instruction
+  const char *position = ptr;
+  while (ptr < end && is_digit(*ptr)) {
+    ptr++;
+  }
+  if (ptr == position || ptr >= end || *ptr != ' ') {
+    return;
+  }
+  ptr++;
+
+  if (starts_with_token(ptr, end, OPT_GETCONSTANT_PATH,
+                        OPT_GETCONSTANT_PATH_LEN)) {
+    scan_opt_getconstant_path(names, ptr + OPT_GETCONSTANT_PATH_LEN, end);
+  } else if (starts_with_token(ptr, end, GETCONSTANT, GETCONSTANT_LEN)) {
+    scan_getconstant(names, ptr + GETCONSTANT_LEN, end);
+  }
+}
+
+static VALUE iseq_disasm(VALUE iseq) {
+  return rb_iseq_disasm(rb_iseqw_to_iseq(iseq));
+}
+
+bool dd_ci_scan_iseq_constants(VALUE iseq, VALUE names) {
+  // disassembling fails for some ISeqs (for example on Ruby 3.3 with constant
+  // names that are not ASCII)
+  VALUE disasm = dd_ci_rescue_nil(iseq_disasm, iseq);
+  if (!RB_TYPE_P(disasm, T_STRING)) {
+    return false;
+  }
+
+  const char *ptr = RSTRING_PTR(disasm);
+  const char *end = ptr + RSTRING_LEN(disasm);
+  while (ptr < end) {
+    const char *line_end = memchr(ptr, '\n', (size_t)(end - ptr));
+    if (line_end == NULL) {
+      line_end = end;
+    }
+    scan_disasm_line(names, ptr, line_end);
+    ptr = line_end + 1;
+  }
+
+  RB_GC_GUARD(disasm);
+  return true;
+}
+
+/* ---- Dependencies map --------------------------------------------------- */
+
+struct static_dependencies_scan {
+  const char *root_path;
+  long root_path_len;
+  const char *ignored_path;
+  long ignored_path_len;
+
+  // { String => Hash{String => true} } source file to its dependencies
+  VALUE dependencies_map;
+  // { String => String | false } constant name to the file it resolves to
+  VALUE resolved_constants;
+};
+
+static bool is_path_included(struct static_dependencies_scan *scan,
+                             VALUE path) {
+  return RB_TYPE_P(path, T_STRING) &&
+         dd_ci_is_path_included(RSTRING_PTR(path), RSTRING_LEN(path),
+                                scan->root_path, scan->root_path_len,
+                                scan->ignored_path, scan->ignored_path_len);
+}
+
+static VALUE hash_fetch_or_create(VALUE hash, VALUE key) {
+  VALUE value = rb_hash_lookup2(hash, key, Qundef);
+  if (value == Qundef) {
+    value = rb_hash_new();
+    rb_hash_aset(hash, key, value);
+  }
+  return value;
+}
+
+// Constant names are fully qualified, so they resolve to the same file no
+// matter which file references them.
+static VALUE resolve_constant(struct static_dependencies_scan *scan,
+                              VALUE constant_name) {
+  VALUE file = rb_hash_lookup2(scan->resolved_constants, constant_name, Qundef);
+  if (file != Qundef) {
+    return file;
+  }
+
+  file = dd_ci_resolve_const_to_file(constant_name);
+  if (!is_path_included(scan, file)) {
+    file = Qfalse;
+  }
+  rb_hash_aset(scan->resolved_constants, constant_name, file);
+  return file;
+}
+
+static int resolve_constant_i(VALUE constant_name, VALUE _value, VALUE data) {
+  VALUE *args = (VALUE *)data;
+  struct static_dependencies_scan *scan =
+      (struct static_dependencies_scan *)args[0];
+
+  VALUE file = resolve_constant(scan, constant_name);
+  if (file != Qfalse) {
+    rb_hash_aset(args[1], file, Qtrue);
+  }
+  return ST_CONTINUE;
+}
+
+static int resolve_file_constants_i(VALUE path, VALUE constant_names,
+                                    VALUE data) {
+  struct static_dependencies_scan *scan =
+      (struct static_dependencies_scan *)data;
+
+  VALUE args[2] = {(VALUE)scan,
+                   hash_fetch_or_create(scan->dependencies_map, path)};
+  rb_hash_foreach(constant_names, resolve_constant_i, (VALUE)args);
+  return ST_CONTINUE;
+}
+
+static VALUE mark_iseq_child_i(RB_BLOCK_CALL_FUNC_ARGLIST(child, children)) {
+  st_insert((st_table *)children, (st_data_t)rb_iseqw_to_iseq(child), 1);
+  return Qnil;
+}
+
+// Returns the included ISeqs that are not children of other live ISeqs. The
+// disassembly of a root ISeq covers all of its children, so every instruction
+// is scanned once.
+static VALUE collect_root_iseqs(struct static_dependencies_scan *scan) {
+  VALUE included_iseqs =
+      dd_ci_iseqs_under(scan->root_path, scan->root_path_len,
+                        scan->ignored_path, scan->ignored_path_len);
+  st_table *children = st_init_numtable();
+
+  long len = RARRAY_LEN(included_iseqs);
+  for (long i = 0; i < len; i++) {
+    rb_block_call(rb_ary_entry(included_iseqs, i), rb_intern("each_child"), 0,
+                  NULL, mark_iseq_child_i, (VALUE)children);
+  }
+
+  VALUE root_iseqs = rb_ary_new();
+  for (long i = 0; i < len; i++) {
+    VALUE iseq = rb_ary_entry(included_iseqs, i);
+    if (!st_is_member(children, (st_data_t)rb_iseqw_to_iseq(iseq))) {
+      rb_ary_push(root_iseqs, iseq);
+    }
+  }
+
+  st_free_table(children);
+  RB_GC_GUARD(included_iseqs);
+  return root_iseqs;
+}
+
+static VALUE constant_names_from_cache(VALUE cached_names) {
+  VALUE names = rb_hash_new();
+  long len = RARRAY_LEN(cached_names);
+  for (long i = 0; i < len; i++) {
+    VALUE name = rb_ary_entry(cached_names, i);
+    if (RB_TYPE_P(name, T_STRING)) {
+      rb_hash_aset(names, name, Qtrue);
+    }
+  }
+  return names;
+}
+
+/*
+ * ISeqCollector.scan_static_dependencies(root_path, ignored_path,
+ *                                        cached_constants)
+ *
+ * Scan all live ISeqs under root_path (and not under ignored_path) for
+ * constant references and resolve the constants to the files where they are
+ * defined.
+ *
+ * ISeqs of files present in cached_constants ({String => Array<String>}) are
+ * not scanned, the cached constant names are resolved instead.
+ *
+ * @return [Array] the dependencies map ({String => Hash{String => true}}),
+ *   the ISeqs that could not be scanned natively and the constant names
+ *   found per file ({String => Hash{String => true}})
+ */
+static VALUE iseq_collector_scan_static_dependencies(VALUE self,
+                                                     VALUE root_path,
+                                                     VALUE ignored_path,
+                                                     VALUE cached_constants) {
+  Check_Type(root_path, T_STRING);
+  if (!NIL_P(cached_constants)) {
+    Check_Type(cached_constants, T_HASH);
+  }
+
+  struct static_dependencies_scan scan = {
+      .root_path = RSTRING_PTR(root_path),
+      .root_path_len = RSTRING_LEN(root_path),
+      .ignored_path = NULL,
+      .ignored_path_len = 0,
+      .dependencies_map = rb_hash_new(),
+      .resolved_constants = rb_hash_new()};
+  if (!NIL_P(ignored_path)) {
+    Check_Type(ignored_path, T_STRING);
+    scan.ignored_path = RSTRING_PTR(ignored_path);
+    scan.ignored_path_len = RSTRING_LEN(ignored_path);
+  }
+
+  VALUE root_iseqs = collect_root_iseqs(&scan);
+  VALUE unscanned_iseqs = rb_ary_new();
+  // { String => Hash{String => true} } source file to its constant names
+  VALUE file_constants = rb_hash_new();
+
+  long len = RARRAY_LEN(root_iseqs);
+  for (long i = 0; i < len; i++) {
+    VALUE iseq = rb_ary_entry(root_iseqs, i);
+    VALUE path = rb_funcall(iseq, rb_intern("absolute_path"), 0);
+
+    hash_fetch_or_create(scan.dependencies_map, path);
+
+    VALUE cached_names = NIL_P(cached_constants)
+                             ? Qnil
+                             : rb_hash_lookup(cached_constants, path);
+    if (RB_TYPE_P(cached_names, T_ARRAY)) {
+      if (rb_hash_lookup2(file_constants, path, Qundef) == Qundef) {
+        rb_hash_aset(file_constants, path,
+                     constant_names_from_cache(cached_names));
+      }
+      continue;
+    }
+
+    if (!dd_ci_scan_iseq_constants(
+            iseq, hash_fetch_or_create(file_constants, path))) {
+      rb_ary_push(unscanned_iseqs, iseq);
+    }
+  }
+
+  rb_hash_foreach(file_constants, resolve_file_constants_i, (VALUE)&scan);
+
+  RB_GC_GUARD(root_path);
+  RB_GC_GUARD(ignored_path);
+  RB_GC_GUARD(scan.resolved_constants);
+  return rb_ary_new_from_args(3, scan.dependencies_map, unscanned_iseqs,
+                              file_constants);
+}
+
+/* ---- Module initialization ---------------------------------------------- */
+
+void Init_dd_ci_static_dependencies(void) {
+  VALUE mDatadog = rb_define_module("Datadog");
+  VALUE mCI = rb_define_module_under(mDatadog, "CI");
+  VALUE mSourceCode = rb_define_module_under(mCI, "SourceCode");
+  VALUE mISeqCollector = rb_define_module_under(mSourceCode, "ISeqCollector");
+
+  rb_define_singleton_method(mISeqCollector, "scan_static_dependencies",
+                             iseq_collector_scan_static_dependencies, 3);
+}
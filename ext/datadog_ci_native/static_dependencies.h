@@ -0,0 +1,18 @@
+#ifndef STATIC_DEPENDENCIES_H
+#define STATIC_DEPENDENCIES_H
+
+#include <ruby.h>
+#include <stdbool.h>
+
+/**
+ * Scan the instructions of a root ISeq and its children for constant
+ * references and add their qualified names to the names Hash as
+ * { String => true }.
+ *
+ * Returns false if the instructions of the ISeq could not be read.
+ */
+bool dd_ci_scan_iseq_constants(VALUE iseq, VALUE names);
+
+void Init_dd_ci_static_dependencies(void);
+
+#endif /* STATIC_DEPENDENCIES_H */
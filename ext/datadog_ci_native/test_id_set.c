@@ -0,0 +1,546 @@
+#include <ruby.h>
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_id_set.h"
+
+// Set of test IDs ("<suite>.<name>.<parameters>") that stores a 64-bit
+// fingerprint per test instead of the ID string. Fingerprints live in an
+// open-addressing table with linear probing, so a set of 500k tests takes a
+// few MB and lookups don't allocate. The fingerprint of an ID string and of
+// its (name, suite, parameters) fields are the same: the fields are hashed as
+// if they were joined with dots, without building the ID.
+//
+// Two different tests share a fingerprint with negligible probability (about
+// 1e-8 for a million tests), such a collision makes them both members.
+//
+// The table can also be mapped read-only from an index file written by
+// Test Optimization cache producers (see TestOptimizationCache::IndexFile):
+// the file holds the slots as little-endian 64-bit words, so the set is
+// queried in place and its pages are shared by all the processes mapping it.
+
+// 0 marks empty slots, a fingerprint of 0 is stored as 1
+#define EMPTY_SLOT 0
+#define MIN_CAPACITY 16
+// the table grows when it is more than 3/4 full
+#define MAX_LOAD_NUMERATOR 3
+#define MAX_LOAD_DENOMINATOR 4
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static const char ID_SEPARATOR = '.';
+
+// Data structure
+struct test_id_set_data {
+  uint64_t *slots;
+  size_t capacity;
+  size_t count;
+  // set when the slots point into a mapped index file
+  void *mapping;
+  size_t mapping_size;
+};
+
+static void test_id_set_data_release(struct test_id_set_data *data) {
+  if (data->mapping != NULL) {
+    munmap(data->mapping, data->mapping_size);
+  } else {
+    xfree(data->slots);
+  }
+
+  data->slots = NULL;
+  data->capacity = 0;
+  data->count = 0;
+  data->mapping = NULL;
+  data->mapping_size = 0;
+}
+
+static void test_id_set_free(void *ptr) {
+  struct test_id_set_data *data = ptr;
+  test_id_set_data_release(data);
+  xfree(data);
+}
+
+static size_t test_id_set_memsize(const void *ptr) {
+  const struct test_id_set_data *data = ptr;
+  // mapped slots are backed by the page cache
+  size_t slots_size =
+      data->mapping != NULL ? 0 : data->capacity * sizeof(uint64_t);
+  return sizeof(struct test_id_set_data) + slots_size;
+}
+
+static const rb_data_type_t test_id_set_data_type = {
+    .wrap_struct_name = "dd_test_id_set",
+    .function = {.dmark = NULL,
+                 .dfree = test_id_set_free,
+                 .dsize = test_id_set_memsize},
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY};
+
+static VALUE cTestIdSet = Qnil;
+
+static VALUE test_id_set_allocate(VALUE klass) {
+  struct test_id_set_data *data;
+  VALUE test_id_set = TypedData_Make_Struct(
+      klass, struct test_id_set_data, &test_id_set_data_type, data);
+
+  data->slots = NULL;
+  data->capacity = 0;
+  data->count = 0;
+  data->mapping = NULL;
+  data->mapping_size = 0;
+
+  return test_id_set;
+}
+
+static struct test_id_set_data *get_test_id_set_data(VALUE self) {
+  struct test_id_set_data *data;
+  TypedData_Get_Struct(self, struct test_id_set_data, &test_id_set_data_type,
+                       data);
+  return data;
+}
+
+static bool test_id_set_p(VALUE obj) {
+  return rb_typeddata_is_kind_of(obj, &test_id_set_data_type);
+}
+
+// Fingerprints
+
+static uint64_t fnv_update(uint64_t hash, const char *bytes, long len) {
+  for (long i = 0; i < len; i++) {
+    hash ^= (uint8_t)bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// nil hashes as an empty string, same as in string interpolation
+static uint64_t fnv_update_value(uint64_t hash, VALUE value) {
+  if (NIL_P(value)) {
+    return hash;
+  }
+  if (!RB_TYPE_P(value, T_STRING)) {
+    value = rb_obj_as_string(value);
+  }
+  hash = fnv_update(hash, RSTRING_PTR(value), RSTRING_LEN(value));
+  RB_GC_GUARD(value);
+  return hash;
+}
+
+// FNV-1a spreads the low bits poorly, the splitmix64 finalizer makes the
+// fingerprint usable as a table index
+static uint64_t finalize_fingerprint(uint64_t hash) {
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash == EMPTY_SLOT ? 1 : hash;
+}
+
+static uint64_t id_fingerprint(VALUE datadog_test_id) {
+  return finalize_fingerprint(fnv_update(FNV_OFFSET_BASIS,
+                                         RSTRING_PTR(datadog_test_id),
+                                         RSTRING_LEN(datadog_test_id)));
+}
+
+// Same as the fingerprint of Utils::TestRun.datadog_test_id(test_name, suite,
+// parameters)
+static uint64_t fields_fingerprint(VALUE test_name, VALUE suite,
+                                   VALUE parameters) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  hash = fnv_update_value(hash, suite);
+  hash = fnv_update(hash, &ID_SEPARATOR, 1);
+  hash = fnv_update_value(hash, test_name);
+  hash = fnv_update(hash, &ID_SEPARATOR, 1);
+  hash = fnv_update_value(hash, parameters);
+  return finalize_fingerprint(hash);
+}
+
+// Table
+
+static size_t slot_index(const struct test_id_set_data *data,
+                         uint64_t fingerprint) {
+  size_t mask = data->capacity - 1;
+  size_t index = (size_t)fingerprint & mask;
+  // bounded so that a corrupted index file without empty slots can't hang
+  for (size_t probes = 1; data->slots[index] != EMPTY_SLOT &&
+                          data->slots[index] != fingerprint &&
+                          probes < data->capacity;
+       probes++) {
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+static void test_id_set_data_resize(struct test_id_set_data *data,
+                                    size_t capacity) {
+  uint64_t *old_slots = data->slots;
+  size_t old_capacity = data->capacity;
+
+  data->slots = ZALLOC_N(uint64_t, capacity);
+  data->capacity = capacity;
+
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old_slots[i] != EMPTY_SLOT) {
+      data->slots[slot_index(data, old_slots[i])] = old_slots[i];
+    }
+  }
+
+  xfree(old_slots);
+}
+
+static void test_id_set_data_reserve(struct test_id_set_data *data,
+                                     size_t count) {
+  size_t capacity = data->capacity > 0 ? data->capacity : MIN_CAPACITY;
+  while (count * MAX_LOAD_DENOMINATOR > capacity * MAX_LOAD_NUMERATOR) {
+    capacity *= 2;
+  }
+
+  if (capacity != data->capacity) {
+    test_id_set_data_resize(data, capacity);
+  }
+}
+
+static void test_id_set_data_add(struct test_id_set_data *data,
+                                 uint64_t fingerprint) {
+  test_id_set_data_reserve(data, data->count + 1);
+
+  size_t index = slot_index(data, fingerprint);
+  if (data->slots[index] == EMPTY_SLOT) {
+    data->slots[index] = fingerprint;
+    data->count++;
+  }
+}
+
+static bool test_id_set_data_include(const struct test_id_set_data *data,
+                                     uint64_t fingerprint) {
+  if (data->count == 0) {
+    return false;
+  }
+  return data->slots[slot_index(data, fingerprint)] == fingerprint;
+}
+
+static void test_id_set_data_merge(struct test_id_set_data *data,
+                                   const struct test_id_set_data *other_data) {
+  test_id_set_data_reserve(data, data->count + other_data->count);
+
+  for (size_t i = 0; i < other_data->capacity; i++) {
+    if (other_data->slots[i] != EMPTY_SLOT) {
+      test_id_set_data_add(data, other_data->slots[i]);
+    }
+  }
+}
+
+static VALUE id_to_s(VALUE datadog_test_id) {
+  return RB_TYPE_P(datadog_test_id, T_STRING)
+             ? datadog_test_id
+             : rb_obj_as_string(datadog_test_id);
+}
+
+static void add_ids(struct test_id_set_data *data, VALUE ids) {
+  ids = rb_Array(ids);
+  test_id_set_data_reserve(data, data->count + (size_t)RARRAY_LEN(ids));
+
+  for (long i = 0; i < RARRAY_LEN(ids); i++) {
+    test_id_set_data_add(data, id_fingerprint(id_to_s(RARRAY_AREF(ids, i))));
+  }
+  RB_GC_GUARD(ids);
+}
+
+// TestIdSet instance methods available in Ruby
+
+// TestIdSet.new(datadog_test_ids = nil)
+static VALUE test_id_set_initialize(int argc, VALUE *argv, VALUE self) {
+  VALUE ids;
+  rb_scan_args(argc, argv, "01", &ids);
+
+  if (!NIL_P(ids)) {
+    rb_check_frozen(self);
+    add_ids(get_test_id_set_data(self), ids);
+  }
+  return self;
+}
+
+static VALUE test_id_set_initialize_copy(VALUE self, VALUE orig) {
+  struct test_id_set_data *data = get_test_id_set_data(self);
+  struct test_id_set_data *orig_data = get_test_id_set_data(orig);
+
+  if (data == orig_data) {
+    return self;
+  }
+
+  test_id_set_data_release(data);
+
+  if (orig_data->capacity > 0) {
+    data->slots = ALLOC_N(uint64_t, orig_data->capacity);
+    memcpy(data->slots, orig_data->slots,
+           orig_data->capacity * sizeof(uint64_t));
+    data->capacity = orig_data->capacity;
+    data->count = orig_data->count;
+  }
+
+  return self;
+}
+
+static VALUE test_id_set_size(VALUE self) {
+  return SIZET2NUM(get_test_id_set_data(self)->count);
+}
+
+static VALUE test_id_set_empty_p(VALUE self) {
+  return get_test_id_set_data(self)->count == 0 ? Qtrue : Qfalse;
+}
+
+static VALUE test_id_set_include_p(VALUE self, VALUE datadog_test_id) {
+  if (!RB_TYPE_P(datadog_test_id, T_STRING)) {
+    return Qfalse;
+  }
+
+  return test_id_set_data_include(get_test_id_set_data(self),
+                                  id_fingerprint(datadog_test_id))
+             ? Qtrue
+             : Qfalse;
+}
+
+// include_test?(test_name, suite, parameters = nil)
+static VALUE test_id_set_include_test_p(int argc, VALUE *argv, VALUE self) {
+  VALUE test_name, suite, parameters;
+  rb_scan_args(argc, argv, "21", &test_name, &suite, &parameters);
+
+  return test_id_set_data_include(
+             get_test_id_set_data(self),
+             fields_fingerprint(test_name, suite, parameters))
+             ? Qtrue
+             : Qfalse;
+}
+
+static VALUE test_id_set_add(VALUE self, VALUE datadog_test_id) {
+  rb_check_frozen(self);
+
+  test_id_set_data_add(get_test_id_set_data(self),
+                       id_fingerprint(id_to_s(datadog_test_id)));
+  return self;
+}
+
+// add_test(test_name, suite, parameters = nil)
+static VALUE test_id_set_add_test(int argc, VALUE *argv, VALUE self) {
+  VALUE test_name, suite, parameters;
+  rb_scan_args(argc, argv, "21", &test_name, &suite, &parameters);
+  rb_check_frozen(self);
+
+  test_id_set_data_add(get_test_id_set_data(self),
+                       fields_fingerprint(test_name, suite, parameters));
+  return self;
+}
+
+static VALUE test_id_set_merge_bang(VALUE self, VALUE other) {
+  rb_check_frozen(self);
+
+  struct test_id_set_data *data = get_test_id_set_data(self);
+  if (!test_id_set_p(other)) {
+    add_ids(data, other);
+    return self;
+  }
+
+  struct test_id_set_data *other_data = get_test_id_set_data(other);
+  if (data != other_data) {
+    test_id_set_data_merge(data, other_data);
+  }
+  return self;
+}
+
+// Compares with another TestIdSet or with a collection of test IDs
+static VALUE test_id_set_equal(VALUE self, VALUE other) {
+  if (self == other) {
+    return Qtrue;
+  }
+
+  VALUE other_set = other;
+  if (!test_id_set_p(other)) {
+    if (!rb_respond_to(other, rb_intern("to_a"))) {
+      return Qfalse;
+    }
+    other_set = test_id_set_allocate(cTestIdSet);
+    add_ids(get_test_id_set_data(other_set), other);
+  }
+
+  struct test_id_set_data *data = get_test_id_set_data(self);
+  struct test_id_set_data *other_data = get_test_id_set_data(other_set);
+  if (data->count != other_data->count) {
+    return Qfalse;
+  }
+
+  for (size_t i = 0; i < other_data->capacity; i++) {
+    if (other_data->slots[i] != EMPTY_SLOT &&
+        !test_id_set_data_include(data, other_data->slots[i])) {
+      return Qfalse;
+    }
+  }
+
+  RB_GC_GUARD(other_set);
+  return Qtrue;
+}
+
+static VALUE test_id_set_inspect(VALUE self) {
+  return rb_sprintf("#<%" PRIsVALUE " size=%" PRIuSIZE ">",
+                    rb_class_name(CLASS_OF(self)),
+                    get_test_id_set_data(self)->count);
+}
+
+static void append_le64(VALUE str, uint64_t value) {
+  uint8_t bytes[sizeof(uint64_t)];
+  for (size_t byte = 0; byte < sizeof(uint64_t); byte++) {
+    bytes[byte] = (uint8_t)(value >> (byte * 8));
+  }
+  rb_str_buf_cat(str, (const char *)bytes, sizeof(uint64_t));
+}
+
+// Marshal support: the set is shared with the other processes of the test
+// session as the list of its fingerprints (little endian)
+static VALUE test_id_set_dump(VALUE self, VALUE _level) {
+  struct test_id_set_data *data = get_test_id_set_data(self);
+
+  VALUE dump = rb_str_buf_new((long)(data->count * sizeof(uint64_t)));
+  for (size_t i = 0; i < data->capacity; i++) {
+    if (data->slots[i] != EMPTY_SLOT) {
+      append_le64(dump, data->slots[i]);
+    }
+  }
+
+  return dump;
+}
+
+static VALUE test_id_set_load(VALUE klass, VALUE dump) {
+  Check_Type(dump, T_STRING);
+
+  long len = RSTRING_LEN(dump);
+  if (len % (long)sizeof(uint64_t) != 0) {
+    rb_raise(rb_eArgError, "invalid test id set dump");
+  }
+
+  VALUE test_id_set = test_id_set_allocate(klass);
+  struct test_id_set_data *data = get_test_id_set_data(test_id_set);
+  test_id_set_data_reserve(data, (size_t)len / sizeof(uint64_t));
+
+  const uint8_t *bytes = (const uint8_t *)RSTRING_PTR(dump);
+  for (long offset = 0; offset < len; offset += sizeof(uint64_t)) {
+    uint64_t fingerprint = 0;
+    for (size_t byte = 0; byte < sizeof(uint64_t); byte++) {
+      fingerprint |= (uint64_t)bytes[offset + byte] << (byte * 8);
+    }
+    if (fingerprint != EMPTY_SLOT) {
+      test_id_set_data_add(data, fingerprint);
+    }
+  }
+
+  RB_GC_GUARD(dump);
+  return test_id_set;
+}
+
+// Index files
+
+// Returns the slots of the table (little endian), the index of an empty set
+// has no slots
+static VALUE test_id_set_dump_index(VALUE self) {
+  struct test_id_set_data *data = get_test_id_set_data(self);
+
+  VALUE index = rb_str_buf_new((long)(data->capacity * sizeof(uint64_t)));
+  for (size_t i = 0; i < data->capacity; i++) {
+    append_le64(index, data->slots[i]);
+  }
+
+  return index;
+}
+
+// TestIdSet.map_index(path, offset, capacity, count)
+//
+// Maps the slots written by #dump_index at offset in the file. The header of
+// the file is trusted: the slots are not scanned so that only the pages
+// touched by lookups are read. Returns a frozen set, or nil on big-endian
+// platforms where the index can't be used in place.
+static VALUE test_id_set_map_index(VALUE klass, VALUE path, VALUE offset,
+                                   VALUE capacity, VALUE count) {
+#ifdef WORDS_BIGENDIAN
+  return Qnil;
+#else
+  FilePathValue(path);
+  size_t slots_offset = NUM2SIZET(offset);
+  size_t slots_capacity = NUM2SIZET(capacity);
+  size_t slots_count = NUM2SIZET(count);
+
+  if (slots_offset % sizeof(uint64_t) != 0 ||
+      (slots_capacity & (slots_capacity - 1)) != 0 ||
+      (slots_capacity == 0 && slots_count > 0) ||
+      (slots_capacity > 0 && slots_count >= slots_capacity) ||
+      slots_capacity > (SIZE_MAX - slots_offset) / sizeof(uint64_t)) {
+    rb_raise(rb_eArgError, "invalid test id index layout");
+  }
+
+  VALUE test_id_set = test_id_set_allocate(klass);
+  struct test_id_set_data *data = get_test_id_set_data(test_id_set);
+
+  if (slots_capacity > 0) {
+    int fd = open(RSTRING_PTR(path), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      rb_sys_fail_str(path);
+    }
+
+    size_t mapping_size = slots_offset + slots_capacity * sizeof(uint64_t);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < 0 ||
+        (size_t)file_stat.st_size < mapping_size) {
+      close(fd);
+      rb_raise(rb_eArgError, "truncated test id index: %" PRIsVALUE, path);
+    }
+
+    void *mapping = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      rb_sys_fail_str(path);
+    }
+
+    data->mapping = mapping;
+    data->mapping_size = mapping_size;
+    data->slots = (uint64_t *)((char *)mapping + slots_offset);
+    data->capacity = slots_capacity;
+    data->count = slots_count;
+  }
+
+  return rb_obj_freeze(test_id_set);
+#endif
+}
+
+void Init_test_id_set(void) {
+  VALUE mDatadog = rb_define_module("Datadog");
+  VALUE mCI = rb_define_module_under(mDatadog, "CI");
+  VALUE mUtils = rb_define_module_under(mCI, "Utils");
+  cTestIdSet = rb_define_class_under(mUtils, "TestIdSet", rb_cObject);
+  rb_gc_register_address(&cTestIdSet);
+
+  rb_define_alloc_func(cTestIdSet, test_id_set_allocate);
+
+  rb_define_method(cTestIdSet, "initialize", test_id_set_initialize, -1);
+  rb_define_method(cTestIdSet, "initialize_copy", test_id_set_initialize_copy,
+                   1);
+  rb_define_method(cTestIdSet, "size", test_id_set_size, 0);
+  rb_define_method(cTestIdSet, "empty?", test_id_set_empty_p, 0);
+  rb_define_method(cTestIdSet, "include?", test_id_set_include_p, 1);
+  rb_define_method(cTestIdSet, "include_test?", test_id_set_include_test_p,
+                   -1);
+  rb_define_method(cTestIdSet, "<<", test_id_set_add, 1);
+  rb_define_method(cTestIdSet, "add_test", test_id_set_add_test, -1);
+  rb_define_method(cTestIdSet, "merge!", test_id_set_merge_bang, 1);
+  rb_define_method(cTestIdSet, "==", test_id_set_equal, 1);
+  rb_define_method(cTestIdSet, "inspect", test_id_set_inspect, 0);
+  rb_define_method(cTestIdSet, "to_s", test_id_set_inspect, 0);
+  rb_define_method(cTestIdSet, "_dump", test_id_set_dump, 1);
+  rb_define_singleton_method(cTestIdSet, "_load", test_id_set_load, 1);
+  rb_define_method(cTestIdSet, "dump_index", test_id_set_dump_index, 0);
+  rb_define_singleton_method(cTestIdSet, "map_index", test_id_set_map_index,
+                             4);
+}
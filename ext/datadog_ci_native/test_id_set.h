@@ -0,0 +1,3 @@
+#pragma once
+
+void Init_test_id_set(void);
@@ -8,6 +8,9 @@ require "datadog/core/buffer/cruby"
 require "datadog/core/buffer/thread_safe"
 
 require "datadog/core/environment/ext"
+require "datadog/core/utils/time"
+
+require_relative "transport/telemetry"
 
 module Datadog
   module CI
@@ -18,10 +21,39 @@ module Datadog
       attr_reader :transport
 
       DEFAULT_BUFFER_MAX_SIZE = 10_000
+      DEFAULT_BUFFER_MAX_BYTES = 32 * 1024 * 1024
       DEFAULT_SHUTDOWN_TIMEOUT = 60
 
       DEFAULT_INTERVAL = 3
 
+      # Buffered events are flushed before the interval elapses when they reach one of these thresholds
+      DEFAULT_FLUSH_BYTES = 4 * 1024 * 1024
+
+      # Size accounted for events that can't estimate their encoded size
+      DEFAULT_EVENT_SIZE = 1024
+
+      # What happens to an event written when the buffer is full (by count or by bytes):
+      # - drop: the event is dropped
+      # - block: the caller waits for the worker to flush the buffer for up to block_timeout seconds, the event is
+      #   dropped if the buffer is still full
+      OVERFLOW_POLICY_DROP = :drop
+      OVERFLOW_POLICY_BLOCK = :block
+      DEFAULT_BLOCK_TIMEOUT = 1
+      # blocked writers check again for buffer space after this time
+      BLOCK_WAKE_UP_INTERVAL = 0.1
+
+      # The interval shrinks down to this value when events are written faster than they can be batched in one
+      # interval, and grows back to the configured interval when the writer is idle
+      MIN_ADAPTIVE_INTERVAL = 0.5
+      # weight of the last observed event rate in the smoothed rate
+      EVENT_RATE_SMOOTHING = 0.5
+
+      attr_reader :buffered_bytes, :spool
+
+      # Interval between flushes and the time the worker waits for the next flush (the interval, or longer after
+      # server errors)
+      attr_reader :flush_interval, :flush_wait_time
+
       def initialize(transport:, options: {})
         @transport = transport
 
@@ -31,17 +63,39 @@ module Datadog
         # Workers::Async::Thread settings
         self.fork_policy = Core::Workers::Async::Thread::FORK_POLICY_RESTART
 
-        # Workers::IntervalLoop settings
-        self.loop_base_interval = options[:interval] || DEFAULT_INTERVAL
+        # Workers::IntervalLoop settings: the loop yields without waiting while it runs, the writer waits for the
+        # next flush itself (see #wait_for_next_flush)
+        self.loop_base_interval = 0
         self.loop_back_off_ratio = options[:back_off_ratio] if options.key?(:back_off_ratio)
         self.loop_back_off_max = options[:back_off_max] if options.key?(:back_off_max)
 
+        @flush_interval = options[:interval] || DEFAULT_INTERVAL
+        @flush_wait_time = @flush_interval
+
         @buffer_size = options.fetch(:buffer_size, DEFAULT_BUFFER_MAX_SIZE)
+        @buffer_max_bytes = options.fetch(:buffer_max_bytes, DEFAULT_BUFFER_MAX_BYTES)
+        @flush_size = options.fetch(:flush_size) { [@buffer_size / 2, 1].max }
+        @flush_bytes = options.fetch(:flush_bytes, DEFAULT_FLUSH_BYTES)
+        @overflow_policy = options.fetch(:overflow_policy, OVERFLOW_POLICY_DROP)
+        @block_timeout = options.fetch(:block_timeout, DEFAULT_BLOCK_TIMEOUT)
+
+        @max_interval = @flush_interval
+        @adaptive_interval = options.fetch(:adaptive_interval, true)
+        @event_rate = 0.0
+        @last_flush_time = nil
 
         self.buffer = buffer_klass.new(@buffer_size)
+        reset_buffer_accounting
+        reset_flush_wake_up
 
         @shutdown_timeout = options.fetch(:shutdown_timeout, DEFAULT_SHUTDOWN_TIMEOUT)
 
+        # Optional Transport::EventSpool shared with the other processes of the test session: producers (worker
+        # processes) append their events to the spool, the writer of the process that owns the spool sends them.
+        # The transport must support #encode_events and #send_encoded_events.
+        @spool = options[:spool]
+        @spool_producer = @spool ? options.fetch(:spool_producer, false) : false
+
         @stopped = false
       end
 
@@ -56,37 +110,81 @@ module Datadog
       end
 
       def perform(*events)
-        responses = transport.send_events(events)
-
-        if responses.find(&:server_error?)
-          loop_back_off!
-          Datadog.logger.warn { "Encountered server error while sending events: #{responses}" }
-        end
+        flush(events) if !events.empty? || spool_pending?
+        wait_for_next_flush
 
         nil
-      rescue => e
-        Datadog.logger.warn { "Error while sending events: #{e}" }
-        loop_back_off!
       end
 
       def stop(force_stop = false, timeout = @shutdown_timeout)
         @stopped = true
 
         buffer.close if running?
+        # release writers blocked on a full buffer, they drop their events
+        @buffer_mutex.synchronize { @buffer_space.broadcast }
+
+        result = super
+
+        # the worker thread of the spool owner might have never been started (parallel_tests runs no tests in the
+        # parent process) or stopped before the producers finished: send what is left in the spool
+        if @spool && !spool_producer? && !running?
+          drain_spool
+          @spool.cleanup
+        end
+
+        result
+      end
 
-        super
+      def spool_producer?
+        @spool_producer
       end
 
+      # The worker waits for the next flush on the writer's own condition variable: wake it up to finish the loop
+      def stop_loop
+        stopped = super
+        flush_early
+        stopped
+      end
+
+      # Starts the worker thread of the spool owner, so that the events spooled by the worker processes are sent
+      # while they run, even if this process never writes events itself (parallel_tests runs no tests in the
+      # parent process).
+      def start_spool_drain
+        return if @spool.nil? || spool_producer?
+
+        perform
+      end
+
+      # Buffered events are accounted by their estimated encoded size. When the buffer fills up beyond the flush
+      # thresholds the worker is woken up to flush right away instead of waiting for the interval to elapse.
       def enqueue(event)
-        buffer.push(event)
+        event_size = estimated_size(event)
+
+        @buffer_mutex.synchronize do
+          return unless reserve_buffer_space(event_size)
+
+          buffer.push(event)
+          @buffered_bytes += event_size
+        end
+
+        flush_early if flush_due?
       end
 
       def dequeue
-        buffer.pop
+        @buffer_mutex.synchronize do
+          events = buffer.pop
+          @buffered_bytes = 0
+          @buffer_space.broadcast
+          events
+        end
       end
 
+      # While the loop runs it yields on every iteration: #perform waits for the next flush itself, so that
+      # #flush_early can wake the worker up. Once the loop is stopped, the pending events are flushed.
       def work_pending?
-        !buffer.empty?
+        return true if run_loop?
+
+        !buffer.empty? || spool_pending?
       end
 
       def async?
@@ -98,6 +196,11 @@ module Datadog
         # A.K.A. copy-on-write. We don't want forks to write events generated from another process.
         # Instead, we reset it after the fork. (Make sure any enqueue operations happen after this.)
         self.buffer = buffer_klass.new(@buffer_size)
+        reset_buffer_accounting
+        reset_flush_wake_up
+
+        # forked workers hand their events over to the spool owner
+        @spool_producer = true if @spool
       end
 
       def buffer_klass
@@ -107,6 +210,156 @@ module Datadog
           Core::Buffer::ThreadSafe
         end
       end
+
+      private
+
+      def reset_buffer_accounting
+        @buffer_mutex = Mutex.new
+        @buffer_space = ConditionVariable.new
+        @buffered_bytes = 0
+      end
+
+      def reset_flush_wake_up
+        @flush_mutex = Mutex.new
+        @flush_wake_up = ConditionVariable.new
+        @flush_requested = false
+      end
+
+      def spool_pending?
+        !@spool.nil? && !spool_producer? && @spool.pending?
+      end
+
+      def flush(events)
+        return spool_events(events) if spool_producer?
+
+        responses = events.empty? ? [] : transport.send_events(events)
+        responses += drain_spool if @spool
+
+        if responses.find(&:server_error?)
+          back_off!
+          Datadog.logger.warn { "Encountered server error while sending events: #{responses}" }
+        else
+          adapt_interval(events.size)
+        end
+
+        nil
+      rescue => e
+        Datadog.logger.warn { "Error while sending events: #{e}" }
+        back_off!
+      end
+
+      # Same back off as Core::Workers::IntervalLoop#loop_back_off!, applied to the wait for the next flush
+      def back_off!
+        @flush_wait_time = [@flush_wait_time * loop_back_off_ratio, loop_back_off_max].min
+      end
+
+      def estimated_size(event)
+        event.respond_to?(:estimated_size) ? event.estimated_size : DEFAULT_EVENT_SIZE
+      end
+
+      # Must be called with @buffer_mutex held. Returns false when the event must be dropped.
+      #
+      # The buffer drops a random event itself when it is full by count, the writer applies the overflow policy
+      # before the buffer gets there so that dropped events are accounted for.
+      def reserve_buffer_space(event_size)
+        deadline = nil
+
+        while buffer_full?(event_size)
+          if @overflow_policy == OVERFLOW_POLICY_BLOCK && !@stopped && running?
+            deadline ||= Core::Utils::Time.get_time + @block_timeout
+            remaining = deadline - Core::Utils::Time.get_time
+            if remaining > 0
+              flush_early
+              @buffer_space.wait(@buffer_mutex, [remaining, BLOCK_WAKE_UP_INTERVAL].min)
+              next
+            end
+          end
+
+          report_dropped_event
+          Datadog.logger.debug { "[#{self.class.name}] Buffer is full, dropping event" }
+          return false
+        end
+
+        true
+      end
+
+      def buffer_full?(event_size)
+        return true if buffer.length >= @buffer_size
+
+        # a single event larger than the budget is still accepted into an empty buffer
+        @buffered_bytes > 0 && @buffered_bytes + event_size > @buffer_max_bytes
+      end
+
+      # Events dropped by the writer are reported with the events dropped by the transport of the same endpoint
+      def report_dropped_event
+        return unless transport.respond_to?(:telemetry_endpoint_tag)
+
+        Transport::Telemetry.endpoint_payload_dropped(1, endpoint: transport.telemetry_endpoint_tag)
+      end
+
+      def flush_due?
+        buffer.length >= @flush_size || @buffered_bytes >= @flush_bytes
+      end
+
+      # Sizes the interval so that a batch collects about flush_size events at the observed event rate: short
+      # intervals keep the buffer small and the shutdown tail short during bursts, the configured interval is used
+      # again when the rate drops.
+      def adapt_interval(events_count)
+        # events were sent: the wait for the next flush is no longer backed off
+        @flush_wait_time = @flush_interval
+        return unless @adaptive_interval
+
+        now = Core::Utils::Time.get_time
+        last_flush_time = @last_flush_time
+        @last_flush_time = now
+        return if last_flush_time.nil?
+
+        elapsed = now - last_flush_time
+        return if elapsed <= 0
+
+        @event_rate = EVENT_RATE_SMOOTHING * (events_count / elapsed) + (1 - EVENT_RATE_SMOOTHING) * @event_rate
+
+        interval = (@event_rate > 0) ? @flush_size / @event_rate : @max_interval
+        interval = interval.clamp([MIN_ADAPTIVE_INTERVAL, @max_interval].min, @max_interval)
+
+        @flush_interval = interval
+        @flush_wait_time = interval
+      end
+
+      def spool_events(events)
+        @spool&.append(transport.encode_events(events)) unless events.empty?
+        nil
+      end
+
+      def drain_spool
+        responses = []
+        @spool&.drain(transport.max_payload_size) do |encoded_events|
+          responses.concat(transport.send_encoded_events(encoded_events))
+        end
+        responses
+      rescue => e
+        Datadog.logger.warn { "Error while sending spooled events: #{e}" }
+        responses || []
+      end
+
+      # Waits for the next interval, unless the loop was stopped or a flush has been requested. A flush requested
+      # while events are being sent starts the next flush right away instead of being missed.
+      def wait_for_next_flush
+        @flush_mutex.synchronize do
+          @flush_wake_up.wait(@flush_mutex, @flush_wait_time) if run_loop? && !@flush_requested
+          @flush_requested = false
+        end
+      end
+
+      # Wakes up the worker waiting for the next flush
+      def flush_early
+        return unless running?
+
+        @flush_mutex.synchronize do
+          @flush_requested = true
+          @flush_wake_up.signal
+        end
+      end
     end
   end
 end
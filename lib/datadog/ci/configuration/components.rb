@@ -1,5 +1,7 @@
 # frozen_string_literal: true
 
+require "tmpdir"
+
 require "datadog/core/telemetry/ext"
 
 require_relative "../ext/settings"
@@ -36,6 +38,7 @@ require_relative "../test_tracing/null_transport"
 require_relative "../test_tracing/transport"
 require_relative "../transport/adapters/telemetry_webmock_safe_adapter"
 require_relative "../transport/api/builder"
+require_relative "../transport/event_spool"
 require_relative "../utils/parsing"
 require_relative "../utils/runtime_tags_overrides"
 require_relative "../utils/test_run"
@@ -49,7 +52,7 @@ module Datadog
       module Components
         attr_reader :test_tracing, :test_impact_analysis, :git_tree_upload_worker, :ci_remote, :test_retries,
           :test_management, :agentless_logs_submission, :impacted_tests_detection, :test_discovery, :code_coverage,
-          :test_optimization_cache
+          :test_optimization_cache, :event_spool_dir
 
         def initialize(settings)
           @test_impact_analysis = TestImpactAnalysis::NullComponent.new
@@ -216,7 +219,10 @@ module Datadog
             bundle_location: settings.ci.itr_code_coverage_excluded_bundle_path,
             use_single_threaded_coverage: settings.ci.itr_code_coverage_use_single_threaded_mode,
             use_allocation_tracing: settings.ci.itr_test_impact_analysis_use_allocation_tracing,
-            static_dependencies_tracking_enabled: settings.ci.tia_static_dependencies_tracking_enabled
+            static_dependencies_tracking_enabled: settings.ci.tia_static_dependencies_tracking_enabled,
+            static_dependencies_cache_enabled: settings.ci.tia_static_dependencies_cache_enabled,
+            static_dependencies_cache_path: settings.ci.tia_static_dependencies_cache_path,
+            use_iseq_line_tracing: settings.ci.tia_iseq_line_tracing_enabled
           )
         end
 
@@ -274,9 +280,43 @@ module Datadog
           # nil means that coverage event will be ignored
           return nil if api.nil? || settings.ci.discard_traces
 
-          AsyncWriter.new(
-            transport: TestImpactAnalysis::Coverage::Transport.new(api: api)
+          options = {
+            # rather slow down a test thread for a moment than lose the coverage of a test
+            overflow_policy: AsyncWriter::OVERFLOW_POLICY_BLOCK
+          }
+          options.merge!(build_event_spool_options(settings, "citestcov"))
+
+          writer = AsyncWriter.new(
+            transport: TestImpactAnalysis::Coverage::Transport.new(api: api),
+            options: options
           )
+          writer.start_spool_drain
+          writer
+        end
+
+        # The process that owns the test session creates the spool directory and keeps it in event_spool_dir.
+        # Worker processes started by parallel_tests receive it in their environment (see Contrib::ParallelTests::CLI)
+        # and read it from the event_spool_dir setting, forked workers inherit it from the writer.
+        def build_event_spool_options(settings, name)
+          return {} unless settings.ci.event_spool_enabled
+
+          producer_spool_dir = settings.ci.event_spool_dir
+          unless producer_spool_dir.nil?
+            return {
+              spool: Transport::EventSpool.new(dir: File.join(producer_spool_dir, name)),
+              spool_producer: true
+            }
+          end
+
+          @event_spool_dir ||= Dir.mktmpdir("datadog-ci-spool-")
+
+          {
+            spool: Transport::EventSpool.new(dir: File.join(@event_spool_dir, name), root_dir: @event_spool_dir),
+            spool_producer: false
+          }
+        rescue => e
+          Datadog.logger.warn("Failed to create event spool, events will be sent by every process: #{e.message}")
+          {}
         end
 
         def build_git_upload_worker(settings, api)
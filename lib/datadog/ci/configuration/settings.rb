@@ -4,6 +4,7 @@ require_relative "../contrib/instrumentation"
 require_relative "../ext/settings"
 require_relative "../ext/test"
 require_relative "../ext/test_optimization_cache"
+require_relative "../ext/transport"
 require_relative "../utils/bundle"
 require_relative "../utils/configuration"
 require_relative "../utils/parsing"
@@ -218,6 +219,23 @@ module Datadog
                 o.default true
               end
 
+              option :tia_static_dependencies_cache_enabled do |o|
+                o.type :bool
+                o.env CI::Ext::Settings::ENV_TIA_STATIC_DEPENDENCIES_CACHE_ENABLED
+                o.default true
+              end
+
+              option :tia_static_dependencies_cache_path do |o|
+                o.type :string, nilable: true
+                o.env CI::Ext::Settings::ENV_TIA_STATIC_DEPENDENCIES_CACHE_PATH
+              end
+
+              option :tia_iseq_line_tracing_enabled do |o|
+                o.type :bool
+                o.env CI::Ext::Settings::ENV_TIA_ISEQ_LINE_TRACING_ENABLED
+                o.default false
+              end
+
               option :code_coverage_report_upload_enabled do |o|
                 o.type :bool
                 o.env CI::Ext::Settings::ENV_CODE_COVERAGE_REPORT_UPLOAD_ENABLED
@@ -234,6 +252,37 @@ module Datadog
                 o.env CI::Ext::Settings::ENV_RUNTIME_TAGS
               end
 
+              option :event_spool_enabled do |o|
+                o.type :bool
+                o.env CI::Ext::Settings::ENV_EVENT_SPOOL_ENABLED
+                o.default false
+              end
+
+              # internal only: set in the environment of parallel_tests workers by the process that owns the spool
+              option :event_spool_dir do |o|
+                o.type :string, nilable: true
+                o.env CI::Ext::Settings::ENV_EVENT_SPOOL_DIR
+              end
+
+              # -1 is zlib's default compression level, 0 disables compression, 9 compresses the most
+              option :transport_compression_level do |o|
+                o.type :int
+                o.env CI::Ext::Settings::ENV_TRANSPORT_COMPRESSION_LEVEL
+                o.default(-1)
+                o.setter do |level|
+                  Utils::Configuration.normalize_transport_compression_level(level)
+                end
+              end
+
+              option :transport_compression_strategy do |o|
+                o.type :string
+                o.env CI::Ext::Settings::ENV_TRANSPORT_COMPRESSION_STRATEGY
+                o.default CI::Ext::Transport::COMPRESSION_STRATEGY_DEFAULT
+                o.setter do |strategy|
+                  Utils::Configuration.normalize_transport_compression_strategy(strategy)
+                end
+              end
+
               define_method(:instrument) do |integration_name, options = {}, &block|
                 return unless enabled
 
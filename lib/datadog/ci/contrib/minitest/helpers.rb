@@ -1,6 +1,8 @@
 # frozen_string_literal: true
 
+require_relative "../../git/local_repository"
 require_relative "../../source_code/constant_resolver"
+require_relative "../../source_code/method_inspect"
 
 module Datadog
   module CI
@@ -57,10 +59,31 @@ module Datadog
               tags: test_suite_tags
             )
             test_suite&.set_expected_tests!(klass.runnable_methods)
+            classify_impacted_tests(klass) if test_suite
 
             test_suite
           end
 
+          # Finds modified tests of the whole test suite at once before they run,
+          # using the same source locations as Minitest::Test#start_datadog_test
+          def self.classify_impacted_tests(klass)
+            impacted_tests_detection = Datadog.send(:components).impacted_tests_detection
+            return unless impacted_tests_detection.enabled?
+
+            relative_paths = {}
+            tests = klass.runnable_methods.map do |method_name|
+              test_method = klass.instance_method(method_name)
+              source_file, first_line_number = test_method.source_location
+              if source_file
+                source_file = relative_paths[source_file] ||= Git::LocalRepository.relative_to_root(source_file)
+              end
+
+              [source_file, first_line_number, SourceCode::MethodInspect.last_line(test_method)]
+            end
+
+            impacted_tests_detection.classify_tests(tests)
+          end
+
           def self.test_suite_name(klass, method_name)
             source_location = extract_runnable_source_location(klass, method_name)&.first
 
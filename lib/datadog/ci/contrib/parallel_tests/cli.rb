@@ -1,5 +1,6 @@
 # frozen_string_literal: true
 
+require_relative "../../ext/settings"
 require_relative "../../ext/test"
 require_relative "../rspec/ext"
 
@@ -36,6 +37,9 @@ module Datadog
                 options[:env] ||= {}
                 options[:env][CI::Ext::Settings::ENV_TEST_VISIBILITY_DRB_SERVER_URI] = test_tracing_component.context_service_uri
                 options[:env]["RUBYOPT"] ||= worker_rubyopt if worker_rubyopt
+                # workers spool their events for this process to send them
+                event_spool_dir = Datadog.send(:components).event_spool_dir
+                options[:env][CI::Ext::Settings::ENV_EVENT_SPOOL_DIR] = event_spool_dir if event_spool_dir
 
                 super
               ensure
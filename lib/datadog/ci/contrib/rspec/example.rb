@@ -169,6 +169,17 @@ module Datadog
               @datadog_source_start
             end
 
+            # Returns the last line of this example's block, nil when it can't be determined.
+            #
+            # Not available if the example's source location wasn't resolved from its own metadata: when we fall back
+            # to parent's location (e.g., for rswag tests), the @example_block is defined in a different file (the gem),
+            # so its end line would be inconsistent with source_file and source_start.
+            def datadog_source_end
+              return @datadog_source_end if defined?(@datadog_source_end)
+
+              @datadog_source_end = (SourceCode::MethodInspect.last_line(@example_block) unless datadog_source_location_from_parent?)
+            end
+
             # Returns true if the source location was resolved from a parent example_group
             # rather than the example's own metadata.
             def datadog_source_location_from_parent?
@@ -203,14 +214,8 @@ module Datadog
                 CI::Ext::Test::TAG_PARAMETERS => datadog_test_parameters
               }
 
-              # Only set source_end if the example's source location wasn't resolved from a parent
-              # example_group. When we fall back to parent's location (e.g., for rswag tests),
-              # the @example_block is defined in a different file (the gem), so its end line
-              # would be inconsistent with source_file and source_start.
-              unless datadog_source_location_from_parent?
-                end_line = SourceCode::MethodInspect.last_line(@example_block)
-                tags[CI::Ext::Test::TAG_SOURCE_END] = end_line.to_s if end_line
-              end
+              end_line = datadog_source_end
+              tags[CI::Ext::Test::TAG_SOURCE_END] = end_line.to_s if end_line
 
               tags
             end
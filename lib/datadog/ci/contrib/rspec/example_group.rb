@@ -52,6 +52,8 @@ module Datadog
 
                 return skip_test_suite(test_suite) if test_suite&.should_skip?
 
+                classify_impacted_tests if test_suite
+
                 success = super
 
                 return success unless test_suite
@@ -73,7 +75,6 @@ module Datadog
 
             def all_examples_skipped_by_datadog?
               descendant_filtered_examples.all? do |example|
-                datadog_test_id = example.datadog_test_id
                 datadog_fqn_test_id = example.datadog_fqn_test_id
 
                 # Don't skip if the test is marked as attempt_to_fix (it should run and be retried)
@@ -81,7 +82,11 @@ module Datadog
 
                 # Skip by Test Impact Analysis: test is skippable and not marked as unskippable
                 tia_skipped = !example.datadog_unskippable? &&
-                  test_impact_analysis_component&.skippable?(datadog_test_id)
+                  test_impact_analysis_component&.skippable_test?(
+                    example.datadog_test_name,
+                    example.datadog_test_suite_name,
+                    example.datadog_test_parameters
+                  )
 
                 # Skip by Test Management: test is disabled
                 test_management_disabled = test_management_component&.disabled?(datadog_fqn_test_id)
@@ -90,6 +95,18 @@ module Datadog
               end
             end
 
+            # Finds modified examples of the whole test suite at once before they run
+            def classify_impacted_tests
+              impacted_tests_detection = impacted_tests_detection_component
+              return unless impacted_tests_detection&.enabled?
+
+              impacted_tests_detection.classify_tests(
+                descendant_filtered_examples.map do |example|
+                  [example.datadog_source_file, example.datadog_source_start, example.datadog_source_end]
+                end
+              )
+            end
+
             # Returns a stable context ID for this example group.
             # Uses RSpec's scoped_id which uniquely identifies each example group.
             def datadog_context_id
@@ -122,6 +139,10 @@ module Datadog
             def test_management_component
               Datadog.send(:components).test_management
             end
+
+            def impacted_tests_detection_component
+              Datadog.send(:components).impacted_tests_detection
+            end
           end
         end
       end
@@ -32,9 +32,16 @@ module Datadog
         ENV_TEST_DISCOVERY_OUTPUT_PATH = "DD_TEST_OPTIMIZATION_DISCOVERY_FILE"
         ENV_AUTO_INSTRUMENTATION_PROVIDER = "DD_CIVISIBILITY_AUTO_INSTRUMENTATION_PROVIDER"
         ENV_TIA_STATIC_DEPENDENCIES_TRACKING_ENABLED = "DD_TEST_OPTIMIZATION_TIA_STATIC_DEPS_COVERAGE_ENABLED"
+        ENV_TIA_STATIC_DEPENDENCIES_CACHE_ENABLED = "DD_TEST_OPTIMIZATION_TIA_STATIC_DEPS_CACHE_ENABLED"
+        ENV_TIA_STATIC_DEPENDENCIES_CACHE_PATH = "DD_TEST_OPTIMIZATION_TIA_STATIC_DEPS_CACHE_PATH"
+        ENV_TIA_ISEQ_LINE_TRACING_ENABLED = "DD_TEST_OPTIMIZATION_TIA_ISEQ_LINE_TRACING_ENABLED"
         ENV_CODE_COVERAGE_REPORT_UPLOAD_ENABLED = "DD_CIVISIBILITY_CODE_COVERAGE_REPORT_UPLOAD_ENABLED"
         ENV_CODE_COVERAGE_FLAGS = "DD_CODE_COVERAGE_FLAGS"
         ENV_RUNTIME_TAGS = "DD_TEST_OPTIMIZATION_RUNTIME_TAGS"
+        ENV_EVENT_SPOOL_ENABLED = "DD_TEST_OPTIMIZATION_EVENT_SPOOL_ENABLED"
+        ENV_EVENT_SPOOL_DIR = "DD_TEST_OPTIMIZATION_EVENT_SPOOL_DIR"
+        ENV_TRANSPORT_COMPRESSION_LEVEL = "DD_TEST_OPTIMIZATION_TRANSPORT_COMPRESSION_LEVEL"
+        ENV_TRANSPORT_COMPRESSION_STRATEGY = "DD_TEST_OPTIMIZATION_TRANSPORT_COMPRESSION_STRATEGY"
 
         # Source: https://docs.datadoghq.com/getting_started/site/
         DD_SITE_ALLOWLIST = %w[
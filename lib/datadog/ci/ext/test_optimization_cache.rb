@@ -13,9 +13,12 @@ module Datadog
         PLAN_FOLDER = ".testoptimization"
         MANIFEST_FILE_NAME = "manifest.txt"
         SUPPORTED_MANIFEST_VERSION = "1"
+        # manifest v2 caches add binary indexes of the known and skippable tests next to the JSON responses
+        INDEXED_MANIFEST_VERSION = "2"
 
         CACHE_FOLDER_NAME = "cache"
         HTTP_CACHE_FOLDER_NAME = "http"
+        INDEX_CACHE_FOLDER_NAME = "index"
 
         TESTOPTIMIZATION_CACHE_PATH = "#{PLAN_FOLDER}/#{CACHE_FOLDER_NAME}"
         TESTOPTIMIZATION_HTTP_CACHE_PATH = "#{TESTOPTIMIZATION_CACHE_PATH}/#{HTTP_CACHE_FOLDER_NAME}"
@@ -25,6 +28,11 @@ module Datadog
         TEST_MANAGEMENT_FILE_NAME = "test_management.json"
         LEGACY_TEST_MANAGEMENT_TESTS_FILE_NAME = "test_management_tests.json"
         SKIPPABLE_TESTS_FILE_NAME = "skippable_tests.json"
+
+        KNOWN_TESTS_INDEX_FILE_NAME = "known_tests.idx"
+        SKIPPABLE_TESTS_INDEX_FILE_NAME = "skippable_tests.idx"
+        # metadata key of the skippable tests index
+        INDEX_METADATA_CORRELATION_ID = "correlation_id"
       end
     end
   end
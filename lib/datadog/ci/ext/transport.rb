@@ -73,6 +73,10 @@ module Datadog
         CONTENT_ENCODING_GZIP = "gzip"
 
         GZIP_MAGIC_NUMBER = "\x1F\x8B".b
+
+        COMPRESSION_LEVELS = (-1..9).freeze
+        COMPRESSION_STRATEGY_DEFAULT = "default"
+        COMPRESSION_STRATEGIES = %w[default filtered huffman_only rle fixed].freeze
       end
     end
   end
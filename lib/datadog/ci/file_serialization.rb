@@ -2,7 +2,8 @@
 
 module Datadog
   module CI
-    # Native fast path for serializing large lists of file paths.
+    # Native fast path for serializing large lists of file paths and whole
+    # batches of code coverage events.
     # Implementation in ext/datadog_ci_native/file_serialization.c.
     #
     # @internal
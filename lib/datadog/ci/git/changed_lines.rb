@@ -5,64 +5,64 @@ module Datadog
     module Git
       # Helper class to efficiently store and query changed line intervals for a single file
       # Uses merged sorted intervals with binary search for O(log n) query performance
+      #
+      # Intervals are packed in a flat array of integers: [start_0, end_0, start_1, end_1, ...].
+      # The object is not synchronized: build! must be called before sharing it between threads, which
+      # Diff does once the whole diff is parsed.
       class ChangedLines
         def initialize
-          @intervals = [] # Array of [start, end] pairs
-          @built = false
-          @mutex = Mutex.new
+          @intervals = [] # flat array of start, end pairs
+          @built = true
         end
 
         # Add an interval (defers merging until build! is called)
         def add_interval(start_line, end_line)
           return if start_line > end_line
 
-          @mutex.synchronize do
-            @intervals << [start_line, end_line]
-            @built = false
-          end
+          # git diff lists the hunks of a file in order, appending keeps the array sorted in the common case
+          last_end = @intervals[-1]
+          @built = false if last_end && last_end + 1 >= start_line
+
+          @intervals << start_line << end_line
         end
 
         # Sort and merge all intervals
         # Call this after all intervals have been added
         def build!
-          @mutex.synchronize do
-            return false if @built
-
-            @built = true
-            return false if @intervals.empty?
-
-            # Sort intervals by start line
-            @intervals.sort_by!(&:first)
-
-            # Merge overlapping intervals
-            merged = []
-
-            # @type var current_start: Integer
-            # @type var current_end: Integer
-            current_start, current_end = @intervals.first
-
-            @intervals.each_with_index do |interval, index|
-              next if index == 0
-              # @type var start_line: Integer
-              # @type var end_line: Integer
-              start_line, end_line = interval
-
-              if start_line <= current_end + 1
-                # Overlapping or adjacent intervals, merge them
-                current_end = [current_end, end_line].max
-              else
-                # Non-overlapping interval, save current and start new
-                merged << [current_start, current_end]
-                current_start = start_line
-                current_end = end_line
-              end
-            end
+          return false if @built
+
+          @built = true
+          return false if @intervals.empty?
+
+          order = (0...@intervals.size / 2).sort_by { |pair| @intervals[pair * 2] }
+
+          # Merge overlapping and adjacent intervals
+          merged = []
 
-            merged << [current_start, current_end]
+          # @type var current_start: Integer
+          # @type var current_end: Integer
+          current_start = @intervals[order[0] * 2]
+          current_end = @intervals[order[0] * 2 + 1]
 
-            @intervals = merged
-            true
+          order.each do |pair|
+            # @type var start_line: Integer
+            # @type var end_line: Integer
+            start_line = @intervals[pair * 2]
+            end_line = @intervals[pair * 2 + 1]
+
+            if start_line <= current_end + 1
+              current_end = end_line if end_line > current_end
+            else
+              merged << current_start << current_end
+              current_start = start_line
+              current_end = end_line
+            end
           end
+
+          merged << current_start << current_end
+
+          @intervals = merged
+          true
         end
 
         # Check if any line in the query interval overlaps with changed lines
@@ -74,13 +74,14 @@ module Datadog
 
           # Binary search for the first interval that might overlap
           left = 0
-          right = @intervals.length - 1
+          right = @intervals.length / 2 - 1
 
           while left <= right
             mid = (left + right) / 2
             # @type var interval_start: Integer
             # @type var interval_end: Integer
-            interval_start, interval_end = @intervals[mid]
+            interval_start = @intervals[mid * 2]
+            interval_end = @intervals[mid * 2 + 1]
 
             if interval_end < query_start
               left = mid + 1
@@ -95,13 +96,46 @@ module Datadog
           false
         end
 
+        # Checks many query intervals at once with a single sweep over the changed intervals
+        #
+        # @param queries [Array<Integer>] query intervals packed as [start_0, end_0, start_1, end_1, ...]
+        # @return [Array<Boolean>] whether each query interval overlaps with changed lines, in the order of queries
+        def overlaps_each(queries)
+          build! unless @built
+
+          queries_count = queries.size / 2
+          result = Array.new(queries_count, false)
+          return result if @intervals.empty?
+
+          order = (0...queries_count).sort_by { |query| queries[query * 2] }
+
+          # merged intervals have increasing ends: the first interval that does not end before
+          # the query start only moves forward as query starts grow
+          intervals_size = @intervals.size
+          position = 0
+
+          order.each do |query|
+            # @type var query_start: Integer
+            # @type var query_end: Integer
+            query_start = queries[query * 2]
+            query_end = queries[query * 2 + 1]
+
+            position += 2 while position < intervals_size && @intervals[position + 1] < query_start
+            break if position == intervals_size
+
+            result[query] = query_start <= query_end && @intervals[position] <= query_end
+          end
+
+          result
+        end
+
         def empty?
           @intervals.empty?
         end
 
         def intervals
           build! unless @built
-          @intervals.dup
+          @intervals.each_slice(2).to_a
         end
       end
     end
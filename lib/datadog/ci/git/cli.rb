@@ -59,6 +59,37 @@ module Datadog
           out
         end
 
+        # Execute a git command and yield its output in chunks while it runs
+        #
+        # Used for commands with potentially large output (e.g. git diff) that is parsed incrementally.
+        #
+        # @param cmd [Array<String>] The git command as an array of strings
+        # @param timeout [Integer] Timeout in seconds for the command execution
+        # @yieldparam chunk [String] Next binary chunk of the output, reused between calls
+        # @return [void]
+        # @raise [GitCommandExecutionError] If the command fails or times out
+        def self.stream_git_command(cmd, timeout: SHORT_TIMEOUT, &block)
+          # @type var out: String
+          # @type var status: Process::Status?
+          out, status = Utils::Command.stream_command(
+            ["git", "-c", "safe.directory=#{safe_directory}"] + cmd,
+            timeout: timeout,
+            &block
+          )
+
+          if status.nil? || !status.success?
+            cmd_str = cmd.join(" ")
+            raise GitCommandExecutionError.new(
+              "Failed to run git command [#{cmd_str}] with output [#{out}]. Status: #{status}",
+              output: out,
+              command: cmd_str,
+              status: status
+            )
+          end
+
+          nil
+        end
+
         # Returns the directory to use for git's safe.directory config.
         # This is cached to avoid repeated filesystem lookups.
         #
@@ -0,0 +1,169 @@
+# frozen_string_literal: true
+
+module Datadog
+  module CI
+    module Git
+      # Parser for git config files (.git/config, ~/.gitconfig)
+      #
+      # Supports the subset of the format used in practice: sections with optional subsections,
+      # quoted values with escape sequences, comments and line continuations.
+      # Files with include directives are not supported, the included files could override any value.
+      #
+      # @api private
+      class ConfigFile
+        class UnsupportedError < StandardError; end
+
+        SECTION_REGEX = /\A\[\s*(?<section>[A-Za-z0-9.-]+)(?:\s+"(?<subsection>(?:[^"\\]|\\.)*)")?\s*\]\s*(?:[#;].*)?\z/.freeze
+        KEY_REGEX = /\A(?<key>[A-Za-z][A-Za-z0-9-]*)\s*(?:=(?<value>.*))?\z/m.freeze
+        UNSUPPORTED_SECTIONS = %w[include includeif].freeze
+        ESCAPES = {"n" => "\n", "t" => "\t", "b" => "\b", "\\" => "\\", "\"" => "\""}.freeze
+
+        # @param path [String] Path of the config file
+        # @return [ConfigFile] parsed config, empty when the file does not exist
+        # @raise [UnsupportedError] if the file can't be parsed
+        def self.load(path)
+          return new({}) unless File.file?(path)
+
+          parse(File.read(path, mode: "rb").force_encoding(Encoding::UTF_8))
+        end
+
+        # @param content [String] Content of the config file
+        # @return [ConfigFile]
+        # @raise [UnsupportedError] if the content can't be parsed
+        def self.parse(content)
+          # Hash of "section.subsection.key" => values, section and key are case insensitive
+          entries = {}
+          section = nil
+
+          lines = content.lines
+          while (line = lines.shift)
+            line = line.strip
+            next if line.empty? || line.start_with?("#", ";")
+
+            if line.start_with?("[")
+              match = SECTION_REGEX.match(line)
+              raise UnsupportedError, "invalid section header: #{line}" if match.nil?
+
+              section_name = match[:section].to_s.downcase
+              raise UnsupportedError, "unsupported section: #{section_name}" if UNSUPPORTED_SECTIONS.include?(section_name)
+
+              subsection = match[:subsection]
+              section = subsection ? "#{section_name}.#{subsection.gsub(/\\(.)/, '\1')}" : section_name
+              next
+            end
+
+            raise UnsupportedError, "key outside of any section" if section.nil?
+
+            # values continue on the next line when the line ends with a backslash
+            line = "#{line[0...-1]}#{lines.shift&.chomp}" while line.end_with?("\\") && !line.end_with?("\\\\") && lines.any?
+
+            match = KEY_REGEX.match(line)
+            raise UnsupportedError, "invalid config line: #{line}" if match.nil?
+
+            # a key without value is a boolean true
+            raw_value = match[:value]
+            value = raw_value.nil? ? "true" : parse_value(raw_value)
+
+            (entries["#{section}.#{match[:key].to_s.downcase}"] ||= []) << value
+          end
+
+          new(entries)
+        end
+
+        def self.parse_value(raw_value)
+          value = +""
+          # length of the value without trailing whitespace that is not inside quotes
+          value_length = 0
+          quoted = false
+          chars = raw_value.each_char
+          loop do
+            char = chars.next
+
+            case char
+            when "\\"
+              escaped = ESCAPES[chars.next]
+              raise UnsupportedError, "invalid escape sequence in value: #{raw_value}" if escaped.nil?
+
+              value << escaped
+              value_length = value.length
+            when "\""
+              quoted = !quoted
+              value_length = value.length
+            when "#", ";"
+              break unless quoted
+
+              value << char
+              value_length = value.length
+            else
+              # leading whitespace is ignored, inner whitespace is kept
+              next if !quoted && value.empty? && char.match?(/\s/)
+
+              value << char
+              value_length = value.length if quoted || !char.match?(/\s/)
+            end
+          end
+          raise UnsupportedError, "unterminated quote in value: #{raw_value}" if quoted
+
+          value[0, value_length] || ""
+        end
+
+        def initialize(entries)
+          @entries = entries
+        end
+
+        # @param key [String] Full key: "section.key" or "section.subsection.key"
+        # @return [Array<String>] all values of the key in the order of the file
+        def get_all(key)
+          @entries.fetch(normalize_key(key), [])
+        end
+
+        # @param key [String] Full key: "section.key" or "section.subsection.key"
+        # @return [String, nil] the last value of the key, as git does for single-valued keys
+        def get(key)
+          get_all(key).last
+        end
+
+        # @param section [String] Section name
+        # @return [Array<String>] names of the subsections of the section, in the order of the file
+        def subsections(section)
+          prefix = "#{section.downcase}."
+          @entries.each_key.filter_map do |key|
+            next unless key.start_with?(prefix)
+
+            last_dot = key.rindex(".")
+            next if last_dot.nil? || last_dot <= prefix.size
+
+            key[prefix.size...last_dot]
+          end.uniq
+        end
+
+        # @return [Array<String>] all keys of the config, with lowercase section and key names
+        def keys
+          @entries.keys
+        end
+
+        # @param other [ConfigFile] Config with higher priority (e.g. local config over global config)
+        # @return [ConfigFile] config with values of both files, values of other come last
+        def merge(other)
+          entries = @entries.dup
+          other.entries.each { |key, values| entries[key] = (entries[key] || []) + values }
+          ConfigFile.new(entries)
+        end
+
+        protected
+
+        attr_reader :entries
+
+        private
+
+        def normalize_key(key)
+          first_dot = key.index(".")
+          last_dot = key.rindex(".")
+          return key.downcase if first_dot.nil? || last_dot.nil? || first_dot == last_dot
+
+          "#{key[0...first_dot].to_s.downcase}#{key[first_dot..last_dot]}#{key[(last_dot + 1)..].to_s.downcase}"
+        end
+      end
+    end
+  end
+end
@@ -1,6 +1,7 @@
 # frozen_string_literal: true
 
 require "set"
+require "strscan"
 require_relative "changed_lines"
 
 module Datadog
@@ -28,6 +29,11 @@ module Datadog
           changed_lines.overlaps?(start_line, end_line)
         end
 
+        # @return [ChangedLines, nil] changed lines of the file, nil when the file is not changed
+        def changed_lines(file_path)
+          @changed_files[file_path]
+        end
+
         def empty?
           @changed_files.empty?
         end
@@ -45,44 +51,126 @@ module Datadog
         def self.parse_diff_output(output)
           return new if output.nil? || output.empty?
 
-          changed_files = {}
-          current_file = nil
+          parser = StreamParser.new
+          parser << output
+          parser.finish
+        end
 
-          output.each_line do |line|
-            # Match lines like: diff --git a/foo/bar.rb b/foo/bar.rb
-            # This captures git changes on file level
-            match = FILE_CHANGE_REGEX.match(line)
-            if match && match[:file]
-              # this path here is already relative from the git root
-              changed_file = match[:file]
+        # Incremental parser of `git diff -U0` output.
+        #
+        # Output is fed in chunks of any size as it is read from git. Only file headers (diff --git a/...) and
+        # hunk headers (@@ -a,b +c,d @@) are parsed, the scanner jumps over the content lines between them.
+        # Only the incomplete last line of a chunk is kept until the next one arrives.
+        class StreamParser
+          HEADER_START_REGEX = /^(?=diff --git a\/|@@ )/.freeze
+          FILE_HEADER_PREFIX = "diff --git a/".b.freeze
+          HUNK_HEADER_PREFIX = "@@ ".b.freeze
+          FILE_NAME_END = " b/".b.freeze
+          NEWLINE = "\n".b.freeze
+
+          def initialize
+            @changed_files = {} # Hash of file_path => ChangedLines
+            @current_lines = nil
+            @pending = String.new(encoding: Encoding::BINARY)
+            @skip_line = false
+          end
+
+          # @param chunk [String] Next part of the git diff output
+          # @return [StreamParser] self
+          def <<(chunk)
+            @pending << chunk.b
 
-              unless changed_file.nil? || changed_file.empty?
-                current_file = changed_file
-                changed_files[current_file] ||= ChangedLines.new
+            if @skip_line
+              newline = @pending.index(NEWLINE)
+              if newline.nil?
+                @pending.clear
+                return self
               end
 
-              Datadog.logger.debug { "matched changed_file: #{changed_file} from git diff line: #{line}" }
+              @skip_line = false
+              @pending = @pending.byteslice(newline + 1, @pending.bytesize) || String.new(encoding: Encoding::BINARY)
+            end
+
+            scanner = StringScanner.new(@pending)
+            rest_start = nil
 
-              next
+            while scanner.skip_until(HEADER_START_REGEX)
+              line_start = scanner.pos
+              line_end = @pending.index(NEWLINE, line_start)
+
+              if line_end.nil?
+                rest_start = line_start
+                break
+              end
+
+              parse_header(@pending.byteslice(line_start, line_end - line_start))
+              scanner.pos = line_end + 1
             end
 
-            # Match lines like: @@ -1,2 +3,4 @@
-            match = LINES_CHANGE_REGEX.match(line)
-            if match && match[:start] && current_file
-              start_line = match[:start].to_i
+            rest_start ||= (last_newline = @pending.rindex(NEWLINE)) ? last_newline + 1 : 0
+            rest = @pending.byteslice(rest_start, @pending.bytesize - rest_start) || ""
+
+            # content lines can be arbitrarily long: don't keep them once it is clear they are not headers
+            if header_prefix?(rest)
+              @pending = rest
+            else
+              @pending = String.new(encoding: Encoding::BINARY)
+              @skip_line = true
+            end
+
+            self
+          end
 
-              line_count = 1 # Default to 1 line if count not specified
-              line_count = match[:count].to_i if match[:count]
+          # @return [Diff] Changed lines of all files in the parsed output
+          def finish
+            parse_header(@pending) unless @skip_line || @pending.empty?
+            @pending = String.new(encoding: Encoding::BINARY)
 
-              end_line = start_line + line_count - 1
+            @changed_files.each_value(&:build!)
+            Diff.new(changed_files: @changed_files)
+          end
 
-              changed_files[current_file].add_interval(start_line, end_line)
+          private
 
-              Datadog.logger.debug { "Added interval [#{start_line}, #{end_line}] for file: #{current_file}" }
+          def header_prefix?(rest)
+            if rest.bytesize < FILE_HEADER_PREFIX.bytesize
+              return true if FILE_HEADER_PREFIX.start_with?(rest) || HUNK_HEADER_PREFIX.start_with?(rest)
             end
+
+            rest.start_with?(FILE_HEADER_PREFIX) || rest.start_with?(HUNK_HEADER_PREFIX)
           end
 
-          new(changed_files: changed_files)
+          def parse_header(line)
+            if line.start_with?(FILE_HEADER_PREFIX)
+              # Lines like: diff --git a/foo/bar.rb b/foo/bar.rb
+              # this path here is already relative from the git root
+              name_end = line.index(FILE_NAME_END, FILE_HEADER_PREFIX.bytesize + 1)
+              return if name_end.nil?
+
+              changed_file = line.byteslice(FILE_HEADER_PREFIX.bytesize, name_end - FILE_HEADER_PREFIX.bytesize)
+              changed_file&.force_encoding(Encoding::UTF_8)
+              return if changed_file.nil? || changed_file.empty?
+
+              @current_lines = (@changed_files[changed_file] ||= ChangedLines.new)
+
+              Datadog.logger.debug { "matched changed_file: #{changed_file} from git diff" }
+              return
+            end
+
+            # Lines like: @@ -1,2 +3,4 @@
+            current_lines = @current_lines
+            return if current_lines.nil?
+
+            match = LINES_CHANGE_REGEX.match(line)
+            return if match.nil? || match[:start].nil?
+
+            start_line = match[:start].to_i
+
+            line_count = 1 # Default to 1 line if count not specified
+            line_count = match[:count].to_i if match[:count]
+
+            current_lines.add_interval(start_line, start_line + line_count - 1)
+          end
         end
       end
     end
@@ -9,6 +9,7 @@ require_relative "../utils/command"
 require_relative "base_branch_sha_detector"
 require_relative "cli"
 require_relative "diff"
+require_relative "repository_reader"
 require_relative "telemetry"
 require_relative "user"
 
@@ -94,7 +95,7 @@ module Datadog
           res = nil
 
           duration_ms = Core::Utils::Time.measure(:float_millisecond) do
-            res = CLI.exec_git_command(["ls-remote", "--get-url"])
+            res = read_repository_or_exec_git(["ls-remote", "--get-url"], &:remote_url)
           end
 
           Telemetry.git_command_ms(Ext::Telemetry::Command::GET_REPOSITORY, duration_ms)
@@ -106,14 +107,14 @@ module Datadog
         end
 
         def self.git_root
-          CLI.exec_git_command(["rev-parse", "--show-toplevel"])
+          read_repository_or_exec_git(["rev-parse", "--show-toplevel"], &:root)
         rescue => e
           log_failure(e, "git root path")
           nil
         end
 
         def self.git_commit_sha
-          CLI.exec_git_command(["rev-parse", "HEAD"])
+          read_repository_or_exec_git(["rev-parse", "HEAD"], &:head_sha)
         rescue => e
           log_failure(e, "git commit sha")
           nil
@@ -125,7 +126,7 @@ module Datadog
           res = nil
 
           duration_ms = Core::Utils::Time.measure(:float_millisecond) do
-            res = CLI.exec_git_command(["rev-parse", "--abbrev-ref", "HEAD"])
+            res = read_repository_or_exec_git(["rev-parse", "--abbrev-ref", "HEAD"], &:branch)
           end
 
           Telemetry.git_command_ms(Ext::Telemetry::Command::GET_BRANCH, duration_ms)
@@ -137,20 +138,30 @@ module Datadog
         end
 
         def self.git_tag
-          CLI.exec_git_command(["tag", "--points-at", "HEAD"])
+          read_repository_or_exec_git(["tag", "--points-at", "HEAD"], &:tags_pointing_at_head)
         rescue => e
           log_failure(e, "git tag")
           nil
         end
 
         def self.git_commit_message(commit_sha = nil)
-          CLI.exec_git_command(["log", "-n", "1", "--format=%B", commit_sha].compact)
+          read_repository_or_exec_git(["log", "-n", "1", "--format=%B", commit_sha].compact) do |reader|
+            reader.commit(commit_sha).message
+          end
         rescue => e
           log_failure(e, "git commit message")
           nil
         end
 
         def self.git_commit_users(commit_sha = nil)
+          commit = RepositoryReader.read { |reader| reader.commit(commit_sha) }
+          if commit
+            return [
+              User.new(commit.author_name, commit.author_email, commit.author_timestamp),
+              User.new(commit.committer_name, commit.committer_email, commit.committer_timestamp)
+            ]
+          end
+
           # Get committer and author information in one command.
           output = CLI.exec_git_command(["show", "-s", "--format=%an\t%ae\t%at\t%cn\t%ce\t%ct", commit_sha].compact)
           unless output
@@ -257,7 +268,8 @@ module Datadog
           res = false
 
           duration_ms = Core::Utils::Time.measure(:float_millisecond) do
-            res = CLI.exec_git_command(["rev-parse", "--is-shallow-repository"]) == "true"
+            res = RepositoryReader.read(&:shallow?)
+            res = CLI.exec_git_command(["rev-parse", "--is-shallow-repository"]) == "true" if res.nil?
           end
           Telemetry.git_command_ms(Ext::Telemetry::Command::CHECK_SHALLOW, duration_ms)
 
@@ -353,21 +365,19 @@ module Datadog
           Telemetry.git_command(Ext::Telemetry::Command::DIFF)
 
           begin
-            # 1. Run the git diff command
-
-            # @type var output: String?
-            output = nil
+            # Run the git diff command and parse its output while it is being read
+            parser = Diff::StreamParser.new
             duration_ms = Core::Utils::Time.measure(:float_millisecond) do
-              output = CLI.exec_git_command(["diff", "-U0", "--word-diff=porcelain", base_commit, "HEAD"], timeout: CLI::LONG_TIMEOUT)
+              CLI.stream_git_command(["diff", "-U0", "--word-diff=porcelain", base_commit, "HEAD"], timeout: CLI::LONG_TIMEOUT) do |chunk|
+                parser << chunk
+              end
             end
             Telemetry.git_command_ms(Ext::Telemetry::Command::DIFF, duration_ms)
 
-            Datadog.logger.debug { "git diff output: #{output}" }
-
-            return Diff.new if output.nil?
+            diff = parser.finish
+            Datadog.logger.debug { "git diff changed files count: #{diff.size}" }
 
-            # 2. Parse the output using Git::Diff
-            Diff.parse_diff_output(output)
+            diff
           rescue => e
             Telemetry.track_error(e, Ext::Telemetry::Command::DIFF)
             log_failure(e, "get changed files from diff")
@@ -388,7 +398,7 @@ module Datadog
         end
 
         def self.get_upstream_branch
-          CLI.exec_git_command(["rev-parse", "--abbrev-ref", "--symbolic-full-name", "@{upstream}"])
+          read_repository_or_exec_git(["rev-parse", "--abbrev-ref", "--symbolic-full-name", "@{upstream}"], &:upstream_branch)
         rescue => e
           Datadog.logger.debug { "Error getting upstream: #{e}" }
           nil
@@ -401,12 +411,21 @@ module Datadog
             upstream.split("/").first
           else
             # Fallback to first remote if no upstream is set
-            first_remote_value = CLI.exec_git_command(["remote"])&.split("\n")&.first
+            first_remote_value = read_repository_or_exec_git(["remote"], &:remotes)&.split("\n")&.first
             Datadog.logger.debug { "First remote value: '#{first_remote_value}'" }
             first_remote_value || "origin"
           end
         end
 
+        # Reads the value directly from the .git directory, runs the git command only if the reader can't answer.
+        # The reader returns an empty string when git would have no output, which is nil as for the git command.
+        def self.read_repository_or_exec_git(cmd, &block)
+          res = RepositoryReader.read(&block)
+          return CLI.exec_git_command(cmd) if res.nil?
+
+          res.empty? ? nil : res
+        end
+
         def self.filter_invalid_commits(commits)
           commits.filter { |commit| Utils::Git.valid_commit_sha?(commit) }
         end
@@ -0,0 +1,234 @@
+# frozen_string_literal: true
+
+require "zlib"
+
+module Datadog
+  module CI
+    module Git
+      # Reads objects (commits, tags) from the object database of a git repository: loose objects and packfiles
+      # with version 2 indexes, including deltified objects.
+      #
+      # @api private
+      class ObjectStore
+        class UnsupportedError < StandardError; end
+
+        OBJECT_TYPES = {1 => "commit", 2 => "tree", 3 => "blob", 4 => "tag"}.freeze
+        OFS_DELTA = 6
+        REF_DELTA = 7
+
+        INDEX_SIGNATURE = "\xFFtOc".b.freeze
+        INDEX_VERSION = 2
+        INDEX_HEADER_SIZE = 8
+        FANOUT_SIZE = 256 * 4
+        SHA_SIZE = 20
+        LARGE_OFFSET_FLAG = 0x80000000
+
+        ENTRY_HEADER_MAX_SIZE = 32
+        INFLATE_CHUNK_SIZE = 8 * 1024
+
+        def initialize(objects_dir)
+          @objects_dir = objects_dir
+          @packs = nil
+        end
+
+        # @param sha [String] Hex SHA-1 of the object
+        # @return [Array(String, String)] type and binary content of the object
+        # @raise [UnsupportedError] if the object is not found or can't be read
+        def read(sha)
+          raise UnsupportedError, "invalid object id: #{sha}" unless sha.match?(/\A[0-9a-f]{40}\z/)
+
+          read_loose(sha) || read_packed(sha) || raise(UnsupportedError, "object #{sha} not found")
+        end
+
+        private
+
+        def read_loose(sha)
+          path = File.join(@objects_dir, sha[0, 2], sha[2..])
+          return nil unless File.file?(path)
+
+          data = Zlib::Inflate.inflate(File.binread(path))
+          header_end = data.index("\0")
+          raise UnsupportedError, "invalid loose object #{sha}" if header_end.nil?
+
+          type, size = data.byteslice(0, header_end).to_s.split(" ")
+          content = data.byteslice(header_end + 1, data.bytesize) || ""
+          raise UnsupportedError, "invalid loose object #{sha}" if type.nil? || content.bytesize != size.to_i
+
+          [type, content]
+        end
+
+        def read_packed(sha)
+          binary_sha = [sha].pack("H*")
+
+          packs.each do |index_path, pack_path|
+            offset = find_in_index(index_path, binary_sha)
+            next if offset.nil?
+
+            return File.open(pack_path, "rb") { |pack| read_pack_entry(pack, offset) }
+          end
+
+          nil
+        end
+
+        def packs
+          @packs ||= Dir.glob(File.join(@objects_dir, "pack", "*.idx")).sort.filter_map do |index_path|
+            pack_path = index_path.sub(/\.idx\z/, ".pack")
+            [index_path, pack_path] if File.file?(pack_path)
+          end
+        end
+
+        # Binary search of the object in a version 2 pack index
+        def find_in_index(index_path, binary_sha)
+          File.open(index_path, "rb") do |index|
+            header = index.pread(INDEX_HEADER_SIZE, 0)
+            signature, version = header.unpack("a4N")
+            if signature != INDEX_SIGNATURE || version != INDEX_VERSION
+              raise UnsupportedError, "unsupported pack index #{index_path}"
+            end
+
+            fanout = index.pread(FANOUT_SIZE, INDEX_HEADER_SIZE).unpack("N256")
+            objects_count = fanout[255]
+            first_byte = binary_sha.getbyte(0).to_i
+
+            low = (first_byte == 0) ? 0 : fanout[first_byte - 1]
+            high = fanout[first_byte] - 1
+            shas_start = INDEX_HEADER_SIZE + FANOUT_SIZE
+
+            while low <= high
+              middle = (low + high) / 2
+              candidate = index.pread(SHA_SIZE, shas_start + middle * SHA_SIZE)
+
+              case candidate <=> binary_sha
+              when -1 then low = middle + 1
+              when 1 then high = middle - 1
+              else
+                offsets_start = shas_start + objects_count * (SHA_SIZE + 4)
+                offset = index.pread(4, offsets_start + middle * 4).unpack1("N")
+                return offset if offset & LARGE_OFFSET_FLAG == 0
+
+                large_offsets_start = offsets_start + objects_count * 4
+                return index.pread(8, large_offsets_start + (offset & ~LARGE_OFFSET_FLAG) * 8).unpack1("Q>")
+              end
+            end
+          end
+
+          nil
+        end
+
+        def read_pack_entry(pack, offset)
+          header = pack.pread(ENTRY_HEADER_MAX_SIZE, offset)
+
+          byte = header.getbyte(0).to_i
+          type = (byte >> 4) & 0x7
+          size = byte & 0x0F
+          shift = 4
+          position = 1
+          while byte & 0x80 != 0
+            byte = header.getbyte(position).to_i
+            position += 1
+            size |= (byte & 0x7F) << shift
+            shift += 7
+          end
+
+          case type
+          when OFS_DELTA
+            byte = header.getbyte(position).to_i
+            position += 1
+            base_distance = byte & 0x7F
+            while byte & 0x80 != 0
+              byte = header.getbyte(position).to_i
+              position += 1
+              base_distance = ((base_distance + 1) << 7) | (byte & 0x7F)
+            end
+
+            base_type, base = read_pack_entry(pack, offset - base_distance)
+            [base_type, apply_delta(base, inflate(pack, offset + position, size))]
+          when REF_DELTA
+            base_sha = header.byteslice(position, SHA_SIZE).to_s.unpack1("H*")
+            base_type, base = read(base_sha)
+            [base_type, apply_delta(base, inflate(pack, offset + position + SHA_SIZE, size))]
+          else
+            type_name = OBJECT_TYPES[type]
+            raise UnsupportedError, "unknown pack object type #{type}" if type_name.nil?
+
+            [type_name, inflate(pack, offset + position, size)]
+          end
+        end
+
+        def inflate(pack, offset, size)
+          inflater = Zlib::Inflate.new
+          data = String.new(capacity: size, encoding: Encoding::BINARY)
+
+          until inflater.finished?
+            chunk = pack.pread(INFLATE_CHUNK_SIZE, offset)
+            offset += chunk.bytesize
+            data << inflater.inflate(chunk)
+          end
+          raise UnsupportedError, "corrupted pack object" if data.bytesize != size
+
+          data
+        ensure
+          inflater&.close
+        end
+
+        def apply_delta(base, delta)
+          position = 0
+          base_size, position = read_delta_size(delta, position)
+          result_size, position = read_delta_size(delta, position)
+          raise UnsupportedError, "delta base size mismatch" if base_size != base.bytesize
+
+          result = String.new(capacity: result_size, encoding: Encoding::BINARY)
+
+          while position < delta.bytesize
+            instruction = delta.getbyte(position).to_i
+            position += 1
+
+            if instruction & 0x80 != 0
+              # copy from the base: offset and size bytes are present when their bit is set
+              copy_offset = 0
+              copy_size = 0
+              4.times do |i|
+                next if instruction & (1 << i) == 0
+
+                copy_offset |= delta.getbyte(position).to_i << (8 * i)
+                position += 1
+              end
+              3.times do |i|
+                next if instruction & (0x10 << i) == 0
+
+                copy_size |= delta.getbyte(position).to_i << (8 * i)
+                position += 1
+              end
+              copy_size = 0x10000 if copy_size == 0
+
+              result << base.byteslice(copy_offset, copy_size).to_s
+            elsif instruction != 0
+              # insert the next bytes of the delta
+              result << delta.byteslice(position, instruction).to_s
+              position += instruction
+            else
+              raise UnsupportedError, "invalid delta instruction"
+            end
+          end
+          raise UnsupportedError, "delta result size mismatch" if result.bytesize != result_size
+
+          result
+        end
+
+        def read_delta_size(delta, position)
+          size = 0
+          shift = 0
+          loop do
+            byte = delta.getbyte(position).to_i
+            position += 1
+            size |= (byte & 0x7F) << shift
+            shift += 7
+            break if byte & 0x80 == 0
+          end
+
+          [size, position]
+        end
+      end
+    end
+  end
+end
@@ -48,14 +48,16 @@ module Datadog
               break
             end
 
-            packfiles.each do |packfile_name|
+            packfile_paths = packfiles.filter_map do |packfile_name|
               next unless packfile_name.start_with?(prefix)
               next unless packfile_name.end_with?(".pack")
 
-              packfile_path = File.join(tmpdir, packfile_name)
-
-              yield packfile_path
+              File.join(tmpdir, packfile_name)
             end
+
+            # all paths are yielded at once: packfiles are removed when the block returns,
+            # the caller can upload them concurrently meanwhile
+            yield packfile_paths.sort unless packfile_paths.empty?
           end
         rescue => e
           Datadog.logger.debug("Packfiles could not be generated, error: #{e}")
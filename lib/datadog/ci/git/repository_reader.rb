@@ -0,0 +1,454 @@
+# frozen_string_literal: true
+
+require_relative "config_file"
+require_relative "object_store"
+
+module Datadog
+  module CI
+    module Git
+      # Reads repository metadata (HEAD, refs, tags, remotes, commits) directly from the .git directory,
+      # without spawning git processes.
+      #
+      # Only repository layouts and features that are fully understood are read: whenever something can't be parsed
+      # or could change the answer of git (include directives, url rewrites, replace refs, reftable...),
+      # UnsupportedError is raised and the caller falls back to the git CLI.
+      #
+      # Methods return nil or "" when git would have no output for the same command.
+      #
+      # @api private
+      class RepositoryReader
+        class UnsupportedError < StandardError; end
+
+        Commit = Struct.new(
+          :author_name,
+          :author_email,
+          :author_timestamp,
+          :committer_name,
+          :committer_email,
+          :committer_timestamp,
+          :message,
+          keyword_init: true
+        )
+
+        SHA_REGEX = /\A[0-9a-f]{40}\z/.freeze
+        SYMBOLIC_REF_PREFIX = "ref: "
+        GITDIR_FILE_PREFIX = "gitdir: "
+        MAX_SYMBOLIC_REF_DEPTH = 5
+        # environment variables that change how git finds the repository, its config or its objects
+        UNSUPPORTED_ENV_VARIABLES = %w[
+          GIT_COMMON_DIR GIT_OBJECT_DIRECTORY GIT_ALTERNATE_OBJECT_DIRECTORIES GIT_CEILING_DIRECTORIES
+          GIT_CONFIG GIT_CONFIG_COUNT GIT_CONFIG_PARAMETERS GIT_NAMESPACE GIT_REPLACE_REF_BASE
+        ].freeze
+        # git resolves short ref names with these rules, see `git help revisions`
+        AMBIGUOUS_REF_RULES = %w[%s refs/%s refs/tags/%s refs/heads/%s refs/remotes/%s refs/remotes/%s/HEAD].freeze
+        # refs that belong to a worktree, other refs are shared by all worktrees in the common directory
+        PER_WORKTREE_REF_PREFIXES = %w[refs/bisect/ refs/worktree/ refs/rewritten/].freeze
+
+        # Runs the block with a reader for the current repository.
+        #
+        # @return [Object, nil] result of the block, nil if the repository can't be read directly
+        def self.read
+          reader = current
+          return nil if reader.nil?
+
+          yield reader
+        rescue => e
+          Datadog.logger.debug { "Unable to read git repository files, using git CLI instead: #{e.class} #{e.message}" }
+          nil
+        end
+
+        # @return [RepositoryReader, nil] reader for the repository of the current directory, nil if not found
+        def self.current
+          return nil if UNSUPPORTED_ENV_VARIABLES.any? { |name| ENV.key?(name) }
+
+          git_dir = ENV["GIT_DIR"]
+          if git_dir
+            work_tree = ENV["GIT_WORK_TREE"]
+            return nil if work_tree.nil?
+
+            return new(git_dir: File.expand_path(git_dir), work_tree: File.expand_path(work_tree))
+          end
+          return nil if ENV.key?("GIT_WORK_TREE")
+
+          current_dir = Dir.pwd
+          loop do
+            dot_git = File.join(current_dir, ".git")
+            if File.directory?(dot_git)
+              return new(git_dir: dot_git, work_tree: current_dir)
+            elsif File.file?(dot_git)
+              # worktrees and submodules: .git file points to the actual git directory
+              content = File.read(dot_git).strip
+              return nil unless content.start_with?(GITDIR_FILE_PREFIX)
+
+              return new(git_dir: File.expand_path(content[GITDIR_FILE_PREFIX.size..].to_s, current_dir), work_tree: current_dir)
+            end
+
+            parent_dir = File.dirname(current_dir)
+            return nil if parent_dir == current_dir
+
+            current_dir = parent_dir
+          end
+        end
+
+        attr_reader :git_dir, :common_dir
+
+        def initialize(git_dir:, work_tree:)
+          @git_dir = git_dir
+          @work_tree = work_tree
+
+          commondir_file = File.join(git_dir, "commondir")
+          @common_dir = if File.file?(commondir_file)
+            File.expand_path(File.read(commondir_file).strip, git_dir)
+          else
+            git_dir
+          end
+
+          @config = nil
+          @packed_refs = nil
+          @object_store = nil
+        end
+
+        # @return [String] absolute path of the working tree, same as `git rev-parse --show-toplevel`
+        def root
+          config
+          File.realpath(@work_tree)
+        end
+
+        # @return [String] SHA of the HEAD commit, same as `git rev-parse HEAD`
+        def head_sha
+          resolve_ref("HEAD") || raise(UnsupportedError, "HEAD can't be resolved")
+        end
+
+        # @return [String] current branch name or "HEAD" when detached, same as `git rev-parse --abbrev-ref HEAD`
+        def branch
+          head_ref = symbolic_head
+          return "HEAD" if head_ref.nil?
+
+          raise UnsupportedError, "HEAD points to #{head_ref}" unless head_ref.start_with?("refs/heads/")
+          # unborn branch: git fails
+          raise UnsupportedError, "#{head_ref} can't be resolved" if resolve_ref(head_ref).nil?
+
+          short_ref_name(head_ref, "refs/heads/")
+        end
+
+        # @return [String] names of the tags pointing at HEAD separated by new lines, same as `git tag --points-at HEAD`
+        def tags_pointing_at_head
+          check_default_tag_sort!
+
+          sha = head_sha
+          peeled_packed_tags = packed_refs_fully_peeled?
+
+          tags = refs_with_prefix("refs/tags/").filter_map do |ref_name, (target, peeled, packed)|
+            next ref_name.delete_prefix("refs/tags/") if target == sha || peeled == sha
+            # packed refs list the peeled commit of annotated tags
+            next if packed && peeled_packed_tags
+
+            type, content = object_store.read(target)
+            next unless type == "tag"
+
+            ref_name.delete_prefix("refs/tags/") if content.start_with?("object #{sha}\n")
+          end
+
+          # git sorts tags by refname byte by byte unless tag.sort is configured
+          tags.sort.join("\n")
+        end
+
+        # @param sha [String, nil] Commit SHA, HEAD when nil
+        # @return [Commit] commit read from the object database
+        def commit(sha = nil)
+          check_no_replace_refs!
+          sha ||= head_sha
+          raise UnsupportedError, "unsupported revision #{sha}" unless sha.match?(SHA_REGEX)
+
+          type, content = object_store.read(sha)
+          raise UnsupportedError, "#{sha} is a #{type}" unless type == "commit"
+
+          parse_commit(content)
+        end
+
+        # @return [String, nil] URL of the default remote, same as `git ls-remote --get-url`
+        def remote_url
+          check_no_url_rewrites!
+
+          remote = nil
+          head_ref = symbolic_head
+          remote = config.get("branch.#{head_ref.delete_prefix("refs/heads/")}.remote") if head_ref&.start_with?("refs/heads/")
+          remote ||= "origin"
+
+          url = config.get_all("remote.#{remote}.url").first
+          raise UnsupportedError, "remote #{remote} has no url" if url.nil?
+
+          url
+        end
+
+        # @return [String] remote names separated by new lines, same as `git remote`
+        def remotes
+          check_no_legacy_remotes!
+
+          config.subsections("remote").sort.join("\n")
+        end
+
+        # @return [String] upstream of the current branch (e.g. "origin/main") or "" if there is none,
+        #   same as `git rev-parse --abbrev-ref --symbolic-full-name @{upstream}`
+        def upstream_branch
+          head_ref = symbolic_head
+          return "" if head_ref.nil? || !head_ref.start_with?("refs/heads/")
+
+          branch_name = head_ref.delete_prefix("refs/heads/")
+          remote = config.get("branch.#{branch_name}.remote")
+          merge_ref = config.get("branch.#{branch_name}.merge")
+          return "" if remote.nil? || merge_ref.nil?
+          raise UnsupportedError, "upstream is a local branch" if remote == "."
+
+          tracking_ref = config.get_all("remote.#{remote}.fetch").filter_map do |refspec|
+            map_refspec(refspec, merge_ref)
+          end.first
+          return "" if tracking_ref.nil? || resolve_ref(tracking_ref).nil?
+          raise UnsupportedError, "unsupported tracking ref #{tracking_ref}" unless tracking_ref.start_with?("refs/remotes/")
+
+          short_ref_name(tracking_ref, "refs/remotes/")
+        end
+
+        # @return [Boolean] true if the repository is a shallow clone, same as `git rev-parse --is-shallow-repository`
+        def shallow?
+          config
+          File.exist?(File.join(@common_dir, "shallow"))
+        end
+
+        private
+
+        # repository config merged with the user's global config, raises when the repository format is not supported
+        def config
+          return @config if @config
+
+          repository_config = ConfigFile.load(File.join(@common_dir, "config"))
+          if repository_config.get("core.repositoryformatversion").to_i > 1 ||
+              repository_config.keys.any? { |key| key.start_with?("extensions.") }
+            raise UnsupportedError, "unsupported repository format"
+          end
+          if repository_config.get("core.bare") == "true" || repository_config.get("core.worktree")
+            raise UnsupportedError, "unsupported working tree configuration"
+          end
+
+          @config = global_config.merge(repository_config)
+        end
+
+        def global_config
+          paths = []
+          paths << "/etc/gitconfig" unless ENV.key?("GIT_CONFIG_NOSYSTEM")
+
+          if ENV["GIT_CONFIG_GLOBAL"]
+            paths << ENV["GIT_CONFIG_GLOBAL"]
+          else
+            xdg_config_home = ENV["XDG_CONFIG_HOME"]
+            home = ENV["HOME"]
+            if xdg_config_home && !xdg_config_home.empty?
+              paths << File.join(xdg_config_home, "git", "config")
+            elsif home
+              paths << File.join(home, ".config", "git", "config")
+            end
+            paths << File.join(home, ".gitconfig") if home
+          end
+
+          paths.reduce(ConfigFile.new({})) { |result, path| result.merge(ConfigFile.load(path)) }
+        end
+
+        def object_store
+          @object_store ||= ObjectStore.new(File.join(@common_dir, "objects"))
+        end
+
+        # @return [String, nil] ref HEAD points to, nil when HEAD is detached
+        def symbolic_head
+          content = File.read(File.join(@git_dir, "HEAD")).strip
+          return nil unless content.start_with?(SYMBOLIC_REF_PREFIX)
+
+          content[SYMBOLIC_REF_PREFIX.size..].to_s.strip
+        end
+
+        # @return [String, nil] SHA the ref points to, nil if the ref does not exist
+        def resolve_ref(ref_name, depth = 0)
+          raise UnsupportedError, "too many levels of symbolic refs" if depth > MAX_SYMBOLIC_REF_DEPTH
+
+          loose_ref_path = File.join(ref_directory(ref_name), ref_name)
+          if File.file?(loose_ref_path)
+            content = File.read(loose_ref_path).strip
+            return resolve_ref(content[SYMBOLIC_REF_PREFIX.size..].to_s.strip, depth + 1) if content.start_with?(SYMBOLIC_REF_PREFIX)
+            raise UnsupportedError, "invalid ref #{ref_name}" unless content.match?(SHA_REGEX)
+
+            return content
+          end
+
+          packed_refs.dig(ref_name, 0)
+        end
+
+        def ref_directory(ref_name)
+          if ref_name == "HEAD" || !ref_name.include?("/") || PER_WORKTREE_REF_PREFIXES.any? { |prefix| ref_name.start_with?(prefix) }
+            @git_dir
+          else
+            @common_dir
+          end
+        end
+
+        # @return [Hash<String, Array(String, String?, Boolean)>] refs with the prefix: name => [sha, peeled sha, packed]
+        def refs_with_prefix(prefix)
+          refs = {}
+          packed_refs.each do |ref_name, (sha, peeled)|
+            refs[ref_name] = [sha, peeled, true] if ref_name.start_with?(prefix)
+          end
+
+          # loose refs take precedence over packed refs
+          Dir.glob("**/*", base: File.join(@common_dir, prefix)).each do |relative_path|
+            ref_name = "#{prefix}#{relative_path}"
+            next unless File.file?(File.join(@common_dir, ref_name))
+
+            sha = resolve_ref(ref_name)
+            refs[ref_name] = [sha, nil, false] if sha
+          end
+
+          refs
+        end
+
+        # @return [Hash<String, Array(String, String?)>] packed refs: name => [sha, peeled sha]
+        def packed_refs
+          return @packed_refs if @packed_refs
+
+          @packed_refs = {}
+          @packed_refs_fully_peeled = false
+
+          path = File.join(@common_dir, "packed-refs")
+          return @packed_refs unless File.file?(path)
+
+          last_ref = nil
+          File.foreach(path) do |line|
+            line = line.chomp
+
+            if line.start_with?("#")
+              @packed_refs_fully_peeled = line.include?(" fully-peeled") || line.include?(" peeled")
+            elsif line.start_with?("^")
+              raise UnsupportedError, "invalid packed-refs file" if last_ref.nil?
+
+              last_ref[1] = line[1..]
+            else
+              sha, ref_name = line.split(" ", 2)
+              raise UnsupportedError, "invalid packed-refs file" if sha.nil? || ref_name.nil? || !sha.match?(SHA_REGEX)
+
+              last_ref = @packed_refs[ref_name] = [sha, nil]
+            end
+          end
+
+          @packed_refs
+        end
+
+        def packed_refs_fully_peeled?
+          packed_refs
+          @packed_refs_fully_peeled
+        end
+
+        # Shortens the ref as git does, raising when the short name would be ambiguous
+        def short_ref_name(ref_name, prefix)
+          short_name = ref_name.delete_prefix(prefix)
+
+          ambiguous = AMBIGUOUS_REF_RULES.any? do |rule|
+            candidate = format(rule, short_name)
+            next false if candidate == ref_name
+
+            File.file?(File.join(ref_directory(candidate), candidate)) || packed_refs.key?(candidate)
+          end
+          raise UnsupportedError, "ambiguous ref name #{short_name}" if ambiguous
+
+          short_name
+        end
+
+        # Maps the ref through a fetch refspec like +refs/heads/*:refs/remotes/origin/*
+        def map_refspec(refspec, ref_name)
+          raise UnsupportedError, "unsupported refspec #{refspec}" if refspec.start_with?("^")
+
+          source, destination = refspec.delete_prefix("+").split(":", 2)
+          return nil if source.nil? || destination.nil? || destination.empty?
+
+          unless source.include?("*")
+            return (source == ref_name) ? destination : nil
+          end
+
+          source_prefix, source_suffix = source.split("*", 2)
+          destination_prefix, destination_suffix = destination.split("*", 2)
+          return nil if source_prefix.nil? || source_suffix.nil? || destination_prefix.nil? || destination_suffix.nil?
+          return nil unless ref_name.start_with?(source_prefix) && ref_name.end_with?(source_suffix)
+
+          matched = ref_name[source_prefix.size...(ref_name.size - source_suffix.size)]
+          "#{destination_prefix}#{matched}#{destination_suffix}"
+        end
+
+        def parse_commit(content)
+          headers_end = content.index("\n\n")
+          headers = headers_end ? content.byteslice(0, headers_end).to_s : content
+          message = headers_end ? content.byteslice(headers_end + 2, content.bytesize).to_s : ""
+
+          author = nil
+          committer = nil
+          headers.each_line(chomp: true) do |line|
+            if line.start_with?("author ")
+              author = parse_identity(line.delete_prefix("author "))
+            elsif line.start_with?("committer ")
+              committer = parse_identity(line.delete_prefix("committer "))
+            elsif line.start_with?("encoding ")
+              encoding = line.delete_prefix("encoding ").strip
+              raise UnsupportedError, "unsupported commit encoding #{encoding}" unless encoding.casecmp?("utf-8")
+            end
+          end
+          raise UnsupportedError, "commit without author or committer" if author.nil? || committer.nil?
+
+          Commit.new(
+            author_name: author[0],
+            author_email: author[1],
+            author_timestamp: author[2],
+            committer_name: committer[0],
+            committer_email: committer[1],
+            committer_timestamp: committer[2],
+            message: message.force_encoding(Encoding::UTF_8).strip
+          )
+        end
+
+        # Parses "Name <email> timestamp timezone"
+        def parse_identity(identity)
+          email_start = identity.index("<")
+          email_end = identity.index(">", email_start.to_i)
+          raise UnsupportedError, "invalid identity #{identity}" if email_start.nil? || email_end.nil?
+
+          name = identity[0...email_start].to_s.strip.force_encoding(Encoding::UTF_8)
+          email = identity[(email_start + 1)...email_end].to_s.force_encoding(Encoding::UTF_8)
+          timestamp = identity[(email_end + 1)..].to_s.strip.split(" ").first.to_s
+
+          [name, email, timestamp]
+        end
+
+        def check_no_replace_refs!
+          replace_refs_dir = File.join(@common_dir, "refs", "replace")
+          replaced = (File.directory?(replace_refs_dir) && !Dir.empty?(replace_refs_dir)) ||
+            packed_refs.each_key.any? { |ref_name| ref_name.start_with?("refs/replace/") } ||
+            File.exist?(File.join(@common_dir, "info", "grafts"))
+          raise UnsupportedError, "repository has replaced commits" if replaced
+        end
+
+        def check_no_url_rewrites!
+          rewrites = config.keys.any? do |key|
+            key.start_with?("url.") && (key.end_with?(".insteadof") || key.end_with?(".pushinsteadof"))
+          end
+          raise UnsupportedError, "repository config rewrites urls" if rewrites
+        end
+
+        def check_default_tag_sort!
+          raise UnsupportedError, "repository config sets tag.sort" if config.get("tag.sort")
+        end
+
+        def check_no_legacy_remotes!
+          legacy_remotes = %w[remotes branches].any? do |dir_name|
+            dir = File.join(@common_dir, dir_name)
+            File.directory?(dir) && !Dir.empty?(dir)
+          end
+          raise UnsupportedError, "repository has legacy remotes" if legacy_remotes
+        end
+      end
+    end
+  end
+end
@@ -7,14 +7,19 @@ require_relative "local_repository"
 require_relative "search_commits"
 require_relative "upload_packfile"
 require_relative "packfiles"
+require_relative "uploaded_commits_cache"
 
 require_relative "../ext/telemetry"
 require_relative "../utils/telemetry"
+require_relative "../worker"
 
 module Datadog
   module CI
     module Git
       class TreeUploader
+        # packfiles are uploaded concurrently, up to the number of connections kept alive by the HTTP adapter
+        MAX_CONCURRENT_UPLOADS = 4
+
         attr_reader :api, :force_unshallow
 
         def initialize(api:, force_unshallow: false)
@@ -47,9 +52,15 @@ module Datadog
             return
           end
 
+          uploaded_commits_cache = UploadedCommitsCache.for_repository(repository_url, api.backend_id)
+
           begin
             # ask the backend for the list of commits it already has
-            known_commits, new_commits = fetch_known_commits_and_split(repository_url, latest_commits)
+            known_commits, new_commits = fetch_known_commits_and_split(
+              repository_url,
+              latest_commits,
+              uploaded_commits_cache
+            )
             # if all commits are present in the backend, we don't need to upload anything
 
             # We optimize unshallowing process by checking the latest available commits with backend:
@@ -69,7 +80,8 @@ module Datadog
               # re-run the search with the updated commit list after unshallowing
               known_commits, new_commits = fetch_known_commits_and_split(
                 repository_url,
-                LocalRepository.git_commits
+                LocalRepository.git_commits,
+                uploaded_commits_cache
               )
             end
           rescue SearchCommits::ApiError => e
@@ -84,15 +96,15 @@ module Datadog
             repository_url: repository_url
           )
           packfiles_count = 0
-          Packfiles.generate(included_commits: new_commits, excluded_commits: known_commits) do |filepath|
-            packfiles_count += 1
-            uploader.call(filepath: filepath)
-          rescue UploadPackfile::ApiError => e
-            Datadog.logger.debug("Packfile upload failed with #{e}")
-            break
+          uploaded = false
+          Packfiles.generate(included_commits: new_commits, excluded_commits: known_commits) do |filepaths|
+            packfiles_count = filepaths.size
+            uploaded = upload_packfiles(uploader, filepaths)
           end
 
           Utils::Telemetry.distribution(Ext::Telemetry::METRIC_GIT_REQUESTS_OBJECT_PACK_FILES, packfiles_count.to_f)
+
+          uploaded_commits_cache&.add(new_commits) if uploaded
         ensure
           Datadog.logger.debug("Git tree upload finished")
         end
@@ -100,13 +112,62 @@ module Datadog
         private
 
         # Split the latest commits list into known and new commits
-        # based on the backend response provided by /search_commits endpoint
-        def fetch_known_commits_and_split(repository_url, latest_commits)
-          Datadog.logger.debug { "Checking the latest commits list with backend: #{latest_commits}" }
-          backend_commits = SearchCommits.new(api: api).call(repository_url, latest_commits)
+        # based on the backend response provided by /search_commits endpoint.
+        #
+        # Commits found in the uploaded commits cache are known without asking the backend.
+        def fetch_known_commits_and_split(repository_url, latest_commits, uploaded_commits_cache)
+          commits_to_search = latest_commits.reject { |commit| uploaded_commits_cache&.include?(commit) }
+
+          backend_commits =
+            if commits_to_search.empty?
+              Datadog.logger.debug("All latest commits are in the uploaded commits cache, skipping commits search")
+              []
+            else
+              Datadog.logger.debug { "Checking the latest commits list with backend: #{commits_to_search}" }
+              SearchCommits.new(api: api).call(repository_url, commits_to_search)
+            end
+
+          uploaded_commits_cache&.add(commits_to_search.select { |commit| backend_commits.include?(commit) })
+
           latest_commits.partition do |commit|
-            backend_commits.include?(commit)
+            backend_commits.include?(commit) || uploaded_commits_cache&.include?(commit)
+          end
+        end
+
+        # Packfiles are independent from each other: they are uploaded concurrently, each one streamed from disk.
+        # Returns true if all packfiles were uploaded.
+        def upload_packfiles(uploader, filepaths)
+          queue = Queue.new
+          filepaths.each { |filepath| queue << filepath }
+          queue.close
+
+          concurrency = [MAX_CONCURRENT_UPLOADS, filepaths.size].min
+          errors =
+            if concurrency <= 1
+              [upload_packfiles_from_queue(uploader, queue)]
+            else
+              workers = Array.new(concurrency) { Worker.new { upload_packfiles_from_queue(uploader, queue) } }
+              workers.each(&:perform)
+              workers.each(&:wait_until_done)
+              workers.map { |worker| worker.error || worker.result }
+            end
+
+          error = errors.compact.first
+          return true if error.nil?
+
+          Datadog.logger.debug("Packfile upload failed with #{error}")
+          false
+        end
+
+        def upload_packfiles_from_queue(uploader, queue)
+          while (filepath = queue.pop)
+            uploader.call(filepath: filepath)
           end
+          nil
+        rescue UploadPackfile::ApiError => e
+          # the remaining packfiles are not uploaded after a failure
+          queue.clear
+          e
         end
 
         def test_tracing_component
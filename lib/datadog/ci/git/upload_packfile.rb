@@ -5,6 +5,7 @@ require "securerandom"
 
 require_relative "../ext/transport"
 require_relative "../ext/telemetry"
+require_relative "../transport/streaming_payload"
 require_relative "../transport/telemetry"
 require_relative "../utils/telemetry"
 
@@ -28,16 +29,18 @@ module Datadog
           payload_boundary = SecureRandom.uuid
 
           filename = File.basename(filepath)
-          packfile_contents = read_file(filepath)
-
-          payload = request_payload(payload_boundary, filename, packfile_contents)
+          payload = request_payload(payload_boundary, filename, filepath)
           content_type = "#{Ext::Transport::CONTENT_TYPE_MULTIPART_FORM_DATA}; boundary=#{payload_boundary}"
 
-          http_response = api.api_request(
-            path: Ext::Transport::DD_API_GIT_UPLOAD_PACKFILE_PATH,
-            payload: payload,
-            headers: {Ext::Transport::HEADER_CONTENT_TYPE => content_type}
-          )
+          http_response = begin
+            api.api_request(
+              path: Ext::Transport::DD_API_GIT_UPLOAD_PACKFILE_PATH,
+              payload: payload,
+              headers: {Ext::Transport::HEADER_CONTENT_TYPE => content_type}
+            )
+          ensure
+            payload.close
+          end
 
           Transport::Telemetry.api_requests(
             Ext::Telemetry::METRIC_GIT_REQUESTS_OBJECT_PACK,
@@ -60,8 +63,10 @@ module Datadog
 
         private
 
-        def request_payload(boundary, filename, packfile_contents)
-          [
+        # The packfile is streamed from disk while the request is sent instead of being read into memory
+        def request_payload(boundary, filename, filepath)
+          payload = Transport::StreamingPayload.new
+          payload << [
             "--#{boundary}",
             'Content-Disposition: form-data; name="pushedSha"',
             "Content-Type: application/json",
@@ -71,13 +76,14 @@ module Datadog
             "Content-Disposition: form-data; name=\"packfile\"; filename=\"#{filename}\"",
             "Content-Type: application/octet-stream",
             "",
-            packfile_contents,
-            "--#{boundary}--"
+            ""
           ].join("\r\n")
+          open_packfile(payload, filepath)
+          payload << "\r\n--#{boundary}--"
         end
 
-        def read_file(filepath)
-          File.read(filepath)
+        def open_packfile(payload, filepath)
+          payload.append_file(filepath)
         rescue => e
           raise ApiError, "Failed to read packfile: #{e.message}"
         end
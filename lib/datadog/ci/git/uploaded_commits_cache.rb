@@ -0,0 +1,136 @@
+# frozen_string_literal: true
+
+require "digest/sha2"
+require "fileutils"
+require "tmpdir"
+
+module Datadog
+  module CI
+    module Git
+      # UploadedCommitsCache persists the commits that the backend acknowledged for a repository (returned by
+      # the commits search or uploaded in packfiles), so that the next runs from the same checkout only have to
+      # search the commits that were added since.
+      #
+      # The cache is stored in the system temporary directory, one file per repository URL and backend (intake host
+      # and API key fingerprint), and is never written into the repository itself. It is kept outside of
+      # Utils::FileStorage::TEMP_DIR that is removed when the test session ends.
+      #
+      # Commits acknowledged more than TTL_SECONDS ago are searched again: the backend may have dropped them.
+      # Up to MAX_COMMITS most recently acknowledged commits are kept. The cache directory must be private to
+      # the current user, otherwise the cache is not used: a planted cache file would suppress the uploads.
+      #
+      # File layout (little-endian integers):
+      #
+      #   "DDUC" | u32 format version | u32 commits count |
+      #   commits: binary SHA-1 + u64 acknowledged at (seconds since epoch), oldest first
+      #
+      # @api private
+      class UploadedCommitsCache
+        MAGIC = "DDUC"
+        FORMAT_VERSION = 2
+        SHA_SIZE = 20
+        ENTRY_SIZE = SHA_SIZE + 8
+        MAX_COMMITS = 10_000
+        TTL_SECONDS = 24 * 60 * 60
+        SHA_REGEX = /\A[0-9a-f]{40}\z/.freeze
+        DEFAULT_DIR = File.join(Dir.tmpdir, "datadog-ci-uploaded-commits")
+
+        # @param repository_url [String] Repository URL the commits were acknowledged for
+        # @param backend_id [String, nil] Backend the commits were acknowledged by, see Transport::Api::Base#backend_id
+        # @return [UploadedCommitsCache, nil] nil when the backend is unknown
+        def self.for_repository(repository_url, backend_id)
+          return nil if backend_id.nil?
+
+          key = Digest::SHA256.hexdigest("#{repository_url}\0#{backend_id}")[0, 32]
+          new(File.join(DEFAULT_DIR, "#{key}.cache"))
+        end
+
+        # @return [String] Path of the cache file
+        attr_reader :path
+
+        # @param path [String] Path of the cache file
+        def initialize(path)
+          @path = path
+          @commits = nil
+        end
+
+        # @param sha [String] Hex SHA-1 of the commit
+        # @return [Boolean] true if the commit was acknowledged by the backend less than TTL_SECONDS ago
+        def include?(sha)
+          commits.key?(sha)
+        end
+
+        # Add the commits acknowledged by the backend and write the cache if any of them is new.
+        #
+        # @param shas [Enumerable<String>] Hex SHA-1s of the commits
+        # @return [void]
+        def add(shas)
+          new_commits = shas.select { |sha| sha.match?(SHA_REGEX) && !commits.key?(sha) }
+          return if new_commits.empty?
+
+          acknowledged_at = Time.now.to_i
+          # other processes may have written the cache since it was read
+          @commits = read_commits.merge(commits) { |_, theirs, ours| [theirs, ours].max }
+          new_commits.each { |sha| @commits[sha] = acknowledged_at }
+          write_commits
+        end
+
+        private
+
+        def commits
+          @commits ||= read_commits
+        end
+
+        def read_commits
+          return {} unless File.exist?(path) && private_dir?
+
+          data = File.binread(path)
+          return {} unless data.byteslice(0, MAGIC.bytesize) == MAGIC
+
+          version, count = data.unpack("VV", offset: MAGIC.bytesize)
+          return {} unless version == FORMAT_VERSION
+
+          entries = data.byteslice(MAGIC.bytesize + 8, count * ENTRY_SIZE)
+          raise ArgumentError, "truncated uploaded commits cache" if entries.nil? || entries.bytesize != count * ENTRY_SIZE
+
+          expired_at = Time.now.to_i - TTL_SECONDS
+          result = {}
+          entries.unpack("H40Q<" * count).each_slice(2) do |sha, acknowledged_at|
+            result[sha] = acknowledged_at if acknowledged_at > expired_at
+          end
+          result
+        rescue => e
+          Datadog.logger.debug { "Failed to read uploaded commits cache #{path}: #{e.class} - #{e.message}" }
+          {}
+        end
+
+        def write_commits
+          entries = commits.sort_by.with_index { |(_, acknowledged_at), index| [acknowledged_at, index] }.last(MAX_COMMITS)
+
+          data = +"".b
+          data << MAGIC << [FORMAT_VERSION, entries.size].pack("VV") << entries.flatten.pack("H40Q<" * entries.size)
+
+          dir = File.dirname(path)
+          FileUtils.mkdir_p(dir, mode: 0o700)
+          return unless private_dir?
+
+          # write to a temporary file first: other processes may be reading the cache
+          temp_path = "#{path}.#{Process.pid}.tmp"
+          File.binwrite(temp_path, data, perm: 0o600)
+          File.rename(temp_path, path)
+        rescue => e
+          Datadog.logger.debug { "Failed to write uploaded commits cache #{path}: #{e.class} - #{e.message}" }
+        end
+
+        # the cache directory must be owned by the current user and not writable by anyone else
+        def private_dir?
+          stat = File.lstat(File.dirname(path))
+          return true if stat.directory? && stat.owned? && (stat.mode & 0o022).zero?
+
+          Datadog.logger.debug { "Ignoring uploaded commits cache #{path}: the directory is not private" }
+          false
+        end
+      end
+    end
+  end
+end
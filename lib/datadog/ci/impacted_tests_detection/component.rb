@@ -10,6 +10,8 @@ module Datadog
         def initialize(enabled:)
           @enabled = enabled
           @git_diff = Git::Diff.new
+          # source file => {packed start and end lines => modified}, filled by classify_tests
+          @verdicts = {}
         end
 
         def configure(library_settings, test_session)
@@ -59,13 +61,66 @@ module Datadog
           # @type var source_file: String
           source_file = source_file[1..] if source_file.start_with?("/")
 
-          result = @git_diff.lines_changed?(source_file, start_line: test_span.start_line, end_line: test_span.end_line)
+          start_line = test_span.start_line
+          end_line = test_span.end_line
+
+          result = cached_verdict(source_file, start_line, end_line)
+          result = @git_diff.lines_changed?(source_file, start_line: start_line, end_line: end_line) if result.nil?
+
           Datadog.logger.debug do
             "Impacted tests detection: test #{test_span.name} with source file #{source_file} is modified: #{result}"
           end
           result
         end
 
+        # Classifies all tests of a test suite in one pass when the suite is loaded.
+        # Tests of the same file are checked with a single sweep over its changed lines and the verdicts are
+        # cached, so that tag_modified_test does not have to search the diff again for every test.
+        #
+        # @param tests [Array<Array(String, Integer, Integer)>] source file, start line and end line of each test
+        # @return [Array<Boolean>] whether each test is modified, in the order of tests
+        def classify_tests(tests)
+          result = Array.new(tests.size, false)
+          return result unless enabled?
+
+          # source file => [changed lines, packed start and end lines of its tests, indexes of its tests]
+          tests_by_file = {}
+
+          tests.each_with_index do |(source_file, start_line, end_line), index|
+            next if source_file.nil?
+
+            source_file = source_file[1..] if source_file.start_with?("/")
+
+            changed_lines = @git_diff.changed_lines(source_file)
+            next if changed_lines.nil?
+
+            # same as Git::Diff#lines_changed?: the test is modified if its file is changed
+            if start_line.nil? || end_line.nil?
+              result[index] = true
+              next
+            end
+
+            file_tests = (tests_by_file[source_file] ||= [changed_lines, [], []])
+            file_tests[1] << start_line << end_line
+            file_tests[2] << index
+          end
+
+          tests_by_file.each do |source_file, (changed_lines, lines, indexes)|
+            file_verdicts = (@verdicts[source_file] ||= {})
+
+            changed_lines.overlaps_each(lines).each_with_index do |modified, position|
+              result[indexes[position]] = modified
+              file_verdicts[verdict_key(lines[position * 2], lines[position * 2 + 1])] = modified
+            end
+          end
+
+          Datadog.logger.debug do
+            "Impacted tests detection: classified #{tests.size} tests, #{result.count(true)} modified"
+          end
+
+          result
+        end
+
         def tag_modified_test(test_span)
           return unless modified?(test_span)
 
@@ -78,6 +133,17 @@ module Datadog
 
         private
 
+        def cached_verdict(source_file, start_line, end_line)
+          return nil if start_line.nil? || end_line.nil?
+
+          @verdicts[source_file]&.[](verdict_key(start_line, end_line))
+        end
+
+        # packs both lines into a single Integer key to avoid allocating an array per test
+        def verdict_key(start_line, end_line)
+          (start_line << 32) | (end_line & 0xFFFFFFFF)
+        end
+
         def git_tree_upload_worker
           Datadog.send(:components).git_tree_upload_worker
         end
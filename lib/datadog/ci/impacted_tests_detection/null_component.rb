@@ -16,6 +16,10 @@ module Datadog
           false
         end
 
+        def classify_tests(tests)
+          Array.new(tests.size, false)
+        end
+
         def tag_modified_test(_test_span)
         end
       end
@@ -21,16 +21,16 @@ module Datadog
 
         # called on test session start, uses test session info to send configuration request to the backend
         def configure(test_session)
-          fetch_library_configuration(test_session)
+          library_configuration = fetch_library_configuration(test_session)
 
           # configure different components in parallel because they might block on HTTP requests
           configuration_workers = [
-            Worker.new { test_impact_analysis.configure(@library_configuration, test_session) },
-            Worker.new { test_retries.configure(@library_configuration, test_session) },
-            Worker.new { test_tracing.configure(@library_configuration, test_session) },
-            Worker.new { test_management.configure(@library_configuration, test_session) },
-            Worker.new { impacted_tests_detection.configure(@library_configuration, test_session) },
-            Worker.new { code_coverage.configure(@library_configuration) }
+            Worker.new { test_impact_analysis.configure(fetch_git_dependent_configuration(test_session), test_session) },
+            Worker.new { test_retries.configure(library_configuration, test_session) },
+            Worker.new { test_tracing.configure(library_configuration, test_session) },
+            Worker.new { test_management.configure(library_configuration, test_session) },
+            Worker.new { impacted_tests_detection.configure(library_configuration, test_session) },
+            Worker.new { code_coverage.configure(library_configuration) }
           ]
 
           # launch configuration workers
@@ -38,6 +38,9 @@ module Datadog
 
           # block until all workers are done
           configuration_workers.each(&:wait_until_done)
+
+          # Store component state for distributed test runs
+          store_component_state if @library_configuration_fetched && test_session.distributed
         end
 
         # Implementation of Stateful interface
@@ -72,6 +75,8 @@ module Datadog
         private
 
         def fetch_library_configuration(test_session)
+          @library_configuration_fetched = false
+
           # In test discovery mode, skip backend fetching and use default settings (everything is disabled)
           return @library_configuration = LibrarySettings.from_http_response(nil) if @test_discovery_enabled
 
@@ -79,24 +84,27 @@ module Datadog
           library_configuration_loaded = load_component_state
           return @library_configuration if library_configuration_loaded
 
+          @library_configuration_fetched = true
           @library_configuration = @library_settings_client.fetch(test_session)
+        end
 
-          # sometimes we can skip code coverage for default branch if there are no changes in the repository
-          # backend needs git metadata uploaded for this test session to check if we can skip code coverage
-          if @library_configuration.require_git?
-            Datadog.logger.debug { "Library configuration endpoint requires git upload to be finished, waiting..." }
-            git_tree_upload_worker.wait_until_done
+        # Sometimes we can skip code coverage for default branch if there are no changes in the repository:
+        # backend needs git metadata uploaded for this test session to check if we can skip code coverage.
+        #
+        # Only test impact analysis settings depend on git metadata, so only test impact analysis waits for the
+        # git upload. The other components are configured with the first response in the meantime.
+        def fetch_git_dependent_configuration(test_session)
+          return @library_configuration unless @library_configuration_fetched && @library_configuration.require_git?
 
-            Datadog.logger.debug { "Requesting library configuration again..." }
-            @library_configuration = @library_settings_client.fetch(test_session)
+          Datadog.logger.debug { "Library configuration endpoint requires git upload to be finished, waiting..." }
+          git_tree_upload_worker.wait_until_done
 
-            if @library_configuration.require_git?
-              Datadog.logger.debug { "git metadata upload did not complete in time when configuring library" }
-            end
-          end
+          Datadog.logger.debug { "Requesting library configuration again..." }
+          @library_configuration = @library_settings_client.fetch(test_session)
 
-          # Store component state for distributed test runs
-          store_component_state if test_session.distributed
+          if @library_configuration.require_git?
+            Datadog.logger.debug { "git metadata upload did not complete in time when configuring library" }
+          end
 
           @library_configuration
         end
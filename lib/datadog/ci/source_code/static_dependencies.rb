@@ -1,5 +1,6 @@
 # frozen_string_literal: true
 
+require_relative "static_dependencies_cache"
 require_relative "static_dependencies_extractor"
 
 module Datadog
@@ -29,30 +30,100 @@ module Datadog
         # Collect all live ISeqs from the Ruby object space.
         # Falls back to empty array if native extension is not available.
         #
-        # @return [Array<RubyVM::InstructionSequence>] Array of all live ISeqs
-        def self.collect
+        # When root_path is given, only ISeqs of files under root_path and outside ignored_path
+        # are returned, without wrapping the others.
+        #
+        # @param root_path [String, nil] Only collect ISeqs of files under this path
+        # @param ignored_path [String, nil] Exclude ISeqs of files under this path
+        # @return [Array<RubyVM::InstructionSequence>] Array of live ISeqs
+        def self.collect(root_path = nil, ignored_path = nil)
           return [] unless STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE
+          return collect_iseqs if root_path.nil?
+
+          collect_iseqs_under(root_path, ignored_path)
+        end
+
+        # Start recording ISeqs of files under root_path as they are loaded.
+        #
+        # Captured ISeqs include top-level ISeqs that would otherwise be garbage collected
+        # after their file has been loaded, and collecting them doesn't walk the whole heap.
+        # Files loaded before the capture started are collected once, when it starts.
+        #
+        # @param root_path [String] Only capture ISeqs of files under this path
+        # @param ignored_path [String, nil] Exclude ISeqs of files under this path
+        # @return [Boolean] Whether the capture was started
+        def self.start_capture(root_path, ignored_path = nil)
+          return false unless STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE
 
-          collect_iseqs
+          start_iseq_capture(root_path, ignored_path)
+          true
+        end
+
+        # Stop recording ISeqs and release the captured ones.
+        #
+        # @return [void]
+        def self.stop_capture
+          return unless STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE
+
+          stop_iseq_capture
+        end
+
+        # Scan all live ISeqs under root_path (or the ISeqs captured for root_path) for
+        # constant references and resolve them to the files where the constants are defined.
+        # Falls back to empty results if native extension is not available.
+        #
+        # @param root_path [String] Only process files under this path
+        # @param ignored_path [String, nil] Exclude files under this path
+        # @param cached_constants [Hash{String => Array<String>}, nil] Constant names of files that don't need to be scanned
+        # @return [Array(Hash{String => Hash{String => Boolean}}, Array<RubyVM::InstructionSequence>, Hash{String => Hash{String => Boolean}})]
+        #   The dependencies map, the ISeqs that could not be scanned natively and the constant names per file
+        def self.static_dependencies(root_path, ignored_path = nil, cached_constants = nil)
+          return [{}, [], {}] unless STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE
+
+          scan_static_dependencies(root_path, ignored_path, cached_constants)
         end
       end
 
       module StaticDependencies
         # Populate the static dependencies map by scanning all live ISeqs.
         #
+        # When cache_path is given, the constant names found in every file are persisted there
+        # and only files that changed since the cache was written are scanned again.
+        #
         # @param root_path [String] Only process files under this path
         # @param ignored_path [String, nil] Exclude files under this path
+        # @param cache_path [String, nil] Path of the static dependencies cache file
         # @return [Hash{String => Hash{String => Boolean}}] The dependencies map
-        def self.populate!(root_path, ignored_path = nil)
+        def self.populate!(root_path, ignored_path = nil, cache_path: nil)
           raise ArgumentError, "root_path must be a String and not nil" if root_path.nil? || !root_path.is_a?(String)
 
-          extractor = StaticDependenciesExtractor.new(root_path, ignored_path)
+          cache = StaticDependenciesCache.new(cache_path, root_path) if cache_path && ISeqCollector::STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE
+          cached_constants = cache&.load
+          # the files are recorded before they are scanned, the ISeqs come from the active capture when there is one
+          cache&.snapshot(ISeqCollector.collect(root_path, ignored_path).map(&:absolute_path))
+
+          dependencies_map, unscanned_iseqs, file_constants = ISeqCollector.static_dependencies(
+            root_path, ignored_path, cached_constants
+          )
+
+          # ISeqs that can't be disassembled natively are scanned from their ISeq#to_a representation
+          unless unscanned_iseqs.empty?
+            extractor = StaticDependenciesExtractor.new(root_path, ignored_path)
+            unscanned_iseqs.each do |iseq|
+              extractor.extract(iseq)
+            end
 
-          ISeqCollector.collect.each do |iseq|
-            extractor.extract(iseq)
+            extractor.dependencies_map.each do |file, deps|
+              (dependencies_map[file] ||= {}).merge!(deps)
+            end
           end
 
-          @dependencies_map = extractor.dependencies_map
+          # the dependencies map is only populated once, captured ISeqs are not needed anymore
+          ISeqCollector.stop_capture
+
+          cache&.store(file_constants, unscanned_iseqs.map(&:absolute_path).to_set)
+
+          @dependencies_map = dependencies_map
         end
 
         # Fetch static dependencies for a given file.
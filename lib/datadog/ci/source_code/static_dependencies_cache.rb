@@ -0,0 +1,251 @@
+# frozen_string_literal: true
+
+require "digest/sha1"
+require "fileutils"
+require "set"
+require "tmpdir"
+
+module Datadog
+  module CI
+    module SourceCode
+      # StaticDependenciesCache persists the constant names referenced by every scanned source file,
+      # so that the next process only has to scan the files that changed since the cache was written.
+      #
+      # Constant names are cached instead of resolved dependencies: the file that defines a constant
+      # can change without the referencing file changing, so cached names are resolved on every load.
+      #
+      # Files are keyed by their path relative to root_path and validated by size and mtime. When only the
+      # mtime changed (fresh checkouts on CI), the content digest decides whether the entry is still valid.
+      # The size, mtime and digest of a file are recorded before its ISeqs are scanned, so the stored constant
+      # names never get the stat of a file that was changed while the process was running.
+      #
+      # File layout (little-endian integers):
+      #
+      #   "DDSD" | u32 format version | u32 length + Ruby version
+      #   u32 names count | names: u32 length + bytes
+      #   u32 files count | files: u32 length + relative path, u64 mtime (ns), u64 size, SHA1 digest, u32 first ref
+      #   u32 refs count  | refs: u32 name index
+      #
+      # The names referenced by file i are refs[first_ref(i)...first_ref(i + 1)].
+      #
+      # The default cache is kept outside of Utils::FileStorage::TEMP_DIR that is removed when the test session ends.
+      #
+      # @api private
+      class StaticDependenciesCache
+        MAGIC = "DDSD"
+        FORMAT_VERSION = 1
+        DIGEST_SIZE = 20
+        DEFAULT_DIR = File.join(Dir.tmpdir, "datadog-ci-static-dependencies")
+
+        Entry = Struct.new(:mtime_ns, :size, :digest, :constant_names)
+
+        # Default cache location for a repository: shared by all processes running from the same checkout.
+        #
+        # @param root_path [String] The repository root
+        # @return [String]
+        def self.default_path(root_path)
+          File.join(DEFAULT_DIR, "#{Digest::SHA1.hexdigest(root_path)[0, 16]}.cache")
+        end
+
+        # @return [String] Path of the cache file
+        attr_reader :path
+
+        # @return [String] Root path the cached file paths are relative to
+        attr_reader :root_path
+
+        # @param path [String] Path of the cache file
+        # @param root_path [String] Root path the cached file paths are relative to
+        def initialize(path, root_path)
+          @path = path
+          @root_path = root_path
+          @root_prefix = root_path.end_with?(File::SEPARATOR) ? root_path : "#{root_path}#{File::SEPARATOR}"
+          @entries = {}
+          @snapshots = {}
+          @dirty = false
+        end
+
+        # Read the cache file and return the constant names of the files that did not change.
+        #
+        # @return [Hash{String => Array<String>}] Constant names by absolute file path
+        def load
+          @entries = read_entries
+          @dirty = false
+
+          result = {}
+          @entries.delete_if do |relative_path, entry|
+            absolute_path = File.join(root_path, relative_path)
+            if valid?(absolute_path, entry)
+              result[absolute_path] = entry.constant_names
+              false
+            else
+              @dirty = true
+              true
+            end
+          end
+          result
+        end
+
+        # Record the size, mtime and digest of the files that are about to be scanned.
+        # Files that are valid in the loaded cache are not scanned again and are not recorded.
+        #
+        # @param absolute_paths [Enumerable<String, nil>] Files of the ISeqs that are about to be scanned
+        # @return [void]
+        def snapshot(absolute_paths)
+          absolute_paths.each do |absolute_path|
+            next if absolute_path.nil? || @snapshots.key?(absolute_path)
+
+            relative_path = relative_path_for(absolute_path)
+            next if relative_path.nil? || @entries.key?(relative_path)
+
+            @snapshots[absolute_path] = build_entry(absolute_path)
+          end
+        end
+
+        # Add the files scanned in this process to the cache and write it if anything changed.
+        # Only files recorded by #snapshot before they were scanned are added.
+        #
+        # @param file_constants [Hash{String => Hash{String => Boolean}}] Constant names by absolute file path
+        # @param skipped_files [Set<String>] Files that were not fully scanned and must not be cached
+        # @return [void]
+        def store(file_constants, skipped_files = Set.new)
+          file_constants.each do |absolute_path, constant_names|
+            next if skipped_files.include?(absolute_path)
+
+            relative_path = relative_path_for(absolute_path)
+            next if relative_path.nil? || @entries.key?(relative_path)
+
+            entry = @snapshots[absolute_path]
+            next if entry.nil?
+
+            entry.constant_names = constant_names.keys
+            @entries[relative_path] = entry
+            @dirty = true
+          end
+          @snapshots.clear
+
+          write_entries if @dirty
+        end
+
+        private
+
+        def relative_path_for(absolute_path)
+          return nil unless absolute_path.start_with?(@root_prefix)
+
+          absolute_path.byteslice(@root_prefix.bytesize..)
+        end
+
+        def mtime_ns(stat)
+          stat.mtime.to_i * 1_000_000_000 + stat.mtime.nsec
+        end
+
+        def valid?(absolute_path, entry)
+          stat = File.stat(absolute_path)
+          return false unless stat.file? && stat.size == entry.size
+
+          current_mtime_ns = mtime_ns(stat)
+          return true if current_mtime_ns == entry.mtime_ns
+          return false unless Digest::SHA1.file(absolute_path).digest == entry.digest
+
+          entry.mtime_ns = current_mtime_ns
+          @dirty = true
+          true
+        rescue SystemCallError
+          false
+        end
+
+        def build_entry(absolute_path)
+          stat = File.stat(absolute_path)
+          return nil unless stat.file?
+
+          Entry.new(mtime_ns(stat), stat.size, Digest::SHA1.file(absolute_path).digest, nil)
+        rescue SystemCallError
+          nil
+        end
+
+        def read_entries
+          return {} unless File.exist?(path)
+
+          data = File.binread(path)
+          offset = 0
+
+          read_u32 = lambda do
+            value = data.unpack1("V", offset: offset)
+            offset += 4
+            value
+          end
+          read_bytes = lambda do |size|
+            value = data.byteslice(offset, size)
+            raise ArgumentError, "truncated static dependencies cache" if value.nil? || value.bytesize != size
+
+            offset += size
+            value
+          end
+          read_string = -> { read_bytes.call(read_u32.call).force_encoding(Encoding::UTF_8) }
+
+          return {} unless read_bytes.call(MAGIC.bytesize) == MAGIC
+          return {} unless read_u32.call == FORMAT_VERSION
+          return {} unless read_string.call == RUBY_VERSION
+
+          names = Array.new(read_u32.call) { read_string.call }
+
+          files = Array.new(read_u32.call) do
+            relative_path = read_string.call
+            file_mtime_ns, size = read_bytes.call(16).unpack("Q<Q<")
+            digest = read_bytes.call(DIGEST_SIZE)
+            [relative_path, Entry.new(file_mtime_ns, size, digest, nil), read_u32.call]
+          end
+
+          refs = read_bytes.call(read_u32.call * 4).unpack("V*")
+
+          entries = {}
+          files.each_with_index do |(relative_path, entry, first_ref), index|
+            last_ref = (index + 1 < files.size) ? files[index + 1][2] : refs.size
+            entry.constant_names = refs[first_ref...last_ref].map { |name_index| names.fetch(name_index) }
+            entries[relative_path] = entry
+          end
+          entries
+        rescue => e
+          Datadog.logger.debug { "Failed to read static dependencies cache #{path}: #{e.class} - #{e.message}" }
+          {}
+        end
+
+        def write_entries
+          names = {}
+          refs = []
+          files = +"".b
+
+          @entries.each do |relative_path, entry|
+            files << pack_string(relative_path)
+            files << [entry.mtime_ns, entry.size].pack("Q<Q<") << entry.digest << [refs.size].pack("V")
+
+            entry.constant_names.each do |name|
+              refs << (names[name] ||= names.size)
+            end
+          end
+
+          data = +"".b
+          data << MAGIC << [FORMAT_VERSION].pack("V") << pack_string(RUBY_VERSION)
+          data << [names.size].pack("V")
+          names.each_key { |name| data << pack_string(name) }
+          data << [@entries.size].pack("V") << files
+          data << [refs.size].pack("V") << refs.pack("V*")
+
+          # write to a temporary file first: other processes may be reading the cache
+          FileUtils.mkdir_p(File.dirname(path))
+          temp_path = "#{path}.#{Process.pid}.tmp"
+          File.binwrite(temp_path, data)
+          File.rename(temp_path, path)
+
+          @dirty = false
+        rescue => e
+          Datadog.logger.debug { "Failed to write static dependencies cache #{path}: #{e.class} - #{e.message}" }
+        end
+
+        def pack_string(value)
+          value = value.b
+          [value.bytesize].pack("V") << value
+        end
+      end
+    end
+  end
+end
@@ -0,0 +1,18 @@
+# frozen_string_literal: true
+
+module Datadog
+  module CI
+    # Native fast path for writing test events straight into citestcycle
+    # payloads.
+    # Implementation in ext/datadog_ci_native/span_serialization.c.
+    #
+    # @internal
+    module SpanSerialization
+      begin
+        require "datadog_ci_native.#{RUBY_VERSION}_#{RUBY_PLATFORM}"
+      rescue LoadError
+        # events are encoded with the msgpack gem
+      end
+    end
+  end
+end
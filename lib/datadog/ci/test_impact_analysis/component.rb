@@ -14,6 +14,8 @@ require_relative "../source_code/static_dependencies"
 require_relative "../utils/parsing"
 require_relative "../utils/stateful"
 require_relative "../utils/telemetry"
+require_relative "../utils/test_id_set"
+require_relative "../worker"
 
 require_relative "coverage/event"
 require_relative "coverage/files"
@@ -44,7 +46,10 @@ module Datadog
           bundle_location: nil,
           use_single_threaded_coverage: false,
           use_allocation_tracing: true,
-          static_dependencies_tracking_enabled: false
+          static_dependencies_tracking_enabled: false,
+          static_dependencies_cache_enabled: false,
+          static_dependencies_cache_path: nil,
+          use_iseq_line_tracing: false
         )
           @enabled = enabled
           @api = api
@@ -60,6 +65,9 @@ module Datadog
           @use_single_threaded_coverage = use_single_threaded_coverage
           @use_allocation_tracing = use_allocation_tracing
           @static_dependencies_tracking_enabled = static_dependencies_tracking_enabled
+          @static_dependencies_cache_enabled = static_dependencies_cache_enabled
+          @static_dependencies_cache_path = static_dependencies_cache_path
+          @use_iseq_line_tracing = use_iseq_line_tracing
 
           @test_skipping_enabled = false
           @code_coverage_enabled = false
@@ -67,11 +75,18 @@ module Datadog
           @coverage_writer = coverage_writer
 
           @correlation_id = nil
-          @skippable_tests = Set.new
+          @skippable_tests = Utils::TestIdSet.new
           @skippable_suites = Set.new
 
           @mutex = Mutex.new
 
+          # Coverage collectors of all threads, their stats are reported together when the session ends.
+          # Collectors are held weakly: the collectors of finished threads are freed with their thread.
+          @coverage_collectors = ObjectSpace::WeakMap.new
+          @coverage_collectors_mutex = Mutex.new
+
+          start_static_dependencies_capture
+
           # Context coverage: stores coverage collected during before(:context)/before(:all) hooks
           # keyed by context_id (e.g., RSpec scoped_id for example groups)
           # Only used when use_single_threaded_coverage is false (multi-threaded mode)
@@ -98,19 +113,21 @@ module Datadog
           test_session.set_tag(Ext::Test::TAG_CODE_COVERAGE_ENABLED, @code_coverage_enabled)
           test_session.set_tag(Ext::Test::TAG_ITR_TEST_SKIPPING_TYPE, @test_skipping_mode)
 
+          # Skippables are fetched while code coverage is set up: the request waits for the git upload
+          # and populating the static dependencies map only scans the loaded code.
+          skippables_worker = Worker.new { configure_skippables(test_session) } if skipping_tests? || skipping_suites?
+          skippables_worker&.perform
+
           if @code_coverage_enabled
             load_datadog_cov!
 
             populate_static_dependencies_map!
           end
 
-          # Load external cache or component state first, and if successful, skip fetching skippable tests
-          if skipping_tests? || skipping_suites?
-            return if load_component_state
+          # captured ISeqs are only used to populate the static dependencies map
+          Datadog::CI::SourceCode::ISeqCollector.stop_capture
 
-            fetch_skippables(test_session)
-            store_component_state if test_session.distributed
-          end
+          skippables_worker&.wait_until_done
 
           Datadog.logger.debug("Configured TestImpactAnalysis with enabled: #{@enabled}, skipping_tests: #{@test_skipping_enabled}, code_coverage: #{@code_coverage_enabled}")
         end
@@ -152,7 +169,7 @@ module Datadog
         # Stops coverage collection and returns raw coverage data.
         # This is a low-level method that only stops the collector.
         #
-        # @return [Hash, nil] Raw coverage data or nil
+        # @return [Coverage::CoveredFiles, Hash, nil] Raw coverage data or nil
         def stop_coverage
           return if !enabled? || !code_coverage?
 
@@ -278,10 +295,10 @@ module Datadog
           enabled? && code_coverage? && !suite_skipping_mode? && !@use_single_threaded_coverage
         end
 
-        def skippable?(datadog_test_id)
+        def skippable_test?(test_name, test_suite_name, parameters = nil)
           return false if !enabled? || !skipping_tests?
 
-          @mutex.synchronize { @skippable_tests.include?(datadog_test_id) }
+          @mutex.synchronize { @skippable_tests.include_test?(test_name, test_suite_name, parameters) }
         end
 
         def skippable_suite?(test_suite_name)
@@ -293,7 +310,7 @@ module Datadog
         def mark_if_skippable(test)
           return if !enabled? || !skipping_tests?
 
-          if skippable?(test.datadog_test_id) && !test.attempt_to_fix?
+          if skippable_test?(test.name, test.test_suite_name, test.parameters) && !test.attempt_to_fix?
             test.set_tag(Ext::Test::TAG_ITR_SKIPPED_BY_ITR, "true")
 
             Datadog.logger.debug { "Marked test as skippable: #{test.datadog_test_id}" }
@@ -371,10 +388,12 @@ module Datadog
 
           test_session.set_tag(Ext::Test::TAG_ITR_TESTS_SKIPPED, skipped_tests_count.positive?.to_s)
           test_session.set_tag(Ext::Test::TAG_ITR_TEST_SKIPPING_COUNT, skipped_tests_count)
+
+          report_code_coverage_stats
         end
 
         def skippables_count
-          current_skippables.count
+          current_skippables.size
         end
 
         def shutdown!
@@ -393,7 +412,7 @@ module Datadog
         def restore_state(state)
           set_skippables(
             correlation_id: state[:correlation_id],
-            tests: state[:skippable_tests] || Set.new,
+            tests: state[:skippable_tests] || Utils::TestIdSet.new,
             suites: state[:skippable_suites] || Set.new
           )
         end
@@ -405,16 +424,25 @@ module Datadog
         def restore_state_from_datadog_test_runner
           Datadog.logger.debug { "Restoring skippables from Test Optimization cache" }
 
-          skippables_data = load_cached_skippable_tests
-          if skippables_data.nil?
-            Datadog.logger.debug { "Restoring skippables failed, will request again" }
-            return false
-          end
+          # the index only holds skippable tests, suites are always read from the JSON response
+          skippables_index = load_cached_skippable_tests_index unless suite_skipping_mode?
+          if skippables_index
+            tests, correlation_id = skippables_index
+            set_skippables(correlation_id: correlation_id, tests: tests, suites: Set.new)
 
-          Datadog.logger.debug { "Restored skippables from Test Optimization: #{skippables_data}" }
+            Datadog.logger.debug { "Restored skippables from Test Optimization cache index" }
+          else
+            skippables_data = load_cached_skippable_tests
+            if skippables_data.nil?
+              Datadog.logger.debug { "Restoring skippables failed, will request again" }
+              return false
+            end
 
-          skippable_response = Skippable::Response.from_json(skippables_data)
-          apply_skippable_response(skippable_response)
+            Datadog.logger.debug { "Restored skippables from Test Optimization: #{skippables_data}" }
+
+            skippable_response = Skippable::Response.from_json(skippables_data)
+            apply_skippable_response(skippable_response)
+          end
 
           Datadog.logger.debug { "Found [#{skippables_count}] skippable #{@test_skipping_mode}s from context" }
           Datadog.logger.debug { "ITR correlation ID from context: #{@correlation_id}" }
@@ -430,18 +458,44 @@ module Datadog
         end
 
         def coverage_collector
-          Thread.current[:dd_coverage_collector] ||= Coverage::DDCov.new(
-            root: Git::LocalRepository.root,
-            ignored_path: @bundle_location,
-            threading_mode: code_coverage_mode,
-            use_allocation_tracing: @use_allocation_tracing
-          )
+          Thread.current[:dd_coverage_collector] ||= begin
+            collector = Coverage::DDCov.new(
+              root: Git::LocalRepository.root,
+              ignored_path: @bundle_location,
+              threading_mode: code_coverage_mode,
+              use_allocation_tracing: @use_allocation_tracing,
+              line_tracing_mode: line_tracing_mode
+            )
+            @coverage_collectors_mutex.synchronize { @coverage_collectors[collector] = true }
+            collector
+          end
+        end
+
+        # Collectors are created per thread: their hot path counters are summed, except for the longest stop
+        # that is the longest of all collectors. The stats are meant for tuning the collector and are only logged,
+        # the stats of collectors that were already freed with their thread are not included.
+        def report_code_coverage_stats
+          return unless code_coverage?
+
+          collectors = @coverage_collectors_mutex.synchronize { @coverage_collectors.keys }
+          return if collectors.empty?
+
+          stats = collectors.map(&:stats).reduce do |total, collector_stats|
+            total.merge(collector_stats) do |stat, total_value, value|
+              (stat == :stop_max_time_ns) ? [total_value, value].max : total_value + value
+            end
+          end
+
+          Datadog.logger.debug { "Code coverage stats of #{collectors.size} collector(s): #{stats}" }
         end
 
         def load_datadog_cov!
           require "datadog_ci_native.#{RUBY_VERSION}_#{RUBY_PLATFORM}"
 
-          Datadog.logger.debug("Loaded Datadog code coverage collector, using coverage mode: #{code_coverage_mode}")
+          Datadog.logger.debug(
+            "Loaded Datadog code coverage collector, using coverage mode: #{code_coverage_mode}, " \
+            "line tracing mode: #{line_tracing_mode}"
+          )
         rescue LoadError => e
           Datadog.logger.error("Failed to load coverage collector: #{e}. Code coverage will not be collected.")
           Core::Telemetry::Logger.report(e, description: "Failed to load coverage collector")
@@ -449,11 +503,32 @@ module Datadog
           @code_coverage_enabled = false
         end
 
+        # Record ISeqs of the project files as they are loaded, before we know whether code coverage is enabled.
+        # Capturing at load time keeps top-level ISeqs that would be garbage collected by the time the
+        # dependencies map is populated.
+        def start_static_dependencies_capture
+          return unless @enabled
+          return unless @static_dependencies_tracking_enabled
+
+          Datadog::CI::SourceCode::ISeqCollector.start_capture(Git::LocalRepository.root, @bundle_location)
+        end
+
         def populate_static_dependencies_map!
           return unless @code_coverage_enabled
           return unless @static_dependencies_tracking_enabled
 
-          Datadog::CI::SourceCode::StaticDependencies.populate!(Git::LocalRepository.root, @bundle_location)
+          root_path = Git::LocalRepository.root
+          Datadog::CI::SourceCode::StaticDependencies.populate!(
+            root_path,
+            @bundle_location,
+            cache_path: static_dependencies_cache_path(root_path)
+          )
+        end
+
+        def static_dependencies_cache_path(root_path)
+          return nil unless @static_dependencies_cache_enabled
+
+          @static_dependencies_cache_path || Datadog::CI::SourceCode::StaticDependenciesCache.default_path(root_path)
         end
 
         def enrich_coverage_with_static_dependencies(coverage)
@@ -521,6 +596,14 @@ module Datadog
           test.inherit_impacted_files(test_suite.lock_custom_impacted_files)
         end
 
+        def configure_skippables(test_session)
+          # Load external cache or component state first, and if successful, skip fetching skippable tests
+          return if load_component_state
+
+          fetch_skippables(test_session)
+          store_component_state if test_session.distributed
+        end
+
         def fetch_skippables(test_session)
           return unless skipping_tests? || skipping_suites?
 
@@ -578,6 +661,10 @@ module Datadog
           @use_single_threaded_coverage ? :single : :multi
         end
 
+        def line_tracing_mode
+          @use_iseq_line_tracing ? :iseq : :global
+        end
+
         def git_tree_upload_worker
           Datadog.send(:components).git_tree_upload_worker
         end
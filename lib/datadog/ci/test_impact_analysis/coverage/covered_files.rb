@@ -0,0 +1,14 @@
+# frozen_string_literal: true
+
+module Datadog
+  module CI
+    module TestImpactAnalysis
+      module Coverage
+        # Placeholder for the set of files covered by a test
+        # Implementation in ext/datadog_ci_native/covered_files.c
+        class CoveredFiles
+        end
+      end
+    end
+  end
+end
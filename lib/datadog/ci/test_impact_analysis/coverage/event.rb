@@ -9,7 +9,10 @@ module Datadog
     module TestImpactAnalysis
       module Coverage
         class Event
-          attr_reader :test_id, :test_suite_id, :test_session_id
+          # map header, keys and 64-bit ids
+          ESTIMATED_OVERHEAD = 80
+
+          attr_reader :test_id, :test_suite_id, :test_session_id, :files
 
           def initialize(
             test_id:,
@@ -31,7 +34,7 @@ module Datadog
             valid = true
 
             %i[test_suite_id test_session_id files].each do |key|
-              value = (key == :files) ? @files : send(key)
+              value = send(key)
               next unless value.nil?
 
               Datadog.logger.warn("citestcov event is invalid: [#{key}] is nil. Event: #{self}")
@@ -41,6 +44,11 @@ module Datadog
             valid
           end
 
+          # Estimate of the encoded size, used to budget the bytes buffered by the coverage writer
+          def estimated_size
+            ESTIMATED_OVERHEAD + (@files.nil? ? 0 : @files.estimated_size)
+          end
+
           def to_msgpack(packer = nil)
             packer ||= MessagePack::Packer.new
 
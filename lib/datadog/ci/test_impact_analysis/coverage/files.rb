@@ -14,6 +14,13 @@ module Datadog
         class Files
           EMPTY_FILES = [].freeze
 
+          # {"filename" => path} entry overhead and a typical repository-relative path
+          ESTIMATED_ENTRY_OVERHEAD = 12
+          ESTIMATED_PATH_SIZE = 48
+
+          # Inputs of the native serialization, see FileSerialization.pack_coverage_events
+          attr_reader :coverage, :custom_impacted_files, :root
+
           def initialize(coverage, custom_impacted_files = EMPTY_FILES)
             @coverage = coverage
             @custom_impacted_files = custom_impacted_files
@@ -32,6 +39,14 @@ module Datadog
             normalized_files.size
           end
 
+          # Estimate of the encoded size without normalizing the files, cheap enough to be called for every event
+          # written to the coverage writer.
+          def estimated_size
+            size = @coverage.size * (ESTIMATED_ENTRY_OVERHEAD + ESTIMATED_PATH_SIZE)
+            @custom_impacted_files.each { |file| size += ESTIMATED_ENTRY_OVERHEAD + file.bytesize }
+            size
+          end
+
           # Writes the complete MessagePack files array. The native fast path
           # combines absolute-path classification, immutable-root slicing,
           # stable deduplication, and filename-entry packing. Any shape it does
@@ -60,7 +75,8 @@ module Datadog
           # native coverage and the custom impacted-files API. Serialized files
           # are normalized through {#each}.
           def inspect_coverage
-            coverage = @coverage.dup
+            # native coverage is a CoveredFiles set, present it as a Hash
+            coverage = @coverage.is_a?(Hash) ? @coverage.dup : @coverage.to_h
             @custom_impacted_files.each do |file|
               coverage[file] = true
             end
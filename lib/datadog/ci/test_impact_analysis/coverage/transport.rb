@@ -1,6 +1,7 @@
 # frozen_string_literal: true
 
 require_relative "event"
+require_relative "../../file_serialization"
 require_relative "../../ext/telemetry"
 require_relative "../../transport/event_platform_transport"
 require_relative "../../transport/telemetry"
@@ -10,12 +11,12 @@ module Datadog
     module TestImpactAnalysis
       module Coverage
         class Transport < Datadog::CI::Transport::EventPlatformTransport
-          private
-
           def telemetry_endpoint_tag
             Ext::Telemetry::Endpoint::CODE_COVERAGE
           end
 
+          private
+
           def send_payload(encoded_payload)
             api.citestcov_request(
               path: Ext::Transport::TEST_COVERAGE_INTAKE_PATH,
@@ -23,17 +24,29 @@ module Datadog
             )
           end
 
-          def encode_events(events)
-            events.filter_map do |event|
-              unless event.valid?
-                CI::Transport::Telemetry.endpoint_payload_dropped(1, endpoint: telemetry_endpoint_tag)
-                next
-              end
+          # The native encoder writes whole payloads in a single pass instead of encoding every event
+          # into its own string and joining them per chunk.
+          def encode_payloads(events)
+            return super unless FileSerialization.respond_to?(:pack_coverage_events)
+
+            FileSerialization.pack_coverage_events(valid_events(events), max_payload_size) do |event, encoded|
+              event_too_large?(event, encoded)
+            end
+          end
 
+          def each_encoded_event(events)
+            valid_events(events).each do |event|
               encoded = encoder.encode(event)
-              next if event_too_large?(event, encoded)
+              yield encoded unless event_too_large?(event, encoded)
+            end
+          end
+
+          def valid_events(events)
+            events.select do |event|
+              next true if event.valid?
 
-              encoded
+              CI::Transport::Telemetry.endpoint_payload_dropped(1, endpoint: telemetry_endpoint_tag)
+              false
             end
           end
 
@@ -3,6 +3,7 @@
 require "set"
 
 require_relative "../ext/test"
+require_relative "../utils/test_id_set"
 
 module Datadog
   module CI
@@ -18,7 +19,7 @@ module Datadog
           @test_skipping_enabled = false
           @code_coverage_enabled = false
           @skippable_tests_fetch_error = nil
-          @skippable_tests = Set.new
+          @skippable_tests = Utils::TestIdSet.new
           @skippable_suites = Set.new
           @correlation_id = nil
           @test_skipping_mode = Ext::Test::TIATestSkippingMode::TEST
@@ -77,7 +78,7 @@ module Datadog
         def mark_if_skippable(_test)
         end
 
-        def skippable?(_datadog_test_id)
+        def skippable_test?(_test_name, _test_suite_name, _parameters = nil)
           false
         end
 
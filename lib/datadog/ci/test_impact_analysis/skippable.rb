@@ -6,7 +6,7 @@ require_relative "../ext/telemetry"
 require_relative "../ext/transport"
 require_relative "../ext/test"
 require_relative "../transport/telemetry"
-require_relative "../utils/test_run"
+require_relative "../utils/test_id_set"
 require_relative "../utils/telemetry"
 
 module Datadog
@@ -32,14 +32,14 @@ module Datadog
           end
 
           def tests
-            res = Set.new
+            res = Utils::TestIdSet.new
 
             payload.fetch("data", [])
               .each do |test_data|
                 next unless test_data["type"] == Ext::Test::TIATestSkippingMode::TEST
 
                 attrs = test_data["attributes"] || {}
-                res << Utils::TestRun.datadog_test_id(attrs["name"], attrs["suite"], attrs["parameters"])
+                res.add_test(attrs["name"], attrs["suite"], attrs["parameters"])
               end
 
             res
@@ -5,13 +5,15 @@ require_relative "locator"
 require_relative "readers/legacy"
 require_relative "readers/missing"
 require_relative "readers/v1"
+require_relative "readers/v2"
 
 module Datadog
   module CI
     module TestOptimizationCache
       class Component
         READER_BY_MANIFEST_VERSION = {
-          Ext::TestOptimizationCache::SUPPORTED_MANIFEST_VERSION => Readers::V1
+          Ext::TestOptimizationCache::SUPPORTED_MANIFEST_VERSION => Readers::V1,
+          Ext::TestOptimizationCache::INDEXED_MANIFEST_VERSION => Readers::V2
         }.freeze
 
         def initialize(manifest_file:, runfiles_dir:, runfiles_manifest_file:, test_srcdir:)
@@ -44,6 +46,14 @@ module Datadog
           @reader.load_skippable_tests
         end
 
+        def load_known_tests_index
+          @reader.load_known_tests_index
+        end
+
+        def load_skippable_tests_index
+          @reader.load_skippable_tests_index
+        end
+
         def shutdown!
         end
 
@@ -0,0 +1,89 @@
+# frozen_string_literal: true
+
+require "json"
+
+require_relative "../utils/test_id_set"
+
+module Datadog
+  module CI
+    module TestOptimizationCache
+      # Binary index of a set of tests (known tests, skippable tests) in the Test Optimization cache.
+      #
+      # The index is the prebuilt hash table of Utils::TestIdSet, so it is mapped into memory and queried in place
+      # instead of parsing the JSON response and building the set in every process. Layout, little endian:
+      #
+      #   magic (8 bytes) | format version (u32) | metadata size (u32) | tests count (u64) | slots count (u64)
+      #   metadata: JSON object of strings (e.g. the correlation ID), zero-padded to 8 bytes
+      #   slots: 64-bit test fingerprints, 0 for empty slots
+      #
+      # @api private
+      module IndexFile
+        MAGIC = "DDCITIX\0".b.freeze
+        FORMAT_VERSION = 1
+        HEADER_FORMAT = "a8VVQ<Q<"
+        HEADER_SIZE = 32
+        SLOT_SIZE = 8
+
+        # Writes the index atomically, concurrent readers see either the previous file or the new one.
+        #
+        # @param path [String] Path of the index file
+        # @param test_id_set [Utils::TestIdSet] Tests of the index
+        # @param metadata [Hash<String, String>] Metadata stored along with the tests
+        # @return [Boolean] true when the index was written, false when the native extension is not available
+        def self.write(path, test_id_set, metadata = {})
+          return false unless test_id_set.respond_to?(:dump_index)
+
+          slots = test_id_set.dump_index
+          encoded_metadata = JSON.generate(metadata).b
+          padding = -encoded_metadata.bytesize % SLOT_SIZE
+
+          header = [
+            MAGIC,
+            FORMAT_VERSION,
+            encoded_metadata.bytesize,
+            test_id_set.size,
+            slots.bytesize / SLOT_SIZE
+          ].pack(HEADER_FORMAT)
+
+          temp_path = "#{path}.#{Process.pid}.tmp"
+          File.open(temp_path, "wb") do |file|
+            file.write(header, encoded_metadata, "\0" * padding, slots)
+          end
+          File.rename(temp_path, path)
+
+          true
+        end
+
+        # @param path [String] Path of the index file
+        # @return [Array(Utils::TestIdSet, Hash<String, String>), nil] frozen set of tests mapped from the file and the
+        #   metadata, nil when the index is missing, invalid or can't be mapped on this platform
+        def self.read(path)
+          return nil unless Utils::TestIdSet.respond_to?(:map_index)
+          return nil unless File.exist?(path)
+
+          header = File.binread(path, HEADER_SIZE)
+          return invalid(path, "truncated header") if header.nil? || header.bytesize < HEADER_SIZE
+
+          magic, version, metadata_size, tests_count, slots_count = header.unpack(HEADER_FORMAT)
+          return invalid(path, "unknown format") if magic != MAGIC || version != FORMAT_VERSION
+
+          metadata = JSON.parse(File.binread(path, metadata_size, HEADER_SIZE).to_s)
+          return invalid(path, "invalid metadata") unless metadata.is_a?(Hash)
+
+          slots_offset = HEADER_SIZE + metadata_size + (-metadata_size % SLOT_SIZE)
+          test_id_set = Utils::TestIdSet.map_index(path, slots_offset, slots_count, tests_count)
+          return nil if test_id_set.nil?
+
+          [test_id_set, metadata]
+        rescue => e
+          invalid(path, "#{e.class} - #{e.message}")
+        end
+
+        def self.invalid(path, reason)
+          Datadog.logger.debug { "Ignoring Test Optimization cache index #{path}: #{reason}" }
+          nil
+        end
+      end
+    end
+  end
+end
@@ -24,6 +24,14 @@ module Datadog
           nil
         end
 
+        def load_known_tests_index
+          nil
+        end
+
+        def load_skippable_tests_index
+          nil
+        end
+
         def shutdown!
         end
       end
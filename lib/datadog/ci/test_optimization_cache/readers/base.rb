@@ -27,6 +27,21 @@ module Datadog
             raise NotImplementedError, "#{self.class} must implement #load_skippable_tests"
           end
 
+          # Prebuilt set of known tests, readers without binary indexes return nil and known tests are loaded with
+          # #load_known_tests.
+          #
+          # @return [Utils::TestIdSet, nil]
+          def load_known_tests_index
+            nil
+          end
+
+          # Prebuilt set of skippable tests with the correlation ID of the skippable tests response.
+          #
+          # @return [Array(Utils::TestIdSet, String), nil]
+          def load_skippable_tests_index
+            nil
+          end
+
           private
 
           def read_json_file(file_path)
@@ -0,0 +1,41 @@
+# frozen_string_literal: true
+
+require_relative "../../ext/test_optimization_cache"
+require_relative "../index_file"
+require_relative "v1"
+
+module Datadog
+  module CI
+    module TestOptimizationCache
+      module Readers
+        # Manifest v2 cache: the JSON responses of manifest v1 plus binary indexes of the known and skippable tests
+        # that are mapped instead of parsed. A missing or unusable index falls back to the JSON response.
+        class V2 < V1
+          def load_known_tests_index
+            test_id_set, _metadata = IndexFile.read(index_file_path(Ext::TestOptimizationCache::KNOWN_TESTS_INDEX_FILE_NAME))
+            test_id_set
+          end
+
+          def load_skippable_tests_index
+            index = IndexFile.read(index_file_path(Ext::TestOptimizationCache::SKIPPABLE_TESTS_INDEX_FILE_NAME))
+            return nil if index.nil?
+
+            test_id_set, metadata = index
+            [test_id_set, metadata[Ext::TestOptimizationCache::INDEX_METADATA_CORRELATION_ID]]
+          end
+
+          private
+
+          def index_file_path(file_name)
+            File.join(
+              @test_optimization_path,
+              Ext::TestOptimizationCache::CACHE_FOLDER_NAME,
+              Ext::TestOptimizationCache::INDEX_CACHE_FOLDER_NAME,
+              file_name
+            )
+          end
+        end
+      end
+    end
+  end
+end
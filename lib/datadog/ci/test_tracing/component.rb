@@ -16,6 +16,7 @@ require_relative "../ext/test"
 require_relative "../git/local_repository"
 require_relative "../utils/file_storage"
 require_relative "../utils/stateful"
+require_relative "../utils/test_id_set"
 require_relative "../utils/test_name"
 
 require_relative "../worker"
@@ -52,7 +53,7 @@ module Datadog
           # and uses this list to determine if a test is new or not. New tests are marked with "test.is_new" tag.
           @known_tests_enabled = false
           @known_tests_client = known_tests_client
-          @known_tests = Set.new
+          @known_tests = Utils::TestIdSet.new
 
           # this is used for parallel test runners such as parallel_tests
           if context_service_uri
@@ -236,15 +237,22 @@ module Datadog
         def restore_state_from_datadog_test_runner
           Datadog.logger.debug { "Restoring known tests from Test Optimization cache" }
 
-          known_tests_data = load_cached_known_tests
-          if known_tests_data.nil?
-            Datadog.logger.debug { "Restoring known tests failed, will request again" }
-            return false
-          end
+          known_tests = load_cached_known_tests_index
+          if known_tests
+            Datadog.logger.debug { "Restored known tests from Test Optimization cache index" }
+          else
+            known_tests_data = load_cached_known_tests
+            if known_tests_data.nil?
+              Datadog.logger.debug { "Restoring known tests failed, will request again" }
+              return false
+            end
 
-          Datadog.logger.debug { "Restored known tests from Test Optimization: #{known_tests_data}" }
+            Datadog.logger.debug { "Restored known tests from Test Optimization: #{known_tests_data}" }
+
+            known_tests = KnownTests::Response.from_json(known_tests_data).tests
+          end
 
-          @known_tests = KnownTests::Response.from_json(known_tests_data).tests
+          @known_tests = known_tests
           @known_tests_enabled = !@known_tests.empty?
 
           unless @known_tests_enabled
@@ -444,11 +452,11 @@ module Datadog
           @known_tests_enabled = false if @known_tests_enabled && @known_tests.empty?
           return false unless @known_tests_enabled
 
-          test_id = Utils::TestRun.datadog_test_id(test_span.name, test_span.test_suite_name)
-          result = !@known_tests.include?(test_id)
+          result = !@known_tests.include_test?(test_span.name, test_span.test_suite_name)
 
           if result
             Datadog.logger.debug do
+              test_id = Utils::TestRun.datadog_test_id(test_span.name, test_span.test_suite_name)
               "#{test_id} is not found in the known tests set, it is a new test"
             end
           end
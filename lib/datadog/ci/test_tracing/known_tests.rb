@@ -8,7 +8,8 @@ require_relative "../ext/telemetry"
 require_relative "../ext/transport"
 require_relative "../transport/telemetry"
 require_relative "../utils/telemetry"
-require_relative "../utils/test_run"
+require_relative "../utils/test_id_set"
+require_relative "../worker"
 
 module Datadog
   module CI
@@ -32,8 +33,11 @@ module Datadog
           end
 
           def tests
-            res = Set.new
+            add_tests_to(Utils::TestIdSet.new)
+          end
 
+          # Adds the tests of this response to the given set, without building a set for the response only
+          def add_tests_to(test_id_set)
             payload
               .fetch("data", {})
               .fetch("attributes", {})
@@ -41,12 +45,12 @@ module Datadog
               .each do |_test_module, suites_hash|
                 suites_hash.each do |test_suite, tests|
                   tests.each do |test_name|
-                    res << Utils::TestRun.datadog_test_id(test_name, test_suite)
+                    test_id_set.add_test(test_name, test_suite)
                   end
                 end
               end
 
-            res
+            test_id_set
           end
 
           def cursor
@@ -95,20 +99,18 @@ module Datadog
 
         def fetch(test_session)
           api = @api
-          return Set.new unless api
+          return Utils::TestIdSet.new unless api
 
-          result = Set.new
+          result = Utils::TestIdSet.new
           total_request_ms = 0.0
-          page_state = nil
           page_number = 1
 
           fetch_start_time = Core::Utils::Time.get_time(:float_millisecond)
 
-          loop do
-            Datadog.logger.debug { "Fetching known tests page ##{page_number}#{" with cursor" if page_state}" }
-
-            response = fetch_page(api, test_session, page_state: page_state)
+          Datadog.logger.debug { "Fetching known tests page ##{page_number}" }
+          response = fetch_page(api, test_session)
 
+          loop do
             unless response.ok?
               # mark the test session so that all events emitted in this session are tagged
               # with the hidden _dd.ci.library_configuration_error.known_tests tag
@@ -118,23 +120,41 @@ module Datadog
                 "Failed to fetch known tests page ##{page_number}, bailing out of known tests fetch. " \
                 "Early flake detection will not work."
               )
-              return Set.new
+              return Utils::TestIdSet.new
             end
 
             # @type var response: Datadog::CI::TestTracing::KnownTests::Response
             http_response = response.http_response
             total_request_ms += http_response.duration_ms if http_response
 
-            page_tests = response.tests
-            result.merge(page_tests)
-            Datadog.logger.debug { "Received #{page_tests.size} known tests from page ##{page_number} (total so far: #{result.size})" }
+            # pages are streamed: the next page is requested while the tests of this page are added to the result
+            next_page_worker = nil
+            if response.has_next?
+              page_state = response.cursor
+              Datadog.logger.debug { "Fetching known tests page ##{page_number + 1} with cursor" }
+
+              next_page_worker = Worker.new { fetch_page(api, test_session, page_state: page_state) }
+              next_page_worker.perform
+            end
 
-            unless response.has_next?
+            begin
+              size_before = result.size
+              response.add_tests_to(result)
+              Datadog.logger.debug { "Received #{result.size - size_before} known tests from page ##{page_number} (total so far: #{result.size})" }
+            ensure
+              # the next page request is never left running behind, even when adding the tests failed
+              next_page_worker&.wait_until_done
+            end
+
+            if next_page_worker.nil?
               Datadog.logger.debug { "Stopping known tests fetch: no more pages after page ##{page_number}" }
               break
             end
 
-            page_state = response.cursor
+            next_page_error = next_page_worker.error
+            raise next_page_error unless next_page_error.nil?
+
+            response = next_page_worker.result
             page_number += 1
           end
 
@@ -3,6 +3,7 @@
 require "set"
 
 require_relative "../../ext/test"
+require_relative "../../span_serialization"
 require_relative "meta_truncation"
 
 module Datadog
@@ -23,21 +24,24 @@ module Datadog
 
           REQUIRED_FIELDS = %w[error name resource start duration].freeze
 
-          attr_reader :trace, :span, :meta, :options
+          attr_reader :trace, :span, :options
 
           def initialize(trace, span, options: {})
             @trace = trace
             @span = span
             @options = options
 
-            @meta = MetaTruncation.truncate_string_values(
-              @span.meta.reject { |key, _| Ext::Test::TRANSIENT_TAGS.include?(key) }
-            )
-
             @errors = {}
             @validated = false
           end
 
+          # Built on first use only: the native encoder writes the span meta without copying it
+          def meta
+            @meta ||= MetaTruncation.truncate_string_values(
+              @span.meta.reject { |key, _| Ext::Test::TRANSIENT_TAGS.include?(key) }
+            )
+          end
+
           def to_msgpack(packer = nil)
             packer ||= MessagePack::Packer.new
 
@@ -60,6 +64,17 @@ module Datadog
             end
           end
 
+          # Appends the same bytes as #to_msgpack to buffer with the native encoder.
+          #
+          # @return [Boolean] false when the event must be encoded with #to_msgpack, buffer is left unchanged
+          def write_to(buffer)
+            return false unless SpanSerialization.respond_to?(:pack_event)
+
+            SpanSerialization.pack_event(
+              buffer, self, Ext::Test::TRANSIENT_TAGS, MetaTruncation::MAX_META_STRING_LENGTH
+            )
+          end
+
           # validates according to citestcycle json schema
           def valid?
             validate! unless @validated
@@ -37,12 +37,12 @@ module Datadog
           send_events(traces)
         end
 
-        private
-
         def telemetry_endpoint_tag
           Ext::Telemetry::Endpoint::TEST_CYCLE
         end
 
+        private
+
         def send_payload(encoded_payload)
           api.citestcycle_request(
             path: Datadog::CI::Ext::Transport::TEST_VISIBILITY_INTAKE_PATH,
@@ -50,24 +50,47 @@ module Datadog
           )
         end
 
-        def encode_events(traces)
-          traces.flat_map do |trace|
-            trace.spans.filter_map { |span| encode_span(trace, span) }
+        # Events are written in place into the payload buffers, see Serializers::Base#write_to
+        def encode_payloads(traces)
+          builder = CI::Transport::PayloadBuilder.new(payload_header, max_payload_size)
+
+          each_valid_serializer(traces) do |span, serializer|
+            too_large_event = builder.write do |buffer|
+              buffer << encoder.encode(serializer) unless serializer.write_to(buffer)
+            end
+            event_too_large?(span, too_large_event) unless too_large_event.nil?
+          end
+
+          builder.payloads
+        end
+
+        def each_encoded_event(traces)
+          each_valid_serializer(traces) do |span, serializer|
+            encoded = encoder.encode(serializer)
+            yield encoded unless event_too_large?(span, encoded)
           end
         end
 
-        def encode_span(trace, span)
+        def each_valid_serializer(traces)
+          itr_correlation_id = test_impact_analysis&.correlation_id
+
+          traces.each do |trace|
+            trace.spans.each do |span|
+              serializer = valid_serializer(trace, span, itr_correlation_id)
+              yield span, serializer unless serializer.nil?
+            end
+          end
+        end
+
+        def valid_serializer(trace, span, itr_correlation_id)
           serializer = serializers_factory.serializer(
             trace,
             span,
-            options: {itr_correlation_id: test_impact_analysis&.correlation_id}
+            options: {itr_correlation_id: itr_correlation_id}
           )
 
           if serializer.valid?
-            encoded = encoder.encode(serializer)
-            return nil if event_too_large?(span, encoded)
-
-            encoded
+            serializer
           else
             message = "Event with type #{serializer.event_type}(name=#{serializer.name}) is invalid: #{serializer.validation_errors}"
 
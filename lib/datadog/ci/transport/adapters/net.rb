@@ -1,5 +1,7 @@
 # frozen_string_literal: true
 
+require "stringio"
+
 require "datadog/core/transport/response"
 require "datadog/core/transport/ext"
 
@@ -13,27 +15,69 @@ module Datadog
     module Transport
       module Adapters
         # Adapter for Net::HTTP
+        #
+        # Connections are kept alive and reused by the following requests, up to pool_size idle connections are
+        # kept for concurrent requests. A Net::HTTP object that reconnects resumes its previous TLS session.
         class Net
+          DEFAULT_POOL_SIZE = 4
+
+          # Errors raised when a kept-alive connection was closed by the server while it was idle
+          STALE_CONNECTION_ERRORS = [
+            Errno::ECONNRESET,
+            Errno::EPIPE,
+            EOFError
+          ].freeze
+
           attr_reader \
             :hostname,
             :port,
             :timeout,
-            :ssl
+            :ssl,
+            :pool_size
 
-          def initialize(hostname:, port:, ssl:, timeout_seconds:)
+          def initialize(hostname:, port:, ssl:, timeout_seconds:, pool_size: DEFAULT_POOL_SIZE)
             @hostname = hostname
             @port = port
             @timeout = timeout_seconds
             @ssl = ssl
-          end
+            @pool_size = pool_size
 
-          def open(&block)
-            req = NetHttpClient.original_net_http.new(hostname, port)
+            @pool_mutex = Mutex.new
+            @idle_connections = []
+            @pid = Process.pid
+          end
 
-            req.use_ssl = ssl
-            req.open_timeout = req.read_timeout = timeout
+          # Yields a started connection taken from the pool. A connection that was reused and turns out to be closed
+          # by the server is replaced by a new one once, if retry_if returns true: it must only do so when the
+          # request did not reach the server, a request that was sent would be duplicated.
+          #
+          # @param retry_if [Proc, nil] called after a reused connection failed, no retry when nil
+          def open(retry_if: nil)
+            http = checkout
+            reused = http.started?
+
+            begin
+              http.start unless http.started?
+              result = yield http
+            rescue *STALE_CONNECTION_ERRORS
+              discard(http)
+              raise unless reused && retry_if&.call
+
+              http = checkout
+              begin
+                http.start unless http.started?
+                result = yield http
+              rescue
+                discard(http)
+                raise
+              end
+            rescue
+              discard(http)
+              raise
+            end
 
-            req.start(&block)
+            checkin(http)
+            result
           end
 
           def call(path:, payload:, headers:, verb:)
@@ -50,10 +94,15 @@ module Datadog
 
           def post(path:, payload:, headers:)
             post = ::Net::HTTP::Post.new(path, headers)
-            post.body = payload
-
-            # Connect and send the request
-            http_response = open do |http|
+            # the body is read while the request is sent: until it was read to the end,
+            # the server could not have received the whole request
+            body_stream = payload.respond_to?(:read) ? payload : StringIO.new(payload)
+            post.body_stream = body_stream
+            post.content_length = body_stream.size
+
+            # Connect and send the request, the request is retried on a new connection only if it was not sent
+            http_response = open(retry_if: -> { !body_stream.eof? }) do |http|
+              body_stream.rewind
               http.request(post)
             end
 
@@ -162,6 +211,46 @@ module Datadog
               "#{super}, http_response:#{http_response}"
             end
           end
+
+          private
+
+          def checkout
+            @pool_mutex.synchronize do
+              # connections of the parent process must not be used by forks, they share the same sockets
+              if @pid != Process.pid
+                @idle_connections = []
+                @pid = Process.pid
+              end
+
+              @idle_connections.pop || build_connection
+            end
+          end
+
+          def checkin(http)
+            @pool_mutex.synchronize do
+              if @pid == Process.pid && @idle_connections.size < pool_size
+                @idle_connections.push(http)
+                return
+              end
+            end
+
+            discard(http)
+          end
+
+          def discard(http)
+            http.finish if http.started?
+          rescue IOError, SystemCallError
+            # the connection is dropped anyway
+          end
+
+          def build_connection
+            http = NetHttpClient.original_net_http.new(hostname, port)
+
+            http.use_ssl = ssl
+            http.open_timeout = http.read_timeout = timeout
+
+            http
+          end
         end
       end
     end
@@ -1,6 +1,9 @@
 # frozen_string_literal: true
 
+require "digest/sha2"
+
 require_relative "base"
+require_relative "../gzip"
 require_relative "../../ext/transport"
 
 module Datadog
@@ -22,8 +25,20 @@ module Datadog
           #   {"errors":[{"status":"403","title":"Forbidden","detail":"API key is invalid"}]}
           API_KEY_ERROR_PAYLOAD_MARKER = "API key"
 
-          def initialize(api_key:, citestcycle_url:, api_url:, citestcov_url:, logs_intake_url:, cicovreprt_url:)
+          def initialize(
+            api_key:,
+            citestcycle_url:,
+            api_url:,
+            citestcov_url:,
+            logs_intake_url:,
+            cicovreprt_url:,
+            compression_level: Gzip::DEFAULT_LEVEL,
+            compression_strategy: Gzip::DEFAULT_STRATEGY
+          )
             @api_key = api_key
+            @api_url = api_url
+            @compression_level = compression_level
+            @compression_strategy = compression_strategy
             @citestcycle_http = build_http_client(citestcycle_url, compress: true)
             @api_http = build_http_client(api_url, compress: false)
             @citestcov_http = build_http_client(citestcov_url, compress: true)
@@ -52,9 +67,9 @@ module Datadog
           end
 
           def citestcov_request(path:, payload:, headers: {}, verb: "post")
-            super
+            citestcov_payload = super
 
-            perform_request(@citestcov_http, path: path, payload: @citestcov_payload, headers: headers, verb: verb)
+            perform_request(@citestcov_http, path: path, payload: citestcov_payload, headers: headers, verb: verb)
           end
 
           def logs_intake_request(path:, payload:, headers: {}, verb: "post")
@@ -64,9 +79,13 @@ module Datadog
           end
 
           def cicovreprt_request(path:, event_payload:, compressed_coverage_report:, headers: {}, verb: "post")
-            super
+            cicovreprt_payload = super
+
+            perform_request(@cicovreprt_http, path: path, payload: cicovreprt_payload, headers: headers, verb: verb)
+          end
 
-            perform_request(@cicovreprt_http, path: path, payload: @cicovreprt_payload, headers: headers, verb: verb)
+          def backend_id
+            "#{@api_url}/#{Digest::SHA256.hexdigest(api_key.to_s)}"
           end
 
           private
@@ -118,7 +137,9 @@ module Datadog
               host: uri.host,
               port: uri.port || 80,
               ssl: uri.scheme == "https" || uri.port == 443,
-              compress: compress
+              compress: compress,
+              compression_level: @compression_level,
+              compression_strategy: @compression_strategy
             )
           end
 
@@ -23,7 +23,8 @@ module Datadog
             headers[Ext::Transport::HEADER_CONTENT_TYPE] ||=
               "#{Ext::Transport::CONTENT_TYPE_MULTIPART_FORM_DATA}; boundary=#{citestcov_request_boundary}"
 
-            @citestcov_payload = [
+            # the multipart payload is returned instead of stored, requests can be sent concurrently
+            [
               "--#{citestcov_request_boundary}",
               'Content-Disposition: form-data; name="event"; filename="event.json"',
               "Content-Type: application/json",
@@ -48,7 +49,7 @@ module Datadog
             headers[Ext::Transport::HEADER_CONTENT_TYPE] ||=
               "#{Ext::Transport::CONTENT_TYPE_MULTIPART_FORM_DATA}; boundary=#{cicovreprt_request_boundary}"
 
-            @cicovreprt_payload = [
+            [
               "--#{cicovreprt_request_boundary}",
               'Content-Disposition: form-data; name="event"; filename="event.json"',
               "Content-Type: application/json",
@@ -63,6 +64,14 @@ module Datadog
             ].join("\r\n")
           end
 
+          # Identifies the backend the requests are sent to and the credentials they are sent with:
+          # data acknowledged by one backend must not be reused for another one.
+          #
+          # @return [String, nil]
+          def backend_id
+            nil
+          end
+
           def headers_with_default(headers)
             request_headers = default_headers
             request_headers.merge!(headers)
@@ -5,6 +5,7 @@ require "datadog/core/remote/negotiation"
 
 require_relative "agentless"
 require_relative "evp_proxy"
+require_relative "../gzip"
 require_relative "../http"
 require_relative "../../ext/transport"
 
@@ -39,7 +40,8 @@ module Datadog
               api_url: api_url,
               citestcov_url: citestcov_url,
               logs_intake_url: logs_intake_url,
-              cicovreprt_url: cicovreprt_url
+              cicovreprt_url: cicovreprt_url,
+              **compression_options(settings)
             )
           end
 
@@ -57,7 +59,20 @@ module Datadog
 
             return nil if evp_proxy_path_prefix.nil?
 
-            EvpProxy.new(agent_settings: agent_settings, path_prefix: evp_proxy_path_prefix)
+            EvpProxy.new(
+              agent_settings: agent_settings,
+              path_prefix: evp_proxy_path_prefix,
+              **compression_options(settings)
+            )
+          end
+
+          def self.compression_options(settings)
+            {
+              compression_level: settings.ci.transport_compression_level,
+              compression_strategy: Gzip::STRATEGIES.fetch(
+                settings.ci.transport_compression_strategy, Gzip::DEFAULT_STRATEGY
+              )
+            }
           end
         end
       end
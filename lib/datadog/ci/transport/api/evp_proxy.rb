@@ -3,6 +3,7 @@
 require "datadog/core/environment/container"
 
 require_relative "base"
+require_relative "../gzip"
 require_relative "../../ext/transport"
 
 module Datadog
@@ -10,7 +11,16 @@ module Datadog
     module Transport
       module Api
         class EvpProxy < Base
-          def initialize(agent_settings:, path_prefix: Ext::Transport::EVP_PROXY_V2_PATH_PREFIX)
+          def initialize(
+            agent_settings:,
+            path_prefix: Ext::Transport::EVP_PROXY_V2_PATH_PREFIX,
+            compression_level: Gzip::DEFAULT_LEVEL,
+            compression_strategy: Gzip::DEFAULT_STRATEGY
+          )
+            @compression_level = compression_level
+            @compression_strategy = compression_strategy
+            @agent_url = "#{agent_settings.hostname}:#{agent_settings.port}"
+
             @agent_intake_http = build_http_client(
               agent_settings,
               compress: Ext::Transport::EVP_PROXY_COMPRESSION_SUPPORTED[path_prefix]
@@ -39,11 +49,11 @@ module Datadog
           end
 
           def citestcov_request(path:, payload:, headers: {}, verb: "post")
-            super
+            citestcov_payload = super
 
             headers[Ext::Transport::HEADER_EVP_SUBDOMAIN] = Ext::Transport::TEST_COVERAGE_INTAKE_HOST_PREFIX
 
-            perform_request(@agent_intake_http, path: path, payload: @citestcov_payload, headers: headers, verb: verb)
+            perform_request(@agent_intake_http, path: path, payload: citestcov_payload, headers: headers, verb: verb)
           end
 
           def logs_intake_request(path:, payload:, headers: {}, verb: "post")
@@ -51,11 +61,15 @@ module Datadog
           end
 
           def cicovreprt_request(path:, event_payload:, compressed_coverage_report:, headers: {}, verb: "post")
-            super
+            cicovreprt_payload = super
 
             headers[Ext::Transport::HEADER_EVP_SUBDOMAIN] = Ext::Transport::CODE_COVERAGE_REPORT_INTAKE_HOST_PREFIX
 
-            perform_request(@agent_intake_http, path: path, payload: @cicovreprt_payload, headers: headers, verb: verb)
+            perform_request(@agent_intake_http, path: path, payload: cicovreprt_payload, headers: headers, verb: verb)
+          end
+
+          def backend_id
+            "#{@agent_url}#{@path_prefix}"
           end
 
           private
@@ -94,7 +108,9 @@ module Datadog
               port: agent_settings.port,
               ssl: agent_settings.ssl,
               timeout: agent_settings.timeout_seconds,
-              compress: compress
+              compress: compress,
+              compression_level: @compression_level,
+              compression_strategy: @compression_strategy
             )
           end
         end
@@ -3,22 +3,28 @@
 require "msgpack"
 
 require "datadog/core/encoding"
-require "datadog/core/chunker"
 
+require_relative "adapters/net"
+require_relative "payload_builder"
 require_relative "telemetry"
+require_relative "../worker"
 
 module Datadog
   module CI
     module Transport
       class EventPlatformTransport
         DEFAULT_MAX_PAYLOAD_SIZE = 4.5 * 1024 * 1024
+        # matches the connections kept alive by Adapters::Net
+        DEFAULT_MAX_CONCURRENT_REQUESTS = Adapters::Net::DEFAULT_POOL_SIZE
 
         attr_reader :api,
-          :max_payload_size
+          :max_payload_size,
+          :max_concurrent_requests
 
-        def initialize(api:, max_payload_size: DEFAULT_MAX_PAYLOAD_SIZE)
+        def initialize(api:, max_payload_size: DEFAULT_MAX_PAYLOAD_SIZE, max_concurrent_requests: DEFAULT_MAX_CONCURRENT_REQUESTS)
           @api = api
           @max_payload_size = max_payload_size
+          @max_concurrent_requests = max_concurrent_requests
         end
 
         def send_events(events)
@@ -26,71 +32,126 @@ module Datadog
 
           Datadog.logger.debug { "[#{self.class.name}] Sending #{events.count} events..." }
 
-          encoded_events = []
+          payloads = []
           # @type var serialization_duration_ms: Float
           serialization_duration_ms = Core::Utils::Time.measure(:float_millisecond) do
-            encoded_events = encode_events(events)
-            if encoded_events.empty?
+            payloads = encode_payloads(events)
+            if payloads.empty?
               Datadog.logger.debug { "[#{self.class.name}] Empty encoded events list, skipping send" }
               return []
             end
           end
 
-          Telemetry.events_enqueued_for_serialization(encoded_events.count)
+          Telemetry.events_enqueued_for_serialization(payloads.sum { |_, events_count| events_count })
           Telemetry.endpoint_payload_serialization_ms(serialization_duration_ms, endpoint: telemetry_endpoint_tag)
 
-          responses = []
+          send_payloads(payloads)
+        end
 
-          Datadog::Core::Chunker.chunk_by_size(encoded_events, max_payload_size).map do |chunk|
-            encoded_payload = pack_events(chunk)
-            Datadog.logger.debug do
-              "[#{self.class.name}] Send chunk of #{chunk.count} events; payload size #{encoded_payload.size}"
-            end
-            Telemetry.endpoint_payload_events_count(chunk.count, endpoint: telemetry_endpoint_tag)
+        # Encodes the events one by one, used to spool events that are sent later by another process.
+        #
+        # @return [Array<String>] MessagePack encoded events
+        def encode_events(events)
+          encoded_events = []
+          each_encoded_event(events) { |encoded_event| encoded_events << encoded_event }
+          encoded_events
+        end
 
-            response = send_payload(encoded_payload)
+        # Sends events encoded with #encode_events, possibly by other processes.
+        def send_encoded_events(encoded_events)
+          return [] if encoded_events.empty?
 
-            Telemetry.endpoint_payload_requests(
-              1,
-              endpoint: telemetry_endpoint_tag, compressed: response.request_compressed
-            )
-            Telemetry.endpoint_payload_requests_ms(response.duration_ms, endpoint: telemetry_endpoint_tag)
-            Telemetry.endpoint_payload_bytes(response.request_size, endpoint: telemetry_endpoint_tag)
-
-            # HTTP layer could send events and exhausted retries (if any)
-            unless response.ok?
-              Telemetry.endpoint_payload_dropped(chunk.count, endpoint: telemetry_endpoint_tag)
-              Telemetry.endpoint_payload_requests_errors(
-                1,
-                endpoint: telemetry_endpoint_tag,
-                error_type: response.telemetry_error_type,
-                status_code: response.code
-              )
-            end
+          Datadog.logger.debug { "[#{self.class.name}] Sending #{encoded_events.size} spooled events..." }
+
+          builder = PayloadBuilder.new(payload_header, max_payload_size)
+          encoded_events.each { |encoded_event| builder << encoded_event }
+
+          send_payloads(builder.payloads)
+        end
+
+        # @return [String] endpoint tag of the telemetry metrics reported for this transport
+        def telemetry_endpoint_tag
+          raise NotImplementedError, "must be implemented by the subclass"
+        end
+
+        private
+
+        # Payloads are independent from each other: they are sent concurrently, so that a payload being retried
+        # doesn't hold back the ones after it. Responses are returned in the order of the payloads.
+        def send_payloads(payloads)
+          concurrency = [max_concurrent_requests, payloads.size].min
+          return payloads.map { |encoded_payload, events_count| send_chunk(encoded_payload, events_count) } if concurrency <= 1
+
+          responses = Array.new(payloads.size)
 
-            responses << response
+          queue = Queue.new
+          payloads.each_with_index { |(encoded_payload, events_count), index| queue << [encoded_payload, events_count, index] }
+          queue.close
+
+          workers = Array.new(concurrency) do
+            Worker.new do
+              while (chunk = queue.pop)
+                encoded_payload, events_count, index = chunk
+                responses[index] = send_chunk(encoded_payload, events_count)
+              end
+            end
           end
+          workers.each(&:perform)
+          workers.each(&:wait_until_done)
+
+          error = workers.filter_map(&:error).first
+          raise error unless error.nil?
 
           responses
         end
 
-        private
+        def send_chunk(encoded_payload, events_count)
+          Datadog.logger.debug do
+            "[#{self.class.name}] Send chunk of #{events_count} events; payload size #{encoded_payload.size}"
+          end
+          Telemetry.endpoint_payload_events_count(events_count, endpoint: telemetry_endpoint_tag)
 
-        def telemetry_endpoint_tag
-          raise NotImplementedError, "must be implemented by the subclass"
+          response = send_payload(encoded_payload)
+
+          Telemetry.endpoint_payload_requests(
+            1,
+            endpoint: telemetry_endpoint_tag, compressed: response.request_compressed
+          )
+          Telemetry.endpoint_payload_requests_ms(response.duration_ms, endpoint: telemetry_endpoint_tag)
+          Telemetry.endpoint_payload_bytes(response.request_size, endpoint: telemetry_endpoint_tag)
+
+          # HTTP layer could send events and exhausted retries (if any)
+          unless response.ok?
+            Telemetry.endpoint_payload_dropped(events_count, endpoint: telemetry_endpoint_tag)
+            Telemetry.endpoint_payload_requests_errors(
+              1,
+              endpoint: telemetry_endpoint_tag,
+              error_type: response.telemetry_error_type,
+              status_code: response.code
+            )
+          end
+
+          response
         end
 
         def encoder
           Datadog::Core::Encoding::MsgpackEncoder
         end
 
-        def pack_events(encoded_events)
-          packer = MessagePack::Packer.new
+        # Encodes the events into payloads no larger than max_payload_size. Every encoded event is appended to
+        # the current payload right away, so encoded events are never held all at once next to the payloads.
+        #
+        # @return [Array<Array(String, Integer)>] payloads with the number of events in each of them
+        def encode_payloads(events)
+          builder = PayloadBuilder.new(payload_header, max_payload_size)
+          each_encoded_event(events) { |encoded_event| builder << encoded_event }
+          builder.payloads
+        end
 
+        def payload_header
+          packer = MessagePack::Packer.new
           write_payload_header(packer)
-
-          packer.write_array_header(encoded_events.count)
-          (packer.buffer.to_a + encoded_events).join
+          packer.to_s
         end
 
         def event_too_large?(event, encoded_event)
@@ -112,7 +173,8 @@ module Datadog
           raise NotImplementedError
         end
 
-        def encode_events(events)
+        # Yields every valid event encoded with MessagePack, events larger than max_payload_size are skipped.
+        def each_encoded_event(events)
           raise NotImplementedError
         end
 
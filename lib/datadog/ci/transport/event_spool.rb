@@ -0,0 +1,144 @@
+# frozen_string_literal: true
+
+require "fileutils"
+
+module Datadog
+  module CI
+    module Transport
+      # Append-only segment directory shared by the processes of one test session.
+      #
+      # Worker processes (forks or parallel_tests workers) append batches of encoded events as segment files instead
+      # of sending them. The process that created the spool reads the segments, merges the events into large payloads
+      # and sends them, so that workers don't open their own connections and don't wait for the upload on exit.
+      #
+      # A segment holds length-prefixed (32-bit big endian) encoded events. It is written to a hidden temporary file
+      # and renamed when complete, so readers never see partially written segments.
+      #
+      # @api private
+      class EventSpool
+        SEGMENT_EXTENSION = ".seg"
+        RECORD_LENGTH_FORMAT = "N"
+        RECORD_LENGTH_SIZE = 4
+
+        attr_reader :dir, :root_dir
+
+        # @param dir [String] Directory of the segments, created if it does not exist
+        # @param root_dir [String, nil] Directory created for the spools of the session, removed on cleanup
+        #   once it is empty
+        def initialize(dir:, root_dir: nil)
+          @dir = dir
+          @root_dir = root_dir
+          @segments_count = 0
+        end
+
+        # Writes the encoded events as one segment.
+        #
+        # @param encoded_events [Array<String>] Encoded events
+        # @return [Boolean] true when the segment was written
+        def append(encoded_events)
+          return true if encoded_events.empty?
+
+          capacity = encoded_events.sum { |encoded_event| encoded_event.bytesize + RECORD_LENGTH_SIZE }
+          data = String.new(encoding: Encoding::BINARY, capacity: capacity)
+          encoded_events.each do |encoded_event|
+            data << [encoded_event.bytesize].pack(RECORD_LENGTH_FORMAT) << encoded_event.b
+          end
+
+          FileUtils.mkdir_p(@dir)
+
+          # the wall clock prefix keeps the segments of all processes roughly in the order they were written
+          name = "#{Process.clock_gettime(Process::CLOCK_REALTIME, :nanosecond)}-#{Process.pid}-#{@segments_count += 1}"
+          temp_path = File.join(@dir, ".#{name}.tmp")
+
+          File.binwrite(temp_path, data)
+          File.rename(temp_path, File.join(@dir, "#{name}#{SEGMENT_EXTENSION}"))
+
+          true
+        rescue => e
+          Datadog.logger.warn("Failed to write events to spool #{@dir}: #{e.class} - #{e.message}")
+          false
+        end
+
+        def pending?
+          !segment_paths.empty?
+        end
+
+        # Yields the encoded events of the complete segments in batches of up to max_batch_size bytes, a single
+        # larger event makes a batch of its own. Segments are deleted once all of their events have been yielded.
+        #
+        # @param max_batch_size [Numeric] Maximum size of the events yielded at once
+        # @yieldparam encoded_events [Array<String>] Encoded events
+        # @return [Integer] Number of events read
+        def drain(max_batch_size)
+          events_count = 0
+          batch = []
+          batch_size = 0
+          read_segments = []
+
+          segment_paths.each do |path|
+            read_records(path).each do |encoded_event|
+              if !batch.empty? && batch_size + encoded_event.bytesize > max_batch_size
+                yield batch
+                delete(read_segments)
+
+                batch = []
+                batch_size = 0
+              end
+
+              batch << encoded_event
+              batch_size += encoded_event.bytesize
+              events_count += 1
+            end
+
+            read_segments << path
+          end
+
+          yield batch unless batch.empty?
+          delete(read_segments)
+
+          events_count
+        end
+
+        def cleanup
+          FileUtils.rm_rf(@dir)
+
+          root_dir = @root_dir
+          Dir.rmdir(root_dir) if root_dir && Dir.exist?(root_dir) && Dir.empty?(root_dir)
+        rescue => e
+          Datadog.logger.debug("Failed to cleanup spool #{@dir}: #{e.class} - #{e.message}")
+        end
+
+        private
+
+        def segment_paths
+          Dir.glob(File.join(@dir, "*#{SEGMENT_EXTENSION}")).sort
+        end
+
+        def read_records(path)
+          data = File.binread(path)
+          records = []
+          offset = 0
+
+          while offset + RECORD_LENGTH_SIZE <= data.bytesize
+            length = data.byteslice(offset, RECORD_LENGTH_SIZE).to_s.unpack1(RECORD_LENGTH_FORMAT).to_i
+            offset += RECORD_LENGTH_SIZE
+            break if offset + length > data.bytesize
+
+            records << data.byteslice(offset, length)
+            offset += length
+          end
+
+          records
+        rescue => e
+          Datadog.logger.warn("Failed to read spool segment #{path}: #{e.class} - #{e.message}")
+          []
+        end
+
+        def delete(paths)
+          paths.each { |path| File.delete(path) if File.exist?(path) }
+          paths.clear
+        end
+      end
+    end
+  end
+end
@@ -7,14 +7,83 @@ module Datadog
   module CI
     module Transport
       module Gzip
+        DEFAULT_LEVEL = Zlib::DEFAULT_COMPRESSION
+        DEFAULT_STRATEGY = Zlib::DEFAULT_STRATEGY
+
+        # zlib strategies by the names used in settings (see Ext::Transport::COMPRESSION_STRATEGIES)
+        STRATEGIES = {
+          "default" => Zlib::DEFAULT_STRATEGY,
+          "filtered" => Zlib::FILTERED,
+          "huffman_only" => Zlib::HUFFMAN_ONLY,
+          "rle" => Zlib::RLE,
+          "fixed" => Zlib::FIXED
+        }.freeze
+
+        READ_CHUNK_SIZE = 64 * 1024
+
+        # zlib window bits: maximum window size with gzip header and trailer instead of zlib ones
+        GZIP_WINDOW_BITS = Zlib::MAX_WBITS + 16
+
+        # Streaming gzip compressor: chunks are deflated as they are appended, so the uncompressed input never has
+        # to be joined into one string. zlib releases the GVL while deflating, so compressing on the writer thread
+        # doesn't hold back the test threads.
+        #
+        # The gzip header carries no file name and no modification time, so the same input always compresses to
+        # the same bytes.
+        class Compressor
+          def initialize(level: DEFAULT_LEVEL, strategy: DEFAULT_STRATEGY)
+            @deflate = Zlib::Deflate.new(level, GZIP_WINDOW_BITS, Zlib::DEF_MEM_LEVEL, strategy)
+            @output = String.new(encoding: Encoding::BINARY)
+            @input_size = 0
+          end
+
+          # @return [Integer] number of uncompressed bytes appended so far
+          attr_reader :input_size
+
+          # @param chunk [String] uncompressed bytes
+          # @return [self]
+          def <<(chunk)
+            @input_size += chunk.bytesize
+            @output << @deflate.deflate(chunk)
+            self
+          end
+
+          # Deflate everything that is left in the IO, READ_CHUNK_SIZE bytes at a time.
+          #
+          # @param io [#read] IO or StreamingPayload
+          # @return [self]
+          def write_from(io)
+            chunk = String.new(encoding: Encoding::BINARY)
+            self << chunk while io.read(READ_CHUNK_SIZE, chunk)
+            self
+          end
+
+          # Flush the remaining input and return the compressed bytes. The compressor can't be used afterwards.
+          #
+          # @return [String]
+          def finish
+            @output << @deflate.finish
+            @deflate.close
+            @output
+          end
+        end
+
         module_function
 
-        def compress(input)
-          sio = StringIO.new
-          gzip_writer = Zlib::GzipWriter.new(sio, Zlib::DEFAULT_COMPRESSION, Zlib::DEFAULT_STRATEGY)
-          gzip_writer << input
-          gzip_writer.close
-          sio.string
+        # @param input [String, StreamingPayload] readable payloads are streamed and rewound afterwards
+        # @return [String] gzip compressed bytes
+        def compress(input, level: DEFAULT_LEVEL, strategy: DEFAULT_STRATEGY)
+          compressor = Compressor.new(level: level, strategy: strategy)
+
+          if input.is_a?(String)
+            compressor << input
+          else
+            input.rewind
+            compressor.write_from(input)
+            input.rewind
+          end
+
+          compressor.finish
         end
 
         def decompress(input)
@@ -18,7 +18,9 @@ module Datadog
           :port,
           :ssl,
           :timeout,
-          :compress
+          :compress,
+          :compression_level,
+          :compression_strategy
 
         DEFAULT_TIMEOUT = 30
         MAX_RETRIES = 3
@@ -40,12 +42,23 @@ module Datadog
           SocketError        # DNS/network issues
         ].freeze
 
-        def initialize(host:, port:, timeout: DEFAULT_TIMEOUT, ssl: true, compress: false)
+        def initialize(
+          host:,
+          port:,
+          timeout: DEFAULT_TIMEOUT,
+          ssl: true,
+          compress: false,
+          compression_level: Gzip::DEFAULT_LEVEL,
+          compression_strategy: Gzip::DEFAULT_STRATEGY
+        )
           @host = host
           @port = port
           @timeout = timeout
           @ssl = ssl.nil? || ssl
           @compress = compress.nil? ? false : compress
+          @compression_level = compression_level
+          @compression_strategy = compression_strategy
+          @adapter_mutex = Mutex.new
         end
 
         def request(
@@ -62,7 +75,7 @@ module Datadog
           duration_ms = Core::Utils::Time.measure(:float_millisecond) do
             if compress
               headers[Ext::Transport::HEADER_CONTENT_ENCODING] = Ext::Transport::CONTENT_ENCODING_GZIP
-              payload = Gzip.compress(payload)
+              payload = Gzip.compress(payload, level: compression_level, strategy: compression_strategy)
             end
 
             if accept_compressed_response
@@ -151,10 +164,13 @@ module Datadog
           end
         end
 
+        # The adapter keeps the connections alive, requests sent concurrently must share it
         def adapter
-          @adapter ||= Datadog::CI::Transport::Adapters::Net.new(
-            hostname: host, port: port, ssl: ssl, timeout_seconds: timeout
-          )
+          @adapter || @adapter_mutex.synchronize do
+            @adapter ||= Datadog::CI::Transport::Adapters::Net.new(
+              hostname: host, port: port, ssl: ssl, timeout_seconds: timeout
+            )
+          end
         end
 
         class ErrorResponse < Adapters::Net::Response
@@ -0,0 +1,103 @@
+# frozen_string_literal: true
+
+module Datadog
+  module CI
+    module Transport
+      # Assembles MessagePack payloads made of a header followed by an array of encoded events.
+      #
+      # Encoded events are appended to the buffer of the current payload as they are produced. The payload is sealed
+      # when the next event would make the events in it exceed max_payload_size. The events array starts with a
+      # fixed-size (array 32) header that is patched in place when the payload is sealed, so sealed buffers are
+      # handed to the HTTP layer as they are, without joining the events again.
+      #
+      # @api private
+      class PayloadBuilder
+        ARRAY32_HEADER = [0xdd, 0].pack("CN").freeze
+        INITIAL_CAPACITY = 64 * 1024
+
+        # @param header [String] MessagePack bytes written before the events array
+        # @param max_payload_size [Numeric] Maximum size of the events in one payload
+        def initialize(header, max_payload_size)
+          @header = header.b
+          @max_payload_size = max_payload_size
+          @payloads = []
+          @buffer = nil
+          @events_count = 0
+          @events_size = 0
+        end
+
+        # @param encoded_event [String] MessagePack encoded event
+        # @return [self]
+        def <<(encoded_event)
+          event_size = encoded_event.bytesize
+          seal if @events_count > 0 && @events_size + event_size > @max_payload_size
+
+          buffer = (@buffer ||= new_buffer)
+          buffer << encoded_event
+          @events_count += 1
+          @events_size += event_size
+          self
+        end
+
+        # Yields the buffer of the current payload for an event to be written into it in place.
+        #
+        # @yieldparam buffer [String] payload buffer, the event must be appended to it
+        # @return [String, nil] the encoded event when it is larger than max_payload_size, it is not part of any payload
+        def write
+          buffer = (@buffer ||= new_buffer)
+          offset = buffer.bytesize
+
+          begin
+            yield buffer
+          rescue
+            buffer.slice!(offset, buffer.bytesize - offset)
+            raise
+          end
+
+          event_size = buffer.bytesize - offset
+          return buffer.slice!(offset, event_size) if event_size > @max_payload_size
+
+          if @events_count > 0 && @events_size + event_size > @max_payload_size
+            encoded_event = buffer.slice!(offset, event_size)
+            seal
+
+            @buffer = new_buffer << encoded_event
+          end
+
+          @events_count += 1
+          @events_size += event_size
+          nil
+        end
+
+        # Seal the current payload and return all payloads.
+        #
+        # @return [Array<Array(String, Integer)>] payloads with the number of events in each of them
+        def payloads
+          seal if @events_count > 0
+          @payloads
+        end
+
+        private
+
+        def new_buffer
+          capacity = [@header.bytesize + ARRAY32_HEADER.bytesize + @max_payload_size, INITIAL_CAPACITY].min
+          buffer = String.new(capacity: capacity.to_i, encoding: Encoding::BINARY)
+          buffer << @header << ARRAY32_HEADER
+        end
+
+        def seal
+          buffer = @buffer
+          return if buffer.nil?
+
+          # same-size replacement of the array length, the buffer is not reallocated
+          buffer[@header.bytesize + 1, 4] = [@events_count].pack("N")
+          @payloads << [buffer, @events_count]
+
+          @buffer = nil
+          @events_count = 0
+          @events_size = 0
+        end
+      end
+    end
+  end
+end
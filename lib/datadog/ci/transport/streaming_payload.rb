@@ -0,0 +1,121 @@
+# frozen_string_literal: true
+
+module Datadog
+  module CI
+    module Transport
+      # Request payload made of strings and files that is read while the request is sent, so that large files
+      # (git packfiles) are never loaded into memory at once.
+      #
+      # Files are opened when they are appended: the payload size is known upfront for the Content-Length header,
+      # and the files can be removed from disk before the request is sent. Rewinding the payload allows the same
+      # payload to be sent again when the request is retried.
+      #
+      # Implements the subset of the IO interface that Net::HTTP uses for request body streams.
+      #
+      # @api private
+      class StreamingPayload
+        READ_CHUNK_SIZE = 64 * 1024
+
+        # @return [Integer] total size of the payload in bytes
+        attr_reader :bytesize
+        alias_method :size, :bytesize
+
+        def initialize
+          @segments = []
+          @bytesize = 0
+          @segment_index = 0
+          @segment_offset = 0
+          @position = 0
+        end
+
+        # @param string [String] bytes to append to the payload
+        # @return [self]
+        def <<(string)
+          string = string.b
+          @segments << string
+          @bytesize += string.bytesize
+          self
+        end
+
+        # @param path [String] path of the file to append to the payload
+        # @return [self]
+        # @raise [SystemCallError] if the file can't be opened
+        def append_file(path)
+          file = File.open(path, "rb")
+          @segments << file
+          @bytesize += file.size
+          self
+        end
+
+        # @param length [Integer, nil] maximum number of bytes to read, everything that is left when nil
+        # @param outbuf [String, nil] buffer to read into
+        # @return [String, nil] nil at the end of the payload when length is given, as IO#read does
+        def read(length = nil, outbuf = nil)
+          outbuf = outbuf ? outbuf.clear.force_encoding(Encoding::BINARY) : String.new(encoding: Encoding::BINARY)
+          return outbuf if length == 0
+
+          while @segment_index < @segments.size && (length.nil? || outbuf.bytesize < length)
+            segment = @segments[@segment_index]
+            wanted = length.nil? ? READ_CHUNK_SIZE : [length - outbuf.bytesize, READ_CHUNK_SIZE].min
+
+            chunk =
+              if segment.is_a?(String)
+                segment.byteslice(@segment_offset, wanted)
+              else
+                read_file_segment(segment, wanted)
+              end
+
+            if chunk.nil? || chunk.empty?
+              @segment_index += 1
+              @segment_offset = 0
+              next
+            end
+
+            outbuf << chunk
+            @segment_offset += chunk.bytesize
+            @position += chunk.bytesize
+          end
+
+          return nil if outbuf.empty? && !length.nil?
+
+          outbuf
+        end
+
+        # @return [Boolean] true when the whole payload was read
+        def eof?
+          @position >= @bytesize
+        end
+
+        # @return [Integer] 0, as IO#rewind does
+        def rewind
+          @segment_index = 0
+          @segment_offset = 0
+          @position = 0
+          0
+        end
+
+        # Close the files of the payload, the payload can't be read afterwards.
+        def close
+          @segments.each { |segment| segment.close unless segment.is_a?(String) }
+          nil
+        end
+
+        # @return [String] the whole payload, for transports that need it in memory (e.g. to compress it)
+        def to_s
+          rewind
+          content = read || ""
+          rewind
+          content
+        end
+
+        private
+
+        def read_file_segment(file, length)
+          file.pread(length, @segment_offset)
+        rescue EOFError
+          nil
+        end
+      end
+    end
+  end
+end
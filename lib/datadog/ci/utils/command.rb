@@ -10,6 +10,7 @@ module Datadog
       module Command
         DEFAULT_TIMEOUT = 10 # seconds
         BUFFER_SIZE = 1024
+        STREAM_CHUNK_SIZE = 64 * 1024
 
         OPEN_STDIN_RETRY_COUNT = 3
 
@@ -92,6 +93,67 @@ module Datadog
           [output, exit_value]
         end
 
+        # Executes a command with timeout and yields its output in chunks as soon as they are read, so that
+        # large outputs are processed without being buffered in memory as a whole.
+        #
+        # The yielded String is binary, it is reused between calls and must not be retained by the block.
+        #
+        # @param command [Array<String>] Command to execute.
+        # @param timeout [Integer] Maximum execution time in seconds
+        # @yieldparam chunk [String] Next chunk of the command's combined stdout and stderr
+        # @return [Array<String, Process::Status?>] Head of the output (for error reporting) and exit status
+        def self.stream_command(command, timeout: DEFAULT_TIMEOUT)
+          chunk = String.new(capacity: STREAM_CHUNK_SIZE, encoding: Encoding::BINARY)
+          output_head = +""
+          exit_value = nil
+          thread = nil
+
+          begin
+            start = Core::Utils::Time.get_time
+
+            stdin, stderrout, thread = Open3.popen2e(*command)
+            stdin.close
+
+            while (Core::Utils::Time.get_time - start) < timeout
+              Kernel.select([stderrout], [], [], 0.1)
+
+              begin
+                stderrout.read_nonblock(STREAM_CHUNK_SIZE, chunk)
+              rescue IO::WaitReadable
+                next
+              rescue EOFError
+                break
+              end
+
+              output_head << chunk.byteslice(0, BUFFER_SIZE - output_head.bytesize) if output_head.bytesize < BUFFER_SIZE
+              yield chunk
+            end
+
+            remaining_time = timeout.to_f - (Core::Utils::Time.get_time - start)
+            thread.join(remaining_time) if thread.alive? && remaining_time.positive?
+
+            if thread.alive?
+              output_head = "Command timed out after #{timeout} seconds"
+              terminate(thread)
+            end
+
+            thread.join(1)
+            exit_value = thread.value
+          ensure
+            # the block raised: don't leave the command running
+            terminate(thread) if exit_value.nil? && thread&.alive?
+            stderrout&.close
+          end
+
+          [output_head.force_encoding(Encoding::UTF_8).scrub.strip, exit_value]
+        end
+
+        def self.terminate(thread)
+          Process.kill("TERM", thread[:pid])
+        rescue
+          # Process already terminated
+        end
+
         def self.popen_with_stdin(command, stdin_data: nil, retries_left: OPEN_STDIN_RETRY_COUNT)
           stdin = nil
           result = Open3.popen2e(*command)
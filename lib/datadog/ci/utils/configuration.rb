@@ -1,6 +1,7 @@
 # frozen_string_literal: true
 
 require_relative "../ext/test"
+require_relative "../ext/transport"
 require_relative "../git/local_repository"
 
 module Datadog
@@ -25,6 +26,30 @@ module Datadog
 
           Ext::Test::TIATestSkippingMode::TEST
         end
+
+        def self.normalize_transport_compression_level(level)
+          return level if Ext::Transport::COMPRESSION_LEVELS.include?(level)
+
+          Datadog.logger.warn(
+            "Invalid transport compression level #{level.inspect}, expected an integer between " \
+            "#{Ext::Transport::COMPRESSION_LEVELS.min} and #{Ext::Transport::COMPRESSION_LEVELS.max}. " \
+            "Falling back to the default compression level."
+          )
+
+          Ext::Transport::COMPRESSION_LEVELS.min
+        end
+
+        def self.normalize_transport_compression_strategy(strategy)
+          return strategy if Ext::Transport::COMPRESSION_STRATEGIES.include?(strategy)
+
+          Datadog.logger.warn(
+            "Invalid transport compression strategy #{strategy.inspect}, expected one of " \
+            "#{Ext::Transport::COMPRESSION_STRATEGIES.join(", ")}. " \
+            "Falling back to #{Ext::Transport::COMPRESSION_STRATEGY_DEFAULT.inspect}."
+          )
+
+          Ext::Transport::COMPRESSION_STRATEGY_DEFAULT
+        end
       end
     end
   end
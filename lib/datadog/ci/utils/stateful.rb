@@ -72,6 +72,14 @@ module Datadog
           test_optimization_cache.load_skippable_tests
         end
 
+        def load_cached_known_tests_index
+          test_optimization_cache.load_known_tests_index
+        end
+
+        def load_cached_skippable_tests_index
+          test_optimization_cache.load_skippable_tests_index
+        end
+
         def test_optimization_cache
           Datadog.send(:components).test_optimization_cache
         end
@@ -0,0 +1,85 @@
+# frozen_string_literal: true
+
+require "set"
+
+require_relative "test_run"
+
+module Datadog
+  module CI
+    module Utils
+      # Set of tests identified by Utils::TestRun.datadog_test_id that doesn't keep the ID strings around: the native
+      # implementation stores a 64-bit fingerprint per test, and #include_test? and #add_test hash the test name,
+      # suite and parameters directly without building the ID.
+      #
+      # Implementation in ext/datadog_ci_native/test_id_set.c, the Set based implementation below is used when the
+      # native extension is not available.
+      class TestIdSet
+        begin
+          require "datadog_ci_native.#{RUBY_VERSION}_#{RUBY_PLATFORM}"
+        rescue LoadError
+          # falls back to a Set of test ID strings
+        end
+
+        unless method_defined?(:include_test?)
+          def initialize(datadog_test_ids = nil)
+            @ids = Set.new
+            merge!(datadog_test_ids) unless datadog_test_ids.nil?
+          end
+
+          def initialize_copy(other)
+            super
+            @ids = @ids.dup
+          end
+
+          def size
+            @ids.size
+          end
+
+          def empty?
+            @ids.empty?
+          end
+
+          def include?(datadog_test_id)
+            @ids.include?(datadog_test_id)
+          end
+
+          def include_test?(test_name, suite, parameters = nil)
+            @ids.include?(TestRun.datadog_test_id(test_name, suite, parameters))
+          end
+
+          def <<(datadog_test_id)
+            @ids << datadog_test_id.to_s
+            self
+          end
+
+          def add_test(test_name, suite, parameters = nil)
+            @ids << TestRun.datadog_test_id(test_name, suite, parameters)
+            self
+          end
+
+          def merge!(other)
+            other_ids = other.is_a?(TestIdSet) ? other.ids : other
+            other_ids.each { |datadog_test_id| self << datadog_test_id }
+            self
+          end
+
+          def ==(other)
+            other_ids = other.is_a?(TestIdSet) ? other.ids : other
+            return false unless other_ids.respond_to?(:to_a)
+
+            @ids == Set.new(other_ids.to_a.map(&:to_s))
+          end
+
+          def inspect
+            "#<#{self.class.name} size=#{size}>"
+          end
+          alias_method :to_s, :inspect
+
+          protected
+
+          attr_reader :ids
+        end
+      end
+    end
+  end
+end
@@ -1,6 +1,9 @@
 # frozen_string_literal: true
 
+require "tmpdir"
+
 require_relative "../../../lib/datadog/ci/async_writer"
+require_relative "../../../lib/datadog/ci/transport/event_spool"
 
 RSpec.describe Datadog::CI::AsyncWriter do
   subject(:writer) { described_class.new(transport: transport, options: options) }
@@ -54,7 +57,8 @@ RSpec.describe Datadog::CI::AsyncWriter do
       let(:options) { {interval: interval} }
       let(:interval) { double("interval") }
 
-      it { expect(writer.loop_base_interval).to be interval }
+      it { expect(writer.flush_interval).to be interval }
+      it { expect(writer.flush_wait_time).to be interval }
     end
 
     context "given :back_off_ratio" do
@@ -119,6 +123,97 @@ RSpec.describe Datadog::CI::AsyncWriter do
     it { expect(writer.buffer).to have_received(:push).with(event) }
   end
 
+  describe "buffer accounting" do
+    let(:options) { {buffer_size: 3, buffer_max_bytes: 100, flush_size: 100, flush_bytes: 1000} }
+    let(:small_event) { double("event", estimated_size: 40) }
+    let(:large_event) { double("event", estimated_size: 500) }
+
+    before do
+      allow(transport).to receive(:telemetry_endpoint_tag).and_return("code_coverage")
+      allow(Datadog::CI::Transport::Telemetry).to receive(:endpoint_payload_dropped)
+    end
+
+    it "accounts buffered events by their estimated size" do
+      writer.enqueue(small_event)
+      writer.enqueue(double("event"))
+
+      expect(writer.buffered_bytes).to eq(40 + described_class::DEFAULT_EVENT_SIZE)
+    end
+
+    it "accepts an event larger than the byte budget into an empty buffer" do
+      writer.enqueue(large_event)
+
+      expect(writer.buffer.length).to eq(1)
+    end
+
+    it "drops events over the byte budget" do
+      2.times { writer.enqueue(small_event) }
+      writer.enqueue(small_event)
+
+      expect(writer.buffer.length).to eq(2)
+      expect(writer.buffered_bytes).to eq(80)
+      expect(Datadog::CI::Transport::Telemetry).to have_received(:endpoint_payload_dropped).with(1, endpoint: "code_coverage")
+    end
+
+    it "drops events over the count budget instead of replacing buffered ones" do
+      events = Array.new(4) { double("event", estimated_size: 1) }
+      events.each { |event| writer.enqueue(event) }
+
+      expect(writer.dequeue).to eq(events.first(3))
+      expect(Datadog::CI::Transport::Telemetry).to have_received(:endpoint_payload_dropped).with(1, endpoint: "code_coverage")
+    end
+
+    it "resets the accounting when events are dequeued" do
+      2.times { writer.enqueue(small_event) }
+      writer.dequeue
+
+      expect(writer.buffered_bytes).to eq(0)
+      writer.enqueue(small_event)
+      expect(writer.buffer.length).to eq(1)
+    end
+  end
+
+  describe "adaptive interval" do
+    let(:options) { {interval: 3, flush_size: 100} }
+    let(:now) { [0.0] }
+
+    before do
+      allow(Datadog::Core::Utils::Time).to receive(:get_time) { now[0] }
+    end
+
+    def flush_after(seconds, events_count)
+      now[0] += seconds
+      writer.send(:adapt_interval, events_count)
+    end
+
+    it "shortens the interval when events are written faster than they are batched" do
+      writer.send(:adapt_interval, 0)
+      flush_after(0.5, 200)
+
+      expect(writer.flush_interval).to eq(described_class::MIN_ADAPTIVE_INTERVAL)
+      expect(writer.flush_wait_time).to eq(described_class::MIN_ADAPTIVE_INTERVAL)
+    end
+
+    it "grows the interval back when the event rate drops" do
+      writer.send(:adapt_interval, 0)
+      flush_after(0.5, 200)
+      3.times { flush_after(3, 1) }
+
+      expect(writer.flush_interval).to eq(3)
+    end
+
+    context "when disabled" do
+      let(:options) { {interval: 3, flush_size: 100, adaptive_interval: false} }
+
+      it "keeps the configured interval" do
+        writer.send(:adapt_interval, 0)
+        flush_after(0.5, 200)
+
+        expect(writer.flush_interval).to eq(3)
+      end
+    end
+  end
+
   describe "#dequeue" do
     subject(:dequeue) { writer.dequeue }
 
@@ -245,6 +340,23 @@ RSpec.describe Datadog::CI::AsyncWriter do
       end
     end
 
+    context "when the worker waits for the next flush" do
+      let(:options) { {interval: 60} }
+
+      before do
+        writer.perform
+        try_wait_until { writer.running? && writer.run_loop? }
+      end
+
+      it "wakes the worker up instead of waiting for the interval" do
+        started = Datadog::Core::Utils::Time.get_time
+
+        expect(stop).to be true
+        expect(Datadog::Core::Utils::Time.get_time - started).to be < 10
+        expect(writer.running?).to be false
+      end
+    end
+
     context "given shutdown_timeout" do
       let(:options) { {shutdown_timeout: 1000} }
       include_context "shuts down the worker"
@@ -261,6 +373,157 @@ RSpec.describe Datadog::CI::AsyncWriter do
       end
     end
   end
+
+  describe "flushing" do
+    let(:events) { Array.new(4) { double("event", estimated_size: 10) } }
+    let(:flushed_events) { [] }
+
+    before do
+      allow(transport).to receive(:send_events) do |events|
+        flushed_events.concat(events)
+        []
+      end
+    end
+
+    context "when the count threshold is reached" do
+      let(:options) { {interval: 60, flush_size: 2} }
+
+      it "flushes before the interval elapses" do
+        writer.perform
+        try_wait_until { writer.running? && writer.run_loop? }
+
+        events.first(2).each { |event| writer.write(event) }
+
+        try_wait_until(seconds: 3) { flushed_events.size == 2 }
+        expect(flushed_events).to eq(events.first(2))
+      end
+    end
+
+    context "when the byte threshold is reached" do
+      let(:options) { {interval: 60, flush_bytes: 30} }
+
+      it "flushes before the interval elapses" do
+        writer.perform
+        try_wait_until { writer.running? && writer.run_loop? }
+
+        events.first(3).each { |event| writer.write(event) }
+
+        try_wait_until(seconds: 3) { flushed_events.size == 3 }
+        expect(flushed_events).to eq(events.first(3))
+      end
+    end
+
+    context "when the transport returns a server error" do
+      let(:options) { {interval: 2, back_off_ratio: 2, back_off_max: 5, adaptive_interval: false} }
+      let(:server_error) { double("response", server_error?: true) }
+
+      it "backs off the wait for the next flush until events are sent again" do
+        allow(transport).to receive(:send_events).and_return([server_error])
+        writer.send(:flush, events.first(1))
+        writer.send(:flush, events.first(1))
+        writer.send(:flush, events.first(1))
+        expect(writer.flush_wait_time).to eq(5)
+
+        allow(transport).to receive(:send_events).and_return([])
+        writer.send(:flush, events.first(1))
+        expect(writer.flush_wait_time).to eq(2)
+      end
+    end
+
+    context "with the block overflow policy" do
+      let(:options) { {interval: 60, buffer_size: 1, flush_size: 10, overflow_policy: :block} }
+
+      it "waits for the buffer to be flushed instead of dropping events" do
+        expect(Datadog::CI::Transport::Telemetry).not_to receive(:endpoint_payload_dropped)
+
+        writer.perform
+        try_wait_until { writer.running? && writer.run_loop? }
+
+        events.each { |event| writer.write(event) }
+        try_wait_until(seconds: 3) { flushed_events.size == 3 }
+
+        expect(flushed_events).to eq(events.first(3))
+        expect(writer.buffer.length).to eq(1)
+      end
+    end
+
+    context "with the block overflow policy when the worker is not running" do
+      let(:options) { {interval: 60, buffer_size: 1, flush_size: 10, overflow_policy: :block} }
+
+      it "drops the event without waiting" do
+        allow(transport).to receive(:telemetry_endpoint_tag).and_return("code_coverage")
+        expect(Datadog::CI::Transport::Telemetry).to receive(:endpoint_payload_dropped).with(1, endpoint: "code_coverage")
+
+        writer.enqueue(events[0])
+        writer.enqueue(events[1])
+
+        expect(writer.dequeue).to eq([events[0]])
+      end
+    end
+  end
+
+  describe "event spool" do
+    let(:spool_root) { Dir.mktmpdir }
+    let(:spool) { Datadog::CI::Transport::EventSpool.new(dir: File.join(spool_root, "events")) }
+    let(:options) { {interval: 60, spool: spool, spool_producer: spool_producer} }
+
+    before do
+      allow(transport).to receive(:encode_events) { |events| events.map(&:to_s) }
+      allow(transport).to receive(:send_encoded_events).and_return([])
+      allow(transport).to receive(:max_payload_size).and_return(1024)
+    end
+
+    after { FileUtils.rm_rf(spool_root) }
+
+    context "when the process is a spool producer" do
+      let(:spool_producer) { true }
+
+      it "appends the events to the spool instead of sending them" do
+        writer.write("event1")
+        writer.write("event2")
+        writer.stop(false, 5)
+
+        expect(transport).not_to have_received(:send_events)
+
+        spooled_events = []
+        spool.drain(1024) { |encoded_events| spooled_events.concat(encoded_events) }
+        expect(spooled_events).to eq(["event1", "event2"])
+      end
+
+      it "does not consider spooled events as pending work" do
+        spool.append(["event"])
+
+        expect(writer.work_pending?).to be false
+      end
+    end
+
+    context "when the process owns the spool" do
+      let(:spool_producer) { false }
+
+      it "considers spooled events as pending work" do
+        spool.append(["event"])
+
+        expect(writer.work_pending?).to be true
+      end
+
+      it "sends the spooled events on stop and removes the spool" do
+        spool.append(["event1"])
+        spool.append(["event2"])
+
+        writer.stop
+
+        expect(transport).to have_received(:send_encoded_events).with(["event1", "event2"])
+        expect(File.exist?(spool.dir)).to be false
+      end
+
+      it "becomes a producer after fork" do
+        writer.after_fork
+
+        expect(writer.spool_producer?).to be true
+      end
+    end
+  end
+
   describe "integration tests" do
     describe "forking" do
       before { skip "Fork not supported on current platform" unless Process.respond_to?(:fork) }
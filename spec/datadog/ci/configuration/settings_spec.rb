@@ -1211,6 +1211,217 @@ RSpec.describe Datadog::CI::Configuration::Settings do
         end
       end
 
+      describe "#tia_static_dependencies_cache_enabled" do
+        subject(:tia_static_dependencies_cache_enabled) { settings.ci.tia_static_dependencies_cache_enabled }
+
+        it { is_expected.to be true }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_TIA_STATIC_DEPENDENCIES_CACHE_ENABLED}" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_TIA_STATIC_DEPENDENCIES_CACHE_ENABLED => enable) do
+              example.run
+            end
+          end
+
+          context "is not defined" do
+            let(:enable) { nil }
+
+            it { is_expected.to be true }
+          end
+
+          context "is set to true" do
+            let(:enable) { "true" }
+
+            it { is_expected.to be true }
+          end
+
+          context "is set to false" do
+            let(:enable) { "false" }
+
+            it { is_expected.to be false }
+          end
+        end
+      end
+
+      describe "#tia_static_dependencies_cache_enabled=" do
+        it "updates the #tia_static_dependencies_cache_enabled setting" do
+          expect { settings.ci.tia_static_dependencies_cache_enabled = false }
+            .to change { settings.ci.tia_static_dependencies_cache_enabled }
+            .from(true)
+            .to(false)
+        end
+      end
+
+      describe "#tia_static_dependencies_cache_path" do
+        subject(:tia_static_dependencies_cache_path) { settings.ci.tia_static_dependencies_cache_path }
+
+        it { is_expected.to be nil }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_TIA_STATIC_DEPENDENCIES_CACHE_PATH}" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_TIA_STATIC_DEPENDENCIES_CACHE_PATH => path) do
+              example.run
+            end
+          end
+
+          context "is not defined" do
+            let(:path) { nil }
+
+            it { is_expected.to be nil }
+          end
+
+          context "is set" do
+            let(:path) { "/ci/cache/static-dependencies.cache" }
+
+            it { is_expected.to eq("/ci/cache/static-dependencies.cache") }
+          end
+        end
+      end
+
+      describe "#tia_static_dependencies_cache_path=" do
+        it "updates the #tia_static_dependencies_cache_path setting" do
+          expect { settings.ci.tia_static_dependencies_cache_path = "/tmp/static-dependencies.cache" }
+            .to change { settings.ci.tia_static_dependencies_cache_path }
+            .from(nil)
+            .to("/tmp/static-dependencies.cache")
+        end
+      end
+
+      describe "#tia_iseq_line_tracing_enabled" do
+        subject(:tia_iseq_line_tracing_enabled) { settings.ci.tia_iseq_line_tracing_enabled }
+
+        it { is_expected.to be false }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_TIA_ISEQ_LINE_TRACING_ENABLED}" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_TIA_ISEQ_LINE_TRACING_ENABLED => enable) do
+              example.run
+            end
+          end
+
+          context "is not defined" do
+            let(:enable) { nil }
+
+            it { is_expected.to be false }
+          end
+
+          context "is set to true" do
+            let(:enable) { "true" }
+
+            it { is_expected.to be true }
+          end
+
+          context "is set to false" do
+            let(:enable) { "false" }
+
+            it { is_expected.to be false }
+          end
+        end
+      end
+
+      describe "#tia_iseq_line_tracing_enabled=" do
+        it "updates the #tia_iseq_line_tracing_enabled setting" do
+          expect { settings.ci.tia_iseq_line_tracing_enabled = true }
+            .to change { settings.ci.tia_iseq_line_tracing_enabled }
+            .from(false)
+            .to(true)
+        end
+      end
+
+      describe "#event_spool_enabled" do
+        subject(:event_spool_enabled) { settings.ci.event_spool_enabled }
+
+        it { is_expected.to be false }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_EVENT_SPOOL_ENABLED}" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_EVENT_SPOOL_ENABLED => enable) do
+              example.run
+            end
+          end
+
+          context "is not defined" do
+            let(:enable) { nil }
+
+            it { is_expected.to be false }
+          end
+
+          context "is set to true" do
+            let(:enable) { "true" }
+
+            it { is_expected.to be true }
+          end
+        end
+      end
+
+      describe "#event_spool_dir" do
+        subject(:event_spool_dir) { settings.ci.event_spool_dir }
+
+        it { is_expected.to be_nil }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_EVENT_SPOOL_DIR} is set" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_EVENT_SPOOL_DIR => "/tmp/spool") do
+              example.run
+            end
+          end
+
+          it { is_expected.to eq("/tmp/spool") }
+        end
+      end
+
+      describe "#transport_compression_level" do
+        subject(:transport_compression_level) { settings.ci.transport_compression_level }
+
+        it { is_expected.to eq(-1) }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_TRANSPORT_COMPRESSION_LEVEL}" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_TRANSPORT_COMPRESSION_LEVEL => level) do
+              example.run
+            end
+          end
+
+          context "is set to a valid level" do
+            let(:level) { "1" }
+
+            it { is_expected.to eq(1) }
+          end
+
+          context "is set to an invalid level" do
+            let(:level) { "10" }
+
+            it { is_expected.to eq(-1) }
+          end
+        end
+      end
+
+      describe "#transport_compression_strategy" do
+        subject(:transport_compression_strategy) { settings.ci.transport_compression_strategy }
+
+        it { is_expected.to eq("default") }
+
+        context "when #{Datadog::CI::Ext::Settings::ENV_TRANSPORT_COMPRESSION_STRATEGY}" do
+          around do |example|
+            ClimateControl.modify(Datadog::CI::Ext::Settings::ENV_TRANSPORT_COMPRESSION_STRATEGY => strategy) do
+              example.run
+            end
+          end
+
+          context "is set to a valid strategy" do
+            let(:strategy) { "filtered" }
+
+            it { is_expected.to eq("filtered") }
+          end
+
+          context "is set to an invalid strategy" do
+            let(:strategy) { "fastest" }
+
+            it { is_expected.to eq("default") }
+          end
+        end
+      end
+
       describe "#code_coverage_report_upload_enabled" do
         subject(:code_coverage_report_upload_enabled) { settings.ci.code_coverage_report_upload_enabled }
 
@@ -359,6 +359,38 @@ RSpec.describe Datadog::CI::Git::ChangedLines do
     end
   end
 
+  describe "#overlaps_each" do
+    before do
+      changed_lines.add_interval(20, 25)
+      changed_lines.add_interval(5, 10)
+      changed_lines.add_interval(11, 12)
+      changed_lines.add_interval(40, 40)
+    end
+
+    it "answers unsorted queries in their original order" do
+      queries = [30, 39, 1, 4, 12, 19, 41, 100, 8, 8, 25, 40, 1, 100, 13, 19]
+
+      expect(changed_lines.overlaps_each(queries)).to eq(
+        [false, false, true, false, true, true, true, false]
+      )
+    end
+
+    it "matches #overlaps? for every query" do
+      queries = (0..45).flat_map { |start_line| [start_line, start_line + 3] }
+
+      expected = queries.each_slice(2).map { |query_start, query_end| changed_lines.overlaps?(query_start, query_end) }
+      expect(changed_lines.overlaps_each(queries)).to eq(expected)
+    end
+
+    it "returns false for invalid queries" do
+      expect(changed_lines.overlaps_each([10, 5, 20, 20])).to eq([false, true])
+    end
+
+    it "returns false for all queries when there are no changed lines" do
+      expect(described_class.new.overlaps_each([1, 10, 5, 5])).to eq([false, false])
+    end
+  end
+
   describe "#empty?" do
     it "returns true for new instance" do
       expect(changed_lines.empty?).to be true
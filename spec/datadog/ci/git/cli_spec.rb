@@ -149,6 +149,45 @@ RSpec.describe Datadog::CI::Git::CLI do
     end
   end
 
+  describe ".stream_git_command" do
+    let(:command) { ["diff", "-U0", "base", "HEAD"] }
+    let(:git_command) { ["git", "-c", "safe.directory=#{described_class.safe_directory}"] + command }
+
+    context "when command succeeds" do
+      before do
+        allow(Datadog::CI::Utils::Command).to receive(:stream_command)
+          .with(git_command, timeout: described_class::LONG_TIMEOUT) do |*, &block|
+            block.call("first chunk")
+            block.call("second chunk")
+            ["first chunk", double("status", success?: true)]
+          end
+      end
+
+      it "yields the output chunks" do
+        chunks = []
+        described_class.stream_git_command(command, timeout: described_class::LONG_TIMEOUT) { |chunk| chunks << chunk }
+
+        expect(chunks).to eq(["first chunk", "second chunk"])
+      end
+    end
+
+    context "when command fails" do
+      before do
+        allow(Datadog::CI::Utils::Command).to receive(:stream_command)
+          .and_return(["fatal: bad revision 'base'", double("status", success?: false)])
+      end
+
+      it "raises GitCommandExecutionError" do
+        expect { described_class.stream_git_command(command) {} }.to raise_error(
+          described_class::GitCommandExecutionError
+        ) do |error|
+          expect(error.output).to eq("fatal: bad revision 'base'")
+          expect(error.command).to eq("diff -U0 base HEAD")
+        end
+      end
+    end
+  end
+
   describe "::GitCommandExecutionError" do
     let(:message) { "Command failed" }
     let(:output) { "error output" }
@@ -0,0 +1,96 @@
+# frozen_string_literal: true
+
+require_relative "../../../../lib/datadog/ci/git/config_file"
+
+RSpec.describe Datadog::CI::Git::ConfigFile do
+  subject(:config) { described_class.parse(content) }
+
+  let(:content) do
+    <<~CONFIG
+      # comment
+      [core]
+      \trepositoryformatversion = 0
+      \tbare = false
+      \tlogAllRefUpdates
+      [remote "origin"]
+      \turl = https://github.com/DataDog/datadog-ci-rb.git ; trailing comment
+      \tfetch = +refs/heads/*:refs/remotes/origin/*
+      \tfetch = +refs/tags/*:refs/tags/*
+      [remote "Upper.Case"]
+      \turl = "  quoted # value  "
+      [branch "main"]
+      \tremote = origin
+      \tmerge = refs/heads/main
+      [user]
+      \tname = John \\"Johnny\\" Doe
+      \tdescription = first line \\
+      continued
+    CONFIG
+  end
+
+  describe "#get" do
+    it "returns values by case insensitive section and key names" do
+      expect(config.get("core.repositoryformatversion")).to eq("0")
+      expect(config.get("CORE.Bare")).to eq("false")
+      expect(config.get("core.logallrefupdates")).to eq("true")
+      expect(config.get("remote.origin.url")).to eq("https://github.com/DataDog/datadog-ci-rb.git")
+      expect(config.get("branch.main.merge")).to eq("refs/heads/main")
+      expect(config.get("core.missing")).to be_nil
+    end
+
+    it "keeps subsections case sensitive" do
+      expect(config.get("remote.Upper.Case.url")).to eq("  quoted # value  ")
+      expect(config.get("remote.upper.case.url")).to be_nil
+    end
+
+    it "parses escape sequences and line continuations" do
+      expect(config.get("user.name")).to eq("John \"Johnny\" Doe")
+      expect(config.get("user.description")).to eq("first line continued")
+    end
+  end
+
+  describe "#get_all" do
+    it "returns all values in order" do
+      expect(config.get_all("remote.origin.fetch")).to eq(
+        ["+refs/heads/*:refs/remotes/origin/*", "+refs/tags/*:refs/tags/*"]
+      )
+    end
+  end
+
+  describe "#subsections" do
+    it "returns subsection names" do
+      expect(config.subsections("remote")).to eq(["origin", "Upper.Case"])
+    end
+  end
+
+  describe "#merge" do
+    it "gives priority to the values of the other config" do
+      merged = described_class.parse("[core]\n\tbare = true\n[alias]\n\tco = checkout\n").merge(config)
+
+      expect(merged.get("core.bare")).to eq("false")
+      expect(merged.get("alias.co")).to eq("checkout")
+    end
+  end
+
+  context "with include directives" do
+    let(:content) { "[include]\n\tpath = other.config\n" }
+
+    it "raises UnsupportedError" do
+      expect { config }.to raise_error(described_class::UnsupportedError)
+    end
+  end
+
+  context "with unterminated quote" do
+    let(:content) { "[core]\n\tname = \"unterminated\n" }
+
+    it "raises UnsupportedError" do
+      expect { config }.to raise_error(described_class::UnsupportedError)
+    end
+  end
+
+  describe ".load" do
+    it "returns an empty config when the file does not exist" do
+      expect(described_class.load("/nonexistent/config").keys).to eq([])
+    end
+  end
+end
@@ -387,6 +387,85 @@ RSpec.describe Datadog::CI::Git::Diff do
     end
   end
 
+  describe Datadog::CI::Git::Diff::StreamParser do
+    subject(:parser) { described_class.new }
+
+    let(:git_output) do
+      <<~OUTPUT
+        diff --git a/file1.rb b/file1.rb
+        index 1234567..abcdefg 100644
+        --- a/file1.rb
+        +++ b/file1.rb
+        @@ -1,2 +1,3 @@
+         class File1
+        +@@ -100 +100 @@
+        ~
+        @@ -20 +21,2 @@
+        -  old
+        diff --git a/lib/file 2.rb b/lib/file 2.rb
+        @@ -5,0 +6 @@
+        +  # new line
+        @@ -9 +10,3 @@
+      OUTPUT
+    end
+
+    def expect_parsed_diff(diff)
+      expect(diff.size).to eq(2)
+      expect(diff.lines_changed?("file1.rb", start_line: 1, end_line: 3)).to be true
+      expect(diff.lines_changed?("file1.rb", start_line: 22, end_line: 22)).to be true
+      expect(diff.lines_changed?("file1.rb", start_line: 4, end_line: 20)).to be false
+      expect(diff.lines_changed?("file1.rb", start_line: 100, end_line: 100)).to be false
+      expect(diff.lines_changed?("lib/file 2.rb", start_line: 6, end_line: 6)).to be true
+      expect(diff.lines_changed?("lib/file 2.rb", start_line: 12, end_line: 12)).to be true
+      expect(diff.lines_changed?("lib/file 2.rb", start_line: 7, end_line: 9)).to be false
+    end
+
+    it "parses the output in a single chunk" do
+      parser << git_output
+
+      expect_parsed_diff(parser.finish)
+    end
+
+    it "parses the output split at every position" do
+      (1...git_output.bytesize).each do |split_at|
+        parser = described_class.new
+        parser << git_output.byteslice(0, split_at)
+        parser << git_output.byteslice(split_at, git_output.bytesize)
+
+        expect_parsed_diff(parser.finish)
+      end
+    end
+
+    it "parses the output fed byte by byte" do
+      git_output.each_char { |char| parser << char }
+
+      expect_parsed_diff(parser.finish)
+    end
+
+    it "parses the last line without trailing newline" do
+      parser << git_output.chomp
+
+      expect_parsed_diff(parser.finish)
+    end
+
+    it "does not keep long content lines" do
+      parser << "diff --git a/file1.rb b/file1.rb\n@@ -1 +1 @@\n+" << ("x" * 100_000)
+
+      expect(parser.instance_variable_get(:@pending)).to be_empty
+
+      parser << "x\n@@ -5 +5 @@\n"
+      diff = parser.finish
+
+      expect(diff.lines_changed?("file1.rb", start_line: 5, end_line: 5)).to be true
+    end
+
+    it "keeps file names in UTF-8" do
+      parser << "diff --git a/caf\u00e9.rb b/caf\u00e9.rb\n@@ -1 +1 @@\n".b
+
+      expect(parser.finish.lines_changed?("caf\u00e9.rb", start_line: 1, end_line: 1)).to be true
+    end
+  end
+
   describe "#inspect" do
     it "returns meaningful representation of the diff" do
       git_output = <<~OUTPUT
@@ -211,9 +211,8 @@ RSpec.describe ::Datadog::CI::Git::LocalRepository do
           expected_path = "a"
 
           # Mock the git command to return our malicious output
-          allow(Datadog::CI::Git::CLI).to receive(:exec_git_command)
-            .with(anything, timeout: anything)
-            .and_return(malicious_diff_output)
+          allow(Datadog::CI::Git::CLI).to receive(:stream_git_command)
+            .with(anything, timeout: anything) { |*, &block| block.call(malicious_diff_output) }
 
           # With the non-greedy regex, it will only capture "a" (up to the first " b/")
           # Mock relative_to_root to return a simple path
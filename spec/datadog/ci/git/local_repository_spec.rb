@@ -373,6 +373,21 @@ RSpec.describe ::Datadog::CI::Git::LocalRepository do
       end
     end
 
+    context "when the repository can't be read from .git directly" do
+      before do
+        allow(Datadog::CI::Git::RepositoryReader).to receive(:current).and_return(nil)
+      end
+
+      it "falls back to git CLI" do
+        with_custom_git_environment do
+          expect(described_class.git_commit_sha).to eq("c7f893648f656339f62fb7b4d8a6ecdf7d063835")
+          expect(described_class.git_branch).to eq("master")
+          expect(described_class.git_commit_message).to eq("First commit with ❤️")
+          expect(described_class.git_commit_users.map(&:name)).to eq(["Friendly bot", "Andrey Marchenko"])
+        end
+      end
+    end
+
     describe ".git_commits" do
       subject do
         with_custom_git_environment do
@@ -0,0 +1,72 @@
+# frozen_string_literal: true
+
+require "tmpdir"
+
+require_relative "../../../../lib/datadog/ci/git/object_store"
+
+RSpec.describe Datadog::CI::Git::ObjectStore do
+  subject(:object_store) { described_class.new(File.join(repo_path, ".git", "objects")) }
+
+  let(:tmpdir) { Dir.mktmpdir }
+  let(:repo_path) { File.join(tmpdir, "repo") }
+
+  let(:git_environment) do
+    {
+      "GIT_AUTHOR_NAME" => "Author",
+      "GIT_AUTHOR_EMAIL" => "author@example.com",
+      "GIT_COMMITTER_NAME" => "Committer",
+      "GIT_COMMITTER_EMAIL" => "committer@example.com"
+    }
+  end
+
+  def git(command)
+    Dir.chdir(repo_path) { `git #{command}` }
+  end
+
+  def all_objects
+    git("cat-file --batch-all-objects --batch-check='%(objectname) %(objecttype)'").lines.map(&:split)
+  end
+
+  before do
+    FileUtils.mkdir_p(repo_path)
+
+    ClimateControl.modify(git_environment) do
+      git("init -q")
+      10.times do |i|
+        # growing file: later versions are stored as deltas once packed
+        File.write(File.join(repo_path, "file.txt"), (1..(i + 1) * 100).to_a.join("\n"))
+        git("add file.txt")
+        git("commit -q -m 'commit #{i}'")
+      end
+    end
+  end
+
+  after do
+    FileUtils.rm_rf(tmpdir)
+  end
+
+  describe "#read" do
+    it "reads loose objects" do
+      all_objects.each do |sha, type|
+        expect(object_store.read(sha)).to eq([type, git("cat-file #{type} #{sha}").b])
+      end
+    end
+
+    it "reads packed and deltified objects" do
+      git("gc -q --aggressive")
+      expect(Dir.glob(File.join(repo_path, ".git", "objects", "pack", "*.pack"))).not_to be_empty
+
+      all_objects.each do |sha, type|
+        expect(object_store.read(sha)).to eq([type, git("cat-file #{type} #{sha}").b])
+      end
+    end
+
+    it "raises UnsupportedError for missing objects" do
+      expect { object_store.read("0" * 40) }.to raise_error(described_class::UnsupportedError)
+    end
+
+    it "raises UnsupportedError for invalid object ids" do
+      expect { object_store.read("HEAD") }.to raise_error(described_class::UnsupportedError)
+    end
+  end
+end
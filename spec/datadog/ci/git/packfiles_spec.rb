@@ -8,10 +8,10 @@ RSpec.describe ::Datadog::CI::Git::Packfiles do
   let(:excluded_commits) { commits[2..] || [] }
 
   describe ".generate" do
-    it "yields packfile" do
+    it "yields packfiles" do
       expect do |b|
         described_class.generate(included_commits: included_commits, excluded_commits: excluded_commits, &b)
-      end.to yield_with_args(/\/.+\h{8}-\h{40}\.pack$/)
+      end.to yield_with_args([/\/.+\h{8}-\h{40}\.pack$/])
     end
 
     context "empty packfiles folder" do
@@ -71,7 +71,7 @@ RSpec.describe ::Datadog::CI::Git::Packfiles do
       it "creates temporary folder in the current directory" do
         expect do |b|
           described_class.generate(included_commits: included_commits, excluded_commits: excluded_commits, &b)
-        end.to yield_with_args(/^#{current_process_tmp_folder}\/pref-sha.pack$/)
+        end.to yield_with_args([/^#{current_process_tmp_folder}\/pref-sha.pack$/])
 
         expect(File.exist?(current_process_tmp_folder)).to be_falsey
       end
@@ -0,0 +1,172 @@
+# frozen_string_literal: true
+
+require "tmpdir"
+
+require_relative "../../../../lib/datadog/ci/git/repository_reader"
+
+RSpec.describe Datadog::CI::Git::RepositoryReader do
+  let(:tmpdir) { Dir.mktmpdir }
+  let(:upstream_path) { File.join(tmpdir, "upstream") }
+  let(:repo_path) { File.join(tmpdir, "repo") }
+
+  let(:git_environment) do
+    {
+      "GIT_AUTHOR_NAME" => "Jöhn Author",
+      "GIT_AUTHOR_EMAIL" => "author@example.com",
+      "GIT_COMMITTER_NAME" => "Committer",
+      "GIT_COMMITTER_EMAIL" => "committer@example.com",
+      "GIT_DIR" => nil,
+      "GIT_WORK_TREE" => nil,
+      # isolate from the user's and system's git config
+      "HOME" => tmpdir,
+      "XDG_CONFIG_HOME" => nil,
+      "GIT_CONFIG_NOSYSTEM" => "1"
+    }
+  end
+
+  def git(command, path: repo_path)
+    ClimateControl.modify(git_environment) do
+      Dir.chdir(path) { `git #{command} 2>/dev/null`.force_encoding(Encoding::UTF_8).strip }
+    end
+  end
+
+  def read(&block)
+    ClimateControl.modify(git_environment) do
+      Dir.chdir(repo_path) { described_class.read(&block) }
+    end
+  end
+
+  # every value read from .git must be the output of the matching git command
+  def expect_same_as_git_cli
+    expect(read(&:root)).to eq(git("rev-parse --show-toplevel"))
+    expect(read(&:head_sha)).to eq(git("rev-parse HEAD"))
+    expect(read(&:branch)).to eq(git("rev-parse --abbrev-ref HEAD"))
+    expect(read(&:tags_pointing_at_head)).to eq(git("tag --points-at HEAD"))
+    expect(read { |reader| reader.commit.message }).to eq(git("log -n 1 --format=%B"))
+    expect(read(&:remote_url)).to eq(git("ls-remote --get-url"))
+    expect(read(&:remotes)).to eq(git("remote"))
+    expect(read(&:upstream_branch)).to eq(git("rev-parse --abbrev-ref --symbolic-full-name @{upstream}"))
+    expect(read(&:shallow?).to_s).to eq(git("rev-parse --is-shallow-repository"))
+
+    commit = read(&:commit)
+    expect(
+      [commit.author_name, commit.author_email, commit.author_timestamp,
+        commit.committer_name, commit.committer_email, commit.committer_timestamp].join("\t")
+    ).to eq(git("show -s --format=%an%x09%ae%x09%at%x09%cn%x09%ce%x09%ct"))
+  end
+
+  before do
+    FileUtils.mkdir_p(upstream_path)
+
+    git("init -q", path: upstream_path)
+    5.times do |i|
+      File.write(File.join(upstream_path, "file.txt"), (1..(i + 1) * 100).to_a.join("\n"))
+      git("add file.txt", path: upstream_path)
+      git("commit -q -m 'Commit #{i} ❤️\n\nWith body'", path: upstream_path)
+    end
+    git("tag -a v1 -m 'annotated tag'", path: upstream_path)
+    git("tag lightweight", path: upstream_path)
+
+    git("clone -q #{upstream_path} #{repo_path}", path: tmpdir)
+    git("remote add another https://example.com/another.git")
+  end
+
+  after do
+    FileUtils.rm_rf(tmpdir)
+  end
+
+  context "with a fresh clone" do
+    it "reads the same metadata as git" do
+      expect_same_as_git_cli
+    end
+  end
+
+  context "with packed refs and objects" do
+    before do
+      git("gc -q --aggressive")
+    end
+
+    it "reads the same metadata as git" do
+      expect(File).to exist(File.join(repo_path, ".git", "packed-refs"))
+
+      expect_same_as_git_cli
+    end
+  end
+
+  context "with detached HEAD and a loose annotated tag" do
+    before do
+      git("checkout -q --detach HEAD~2")
+      git("tag -a v0 -m 'loose annotated tag'")
+    end
+
+    it "reads the same metadata as git" do
+      expect(read(&:branch)).to eq("HEAD")
+      expect(read(&:tags_pointing_at_head)).to eq("v0")
+
+      expect_same_as_git_cli
+    end
+  end
+
+  context "with a worktree" do
+    let(:worktree_path) { File.join(tmpdir, "worktree") }
+
+    it "reads the branch of the worktree" do
+      git("worktree add -q -b worktree-branch #{worktree_path}")
+
+      branch = ClimateControl.modify(git_environment) { Dir.chdir(worktree_path) { described_class.read(&:branch) } }
+      expect(branch).to eq("worktree-branch")
+    end
+  end
+
+  context "when the branch name is ambiguous" do
+    before do
+      git("tag #{git("rev-parse --abbrev-ref HEAD")}")
+    end
+
+    it "does not read the branch" do
+      expect(read(&:branch)).to be_nil
+    end
+  end
+
+  context "when the config rewrites urls" do
+    before do
+      git("config url.https://rewritten.example.com/.insteadOf #{upstream_path}")
+    end
+
+    it "does not read the remote url" do
+      expect(read(&:remote_url)).to be_nil
+    end
+  end
+
+  context "when the config sets the tag sort order" do
+    before do
+      git("tag v10")
+      git("tag v9")
+      git("config tag.sort version:refname")
+    end
+
+    it "does not read the tags" do
+      expect(git("tag --points-at HEAD")).to end_with("v9\nv10")
+      expect(read(&:tags_pointing_at_head)).to be_nil
+    end
+  end
+
+  context "when the repository uses an unsupported format extension" do
+    before do
+      git("config extensions.refStorage reftable")
+      git("config core.repositoryformatversion 1")
+    end
+
+    it "does not read the repository" do
+      expect(read(&:root)).to be_nil
+    end
+  end
+
+  context "when git environment variables change the repository layout" do
+    it "does not read the repository" do
+      ClimateControl.modify(git_environment.merge("GIT_OBJECT_DIRECTORY" => File.join(tmpdir, "objects"))) do
+        expect(described_class.current).to be_nil
+      end
+    end
+  end
+end
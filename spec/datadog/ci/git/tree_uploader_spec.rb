@@ -5,7 +5,7 @@ require_relative "../../../../lib/datadog/ci/git/tree_uploader"
 RSpec.describe Datadog::CI::Git::TreeUploader do
   include_context "Telemetry spy"
 
-  let(:api) { double("api") }
+  let(:api) { double("api", backend_id: "api.datadoghq.com:443/api-key-digest") }
   let(:force_unshallow) { false }
   subject(:tree_uploader) { described_class.new(api: api, force_unshallow: force_unshallow) }
 
@@ -24,9 +24,12 @@ RSpec.describe Datadog::CI::Git::TreeUploader do
     let(:search_commits) { double("search_commits", call: backend_commits) }
     let(:test_tracing_component) { double("test_tracing_component", client_process?: false) }
     let(:test_optimization_cache) { double("test_optimization_cache", cache_available?: false) }
+    let(:uploaded_commits_cache) { nil }
 
     before do
       allow(Datadog::CI::Git::SearchCommits).to receive(:new).with(api: api).and_return(search_commits)
+      allow(Datadog::CI::Git::UploadedCommitsCache).to receive(:for_repository)
+        .with(repository_url, "api.datadoghq.com:443/api-key-digest").and_return(uploaded_commits_cache)
       allow(tree_uploader).to receive(:test_tracing_component).and_return(test_tracing_component)
       allow(tree_uploader).to receive(:test_optimization_cache).and_return(test_optimization_cache)
     end
@@ -131,7 +134,7 @@ RSpec.describe Datadog::CI::Git::TreeUploader do
               expect(Datadog::CI::Git::Packfiles).to receive(:generate).with(
                 included_commits: %w[13c988d4f15e06bcdd0b0af290086a3079cdadb0],
                 excluded_commits: backend_commits
-              ).and_yield("packfile_path")
+              ).and_yield(["packfile_path"])
 
               subject
             end
@@ -149,7 +152,7 @@ RSpec.describe Datadog::CI::Git::TreeUploader do
               expect(Datadog::CI::Git::Packfiles).to receive(:generate).with(
                 included_commits: %w[13c988d4f15e06bcdd0b0af290086a3079cdadb0 782d09e3fbfd8cf1b5c13f3eb9621362f9089ed5],
                 excluded_commits: backend_commits
-              ).and_yield("packfile_path")
+              ).and_yield(["packfile_path"])
 
               subject
             end
@@ -163,7 +166,7 @@ RSpec.describe Datadog::CI::Git::TreeUploader do
             expect(Datadog::CI::Git::Packfiles).to receive(:generate).with(
               included_commits: latest_commits - backend_commits.to_a,
               excluded_commits: backend_commits
-            ).and_yield("packfile_path")
+            ).and_yield(["packfile_path"])
 
             expect(Datadog::CI::Git::UploadPackfile).to receive(:new).with(
               api: api,
@@ -194,6 +197,114 @@ RSpec.describe Datadog::CI::Git::TreeUploader do
             it_behaves_like "emits telemetry metric", :distribution, "git_requests.objects_pack_files", 1.0
           end
         end
+
+        context "when several packfiles are generated" do
+          let(:filepaths) { Array.new(6) { |i| "packfile_path_#{i}" } }
+          let(:uploaded) { Queue.new }
+
+          before do
+            expect(Datadog::CI::Git::LocalRepository).to receive(:git_shallow_clone?).and_return(false)
+            expect(Datadog::CI::Git::Packfiles).to receive(:generate).and_yield(filepaths)
+            expect(Datadog::CI::Git::UploadPackfile).to receive(:new).and_return(upload_packfile)
+          end
+
+          it "uploads all packfiles concurrently" do
+            threads = Queue.new
+            allow(upload_packfile).to receive(:call) do |filepath:|
+              threads << Thread.current
+              sleep(0.01)
+              uploaded << filepath
+            end
+
+            subject
+
+            expect(Array.new(uploaded.size) { uploaded.pop }).to match_array(filepaths)
+            expect(Array.new(threads.size) { threads.pop }.uniq.size).to be > 1
+          end
+
+          it_behaves_like "emits telemetry metric", :distribution, "git_requests.objects_pack_files", 6.0
+
+          context "when one of the uploads fails" do
+            it "stops uploading and logs the failure" do
+              allow(upload_packfile).to receive(:call) do |filepath:|
+                raise Datadog::CI::Git::UploadPackfile::ApiError, "test error" if filepath == "packfile_path_0"
+
+                uploaded << filepath
+              end
+              expect(Datadog.logger).to receive(:debug).with("Packfile upload failed with test error")
+
+              subject
+
+              expect(uploaded.size).to be < filepaths.size
+            end
+          end
+        end
+      end
+
+      context "with the uploaded commits cache" do
+        let(:tmpdir) { Dir.mktmpdir }
+        let(:uploaded_commits_cache) do
+          Datadog::CI::Git::UploadedCommitsCache.new(File.join(tmpdir, "uploaded-commits.cache"))
+        end
+
+        after { FileUtils.remove_entry(tmpdir) }
+
+        it "stores the commits known to the backend" do
+          allow(Datadog::CI::Git::LocalRepository).to receive(:git_shallow_clone?).and_return(false)
+          allow(Datadog::CI::Git::Packfiles).to receive(:generate)
+
+          subject
+
+          expect(uploaded_commits_cache.include?(head_commit)).to be true
+          expect(uploaded_commits_cache.include?(latest_commits.last)).to be false
+        end
+
+        context "when all latest commits are in the cache" do
+          before { uploaded_commits_cache.add(latest_commits) }
+
+          it "skips the commits search" do
+            expect(search_commits).not_to receive(:call)
+            expect(Datadog.logger).to receive(:debug).with("No new commits to upload")
+
+            subject
+          end
+        end
+
+        context "when some of the latest commits are in the cache" do
+          let(:backend_commits) { [] }
+          let(:upload_packfile) { double("upload_packfile", call: nil) }
+
+          before do
+            uploaded_commits_cache.add([head_commit])
+
+            expect(Datadog::CI::Git::LocalRepository).to receive(:git_shallow_clone?).and_return(false)
+            expect(Datadog::CI::Git::UploadPackfile).to receive(:new).and_return(upload_packfile)
+            expect(Datadog::CI::Git::Packfiles).to receive(:generate).with(
+              included_commits: [latest_commits.last],
+              excluded_commits: [head_commit]
+            ).and_yield(["packfile_path"])
+          end
+
+          it "searches only the other commits and stores the uploaded ones" do
+            expect(search_commits).to receive(:call).with(repository_url, [latest_commits.last]).and_return([])
+
+            subject
+
+            expect(uploaded_commits_cache.include?(latest_commits.last)).to be true
+          end
+
+          context "when the packfile upload fails" do
+            before do
+              expect(upload_packfile).to receive(:call).and_raise(Datadog::CI::Git::UploadPackfile::ApiError, "test error")
+            end
+
+            it "does not store the commits" do
+              subject
+
+              expect(uploaded_commits_cache.include?(latest_commits.last)).to be false
+            end
+          end
+        end
       end
     end
   end
@@ -82,24 +82,31 @@ RSpec.describe Datadog::CI::Git::UploadPackfile do
             allow(SecureRandom).to receive(:uuid).and_return("boundary")
           end
 
-          it "uploads the packfile" do
-            expect(api).to receive(:api_request).with(
-              path: Datadog::CI::Ext::Transport::DD_API_GIT_UPLOAD_PACKFILE_PATH,
-              payload: [
-                "--boundary",
-                'Content-Disposition: form-data; name="pushedSha"',
-                "Content-Type: application/json",
-                "",
-                {data: {id: "HEAD", type: "commit"}, meta: {repository_url: "https://datadoghq.com/git/test.git"}}.to_json,
-                "--boundary",
-                'Content-Disposition: form-data; name="packfile"; filename="packfile.idx"',
-                "Content-Type: application/octet-stream",
-                "",
-                "packfile contents",
-                "--boundary--"
-              ].join("\r\n"),
-              headers: {Datadog::CI::Ext::Transport::HEADER_CONTENT_TYPE => "multipart/form-data; boundary=boundary"}
-            ).and_return(http_response)
+          it "streams the packfile in the request payload" do
+            expect(api).to receive(:api_request) do |path:, payload:, headers:|
+              expect(path).to eq(Datadog::CI::Ext::Transport::DD_API_GIT_UPLOAD_PACKFILE_PATH)
+              expect(headers).to eq(
+                Datadog::CI::Ext::Transport::HEADER_CONTENT_TYPE => "multipart/form-data; boundary=boundary"
+              )
+              expect(payload).to be_a(Datadog::CI::Transport::StreamingPayload)
+              expect(payload.read).to eq(
+                [
+                  "--boundary",
+                  'Content-Disposition: form-data; name="pushedSha"',
+                  "Content-Type: application/json",
+                  "",
+                  {data: {id: "HEAD", type: "commit"}, meta: {repository_url: "https://datadoghq.com/git/test.git"}}.to_json,
+                  "--boundary",
+                  'Content-Disposition: form-data; name="packfile"; filename="packfile.idx"',
+                  "Content-Type: application/octet-stream",
+                  "",
+                  "packfile contents",
+                  "--boundary--"
+                ].join("\r\n")
+              )
+
+              http_response
+            end
 
             subject
           end
@@ -0,0 +1,131 @@
+# frozen_string_literal: true
+
+require "tmpdir"
+
+require_relative "../../../../lib/datadog/ci/git/uploaded_commits_cache"
+
+RSpec.describe Datadog::CI::Git::UploadedCommitsCache do
+  let(:tmpdir) { Dir.mktmpdir }
+  let(:path) { File.join(tmpdir, "datadog-ci", "uploaded-commits.cache") }
+  let(:commits) { %w[c7f893648f656339f62fb7b4d8a6ecdf7d063835 13c988d4f15e06bcdd0b0af290086a3079cdadb0] }
+
+  subject(:cache) { described_class.new(path) }
+
+  after { FileUtils.remove_entry(tmpdir) }
+
+  describe ".for_repository" do
+    let(:repository_url) { "https://github.com/DataDog/datadog-ci-rb.git" }
+    let(:backend_id) { "api.datadoghq.com:443/api-key-digest" }
+
+    it "stores the cache in the temporary directory, keyed by the repository URL and the backend" do
+      cache = described_class.for_repository(repository_url, backend_id)
+
+      expect(cache.path).to start_with(File.join(Dir.tmpdir, "datadog-ci-uploaded-commits", ""))
+      expect(cache.path).not_to eq(described_class.for_repository("https://github.com/DataDog/other.git", backend_id).path)
+      expect(cache.path).not_to eq(described_class.for_repository(repository_url, "api.datadoghq.eu:443/api-key-digest").path)
+      expect(cache.path).not_to eq(described_class.for_repository(repository_url, "api.datadoghq.com:443/other-digest").path)
+    end
+
+    it "returns nil when the backend is unknown" do
+      expect(described_class.for_repository(repository_url, nil)).to be_nil
+    end
+  end
+
+  describe "#include?" do
+    it "returns false when the cache file does not exist" do
+      expect(cache.include?(commits.first)).to be false
+    end
+
+    context "when the cache file is corrupted" do
+      before do
+        FileUtils.mkdir_p(File.dirname(path))
+        File.binwrite(path, "DDUC\x02\x00\x00\x00\xff\x00\x00\x00")
+      end
+
+      it "ignores the cache" do
+        expect(cache.include?(commits.first)).to be false
+      end
+    end
+
+    context "when the commits were acknowledged more than TTL_SECONDS ago" do
+      before do
+        cache.add([commits.first])
+        allow(Time).to receive(:now).and_return(Time.at(Time.now.to_i + described_class::TTL_SECONDS + 1))
+        cache.add([commits.last])
+      end
+
+      it "ignores the expired commits" do
+        next_cache = described_class.new(path)
+        expect(next_cache.include?(commits.first)).to be false
+        expect(next_cache.include?(commits.last)).to be true
+      end
+    end
+
+    context "when the cache directory is writable by other users" do
+      before do
+        cache.add(commits)
+        File.chmod(0o777, File.dirname(path))
+      end
+
+      it "ignores the cache" do
+        expect(described_class.new(path).include?(commits.first)).to be false
+      end
+    end
+  end
+
+  describe "#add" do
+    it "creates a private cache directory" do
+      cache.add(commits)
+
+      expect(File.stat(File.dirname(path)).mode & 0o777).to eq(0o700)
+      expect(File.stat(path).mode & 0o777).to eq(0o600)
+    end
+
+    it "persists the commits for the next processes" do
+      cache.add(commits + ["not a sha"])
+
+      expect(cache.include?(commits.first)).to be true
+
+      next_cache = described_class.new(path)
+      expect(next_cache.include?(commits.first)).to be true
+      expect(next_cache.include?(commits.last)).to be true
+      expect(next_cache.include?("not a sha")).to be false
+    end
+
+    it "keeps the commits added by other processes" do
+      other_cache = described_class.new(path)
+      other_cache.include?(commits.first)
+
+      cache.add([commits.first])
+      other_cache.add([commits.last])
+
+      next_cache = described_class.new(path)
+      expect(next_cache.include?(commits.first)).to be true
+      expect(next_cache.include?(commits.last)).to be true
+    end
+
+    it "does not write the cache when all commits are known" do
+      cache.add(commits)
+      mtime = File.mtime(path)
+      File.utime(mtime - 10, mtime - 10, path)
+
+      cache.add([commits.first])
+
+      expect(File.mtime(path)).to eq(mtime - 10)
+    end
+
+    context "when there are more than MAX_COMMITS commits" do
+      before { stub_const("#{described_class}::MAX_COMMITS", 2) }
+
+      it "keeps the most recent commits" do
+        cache.add([commits.first])
+        cache.add([commits.last, "782d09e3fbfd8cf1b5c13f3eb9621362f9089ed5"])
+
+        next_cache = described_class.new(path)
+        expect(next_cache.include?(commits.first)).to be false
+        expect(next_cache.include?(commits.last)).to be true
+        expect(next_cache.include?("782d09e3fbfd8cf1b5c13f3eb9621362f9089ed5")).to be true
+      end
+    end
+  end
+end
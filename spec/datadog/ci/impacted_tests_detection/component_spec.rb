@@ -130,6 +130,48 @@ RSpec.describe Datadog::CI::ImpactedTestsDetection::Component do
     end
   end
 
+  describe "#classify_tests" do
+    let(:tests) do
+      [
+        ["file1.rb", 1, 10],
+        ["/file2.rb", 7, 9],
+        ["file1.rb", 6, 8],
+        ["file2.rb", 5, 5],
+        ["not_in_set.rb", 1, 100],
+        [nil, 1, 10],
+        ["file2.rb", nil, nil]
+      ]
+    end
+
+    before do
+      component.configure(library_settings, test_session)
+    end
+
+    it "classifies all tests in their original order" do
+      expect(component.classify_tests(tests)).to eq([true, false, false, true, false, false, true])
+    end
+
+    it "caches the verdicts for the tests" do
+      component.classify_tests(tests)
+
+      expect_any_instance_of(Datadog::CI::Git::Diff).not_to receive(:lines_changed?)
+
+      test_span = instance_double(Datadog::CI::Test, name: "test", source_file: "file1.rb", start_line: 6, end_line: 8)
+      expect(component.modified?(test_span)).to be false
+
+      test_span = instance_double(Datadog::CI::Test, name: "test", source_file: "/file2.rb", start_line: 5, end_line: 5)
+      expect(component.modified?(test_span)).to be true
+    end
+
+    context "when component is not enabled" do
+      let(:impacted_tests_enabled) { false }
+
+      it "returns false for all tests" do
+        expect(component.classify_tests(tests)).to eq([false] * tests.size)
+      end
+    end
+  end
+
   describe "#tag_modified_test" do
     let(:test_span) { instance_double(Datadog::CI::Test, source_file: source_file) }
     let(:source_file) { "file1.rb" }
@@ -105,6 +105,38 @@ RSpec.describe Datadog::CI::Remote::Component do
       end
     end
 
+    context "git upload is required and takes time" do
+      let(:require_git) { true }
+      let(:git_configuration) do
+        instance_double(Datadog::CI::Remote::LibrarySettings, require_git?: false)
+      end
+
+      before do
+        allow(component).to receive(:load_component_state).and_return(false)
+
+        expect(library_settings_client).to receive(:fetch)
+          .with(test_session).and_return(library_configuration, git_configuration).twice
+      end
+
+      it "configures the other components with the first configuration before the git upload is done" do
+        configured = Queue.new
+
+        expect(git_tree_upload_worker).to receive(:wait_until_done) do
+          Timeout.timeout(5) { 5.times { configured.pop } }
+        end
+        expect(test_impact_analysis).to receive(:configure).with(git_configuration, test_session)
+
+        (configurable_components - [test_impact_analysis]).each do |component|
+          expect(component).to receive(:configure).with(library_configuration, test_session) { configured << component }
+        end
+        expect(code_coverage).to receive(:configure).with(library_configuration) { configured << code_coverage }
+
+        subject
+
+        expect(component.serialize_state).to eq(library_configuration: git_configuration)
+      end
+    end
+
     context "with distributed test session" do
       let(:test_session) { instance_double(Datadog::CI::TestSession, distributed: true) }
       let(:require_git) { false }
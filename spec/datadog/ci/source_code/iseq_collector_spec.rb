@@ -2,12 +2,69 @@
 
 require "spec_helper"
 require "datadog/ci/source_code/static_dependencies"
+require "fileutils"
 require "open3"
 require "rbconfig"
+require "tmpdir"
 
 RSpec.describe Datadog::CI::SourceCode::ISeqCollector do
   let(:lib_path) { File.expand_path("../../../../lib", __dir__) }
 
+  describe ".collect", skip: !described_class::STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE do
+    let(:root_path) { File.expand_path("static_dependencies/fixtures", __dir__) }
+    let(:ignored_path) { File.join(root_path, "ignored") }
+
+    before do
+      require "#{root_path}/constants/base_constant"
+      require "#{root_path}/ignored/ignored_constant"
+    end
+
+    it "returns only ISeqs of files under root_path and outside ignored_path" do
+      iseqs = described_class.collect(root_path, ignored_path)
+
+      expect(iseqs).not_to be_empty
+      expect(iseqs.map(&:absolute_path)).to all(start_with("#{root_path}/"))
+      expect(iseqs.map(&:absolute_path)).not_to include(start_with("#{ignored_path}/"))
+      expect(iseqs.map(&:absolute_path)).to include(File.join(root_path, "constants", "base_constant.rb"))
+    end
+  end
+
+  describe ".start_capture", skip: !described_class::STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE do
+    let(:root_path) { File.realpath(Dir.mktmpdir) }
+    let(:script_path) { File.join(root_path, "captured_script.rb") }
+    let(:ignored_script_path) { File.join(root_path, "vendor", "ignored_script.rb") }
+
+    before do
+      FileUtils.mkdir_p(File.join(root_path, "vendor"))
+      File.write(script_path, "CAPTURED_SCRIPT_VALUE = 1\n")
+      File.write(ignored_script_path, "IGNORED_SCRIPT_VALUE = 1\n")
+    end
+
+    after do
+      described_class.stop_capture
+      FileUtils.rm_rf(root_path)
+    end
+
+    it "keeps top-level ISeqs of the files loaded under root_path" do
+      described_class.start_capture(root_path, File.join(root_path, "vendor"))
+      expect(described_class.iseq_capture_active?).to be true
+
+      load script_path
+      load ignored_script_path
+      GC.start
+
+      paths = described_class.collect(root_path, File.join(root_path, "vendor")).map(&:absolute_path)
+      expect(paths).to eq([script_path])
+    end
+
+    it "releases the captured ISeqs when stopped" do
+      described_class.start_capture(root_path)
+      described_class.stop_capture
+
+      expect(described_class.iseq_capture_active?).to be false
+    end
+  end
+
   describe "debug gem compatibility", skip: !described_class::STATIC_DEPENDENCIES_EXTRACTION_AVAILABLE do
     it "allows debug to install ObjectSpace.each_iseq after datadog/ci is loaded first" do
       skip "reproduces only on Linux" unless RUBY_PLATFORM.include?("linux")
@@ -0,0 +1,168 @@
+# frozen_string_literal: true
+
+require "spec_helper"
+require "fileutils"
+require "tmpdir"
+
+require "datadog/ci/source_code/static_dependencies_cache"
+require "datadog/ci/utils/file_storage"
+
+RSpec.describe Datadog::CI::SourceCode::StaticDependenciesCache do
+  subject(:cache) { described_class.new(cache_path, root_path) }
+
+  let(:tmp_dir) { Dir.mktmpdir }
+  let(:root_path) { File.join(tmp_dir, "app") }
+  let(:cache_path) { File.join(tmp_dir, "cache", "static-dependencies.cache") }
+
+  let(:consumer_path) { File.join(root_path, "consumer.rb") }
+  let(:model_path) { File.join(root_path, "models", "model.rb") }
+
+  before do
+    FileUtils.mkdir_p(File.join(root_path, "models"))
+    File.write(consumer_path, "Model\nServices::Billing\n")
+    File.write(model_path, "class Model; end\n")
+  end
+
+  after { FileUtils.rm_rf(tmp_dir) }
+
+  def store_files
+    described_class.new(cache_path, root_path).tap(&:load).tap { |c| c.snapshot([consumer_path, model_path]) }.store(
+      {
+        consumer_path => {"Model" => true, "Services::Billing" => true},
+        model_path => {}
+      }
+    )
+  end
+
+  describe ".default_path" do
+    let(:cache_path) { described_class.default_path(root_path) }
+
+    after { FileUtils.rm_f(cache_path) }
+
+    it "is outside of the file storage directory" do
+      expect(cache_path).to start_with(described_class::DEFAULT_DIR)
+      expect(cache_path).not_to start_with(Datadog::CI::Utils::FileStorage::TEMP_DIR)
+    end
+
+    it "is different for every root path" do
+      expect(cache_path).not_to eq(described_class.default_path(File.join(tmp_dir, "other")))
+    end
+
+    it "keeps the cache when the file storage is cleaned up" do
+      store_files
+      Datadog::CI::Utils::FileStorage.store("key", "value")
+      Datadog::CI::Utils::FileStorage.cleanup
+
+      expect(File.exist?(cache_path)).to be(true)
+      expect(cache.load).to eq(
+        consumer_path => ["Model", "Services::Billing"],
+        model_path => []
+      )
+    end
+  end
+
+  describe "#load" do
+    it "returns an empty hash when there is no cache file" do
+      expect(cache.load).to eq({})
+    end
+
+    it "returns the stored constant names of unchanged files" do
+      store_files
+
+      expect(cache.load).to eq(
+        consumer_path => ["Model", "Services::Billing"],
+        model_path => []
+      )
+    end
+
+    it "drops files that changed" do
+      store_files
+      File.write(consumer_path, "Model\nServices::Payments\n")
+
+      expect(cache.load).to eq(model_path => [])
+    end
+
+    it "drops files that were removed" do
+      store_files
+      File.delete(model_path)
+
+      expect(cache.load).to eq(consumer_path => ["Model", "Services::Billing"])
+    end
+
+    it "keeps files with the same content and a different mtime" do
+      store_files
+      File.utime(Time.now + 60, Time.now + 60, consumer_path)
+
+      expect(cache.load).to include(consumer_path => ["Model", "Services::Billing"])
+    end
+
+    it "resolves files relative to the root path" do
+      store_files
+      moved_root_path = File.join(tmp_dir, "moved")
+      FileUtils.cp_r(root_path, moved_root_path)
+
+      expect(described_class.new(cache_path, moved_root_path).load).to eq(
+        File.join(moved_root_path, "consumer.rb") => ["Model", "Services::Billing"],
+        File.join(moved_root_path, "models", "model.rb") => []
+      )
+    end
+
+    it "ignores a corrupted cache file" do
+      store_files
+      File.binwrite(cache_path, File.binread(cache_path)[0, 40])
+
+      expect(cache.load).to eq({})
+    end
+  end
+
+  describe "#store" do
+    it "does not store skipped files" do
+      cache.load
+      cache.snapshot([consumer_path, model_path])
+      cache.store({consumer_path => {"Model" => true}, model_path => {}}, Set.new([consumer_path]))
+
+      expect(described_class.new(cache_path, root_path).load).to eq(model_path => [])
+    end
+
+    it "does not store files outside of the root path" do
+      cache.load
+      cache.snapshot(["/outside/file.rb"])
+      cache.store({"/outside/file.rb" => {"Model" => true}})
+
+      expect(described_class.new(cache_path, root_path).load).to eq({})
+    end
+
+    it "keeps previously cached files" do
+      store_files
+      other_path = File.join(root_path, "other.rb")
+      File.write(other_path, "Model\n")
+
+      cache.load
+      cache.snapshot([other_path])
+      cache.store({other_path => {"Model" => true}})
+
+      expect(described_class.new(cache_path, root_path).load).to eq(
+        consumer_path => ["Model", "Services::Billing"],
+        model_path => [],
+        other_path => ["Model"]
+      )
+    end
+
+    it "does not store files that were not recorded before the scan" do
+      cache.load
+      cache.snapshot([model_path])
+      cache.store({consumer_path => {"Model" => true}, model_path => {}})
+
+      expect(described_class.new(cache_path, root_path).load).to eq(model_path => [])
+    end
+
+    it "stores the state of the files when they were recorded" do
+      cache.load
+      cache.snapshot([consumer_path])
+      File.write(consumer_path, "Model\nServices::Payments\n")
+      cache.store({consumer_path => {"Model" => true, "Services::Billing" => true}})
+
+      expect(described_class.new(cache_path, root_path).load).to eq({})
+    end
+  end
+end
@@ -78,6 +78,35 @@ RSpec.describe Datadog::CI::SourceCode::StaticDependencies do
           )
         end
 
+        it "matches the dependencies extracted from ISeq#to_a" do
+          extractor = Datadog::CI::SourceCode::StaticDependenciesExtractor.new(root_path, ignored_path)
+          Datadog::CI::SourceCode::ISeqCollector.collect.each do |iseq|
+            extractor.extract(iseq)
+          end
+
+          expect(populate).to eq(extractor.dependencies_map)
+        end
+
+        context "with cache_path" do
+          let(:cache_dir) { Dir.mktmpdir }
+          let(:cache_path) { File.join(cache_dir, "static-dependencies.cache") }
+
+          after { FileUtils.rm_rf(cache_dir) }
+
+          it "stores the constant names of scanned files and reuses them" do
+            expected = populate
+
+            expect(described_class.populate!(root_path, ignored_path, cache_path: cache_path)).to eq(expected)
+            expect(File.exist?(cache_path)).to be true
+
+            expect(Datadog::CI::SourceCode::ISeqCollector).to receive(:scan_static_dependencies)
+              .with(root_path, ignored_path, hash_including(absolute_fixture_path("consumers/fully_qualified_consumer.rb")))
+              .and_call_original
+
+            expect(described_class.populate!(root_path, ignored_path, cache_path: cache_path)).to eq(expected)
+          end
+        end
+
         it "includes deeply nested constant paths" do
           result = populate
           consumer_path = absolute_fixture_path("consumers/fully_qualified_consumer.rb")
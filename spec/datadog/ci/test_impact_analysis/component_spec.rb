@@ -1260,7 +1260,7 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Component do
           fetch_skippables: instance_double(
             Datadog::CI::TestImpactAnalysis::Skippable::Response,
             correlation_id: "42",
-            tests: Set.new(["suite.test.", "suite2.test.", "suite.test3."]),
+            tests: Datadog::CI::Utils::TestIdSet.new(["suite.test.", "suite2.test.", "suite.test3."]),
             suites: Set.new,
             ok?: true
           )
@@ -1322,6 +1322,39 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Component do
     end
   end
 
+  describe "#skippable_test?" do
+    let(:skippable) do
+      instance_double(
+        Datadog::CI::TestImpactAnalysis::Skippable,
+        fetch_skippables: instance_double(
+          Datadog::CI::TestImpactAnalysis::Skippable::Response,
+          correlation_id: "42",
+          tests: Datadog::CI::Utils::TestIdSet.new(["suite.test.", "suite.test2.{\"arguments\":{}}"]),
+          suites: Set.new,
+          ok?: true
+        )
+      )
+    end
+
+    before do
+      allow(Datadog::CI::TestImpactAnalysis::Skippable).to receive(:new).and_return(skippable)
+
+      configure
+    end
+
+    it "looks the test up by name, suite and parameters" do
+      expect(component.skippable_test?("test", "suite")).to be true
+      expect(component.skippable_test?("test2", "suite", "{\"arguments\":{}}")).to be true
+      expect(component.skippable_test?("test2", "suite")).to be false
+    end
+
+    context "when not skipping tests" do
+      let(:tests_skipping_enabled) { false }
+
+      it { expect(component.skippable_test?("test", "suite")).to be false }
+    end
+  end
+
   describe "#on_test_finished" do
     subject { component.on_test_finished(test_span, testvis_context) }
 
@@ -1412,6 +1445,33 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Component do
       end
     end
 
+    context "when code coverage was collected" do
+      before do
+        configure
+
+        component.start_coverage
+        expect(1 + 1).to eq(2)
+        component.stop_coverage
+      end
+
+      it "logs the stats of the coverage collectors of all threads" do
+        # the finished thread keeps its collector alive
+        thread = Thread.new do
+          component.start_coverage
+          expect(1 + 1).to eq(2)
+          component.stop_coverage
+        end
+        thread.join
+
+        logged = []
+        allow(Datadog.logger).to receive(:debug) { |*args, &block| logged << (block ? block.call : args.first) }
+
+        subject
+
+        expect(logged).to include(a_string_matching(/Code coverage stats of 2 collector\(s\): .*stop_calls(: |=>)2\b/))
+      end
+    end
+
     context "when TestImpactAnalysis is disabled" do
       let(:local_itr_enabled) { false }
 
@@ -406,6 +406,41 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::Event do
       expect(native_bytes).to eq(encode.call)
     end
 
+    it "packs native covered files like the equivalent hash" do
+      root = Datadog::CI::Git::LocalRepository.root
+      absolute_files = Array.new(20) do |index|
+        File.join(root, "app/covered/model-#{index}.rb")
+      end
+      covered_files = Datadog::CI::TestImpactAnalysis::Coverage::CoveredFiles.new
+      absolute_files.each { |file| covered_files[file] = true }
+      custom_files = ["frontend/app.js", absolute_files.first]
+      file_serialization = Datadog::CI::FileSerialization
+
+      expect(file_serialization.pack_files(covered_files, custom_files, root)).to eq(
+        file_serialization.pack_files(absolute_files.to_h { |file| [file, true] }, custom_files, root)
+      )
+    end
+
+    it "packs the same bytes across calls, encodings and roots" do
+      root = Datadog::CI::Git::LocalRepository.root
+      absolute_file = File.join(root, "app/cached/model.rb")
+      custom_files = ["app/cached/model.rb", "frontend/app.js"]
+      file_serialization = Datadog::CI::FileSerialization
+
+      packed = file_serialization.pack_files({absolute_file => true}, custom_files, root)
+
+      expect(file_serialization.pack_files({absolute_file => true}, custom_files, root)).to eq(packed)
+      expect(
+        file_serialization.pack_files({absolute_file.b => true}, custom_files.map(&:b), root)
+      ).to eq(
+        MessagePack.pack([{"filename" => "app/cached/model.rb".b}, {"filename" => "frontend/app.js".b}])
+      )
+      expect(
+        file_serialization.pack_files({absolute_file => true}, [], File.join(root, "app"))
+      ).to eq(MessagePack.pack([{"filename" => "cached/model.rb"}]))
+      expect(file_serialization.pack_files({absolute_file => true}, custom_files, root)).to eq(packed)
+    end
+
     it "falls back for ASCII-incompatible filename encodings" do
       root = Datadog::CI::Git::LocalRepository.root
       encoded_file = "frontend/app.js".encode(Encoding::UTF_16BE)
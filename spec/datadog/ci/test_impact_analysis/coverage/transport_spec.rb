@@ -156,6 +156,29 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::Transport do
           expect(responses.count).to eq(2)
         end
 
+        context "when a chunk is slow to be sent" do
+          let(:second_chunk_sent) { Queue.new }
+
+          before do
+            allow(api).to receive(:citestcov_request) do |args|
+              span_id = MessagePack.unpack(args[:payload])["coverages"].first["span_id"]
+              if span_id == event.test_id.to_i
+                Timeout.timeout(5) { second_chunk_sent.pop }
+              else
+                second_chunk_sent << true
+              end
+
+              spy("response #{span_id}", ok?: true, span_id: span_id)
+            end
+          end
+
+          it "sends the following chunks without waiting and keeps the responses in order" do
+            responses = subject
+
+            expect(responses.map(&:span_id)).to eq(events.map { |e| e.test_id.to_i })
+          end
+        end
+
         it_behaves_like "emits telemetry metric", :inc, "events_enqueued_for_serialization", 2
         it_behaves_like "emits telemetry metric", :distribution, "endpoint_payload.events_count", 1
         it_behaves_like "emits telemetry metric", :distribution, "endpoint_payload.events_serialization_ms"
@@ -177,6 +200,39 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::Transport do
       end
     end
 
+    context "when events are encoded natively" do
+      let(:root) { Datadog::CI::Git::LocalRepository.root }
+      let(:max_payload_size) { 1000 }
+      let(:events) do
+        Array.new(50) do |index|
+          Datadog::CI::TestImpactAnalysis::Coverage::Event.new(
+            test_id: (index.zero? ? nil : (index * 1_000_003).to_s),
+            test_suite_id: "5",
+            test_session_id: "6",
+            files: files_class.new(
+              {File.join(root, "lib/file_#{index}.rb") => true},
+              [File.join(root, "frontend/app.js"), "frontend/app.js"]
+            )
+          )
+        end
+      end
+
+      def decoded(payloads)
+        payloads.map { |payload, events_count| [MessagePack.unpack(payload), events_count] }
+      end
+
+      it "produces the same payloads and chunks as the Ruby encoder" do
+        native_payloads = transport.send(:encode_payloads, events)
+
+        allow(Datadog::CI::FileSerialization).to receive(:respond_to?).and_call_original
+        allow(Datadog::CI::FileSerialization).to receive(:respond_to?).with(:pack_coverage_events).and_return(false)
+        ruby_payloads = transport.send(:encode_payloads, events)
+
+        expect(native_payloads.size).to be > 1
+        expect(decoded(native_payloads)).to eq(decoded(ruby_payloads))
+      end
+    end
+
     context "when all events are invalid" do
       subject { transport.send_events(events) }
 
@@ -206,4 +262,32 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::Transport do
       it_behaves_like "emits telemetry metric", :inc, "endpoint_payload.dropped"
     end
   end
+
+  describe "#send_encoded_events" do
+    let(:other_event) do
+      Datadog::CI::TestImpactAnalysis::Coverage::Event.new(
+        test_id: "4",
+        test_suite_id: "2",
+        test_session_id: "3",
+        files: files_class.new({"other_file.rb" => true})
+      )
+    end
+
+    it "sends events encoded by #encode_events in one payload" do
+      encoded_events = transport.encode_events([event]) + transport.encode_events([other_event])
+
+      transport.send_encoded_events(encoded_events)
+
+      expect(api).to have_received(:citestcov_request) do |args|
+        payload = MessagePack.unpack(args[:payload])
+        expect(payload["version"]).to eq(2)
+        expect(payload["coverages"].map { |coverage| coverage["span_id"] }).to eq([1, 4])
+      end
+    end
+
+    it "does not send anything without events" do
+      expect(transport.send_encoded_events([])).to eq([])
+      expect(api).not_to have_received(:citestcov_request)
+    end
+  end
 end
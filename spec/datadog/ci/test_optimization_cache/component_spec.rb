@@ -77,6 +77,19 @@ RSpec.describe Datadog::CI::TestOptimizationCache::Component do
       expect(component.load_settings).to eq("v1" => true)
     end
 
+    it "uses manifest v2 cache with its binary indexes" do
+      FileUtils.mkdir_p(http_cache_path)
+      File.write(manifest_path, "2\n")
+      File.write(
+        File.join(http_cache_path, Datadog::CI::Ext::TestOptimizationCache::SETTINGS_FILE_NAME),
+        JSON.generate("v2" => true)
+      )
+
+      expect(component.cache_available?).to be true
+      expect(component.load_settings).to eq("v2" => true)
+      expect(component.load_known_tests_index).to be_nil
+    end
+
     it "does not use manifest v1 cache when settings file is absent" do
       FileUtils.mkdir_p(legacy_cache_path)
       FileUtils.mkdir_p(File.dirname(manifest_path))
@@ -93,7 +106,7 @@ RSpec.describe Datadog::CI::TestOptimizationCache::Component do
     it "does not fall back to legacy cache when manifest version is unsupported" do
       FileUtils.mkdir_p(legacy_cache_path)
       FileUtils.mkdir_p(File.dirname(manifest_path))
-      File.write(manifest_path, "2\n")
+      File.write(manifest_path, "3\n")
 
       expect(component.cache_available?).to be false
       expect(component.load_settings).to be_nil
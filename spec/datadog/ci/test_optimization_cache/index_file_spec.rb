@@ -0,0 +1,56 @@
+# frozen_string_literal: true
+
+require "tmpdir"
+
+require_relative "../../../../lib/datadog/ci/test_optimization_cache/index_file"
+
+RSpec.describe Datadog::CI::TestOptimizationCache::IndexFile do
+  let(:dir) { Dir.mktmpdir }
+  let(:path) { File.join(dir, "known_tests.idx") }
+  let(:test_id_set) do
+    Datadog::CI::Utils::TestIdSet.new.tap do |set|
+      1_000.times { |i| set.add_test("test_#{i}", "Suite#{i % 10}") }
+    end
+  end
+
+  before do
+    skip "native extension is not available" unless Datadog::CI::Utils::TestIdSet.respond_to?(:map_index)
+  end
+
+  after { FileUtils.rm_rf(dir) }
+
+  it "maps the tests and metadata written by .write" do
+    expect(described_class.write(path, test_id_set, {"correlation_id" => "42"})).to be true
+
+    mapped_set, metadata = described_class.read(path)
+
+    expect(metadata).to eq("correlation_id" => "42")
+    expect(mapped_set).to be_frozen
+    expect(mapped_set).to eq(test_id_set)
+    expect(mapped_set.include_test?("test_7", "Suite7")).to be true
+    expect(mapped_set.include_test?("test_7", "Suite8")).to be false
+  end
+
+  it "maps empty sets" do
+    described_class.write(path, Datadog::CI::Utils::TestIdSet.new)
+
+    expect(described_class.read(path)).to eq([Datadog::CI::Utils::TestIdSet.new, {}])
+  end
+
+  it "returns nil when the file is missing" do
+    expect(described_class.read(path)).to be_nil
+  end
+
+  it "returns nil when the file is not an index" do
+    File.write(path, JSON.generate("data" => []))
+
+    expect(described_class.read(path)).to be_nil
+  end
+
+  it "returns nil when the slots are truncated" do
+    described_class.write(path, test_id_set)
+    File.binwrite(path, File.binread(path, 1_000))
+
+    expect(described_class.read(path)).to be_nil
+  end
+end
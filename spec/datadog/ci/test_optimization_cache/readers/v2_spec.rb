@@ -0,0 +1,70 @@
+# frozen_string_literal: true
+
+require_relative "../../../../../lib/datadog/ci/test_optimization_cache/readers/v2"
+
+RSpec.describe Datadog::CI::TestOptimizationCache::Readers::V2 do
+  let(:plan_folder) { Datadog::CI::Ext::TestOptimizationCache::PLAN_FOLDER }
+  let(:http_cache_path) { Datadog::CI::Ext::TestOptimizationCache::TESTOPTIMIZATION_HTTP_CACHE_PATH }
+  let(:index_cache_path) do
+    File.join(
+      Datadog::CI::Ext::TestOptimizationCache::TESTOPTIMIZATION_CACHE_PATH,
+      Datadog::CI::Ext::TestOptimizationCache::INDEX_CACHE_FOLDER_NAME
+    )
+  end
+  let(:reader) { described_class.new(plan_folder) }
+
+  around do |example|
+    FileUtils.rm_rf(plan_folder)
+    example.run
+    FileUtils.rm_rf(plan_folder)
+  end
+
+  def write_index(file_name, test_ids, metadata = {})
+    FileUtils.mkdir_p(index_cache_path)
+    Datadog::CI::TestOptimizationCache::IndexFile.write(
+      File.join(index_cache_path, file_name),
+      Datadog::CI::Utils::TestIdSet.new(test_ids),
+      metadata
+    )
+  end
+
+  it "reads the JSON responses like the manifest v1 reader" do
+    FileUtils.mkdir_p(http_cache_path)
+    File.write(
+      File.join(http_cache_path, Datadog::CI::Ext::TestOptimizationCache::SETTINGS_FILE_NAME),
+      JSON.generate("data" => {"attributes" => {}})
+    )
+
+    expect(reader.available?).to be true
+    expect(reader.load_settings).to eq("data" => {"attributes" => {}})
+  end
+
+  it "returns nil when indexes are absent" do
+    expect(reader.load_known_tests_index).to be_nil
+    expect(reader.load_skippable_tests_index).to be_nil
+  end
+
+  context "with indexes" do
+    before do
+      skip "native extension is not available" unless Datadog::CI::Utils::TestIdSet.respond_to?(:map_index)
+
+      write_index(Datadog::CI::Ext::TestOptimizationCache::KNOWN_TESTS_INDEX_FILE_NAME, ["Suite.test_a.", "Suite.test_b."])
+      write_index(
+        Datadog::CI::Ext::TestOptimizationCache::SKIPPABLE_TESTS_INDEX_FILE_NAME,
+        ["Suite.test_a.{\"arguments\":{}}"],
+        {"correlation_id" => "itr-correlation-id"}
+      )
+    end
+
+    it "maps known tests" do
+      expect(reader.load_known_tests_index).to eq(Set.new(["Suite.test_a.", "Suite.test_b."]))
+    end
+
+    it "maps skippable tests with the correlation ID" do
+      tests, correlation_id = reader.load_skippable_tests_index
+
+      expect(tests.include_test?("test_a", "Suite", "{\"arguments\":{}}")).to be true
+      expect(correlation_id).to eq("itr-correlation-id")
+    end
+  end
+end
@@ -1085,7 +1085,7 @@ RSpec.describe Datadog::CI::TestTracing::Component do
       )
     end
 
-    let(:known_tests) { Set.new(["test1", "test2"]) }
+    let(:known_tests) { Datadog::CI::Utils::TestIdSet.new(["test1", "test2"]) }
     let(:known_tests_client) do
       instance_double(
         Datadog::CI::TestTracing::KnownTests,
@@ -1128,7 +1128,7 @@ RSpec.describe Datadog::CI::TestTracing::Component do
         it_behaves_like "emits telemetry metric", :distribution, "known_tests.response_tests", 2
 
         context "and when known tests storage is empty" do
-          let(:known_tests) { Set.new }
+          let(:known_tests) { Datadog::CI::Utils::TestIdSet.new }
 
           it "disables known tests functionality" do
             expect(test_session).to receive(:set_tag).with("test.early_flake.abort_reason", "faulty")
@@ -1264,6 +1264,52 @@ RSpec.describe Datadog::CI::TestTracing::Component do
         end
       end
 
+      context "when manifest v2 known tests index from Test Optimization cache exists" do
+        let(:known_tests_index_path) do
+          File.join(
+            Datadog::CI::Ext::TestOptimizationCache::TESTOPTIMIZATION_CACHE_PATH,
+            Datadog::CI::Ext::TestOptimizationCache::INDEX_CACHE_FOLDER_NAME,
+            Datadog::CI::Ext::TestOptimizationCache::KNOWN_TESTS_INDEX_FILE_NAME
+          )
+        end
+
+        before do
+          skip "native extension is not available" unless Datadog::CI::Utils::TestIdSet.respond_to?(:map_index)
+
+          FileUtils.mkdir_p(File.dirname(known_tests_index_path))
+          FileUtils.mkdir_p(Datadog::CI::Ext::TestOptimizationCache::TESTOPTIMIZATION_HTTP_CACHE_PATH)
+          File.write(
+            File.join(Datadog::CI::Ext::TestOptimizationCache::PLAN_FOLDER, Datadog::CI::Ext::TestOptimizationCache::MANIFEST_FILE_NAME),
+            "2"
+          )
+          File.write(
+            File.join(
+              Datadog::CI::Ext::TestOptimizationCache::TESTOPTIMIZATION_HTTP_CACHE_PATH,
+              Datadog::CI::Ext::TestOptimizationCache::SETTINGS_FILE_NAME
+            ),
+            JSON.generate("data" => {"attributes" => {}})
+          )
+          Datadog::CI::TestOptimizationCache::IndexFile.write(
+            known_tests_index_path,
+            Datadog::CI::Utils::TestIdSet.new(["index suite.index test."])
+          )
+        end
+
+        after do
+          FileUtils.rm_rf(Datadog::CI::Ext::TestOptimizationCache::PLAN_FOLDER)
+        end
+
+        it "maps known tests from the index without reading the JSON response" do
+          expect(known_tests_client).not_to receive(:fetch)
+          expect(Datadog::CI::TestTracing::KnownTests::Response).not_to receive(:from_json)
+
+          subject
+
+          expect(test_tracing.known_tests).to eq(Set.new(["index suite.index test."]))
+          expect(test_tracing.known_tests_enabled).to be true
+        end
+      end
+
       context "when known_tests.json file from Test Optimization cache exists" do
         let(:known_tests_file_path) { "#{Datadog::CI::Ext::TestOptimizationCache::TESTOPTIMIZATION_CACHE_PATH}/known_tests.json" }
 
@@ -315,6 +315,44 @@ RSpec.describe Datadog::CI::TestTracing::KnownTests do
             expect(second_payload["data"]["attributes"]["page_info"]["page_state"]).to eq("next_page_cursor")
           end
 
+          it "requests the next page while adding the tests of the current page" do
+            second_page_requested = Queue.new
+            allow(api).to receive(:api_request) do |args|
+              next first_page_response unless args[:payload].include?("next_page_cursor")
+
+              second_page_requested << true
+              second_page_response
+            end
+
+            first_page = true
+            allow_any_instance_of(Datadog::CI::TestTracing::KnownTests::Response)
+              .to receive(:add_tests_to).and_wrap_original do |original, test_id_set|
+                if first_page
+                  first_page = false
+                  Timeout.timeout(5) { second_page_requested.pop }
+                end
+                original.call(test_id_set)
+              end
+
+            expect(response.size).to eq(4)
+          end
+
+          it "does not leave the next page request running when adding the tests fails" do
+            next_page_requests = Queue.new
+            allow(api).to receive(:api_request) do |args|
+              next first_page_response unless args[:payload].include?("next_page_cursor")
+
+              sleep 0.05
+              next_page_requests << true
+              second_page_response
+            end
+            allow_any_instance_of(Datadog::CI::TestTracing::KnownTests::Response)
+              .to receive(:add_tests_to).and_raise(ArgumentError, "malformed page")
+
+            expect { client.fetch(test_session) }.to raise_error(ArgumentError, "malformed page")
+            expect(next_page_requests.size).to eq(1)
+          end
+
           it_behaves_like "emits telemetry metric", :distribution, "known_tests.pages_fetched"
           it_behaves_like "emits telemetry metric", :distribution, "known_tests.total_fetch_ms"
           it_behaves_like "emits telemetry metric", :distribution, "known_tests.total_request_ms"
@@ -52,6 +52,18 @@ RSpec.describe Datadog::CI::TestTracing::Serializers::TestV2 do
         expect(metrics).to eq({"_dd.top_level" => 1, "memory_allocations" => 16, "_dd.host.vcpu_count" => Etc.nprocessors})
       end
 
+      it "writes the same bytes with the native encoder" do
+        skip "native extension is not available" unless Datadog::CI::SpanSerialization.respond_to?(:pack_event)
+
+        first_test_span.set_tag("long_test_tag", "é" * 5001)
+        first_test_span.set_metric("float_metric", 1.5)
+        first_test_span.set_metric("negative_metric", -200)
+
+        buffer = "prefix".b
+        expect(subject.write_to(buffer)).to be true
+        expect(buffer).to eq("prefix".b + MessagePack.pack(subject))
+      end
+
       it "truncates string meta tag values to the backend limit" do
         first_test_span.set_tag("long_test_tag", "b" * 5001)
 
@@ -274,16 +274,13 @@ RSpec.describe Datadog::CI::TestTracing::Transport do
         let(:max_payload_size) { 21 }
 
         before do
-          # Stub both the encoder and payload packing to return predictable sizes
-          # This completely eliminates environment-specific variations
+          # Stub the encoder to return predictable sizes, the payload header is not counted
+          # against max_payload_size. This completely eliminates environment-specific variations
           allow(Datadog::Core::Encoding::MsgpackEncoder).to receive(:encode) do |encoder, serializer|
             "0123456789" # 10 bytes
           end
-
-          # Stub pack_events to return exactly the concatenated events without any header overhead
-          allow(transport).to receive(:pack_events) do |encoded_events|
-            encoded_events.join
-          end
+          # the stubbed encoder is only used when the native encoder is not
+          allow_any_instance_of(Datadog::CI::TestTracing::Serializers::Base).to receive(:write_to).and_return(false)
         end
 
         it "sends events in two chunks" do
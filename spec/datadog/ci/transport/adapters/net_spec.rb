@@ -2,6 +2,7 @@ require "webmock"
 require "socket"
 
 require_relative "../../../../../lib/datadog/ci/transport/adapters/net"
+require_relative "../../../../../lib/datadog/ci/transport/streaming_payload"
 
 RSpec.describe Datadog::CI::Transport::Adapters::Net do
   subject(:adapter) do
@@ -27,7 +28,10 @@ RSpec.describe Datadog::CI::Transport::Adapters::Net do
       allow(http_connection).to receive(:read_timeout=).with(adapter.timeout)
       allow(http_connection).to receive(:use_ssl=).with(adapter.ssl)
 
-      allow(http_connection).to receive(:start).and_yield(http_connection)
+      started = false
+      allow(http_connection).to receive(:started?) { started }
+      allow(http_connection).to receive(:start) { started = true }
+      allow(http_connection).to receive(:finish) { started = false }
     end
   end
 
@@ -52,6 +56,78 @@ RSpec.describe Datadog::CI::Transport::Adapters::Net do
 
     it "opens and yields a Net::HTTP connection" do
       expect { |b| adapter.open(&b) }.to yield_with_args(http_connection)
+      expect(http_connection).to have_received(:start)
+    end
+
+    it "keeps the connection alive for the next request" do
+      adapter.open {}
+      adapter.open {}
+
+      expect(::Net::HTTP).to have_received(:new).once
+      expect(http_connection).to have_received(:start).once
+      expect(http_connection).not_to have_received(:finish)
+    end
+
+    it "drops the connection when the request fails" do
+      expect { adapter.open { raise Timeout::Error } }.to raise_error(Timeout::Error)
+
+      expect(http_connection).to have_received(:finish)
+    end
+
+    context "when a kept-alive connection was closed by the server" do
+      it "retries once with a new connection when the request was not sent" do
+        adapter.open {}
+
+        attempts = 0
+        result = adapter.open(retry_if: -> { true }) do
+          attempts += 1
+          raise EOFError if attempts == 1
+
+          :response
+        end
+
+        expect(result).to eq(:response)
+        expect(attempts).to eq(2)
+        expect(http_connection).to have_received(:start).twice
+      end
+
+      it "does not retry when the request may have been sent" do
+        adapter.open {}
+
+        attempts = 0
+        expect do
+          adapter.open(retry_if: -> { false }) do
+            attempts += 1
+            raise EOFError
+          end
+        end.to raise_error(EOFError)
+
+        expect(attempts).to eq(1)
+      end
+    end
+
+    context "when a new connection fails" do
+      it "does not retry" do
+        attempts = 0
+        expect do
+          adapter.open do
+            attempts += 1
+            raise Errno::ECONNRESET
+          end
+        end.to raise_error(Errno::ECONNRESET)
+
+        expect(attempts).to eq(1)
+      end
+    end
+
+    context "after fork" do
+      it "does not reuse the connections of the parent process" do
+        adapter.open {}
+        allow(Process).to receive(:pid).and_return(Process.pid + 1)
+        adapter.open {}
+
+        expect(::Net::HTTP).to have_received(:new).twice
+      end
     end
   end
 
@@ -78,8 +154,10 @@ RSpec.describe Datadog::CI::Transport::Adapters::Net do
             .and_return(post)
 
           expect(post)
-            .to receive(:body=)
-            .with(body)
+            .to receive(:body_stream=) { |body_stream| expect(body_stream.read).to eq(body) }
+          expect(post)
+            .to receive(:content_length=)
+            .with(body.bytesize)
 
           expect(http_connection)
             .to receive(:request)
@@ -132,6 +210,35 @@ RSpec.describe Datadog::CI::Transport::Adapters::Net do
       is_expected.to be_a_kind_of(described_class::Response)
       expect(post.http_response).to be(http_response)
     end
+
+    it "streams the body" do
+      expect(http_connection).to receive(:request) do |request|
+        expect(request.content_length).to eq(2)
+        expect(request.body_stream.read).to eq("{}")
+
+        http_response
+      end
+
+      post
+    end
+
+    context "with a streaming payload" do
+      let(:body) { Datadog::CI::Transport::StreamingPayload.new << "streamed payload" }
+
+      it "streams the payload from the beginning" do
+        body.read(8)
+
+        expect(http_connection).to receive(:request) do |request|
+          expect(request.body_stream).to be(body)
+          expect(request.content_length).to eq(16)
+          expect(body.read).to eq("streamed payload")
+
+          http_response
+        end
+
+        expect(post.http_response).to be(http_response)
+      end
+    end
   end
 end
 
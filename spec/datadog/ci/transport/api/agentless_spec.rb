@@ -50,38 +50,55 @@ RSpec.describe Datadog::CI::Transport::Api::Agentless do
         host: "localhost",
         port: 5555,
         ssl: false,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(citestcycle_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "localhost",
         port: 5555,
         ssl: false,
-        compress: false
+        compress: false,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(api_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "localhost",
         port: 5555,
         ssl: false,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(citestcov_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "localhost",
         port: 5555,
         ssl: false,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(logs_intake_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "localhost",
         port: 5555,
         ssl: false,
-        compress: false
+        compress: false,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(cicovreprt_http)
     end
 
+    describe "#backend_id" do
+      it "identifies the API host and the API key without including the key" do
+        expect(subject.backend_id).to eq("http://localhost:5555/#{Digest::SHA256.hexdigest(api_key)}")
+        expect(subject.backend_id).not_to include(api_key)
+      end
+    end
+
     describe "#citestcycle_request" do
       let(:expected_headers) do
         {
@@ -158,35 +175,45 @@ RSpec.describe Datadog::CI::Transport::Api::Agentless do
         host: "citestcycle-intake.datadoghq.com",
         port: 443,
         ssl: true,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(citestcycle_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "api.datadoghq.com",
         port: 443,
         ssl: true,
-        compress: false
+        compress: false,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(api_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "citestcov-intake.datadoghq.com",
         port: 443,
         ssl: true,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(citestcov_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "http-intake.logs.datadoghq.com",
         port: 443,
         ssl: true,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(logs_intake_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
         host: "ci-intake.datadoghq.com",
         port: 443,
         ssl: true,
-        compress: false
+        compress: false,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(cicovreprt_http)
     end
 
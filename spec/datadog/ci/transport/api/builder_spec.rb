@@ -42,7 +42,9 @@ RSpec.describe Datadog::CI::Transport::Api::Builder do
         api_url: "https://api.datadoghq.com:443",
         citestcov_url: "https://citestcov-intake.datadoghq.com:443",
         logs_intake_url: "https://http-intake.logs.datadoghq.com:443",
-        cicovreprt_url: "https://ci-intake.datadoghq.com:443"
+        cicovreprt_url: "https://ci-intake.datadoghq.com:443",
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(api)
 
       expect(subject).to eq(api)
@@ -58,7 +60,9 @@ RSpec.describe Datadog::CI::Transport::Api::Builder do
           api_url: "http://localhost:5555",
           citestcov_url: "http://localhost:5555",
           logs_intake_url: "http://localhost:5555",
-          cicovreprt_url: "http://localhost:5555"
+          cicovreprt_url: "http://localhost:5555",
+          compression_level: Zlib::DEFAULT_COMPRESSION,
+          compression_strategy: Zlib::DEFAULT_STRATEGY
         ).and_return(api)
 
         expect(subject).to eq(api)
@@ -75,7 +79,24 @@ RSpec.describe Datadog::CI::Transport::Api::Builder do
           api_url: "https://api.datadoghq.eu:443",
           citestcov_url: "https://citestcov-intake.datadoghq.eu:443",
           logs_intake_url: "https://http-intake.logs.datadoghq.eu:443",
-          cicovreprt_url: "https://ci-intake.datadoghq.eu:443"
+          cicovreprt_url: "https://ci-intake.datadoghq.eu:443",
+          compression_level: Zlib::DEFAULT_COMPRESSION,
+          compression_strategy: Zlib::DEFAULT_STRATEGY
+        ).and_return(api)
+
+        expect(subject).to eq(api)
+      end
+    end
+
+    context "when transport compression is configured" do
+      before do
+        settings.ci.transport_compression_level = 9
+        settings.ci.transport_compression_strategy = "rle"
+      end
+
+      it "passes the compression level and strategy to Agentless api" do
+        expect(Datadog::CI::Transport::Api::Agentless).to receive(:new).with(
+          hash_including(compression_level: Zlib::BEST_COMPRESSION, compression_strategy: Zlib::RLE)
         ).and_return(api)
 
         expect(subject).to eq(api)
@@ -125,7 +146,12 @@ RSpec.describe Datadog::CI::Transport::Api::Builder do
 
       it "creates and configures http client and EvpProxy" do
         expect(Datadog::CI::Transport::Api::EvpProxy).to(
-          receive(:new).with(agent_settings: agent_settings, path_prefix: "/evp_proxy/v2/").and_return(api)
+          receive(:new).with(
+            agent_settings: agent_settings,
+            path_prefix: "/evp_proxy/v2/",
+            compression_level: Zlib::DEFAULT_COMPRESSION,
+            compression_strategy: Zlib::DEFAULT_STRATEGY
+          ).and_return(api)
         )
 
         expect(subject).to eq(api)
@@ -141,7 +167,12 @@ RSpec.describe Datadog::CI::Transport::Api::Builder do
 
       it "creates and configures http client and EvpProxy" do
         expect(Datadog::CI::Transport::Api::EvpProxy).to(
-          receive(:new).with(agent_settings: agent_settings, path_prefix: "/evp_proxy/v4/").and_return(api)
+          receive(:new).with(
+            agent_settings: agent_settings,
+            path_prefix: "/evp_proxy/v4/",
+            compression_level: Zlib::DEFAULT_COMPRESSION,
+            compression_strategy: Zlib::DEFAULT_STRATEGY
+          ).and_return(api)
         )
 
         expect(subject).to eq(api)
@@ -50,10 +50,18 @@ RSpec.describe Datadog::CI::Transport::Api::EvpProxy do
         port: agent_settings.port,
         ssl: agent_settings.ssl,
         timeout: agent_settings.timeout_seconds,
-        compress: false
+        compress: false,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(intake_http, api_http)
     end
 
+    describe "#backend_id" do
+      it "identifies the agent" do
+        expect(subject.backend_id).to eq("localhost:5555/evp_proxy/v2/")
+      end
+    end
+
     describe "#citestcycle_request" do
       before do
         expect(Datadog::Core::Environment::Container).to receive(:container_id).and_return(container_id)
@@ -277,7 +285,9 @@ RSpec.describe Datadog::CI::Transport::Api::EvpProxy do
         port: agent_settings.port,
         ssl: agent_settings.ssl,
         timeout: agent_settings.timeout_seconds,
-        compress: true
+        compress: true,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(intake_http)
 
       expect(Datadog::CI::Transport::HTTP).to receive(:new).with(
@@ -285,7 +295,9 @@ RSpec.describe Datadog::CI::Transport::Api::EvpProxy do
         port: agent_settings.port,
         ssl: agent_settings.ssl,
         timeout: agent_settings.timeout_seconds,
-        compress: false
+        compress: false,
+        compression_level: Zlib::DEFAULT_COMPRESSION,
+        compression_strategy: Zlib::DEFAULT_STRATEGY
       ).and_return(api_http)
     end
 
@@ -0,0 +1,103 @@
+require "tmpdir"
+
+require_relative "../../../../lib/datadog/ci/transport/event_spool"
+
+RSpec.describe Datadog::CI::Transport::EventSpool do
+  subject(:spool) { described_class.new(dir: dir) }
+
+  let(:root) { Dir.mktmpdir }
+  let(:dir) { File.join(root, "citestcov") }
+
+  after { FileUtils.rm_rf(root) }
+
+  def drained(spool, max_batch_size = 1024)
+    batches = []
+    spool.drain(max_batch_size) { |encoded_events| batches << encoded_events }
+    batches
+  end
+
+  describe "#append" do
+    it "writes one segment per batch" do
+      expect(spool.append(["a", "bc"])).to be true
+      expect(spool.append(["def"])).to be true
+
+      expect(Dir.children(dir).size).to eq(2)
+      expect(spool).to be_pending
+    end
+
+    it "does not write empty batches" do
+      spool.append([])
+
+      expect(spool).not_to be_pending
+    end
+  end
+
+  describe "#drain" do
+    it "yields the events of all segments in the order they were written and deletes the segments" do
+      spool.append(["a", "bc"])
+      spool.append(["def"])
+
+      expect(drained(spool)).to eq([["a", "bc", "def"]])
+      expect(spool).not_to be_pending
+    end
+
+    it "yields batches of up to max_batch_size bytes" do
+      spool.append(["aaa", "bbb"])
+      spool.append(["ccc"])
+
+      expect(drained(spool, 6)).to eq([["aaa", "bbb"], ["ccc"]])
+    end
+
+    it "yields an event larger than max_batch_size on its own" do
+      spool.append(["a", "bbbbbbbb", "c"])
+
+      expect(drained(spool, 4)).to eq([["a"], ["bbbbbbbb"], ["c"]])
+    end
+
+    it "ignores segments that are still being written" do
+      FileUtils.mkdir_p(dir)
+      File.binwrite(File.join(dir, ".1-1-1.tmp"), "partial")
+
+      expect(drained(spool)).to eq([])
+    end
+
+    it "keeps binary events intact" do
+      event = MessagePack.pack({"files" => ["é.rb"]})
+      spool.append([event])
+
+      expect(drained(spool).flatten).to eq([event.b])
+    end
+  end
+
+  describe "#cleanup" do
+    it "removes the spool directory" do
+      spool.append(["a"])
+      spool.cleanup
+
+      expect(File.exist?(dir)).to be false
+    end
+
+    context "with the root directory created for the session" do
+      let(:root_dir) { root }
+      subject(:spool) { described_class.new(dir: dir, root_dir: root_dir) }
+
+      it "removes the root directory once it is empty" do
+        spool.append(["a"])
+        spool.cleanup
+
+        expect(File.exist?(root_dir)).to be false
+      end
+
+      it "keeps the root directory when other spools use it" do
+        other_spool = described_class.new(dir: File.join(root_dir, "other"), root_dir: root_dir)
+        other_spool.append(["b"])
+
+        spool.append(["a"])
+        spool.cleanup
+
+        expect(File.exist?(dir)).to be false
+        expect(other_spool.pending?).to be true
+      end
+    end
+  end
+end
@@ -1,4 +1,5 @@
 require_relative "../../../../lib/datadog/ci/transport/gzip"
+require_relative "../../../../lib/datadog/ci/transport/streaming_payload"
 
 RSpec.describe Datadog::CI::Transport::Gzip do
   let(:input) do
@@ -36,6 +37,54 @@ RSpec.describe Datadog::CI::Transport::Gzip do
     end
   end
 
+  describe ".compress with options" do
+    it "produces the same bytes for the same input" do
+      expect(described_class.compress(input)).to eq(described_class.compress(input))
+    end
+
+    it "supports compression levels and strategies" do
+      best = described_class.compress(input, level: Zlib::BEST_COMPRESSION, strategy: Zlib::FILTERED)
+      stored = described_class.compress(input, level: Zlib::NO_COMPRESSION)
+
+      expect(described_class.decompress(best)).to eq(input)
+      expect(described_class.decompress(stored)).to eq(input)
+      expect(stored.bytesize).to be > input.bytesize
+    end
+  end
+
+  describe ".compress with a streaming payload" do
+    let(:payload) do
+      Datadog::CI::Transport::StreamingPayload.new.tap do |payload|
+        input.each_line { |line| payload << line }
+      end
+    end
+
+    it "compresses the payload like the joined input" do
+      expect(described_class.compress(payload)).to eq(described_class.compress(input))
+    end
+
+    it "rewinds the payload" do
+      described_class.compress(payload)
+
+      expect(payload.read).to eq(input.b)
+    end
+  end
+
+  describe Datadog::CI::Transport::Gzip::Compressor do
+    subject(:compressor) { described_class.new }
+
+    it "compresses chunks like the joined input" do
+      input.each_line { |line| compressor << line }
+
+      expect(compressor.input_size).to eq(input.bytesize)
+      expect(compressor.finish).to eq(Datadog::CI::Transport::Gzip.compress(input))
+    end
+
+    it "produces a valid gzip stream without input" do
+      expect(Datadog::CI::Transport::Gzip.decompress(compressor.finish)).to eq("")
+    end
+  end
+
   describe ".decompress" do
     subject { described_class.decompress(compressed_input) }
 
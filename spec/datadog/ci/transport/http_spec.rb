@@ -1,4 +1,5 @@
 require_relative "../../../../lib/datadog/ci/transport/http"
+require_relative "../../../../lib/datadog/ci/transport/streaming_payload"
 
 RSpec.describe Datadog::CI::Transport::HTTP do
   subject(:transport) { described_class.new(host: host, port: port, **options) }
@@ -80,6 +81,21 @@ RSpec.describe Datadog::CI::Transport::HTTP do
         it { is_expected.to have_attributes(compress: true) }
       end
     end
+
+    context "given compression options" do
+      let(:options) { {compress: true, compression_level: Zlib::BEST_SPEED, compression_strategy: Zlib::FILTERED} }
+
+      it { is_expected.to have_attributes(compression_level: Zlib::BEST_SPEED, compression_strategy: Zlib::FILTERED) }
+    end
+
+    context "without compression options" do
+      it do
+        is_expected.to have_attributes(
+          compression_level: Zlib::DEFAULT_COMPRESSION,
+          compression_strategy: Zlib::DEFAULT_STRATEGY
+        )
+      end
+    end
   end
 
   describe "#request" do
@@ -159,6 +175,15 @@ RSpec.describe Datadog::CI::Transport::HTTP do
         expect(response.request_compressed).to eq(true)
         expect(response.request_size).to eq(expected_payload.bytesize)
       end
+
+      context "with a streaming payload" do
+        let(:payload) { Datadog::CI::Transport::StreamingPayload.new << '{ "key": ' << '"value" }' }
+        let(:expected_payload) { Datadog::CI::Transport::Gzip.compress('{ "key": "value" }') }
+
+        it "compresses the payload as it is read" do
+          expect(response.request_size).to eq(expected_payload.bytesize)
+        end
+      end
     end
 
     context "when request fails" do
@@ -0,0 +1,104 @@
+require_relative "../../../../lib/datadog/ci/transport/payload_builder"
+
+RSpec.describe Datadog::CI::Transport::PayloadBuilder do
+  subject(:builder) { described_class.new(header, max_payload_size) }
+
+  # {"events" => [...]}
+  let(:header) { MessagePack.pack({"events" => []}).byteslice(0, 8) }
+  let(:max_payload_size) { 1024 }
+
+  def encoded(value)
+    MessagePack.pack(value)
+  end
+
+  describe "#payloads" do
+    it "returns nothing when no events were added" do
+      expect(builder.payloads).to eq([])
+    end
+
+    it "writes the header and all events into one payload" do
+      builder << encoded({"id" => 1}) << encoded({"id" => 2})
+
+      payloads = builder.payloads
+      expect(payloads.size).to eq(1)
+
+      payload, events_count = payloads.first
+      expect(events_count).to eq(2)
+      expect(payload.encoding).to eq(Encoding::BINARY)
+      expect(MessagePack.unpack(payload)).to eq("events" => [{"id" => 1}, {"id" => 2}])
+    end
+
+    context "when events exceed max_payload_size" do
+      # every event is 10 bytes, the header is not counted
+      let(:max_payload_size) { 25 }
+      let(:event) { encoded("x" * 8) }
+
+      it "seals the payload before the event that does not fit" do
+        5.times { builder << event }
+
+        payloads = builder.payloads
+        expect(payloads.map(&:last)).to eq([2, 2, 1])
+        payloads.each do |payload, events_count|
+          expect(MessagePack.unpack(payload)).to eq("events" => Array.new(events_count) { "x" * 8 })
+        end
+      end
+
+      it "puts a single event larger than max_payload_size in its own payload" do
+        builder << event << encoded("y" * 40) << event
+
+        expect(builder.payloads.map(&:last)).to eq([1, 1, 1])
+      end
+    end
+
+    it "does not reopen sealed payloads" do
+      builder << encoded(1)
+      first_payloads = builder.payloads.dup
+
+      builder << encoded(2)
+
+      expect(builder.payloads.map { |payload, _| MessagePack.unpack(payload) }).to eq(
+        first_payloads.map { |payload, _| MessagePack.unpack(payload) } + [{"events" => [2]}]
+      )
+    end
+  end
+
+  describe "#write" do
+    let(:max_payload_size) { 25 }
+
+    def write(value)
+      builder.write { |buffer| buffer << encoded(value) }
+    end
+
+    it "adds the event written into the buffer to the current payload" do
+      expect(write("x" * 8)).to be_nil
+      expect(write("y" * 8)).to be_nil
+      builder << encoded("z" * 8)
+
+      expect(builder.payloads.map { |payload, events_count| [MessagePack.unpack(payload), events_count] }).to eq(
+        [[{"events" => ["x" * 8, "y" * 8]}, 2], [{"events" => ["z" * 8]}, 1]]
+      )
+    end
+
+    it "returns an event larger than max_payload_size without adding it to a payload" do
+      write("x" * 8)
+
+      expect(write("y" * 40)).to eq(encoded("y" * 40))
+      expect(builder.payloads.map(&:last)).to eq([1])
+    end
+
+    it "removes a partially written event when the block raises" do
+      write("x" * 8)
+
+      expect do
+        builder.write do |buffer|
+          buffer << "partial"
+          raise ArgumentError
+        end
+      end.to raise_error(ArgumentError)
+
+      payload, events_count = builder.payloads.first
+      expect(events_count).to eq(1)
+      expect(MessagePack.unpack(payload)).to eq("events" => ["x" * 8])
+    end
+  end
+end
@@ -0,0 +1,93 @@
+# frozen_string_literal: true
+
+require "tmpdir"
+
+require_relative "../../../../lib/datadog/ci/transport/streaming_payload"
+
+RSpec.describe Datadog::CI::Transport::StreamingPayload do
+  subject(:payload) { described_class.new }
+
+  let(:tmpdir) { Dir.mktmpdir }
+  let(:filepath) { File.join(tmpdir, "packfile.pack") }
+  let(:file_contents) { "\x00\x01packfile".b * 10_000 }
+
+  before do
+    File.binwrite(filepath, file_contents)
+
+    payload << "head\r\n"
+    payload.append_file(filepath)
+    payload << "\r\ntail"
+  end
+
+  after do
+    payload.close
+    FileUtils.remove_entry(tmpdir)
+  end
+
+  let(:expected_contents) { "head\r\n".b + file_contents + "\r\ntail".b }
+
+  describe "#bytesize" do
+    it "returns the size of strings and files" do
+      expect(payload.bytesize).to eq(expected_contents.bytesize)
+      expect(payload.size).to eq(expected_contents.bytesize)
+    end
+  end
+
+  describe "#read" do
+    it "reads the whole payload" do
+      expect(payload.read).to eq(expected_contents)
+      expect(payload.read).to eq("")
+    end
+
+    it "reads the payload in chunks across segments" do
+      buffer = +""
+      chunks = []
+      while (chunk = payload.read(7_000, buffer))
+        expect(chunk).to be(buffer)
+        chunks << chunk.dup
+      end
+
+      expect(chunks.map(&:bytesize).max).to eq(7_000)
+      expect(chunks.join).to eq(expected_contents)
+    end
+
+    it "is readable with IO.copy_stream" do
+      output = StringIO.new(+"".b)
+      IO.copy_stream(payload, output)
+
+      expect(output.string).to eq(expected_contents)
+    end
+
+    context "when the file is removed after it was appended" do
+      before { File.delete(filepath) }
+
+      it "reads the file contents" do
+        expect(payload.read).to eq(expected_contents)
+      end
+    end
+  end
+
+  describe "#rewind" do
+    it "reads the payload again" do
+      payload.read(10)
+      payload.rewind
+
+      expect(payload.read).to eq(expected_contents)
+    end
+  end
+
+  describe "#to_s" do
+    it "returns the whole payload" do
+      payload.read(10)
+
+      expect(payload.to_s).to eq(expected_contents)
+      expect(payload.read).to eq(expected_contents)
+    end
+  end
+
+  describe "#append_file" do
+    it "raises when the file does not exist" do
+      expect { payload.append_file(File.join(tmpdir, "nonexistent")) }.to raise_error(Errno::ENOENT)
+    end
+  end
+end
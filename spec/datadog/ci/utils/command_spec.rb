@@ -335,4 +335,63 @@ RSpec.describe Datadog::CI::Utils::Command do
       end
     end
   end
+
+  describe ".stream_command" do
+    context "when command produces large output" do
+      let(:large_content) { "line\n" * 200_000 }
+      let(:large_file) { File.join(temp_dir, "large.txt") }
+
+      before do
+        File.write(large_file, large_content)
+      end
+
+      it "yields the output in chunks" do
+        chunks_count = 0
+        streamed = +""
+
+        output_head, status = described_class.stream_command(["cat", large_file]) do |chunk|
+          chunks_count += 1
+          streamed << chunk
+        end
+
+        expect(status).to be_success
+        expect(streamed).to eq(large_content)
+        expect(chunks_count).to be > 1
+        expect(output_head.bytesize).to be <= described_class::BUFFER_SIZE
+      end
+    end
+
+    context "when command fails" do
+      it "returns error output and failure status" do
+        output_head, status = described_class.stream_command(["ls", "/nonexistent/directory"]) {}
+
+        expect(output_head).to include("No such file or directory")
+        expect(status).not_to be_success
+      end
+    end
+
+    context "when command times out" do
+      it "kills the process and returns timeout message" do
+        output_head, status = described_class.stream_command(["sleep", "10"], timeout: 1) {}
+
+        expect(output_head).to eq("Command timed out after 1 seconds")
+        expect(status).not_to be_success
+      end
+    end
+
+    context "when the block raises" do
+      it "terminates the command" do
+        thread = nil
+        allow(Open3).to receive(:popen2e).and_wrap_original do |original, *args|
+          original.call(*args).tap { |result| thread = result.last }
+        end
+
+        expect do
+          described_class.stream_command(["yes"]) { raise ArgumentError, "stop" }
+        end.to raise_error(ArgumentError, "stop")
+
+        expect(thread.join(5)).not_to be_nil
+      end
+    end
+  end
 end
@@ -84,4 +84,46 @@ RSpec.describe ::Datadog::CI::Utils::Configuration do
       end
     end
   end
+
+  describe ".normalize_transport_compression_level" do
+    subject(:normalize_transport_compression_level) { described_class.normalize_transport_compression_level(level) }
+
+    context "when level is valid" do
+      let(:level) { 6 }
+
+      it { is_expected.to eq(6) }
+    end
+
+    context "when level is out of range" do
+      let(:level) { 42 }
+
+      it "logs a warning and returns the default level" do
+        expect(Datadog.logger).to receive(:warn).with(/Invalid transport compression level/)
+
+        expect(normalize_transport_compression_level).to eq(-1)
+      end
+    end
+  end
+
+  describe ".normalize_transport_compression_strategy" do
+    subject(:normalize_transport_compression_strategy) do
+      described_class.normalize_transport_compression_strategy(strategy)
+    end
+
+    context "when strategy is valid" do
+      let(:strategy) { "huffman_only" }
+
+      it { is_expected.to eq("huffman_only") }
+    end
+
+    context "when strategy is invalid" do
+      let(:strategy) { "invalid" }
+
+      it "logs a warning and returns the default strategy" do
+        expect(Datadog.logger).to receive(:warn).with(/Invalid transport compression strategy/)
+
+        expect(normalize_transport_compression_strategy).to eq("default")
+      end
+    end
+  end
 end
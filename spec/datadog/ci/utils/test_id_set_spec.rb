@@ -0,0 +1,85 @@
+require_relative "../../../../lib/datadog/ci/utils/test_id_set"
+
+RSpec.describe ::Datadog::CI::Utils::TestIdSet do
+  subject(:test_id_set) { described_class.new(["SomeSuite.test_a.", "SomeSuite.test_b.{\"arguments\":{}}"]) }
+
+  describe "#include?" do
+    it "finds tests by datadog test id" do
+      expect(test_id_set).to include("SomeSuite.test_a.")
+      expect(test_id_set).to include("SomeSuite.test_b.{\"arguments\":{}}")
+      expect(test_id_set).not_to include("SomeSuite.test_b.")
+      expect(test_id_set).not_to include(nil)
+    end
+  end
+
+  describe "#include_test?" do
+    it "finds tests by name, suite and parameters" do
+      expect(test_id_set.include_test?("test_a", "SomeSuite")).to be true
+      expect(test_id_set.include_test?("test_b", "SomeSuite", "{\"arguments\":{}}")).to be true
+      expect(test_id_set.include_test?("test_b", "SomeSuite")).to be false
+      expect(test_id_set.include_test?("test_a", "OtherSuite")).to be false
+    end
+  end
+
+  describe "#add_test" do
+    it "adds the same test as its datadog test id" do
+      set = described_class.new.add_test("test_c", "SomeSuite", nil)
+
+      expect(set.size).to eq(1)
+      expect(set).to include(Datadog::CI::Utils::TestRun.datadog_test_id("test_c", "SomeSuite"))
+    end
+  end
+
+  describe "#merge!" do
+    it "merges other sets and collections of test ids" do
+      test_id_set.merge!(described_class.new(["SomeSuite.test_a.", "OtherSuite.test_a."]))
+      test_id_set.merge!(Set.new(["OtherSuite.test_b."]))
+
+      expect(test_id_set.size).to eq(4)
+      expect(test_id_set.include_test?("test_b", "OtherSuite")).to be true
+    end
+
+    it "keeps all tests of large sets" do
+      ids = Array.new(100_000) { |i| "Suite#{i % 100}.test_#{i}." }
+      set = described_class.new.merge!(ids)
+
+      expect(set.size).to eq(ids.size)
+      expect(ids.all? { |id| set.include?(id) }).to be true
+      expect(set.include?("Suite0.test_100000.")).to be false
+    end
+  end
+
+  describe "#==" do
+    it "compares with other sets and collections of test ids" do
+      expect(test_id_set).to eq(described_class.new(["SomeSuite.test_b.{\"arguments\":{}}", "SomeSuite.test_a."]))
+      expect(test_id_set).to eq(Set.new(["SomeSuite.test_a.", "SomeSuite.test_b.{\"arguments\":{}}"]))
+      expect(test_id_set).not_to eq(Set.new(["SomeSuite.test_a."]))
+      expect(described_class.new).to eq(Set.new)
+    end
+  end
+
+  describe "#dup" do
+    it "does not share tests with the copy" do
+      copy = test_id_set.dup << "OtherSuite.test_a."
+
+      expect(copy.size).to eq(3)
+      expect(test_id_set.size).to eq(2)
+    end
+  end
+
+  describe "Marshal" do
+    it "restores the set" do
+      restored = Marshal.load(Marshal.dump(test_id_set))
+
+      expect(restored).to be_a(described_class)
+      expect(restored).to eq(test_id_set)
+      expect(restored.include_test?("test_a", "SomeSuite")).to be true
+    end
+  end
+
+  describe "#inspect" do
+    it "does not list the tests" do
+      expect(test_id_set.inspect).to eq("#<Datadog::CI::Utils::TestIdSet size=2>")
+    end
+  end
+end
@@ -0,0 +1,86 @@
+# frozen_string_literal: true
+
+require "objspace"
+
+require "datadog_ci_native.#{RUBY_VERSION}_#{RUBY_PLATFORM}"
+
+RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::CoveredFiles do
+  subject(:covered_files) { described_class.new }
+
+  let(:first_path) { "/project/lib/covered_files_first.rb" }
+  let(:second_path) { "/project/lib/covered_files_second.rb" }
+
+  it "is empty when created" do
+    expect(covered_files).to be_empty
+    expect(covered_files.size).to eq(0)
+    expect(covered_files.keys).to eq([])
+    expect(covered_files).to eq({})
+  end
+
+  it "adds every file once" do
+    covered_files[first_path] = true
+    covered_files[second_path] = true
+    covered_files[first_path] = true
+
+    expect(covered_files.size).to eq(2)
+    expect(covered_files.keys).to contain_exactly(first_path, second_path)
+    expect(covered_files.key?(first_path)).to be(true)
+    expect(covered_files.key?("/project/lib/not_covered.rb")).to be(false)
+    expect(covered_files.to_h).to eq(first_path => true, second_path => true)
+  end
+
+  it "returns frozen interned paths" do
+    path = +"/project/lib/covered_files_mutable.rb"
+    covered_files[path] = true
+    path << "_changed"
+
+    expect(covered_files.keys).to eq(["/project/lib/covered_files_mutable.rb"])
+    expect(covered_files.keys.first).to be_frozen
+  end
+
+  it "iterates paths with each_key" do
+    covered_files[first_path] = true
+
+    expect(covered_files.each_key.to_a).to eq([first_path])
+    yielded = []
+    covered_files.each_key { |path| yielded << path }
+    expect(yielded).to eq([first_path])
+  end
+
+  it "merges other covered files and hashes" do
+    other = described_class.new
+    other[second_path] = true
+    covered_files[first_path] = true
+
+    covered_files.merge!(other)
+    covered_files.merge!("/project/lib/covered_files_third.rb" => true)
+
+    expect(covered_files.size).to eq(3)
+    expect(covered_files.keys).to include(first_path, second_path, "/project/lib/covered_files_third.rb")
+    expect(other.size).to eq(1)
+  end
+
+  it "copies the set on dup" do
+    covered_files[first_path] = true
+    copy = covered_files.dup
+    copy[second_path] = true
+
+    expect(covered_files.size).to eq(1)
+    expect(copy.size).to eq(2)
+    expect(copy).not_to eq(covered_files)
+    expect(covered_files.dup).to eq(covered_files)
+  end
+
+  it "does not grow the bitmaps for paths packed by FileSerialization" do
+    covered_files[first_path] = true
+    memsize = ObjectSpace.memsize_of(covered_files)
+
+    serialized_paths = Array.new(1_000) { |i| "/project/lib/serialized_only_#{i}.rb" }
+    Datadog::CI::FileSerialization.pack_files(serialized_paths.to_h { |path| [path, true] }, ["custom.rb"], "/project")
+
+    other = described_class.new
+    other[first_path] = true
+    expect(ObjectSpace.memsize_of(other)).to eq(memsize)
+    expect(other.key?(serialized_paths.first)).to be(false)
+  end
+end
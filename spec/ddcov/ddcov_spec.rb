@@ -2,10 +2,15 @@
 
 require "datadog_ci_native.#{RUBY_VERSION}_#{RUBY_PLATFORM}"
 
+require "fileutils"
+require "tmpdir"
+
 require_relative "app/model/my_model"
 require_relative "app/model/my_model_❤️"
 require_relative "app/model/my_struct"
 require_relative "app/model/dynamic_model"
+require_relative "app/model/extensible_model"
+require_relative "app/concerns/auditable"
 require_relative "calculator/calculator"
 require_relative "calculator/code_with_❤️"
 
@@ -13,13 +18,15 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::DDCov do
   let(:ignored_path) { nil }
   let(:threading_mode) { :multi }
   let(:use_allocation_tracing) { true }
+  let(:line_tracing_mode) { :global }
 
   subject do
     described_class.new(
       root: root,
       ignored_path: ignored_path,
       threading_mode: threading_mode,
-      use_allocation_tracing: use_allocation_tracing
+      use_allocation_tracing: use_allocation_tracing,
+      line_tracing_mode: line_tracing_mode
     )
   end
 
@@ -161,6 +168,16 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::DDCov do
         expect(coverage.keys).to include(absolute_path("calculator/operations/subtract.rb"))
       end
 
+      it "collects the same files again in the next test" do
+        2.times do
+          subject.start
+          expect(calculator.add(1, 2)).to eq(3)
+          coverage = subject.stop
+          expect(coverage.size).to eq(1)
+          expect(coverage.keys).to include(absolute_path("calculator/operations/add.rb"))
+        end
+      end
+
       it "does not track coverage when stopped" do
         subject.start
         expect(calculator.add(1, 2)).to eq(3)
@@ -383,6 +400,49 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::DDCov do
             expect(coverage.keys).to include(absolute_path("calculator/operations/multiply.rb"))
           end
 
+          it "attributes coverage to the collector of the thread that runs the test" do
+            ready = Thread::Queue.new
+            go = Thread::Queue.new
+            done = Thread::Queue.new
+            release = Thread::Queue.new
+
+            # both collectors are active while both tests run
+            run_test = lambda do |&test|
+              Thread.new do
+                cov = thread_local_cov
+                cov.start
+                ready << :ready
+                go.pop
+
+                test.call
+
+                done << :done
+                release.pop
+                cov.stop
+              end
+            end
+
+            t1 = run_test.call { expect(calculator.add(1, 2)).to eq(3) }
+            # threads spawned by the test belong to the test
+            t2 = run_test.call { expect(Thread.new { calculator.multiply(1, 2) }.value).to eq(2) }
+
+            2.times { ready.pop }
+            2.times { go << :go }
+            2.times { done.pop }
+            # threads that are not owned by any test are attributed to all tests
+            expect(calculator.subtract(1, 2)).to eq(-1)
+            2.times { release << :release }
+
+            expect(t1.value.keys).to contain_exactly(
+              absolute_path("calculator/operations/add.rb"),
+              absolute_path("calculator/operations/subtract.rb")
+            )
+            expect(t2.value.keys).to contain_exactly(
+              absolute_path("calculator/operations/multiply.rb"),
+              absolute_path("calculator/operations/subtract.rb")
+            )
+          end
+
           it "collects distinct dynamic sources executed by many threads" do
             root = absolute_path("dynamic/threaded")
             collector = described_class.new(
@@ -418,6 +478,147 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::DDCov do
       end
     end
 
+    context "when line tracing mode is iseq" do
+      let(:root) { absolute_path("calculator") }
+      let(:line_tracing_mode) { :iseq }
+      let(:use_allocation_tracing) { false }
+
+      it "collects code coverage including Calculator and operations" do
+        subject.start
+
+        expect(calculator.add(1, 2)).to eq(3)
+        expect(calculator.subtract(1, 2)).to eq(-1)
+
+        coverage = subject.stop
+
+        expect(coverage.size).to eq(3)
+        expect(coverage.keys).to include(
+          absolute_path("calculator/calculator.rb"),
+          absolute_path("calculator/operations/add.rb"),
+          absolute_path("calculator/operations/subtract.rb")
+        )
+      end
+
+      it "re-arms files that were covered by the previous test" do
+        subject.start
+        expect(calculator.add(1, 2)).to eq(3)
+        first_coverage = subject.stop
+
+        subject.start
+        expect(calculator.add(1, 2)).to eq(3)
+        second_coverage = subject.stop
+
+        expect(first_coverage.keys).to include(absolute_path("calculator/operations/add.rb"))
+        expect(second_coverage.keys).to include(absolute_path("calculator/operations/add.rb"))
+      end
+
+      it "does not track coverage when stopped but traces the file in the next test" do
+        subject.start
+        subject.stop
+
+        expect(calculator.multiply(1, 2)).to eq(2)
+
+        subject.start
+        expect(calculator.subtract(1, 2)).to eq(-1)
+        expect(calculator.multiply(1, 2)).to eq(2)
+        coverage = subject.stop
+
+        expect(coverage.size).to eq(3)
+        expect(coverage.keys).to include(
+          absolute_path("calculator/operations/subtract.rb"),
+          absolute_path("calculator/operations/multiply.rb")
+        )
+      end
+
+      it "tracks coverage in mixins" do
+        subject.start
+        expect(calculator.divide(6, 3)).to eq(2)
+        coverage = subject.stop
+
+        expect(coverage.keys).to include(absolute_path("calculator/operations/divide.rb"))
+        expect(coverage.keys).to include(absolute_path("calculator/operations/helpers/calculator_logger.rb"))
+      end
+
+      it "collects coverage for background threads" do
+        subject.start
+        Thread.new { expect(calculator.add(1, 2)).to eq(3) }.join
+        coverage = subject.stop
+
+        expect(coverage.keys).to include(absolute_path("calculator/operations/add.rb"))
+      end
+
+      it "records a file for every collector that is active when the file is executed" do
+        other_collector = described_class.new(root: root, threading_mode: :multi, line_tracing_mode: :iseq)
+
+        subject.start
+        other_collector.start
+        expect(calculator.add(1, 2)).to eq(3)
+        coverage = subject.stop
+
+        expect(calculator.subtract(1, 2)).to eq(-1)
+        other_coverage = other_collector.stop
+
+        expect(coverage.keys).to include(absolute_path("calculator/operations/add.rb"))
+        expect(coverage.keys).not_to include(absolute_path("calculator/operations/subtract.rb"))
+        expect(other_coverage.keys).to include(
+          absolute_path("calculator/operations/add.rb"),
+          absolute_path("calculator/operations/subtract.rb")
+        )
+      end
+
+      context "when files are loaded after coverage was started" do
+        let(:root) { Dir.mktmpdir }
+
+        after { FileUtils.remove_entry(root) }
+
+        it "collects coverage for the loaded files" do
+          late_file = File.join(root, "late_loaded.rb")
+          File.write(late_file, "module DDCovLateLoaded\n  def self.call\n    42\n  end\nend\n")
+
+          subject.start
+          subject.stop
+
+          load late_file
+
+          subject.start
+          expect(DDCovLateLoaded.call).to eq(42)
+          coverage = subject.stop
+
+          expect(coverage.keys).to eq([late_file])
+        ensure
+          Object.send(:remove_const, :DDCovLateLoaded) if Object.const_defined?(:DDCovLateLoaded, false)
+        end
+      end
+
+      context "in single threaded coverage mode" do
+        let(:threading_mode) { :single }
+
+        it "does not record files executed by other threads" do
+          subject.start
+          Thread.new { expect(calculator.add(1, 2)).to eq(3) }.join
+          expect(calculator.multiply(1, 2)).to eq(2)
+          coverage = subject.stop
+
+          expect(coverage.keys).not_to include(absolute_path("calculator/operations/add.rb"))
+          expect(coverage.keys).to include(absolute_path("calculator/operations/multiply.rb"))
+
+          subject.start
+          expect(calculator.add(1, 2)).to eq(3)
+          coverage = subject.stop
+
+          expect(coverage.keys).to include(absolute_path("calculator/operations/add.rb"))
+        end
+      end
+
+      context "when line tracing mode is invalid" do
+        let(:line_tracing_mode) { :invalid_mode }
+
+        it "raises an error" do
+          expect { subject }.to raise_error(ArgumentError, "line tracing mode is invalid")
+        end
+      end
+    end
+
     context "when dynamic source filenames stress the line-event cache" do
       let(:root) { absolute_path("dynamic/included") }
       let(:use_allocation_tracing) { false }
@@ -586,6 +787,48 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::DDCov do
           expect(coverage.keys).to include(absolute_path("app/concerns/queryable.rb"))
         end
 
+        it "tracks coverage for the same class in consecutive tests" do
+          2.times do
+            subject.start
+            MyModel.new
+            coverage = subject.stop
+
+            expect(coverage.size).to eq(4)
+            expect(coverage.keys).to include(absolute_path("app/model/my_model.rb"))
+          end
+        end
+
+        it "tracks modules included into an indexed class" do
+          subject.start
+          ExtensibleModel.new
+          coverage = subject.stop
+          expect(coverage.keys).to eq([absolute_path("app/model/extensible_model.rb")])
+
+          ExtensibleModel.include(Auditable)
+
+          subject.start
+          ExtensibleModel.new
+          coverage = subject.stop
+          expect(coverage.keys).to contain_exactly(
+            absolute_path("app/model/extensible_model.rb"),
+            absolute_path("app/concerns/auditable.rb")
+          )
+        end
+
+        it "tracks classes defined after coverage was started" do
+          subject.start
+          subject.stop
+
+          Object.const_set(:LateDefinedModel, Class.new(MyModel))
+
+          subject.start
+          LateDefinedModel.new
+          coverage = subject.stop
+          expect(coverage.keys).to include(absolute_path("app/model/my_model.rb"))
+        ensure
+          Object.send(:remove_const, :LateDefinedModel) if Object.const_defined?(:LateDefinedModel)
+        end
+
         it "tracks coverage for structs" do
           subject.start
 
@@ -876,4 +1119,69 @@ RSpec.describe Datadog::CI::TestImpactAnalysis::Coverage::DDCov do
       end
     end
   end
+
+  describe "#stats" do
+    let!(:calculator) { Calculator.new }
+    let(:root) { absolute_path("calculator/operations") }
+    let(:use_allocation_tracing) { false }
+
+    it "starts with all counters at zero" do
+      stats = subject.stats
+
+      expect(stats).to include(:line_events, :newobj_events, :stop_calls, :stop_time_ns)
+      expect(stats.values.uniq).to eq([0])
+    end
+
+    it "counts line events and path classification" do
+      subject.start
+      2.times { calculator.add(1, 2) }
+      subject.stop
+
+      stats = subject.stats
+      expect(stats[:line_events]).to be > 0
+      expect(stats[:line_fast_path_hits]).to be > 0
+      expect(stats[:profile_frames_calls]).to be > 0
+      # calculator.rb and this spec file are outside of root
+      expect(stats[:excluded_path_verdicts]).to be >= 2
+      expect(stats[:line_direct_cache_hits] + stats[:line_table_hits]).to be > 0
+      expect(stats[:stop_calls]).to eq(1)
+      expect(stats[:stop_time_ns]).to be > 0
+      expect(stats[:stop_max_time_ns]).to be <= stats[:stop_time_ns]
+    end
+
+    it "does not classify a file again in the next test" do
+      2.times do
+        subject.start
+        calculator.add(1, 2)
+        subject.stop
+      end
+      first_profile_frames_calls = subject.stats[:profile_frames_calls]
+
+      subject.start
+      calculator.add(1, 2)
+      subject.stop
+
+      stats = subject.stats
+      expect(stats[:profile_frames_calls]).to eq(first_profile_frames_calls)
+      expect(stats[:stop_calls]).to eq(3)
+    end
+
+    context "when allocation tracing is enabled" do
+      let(:root) { absolute_path("app") }
+      let(:use_allocation_tracing) { true }
+
+      it "counts allocation events and class cache hits" do
+        2.times do
+          subject.start
+          3.times { MyModel.new }
+          subject.stop
+        end
+
+        stats = subject.stats
+        expect(stats[:newobj_events]).to be >= 6
+        expect(stats[:klass_cache_hits]).to be >= 4
+        expect(stats[:klass_index_hits] + stats[:klass_index_misses]).to be >= 2
+      end
+    end
+  end
 end
@@ -28,6 +28,7 @@ RSpec.shared_context "CI mode activated" do
   let(:itr_enabled) { false }
   let(:code_coverage_enabled) { false }
   let(:static_dependencies_tracking_enabled) { false }
+  let(:static_dependencies_cache_enabled) { false }
   let(:tests_skipping_enabled) { false }
   let(:git_metadata_upload_enabled) { false }
   let(:require_git) { false }
@@ -140,7 +141,9 @@ RSpec.shared_context "CI mode activated" do
     allow_any_instance_of(Datadog::CI::TestImpactAnalysis::Skippable).to receive(:fetch_skippables).and_return(skippable_tests_response)
     allow_any_instance_of(Datadog::CI::TestImpactAnalysis::Coverage::Transport).to receive(:send_events).and_return([])
 
-    allow_any_instance_of(Datadog::CI::TestTracing::KnownTests).to receive(:fetch).and_return(known_tests)
+    allow_any_instance_of(Datadog::CI::TestTracing::KnownTests).to receive(:fetch).and_return(
+      Datadog::CI::Utils::TestIdSet.new(known_tests)
+    )
 
     allow_any_instance_of(Datadog::CI::TestManagement::TestsProperties).to receive(:fetch).and_return(test_properties)
 
@@ -177,6 +180,7 @@ RSpec.shared_context "CI mode activated" do
       c.ci.itr_code_coverage_excluded_bundle_path = bundle_path
       c.ci.itr_code_coverage_use_single_threaded_mode = use_single_threaded_coverage
       c.ci.tia_static_dependencies_tracking_enabled = static_dependencies_tracking_enabled
+      c.ci.tia_static_dependencies_cache_enabled = static_dependencies_cache_enabled
 
       # test retries
       c.ci.retry_failed_tests_max_attempts = retry_failed_tests_max_attempts